@@ -0,0 +1,173 @@
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+
+#define MAX(a,b) ((a) > (b) ? (a) : (b))
+#define MIN(a,b) ((a) < (b) ? (a) : (b))
+
+/* chunks are at most this big, unless a single page is bigger */
+#define CHUNK_BYTES (1 << 20)
+
+static size_t chunk_bytes(arena_t *a) {
+  return MAX(1, (a->mask + 1) * a->size);
+}
+
+/* Resizes the arrays kept per page to nmemb entries. Shrinking them
+ * can't fail, as the old arrays are kept if realloc() does.
+ */
+static int arena_realloc(arena_t *a, size_t nmemb) {
+  uint64_t *key;
+  uint8_t *in_use;
+  size_t *free;
+
+  nmemb = MAX(nmemb, 1);
+
+  key = realloc(a->key, nmemb * sizeof(uint64_t));
+  if (key)
+    a->key = key;
+  in_use = realloc(a->in_use, nmemb);
+  if (in_use)
+    a->in_use = in_use;
+  free = realloc(a->free, nmemb * sizeof(size_t));
+  if (free)
+    a->free = free;
+
+  return key && in_use && free ? 0 : -1;
+}
+
+arena_t *arena_new(size_t size, size_t nmemb) {
+  arena_t *a;
+  size_t pages;
+
+  a = calloc(1, sizeof(arena_t));
+  if (!a)
+    return NULL;
+
+  /* the largest power of two pages that fits in a chunk, but no more
+     than needed for nmemb pages */
+  a->size = size;
+  a->shift = 0;
+  pages = size ? CHUNK_BYTES / size : CHUNK_BYTES;
+  while ((2UL << a->shift) <= pages && (1UL << a->shift) < nmemb)
+    a->shift++;
+  a->mask = (1UL << a->shift) - 1;
+
+  if (arena_resize(a, nmemb, NULL, NULL)) {
+    arena_free(&a);
+    return NULL;
+  }
+
+  return a;
+}
+
+void arena_free(arena_t **a) {
+  size_t i;
+
+  if (!a || !*a)
+    return;
+  for (i=0; i<(*a)->nchunks; i++)
+    free((*a)->chunk[i]);
+  free((*a)->chunk);
+  free((*a)->key);
+  free((*a)->in_use);
+  free((*a)->free);
+  free(*a);
+  *a = NULL;
+}
+
+int arena_alloc(arena_t *a, uint64_t key, size_t *slot) {
+  if (a->nfree)
+    *slot = a->free[--a->nfree];
+  else if (a->active < a->nmemb)
+    *slot = a->active++;
+  else
+    return 1;
+
+  a->key[*slot] = key;
+  a->in_use[*slot] = 1;
+  a->used++;
+
+  return 0;
+}
+
+void arena_release(arena_t *a, size_t slot) {
+  a->in_use[slot] = 0;
+  a->free[a->nfree++] = slot;
+  a->used--;
+}
+
+static int arena_grow(arena_t *a, size_t nmemb) {
+  size_t nchunks, i;
+  char **chunk;
+
+  if (arena_realloc(a, nmemb))
+    return -1;
+
+  nchunks = (nmemb + a->mask) >> a->shift;
+  chunk = realloc(a->chunk, MAX(nchunks, 1) * sizeof(char *));
+  if (!chunk)
+    return -1;
+  a->chunk = chunk;
+
+  for (i=a->nchunks; i<nchunks; i++) {
+    a->chunk[i] = malloc(chunk_bytes(a));
+    if (!a->chunk[i]) {
+      while (i-- > a->nchunks)
+        free(a->chunk[i]);
+      return -1;
+    }
+  }
+
+  memset(a->in_use + a->nmemb, 0, nmemb - a->nmemb);
+  a->nchunks = nchunks;
+  a->nmemb = nmemb;
+
+  return 0;
+}
+
+static int arena_shrink(arena_t *a, size_t nmemb,
+                        void (*move)(void *ctx, size_t from, size_t to),
+                        void *ctx) {
+  size_t nchunks, from, to, i, j;
+
+  if (a->used > nmemb)
+    return -1;
+
+  /* only the free pages below nmemb remain free. If any page at or
+     beyond nmemb is in use, all pages below nmemb have been handed out
+     and the free ones are on the stack, enough of them to take every
+     page that has to move. */
+  for (i=j=0; i<a->nfree; i++)
+    if (a->free[i] < nmemb)
+      a->free[j++] = a->free[i];
+  a->nfree = j;
+
+  for (from=nmemb; from<a->active; from++) {
+    if (!a->in_use[from])
+      continue;
+    to = a->free[--a->nfree];
+    memcpy(arena_page(a, to), arena_page(a, from), a->size);
+    a->key[to] = a->key[from];
+    a->in_use[to] = 1;
+    a->in_use[from] = 0;
+    if (move)
+      move(ctx, from, to);
+  }
+  a->active = MIN(a->active, nmemb);
+
+  nchunks = (nmemb + a->mask) >> a->shift;
+  for (i=nchunks; i<a->nchunks; i++)
+    free(a->chunk[i]);
+  a->nchunks = nchunks;
+  a->nmemb = nmemb;
+  arena_realloc(a, nmemb);
+
+  return 0;
+}
+
+int arena_resize(arena_t *a, size_t nmemb,
+                 void (*move)(void *ctx, size_t from, size_t to), void *ctx) {
+  if (nmemb > a->nmemb || !a->chunk)
+    return arena_grow(a, nmemb);
+  return arena_shrink(a, nmemb, move, ctx);
+}
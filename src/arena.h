@@ -0,0 +1,101 @@
+#ifndef ARENA_H_6a1f0c2d9e8b47f3a5c4d7e2b1f09a36
+#define ARENA_H_6a1f0c2d9e8b47f3a5c4d7e2b1f09a36
+
+/* Page arena.
+ *
+ * An arena_t holds the nmemb pages of a cache, each of size bytes and
+ * numbered 0 to nmemb-1, and remembers which key each page in use
+ * holds. Pages are allocated in chunks of a power of two pages, so
+ * that growing the arena only allocates the chunks added and never
+ * moves a page, and shrinking it can give whole chunks back.
+ *
+ * Page lookups are defined here so that they can be inlined into the
+ * hot paths that use them.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef struct arena_s {
+  char **chunk;
+  size_t nchunks;
+  int shift;
+  size_t mask;
+  size_t size;
+  size_t nmemb;
+  /* pages below active have been handed out at some point, those
+     released since are on the free stack */
+  size_t active;
+  size_t used;
+  size_t *free;
+  size_t nfree;
+  uint64_t *key;
+  uint8_t *in_use;
+} arena_t;
+
+/* Allocates a new arena of nmemb pages of size bytes, none in use.
+ *
+ * Returns NULL if out of memory.
+ */
+arena_t *arena_new(size_t size, size_t nmemb);
+
+/* Destroys an arena and releases all associated resources
+ *
+ * The arena pointer at *a will be set to NULL
+ */
+void arena_free(arena_t **a);
+
+/* Allocates a page for key, the one released last if any.
+ *
+ * Returns 0 on success
+ *         1 if all pages are in use
+ */
+int arena_alloc(arena_t *a, uint64_t key, size_t *slot);
+
+/* Releases a page in use
+ */
+void arena_release(arena_t *a, size_t slot);
+
+/* Resizes the arena to nmemb pages.
+ *
+ * Growing allocates the chunks needed for the pages added, if any.
+ * Shrinking requires that at most nmemb pages are in use. Each page
+ * in use at or beyond nmemb is copied, key and all, to a free page
+ * below it, and move(ctx, from, to) is called so that the caller can
+ * follow it, after which the chunks beyond nmemb are freed.
+ *
+ * Returns 0 on success
+ *         -1 if out of memory or if more than nmemb pages are in use
+ */
+int arena_resize(arena_t *a, size_t nmemb,
+                 void (*move)(void *ctx, size_t from, size_t to), void *ctx);
+
+/* Returns the page in slot
+ */
+static inline void *arena_page(arena_t *a, size_t slot) {
+  return a->chunk[slot >> a->shift] + (slot & a->mask) * a->size;
+}
+
+/* Returns the key held by the page in slot
+ */
+static inline uint64_t arena_key(arena_t *a, size_t slot) {
+  return a->key[slot];
+}
+
+/* Returns true if the page in slot is in use
+ */
+static inline int arena_in_use(arena_t *a, size_t slot) {
+  return a->in_use[slot];
+}
+
+/* Returns the number of pages, and the number of those in use
+ */
+static inline size_t arena_nmemb(arena_t *a) {
+  return a->nmemb;
+}
+
+static inline size_t arena_used(arena_t *a) {
+  return a->used;
+}
+
+#endif
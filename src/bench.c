@@ -1,27 +1,128 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 #include <time.h>
+#include <unistd.h>
 #include "lru.h"
 #include "rnd.h"
 #include "fifo.h"
 #include "clk.h"
 #include "gclk.h"
 #include "slru.h"
+#include "twoq.h"
+#include "mq.h"
+#include "lfu.h"
+#include "lecar.h"
+#include "sample.h"
+#include "opt.h"
+#include "gd.h"
+#include "htable.h"
+#include "seqdet.h"
 
 /* Benchmarks the caches against some data set.
  *
  * The page-file is a list of 64 bit hex numbers, each of which
  * identifying a page to request. The optional nmemb argument specifys
- * the number of pages to keep in cache.
+ * the number of pages to keep in cache. A page-file of "-" reads the
+ * list from stdin, so that a trace can be piped in from tracegen.
+ *
+ * With -c, each key is followed by the cost of refilling its page, a
+ * decimal number. Cost-aware policies are given it, and the total
+ * cost of each policy's misses is reported. E.g. to make one key in
+ * 16 50 times as expensive:
+ *
+ *   tracegen zipf | awk '{ print $1, $1 ~ /0$/ ? 50 : 1 }' | bench -c -
+ *
+ * With -w, the replay is also reported every window accesses, as CSV
+ * rows of the policy, the window's index, the accesses so far, its
+ * hit ratio, its working set size (distinct keys) and its eviction
+ * rate (evictions per access), e.g.
+ *
+ *   tracegen zipf:len=500000+scan:base=1000000,len=50000+zipf:len=500000 |
+ *     bench -w 10000 - > timeline.csv
+ *
+ * which shows how fast each policy recovers after the scan. Rows are
+ * written as each window completes, to the file given by -o, or to
+ * stdout, in which case the summary goes to stderr.
+ *
+ * The -prefetch policies read ahead of sequential runs of keys, see
+ * seqdet.h, filling the pages they prefetch as on a miss. For them,
+ * the prefetches' accuracy, the part of the pages prefetched that
+ * were fetched before being evicted, and coverage, the part of the
+ * misses there would have been that they turned into hits, are
+ * reported too.
+ *
+ * With -t, each policy is then timed over the given number of
+ * replays, after a warm-up replay, each replay with a new cache.
+ * Fetches are timed once as the policy's own cost, the pages left
+ * untouched, and once as the full data path, where each page is
+ * written on a miss and checked on a hit, a page that reads back
+ * wrong failing the run. Reported are the median and 99th percentile
+ * ns of single fetches, one in each BATCH being timed on its own, less
+ * what reading the clock costs, and the overall throughput in Mops/s.
+ * Timing leaves out readahead.
  */
 
 #define BLOCK_SIZE 4096
 #define DEFAULT_NMEMB 1024
 
+/* header-only builds of some of the policies, see tmpl.h, which are
+   compiled for the default number of pages only, and left out of
+   runs with any other */
+#define TMPL_NAME   fifo_inline
+#define TMPL_POLICY TMPL_FIFO
+#define TMPL_SIZE   BLOCK_SIZE
+#define TMPL_NMEMB  DEFAULT_NMEMB
+#include "tmpl.h"
+
+#define TMPL_NAME   clk_inline
+#define TMPL_POLICY TMPL_CLK
+#define TMPL_SIZE   BLOCK_SIZE
+#define TMPL_NMEMB  DEFAULT_NMEMB
+#include "tmpl.h"
+
+#define TMPL_NAME   clk_swiss_inline
+#define TMPL_POLICY TMPL_CLK
+#define TMPL_SIZE   BLOCK_SIZE
+#define TMPL_NMEMB  DEFAULT_NMEMB
+#define TMPL_INDEX  TMPL_SWISS
+#include "tmpl.h"
+
+#define TMPL_NAME   gclk_inline
+#define TMPL_POLICY TMPL_GCLK
+#define TMPL_SIZE   BLOCK_SIZE
+#define TMPL_NMEMB  DEFAULT_NMEMB
+#include "tmpl.h"
+
+#define TMPL_NAME   rnd_inline
+#define TMPL_POLICY TMPL_RND
+#define TMPL_SIZE   BLOCK_SIZE
+#define TMPL_NMEMB  DEFAULT_NMEMB
+#include "tmpl.h"
+
+#define TMPL_NAME   lru_inline
+#define TMPL_POLICY TMPL_LRU
+#define TMPL_SIZE   BLOCK_SIZE
+#define TMPL_NMEMB  DEFAULT_NMEMB
+#include "tmpl.h"
+
+
+#define SAMPLES 5
+/* counters of the cost-weighted GCLOCK go up to the highest cost
+   that tells pages apart, as costs above it are taken as it */
+#define GCLK_COST_MAX 64
+
+/* timing mode: replays run and discarded first, and fetches per
+   timed batch, enough to make the clock's own cost negligible, the
+   first of which is also timed on its own */
+#define WARMUP 1
+#define BATCH 256
+
 
 typedef void* (*cache_new_fun)  (size_t, size_t);
 typedef int   (*cache_fetch_fun)(void *, uint64_t, void**);
+typedef int   (*cache_fetch_cost_fun)(void *, uint64_t, uint32_t, void**);
 typedef void  (*cache_free_fun) (void **);
 
 struct implementation_s {
@@ -29,18 +130,142 @@ struct implementation_s {
   cache_new_fun new_f;
   cache_fetch_fun fetch_f;
   cache_free_fun free_f;
+  /* for cost-aware policies */
+  cache_fetch_cost_fun fetch_cost_f;
+  /* for policies that read ahead */
+  cache_fetch_fun prefetch_f;
+  /* for builds fixed at a number of pages, 0 meaning any */
+  size_t nmemb;
 };
 
+/* the loaded trace, which OPT needs up front */
+static uint64_t *trace_key;
+static size_t trace_len;
+
+static opt_t *opt_trace_new(size_t size, size_t nmemb) {
+  return opt_new(size, nmemb, trace_key, trace_len);
+}
+
+static rnd_t *rnd_lru_new(size_t size, size_t nmemb) {
+  struct rnd_opts opts = {.seed = 1, .samples = SAMPLES,
+                          .sample = RND_SAMPLE_LRU};
+  return rnd_new_ex(size, nmemb, &opts);
+}
+
+static rnd_t *rnd_lfu_new(size_t size, size_t nmemb) {
+  struct rnd_opts opts = {.seed = 1, .samples = SAMPLES,
+                          .sample = RND_SAMPLE_LFU};
+  return rnd_new_ex(size, nmemb, &opts);
+}
+
+static sample_t *sample_lfu_new(size_t size, size_t nmemb) {
+  struct sample_opts opts = {.policy = SAMPLE_LFU, .samples = SAMPLES,
+                             .pool = 16, .seed = 1};
+  return sample_new_ex(size, nmemb, &opts);
+}
+
+static clk_t *clk_cuckoo_new(size_t size, size_t nmemb) {
+  struct clk_opts opts = {.index = HTABLE_CUCKOO};
+  return clk_new_ex(size, nmemb, &opts);
+}
+
+static clk_t *clk_swiss_new(size_t size, size_t nmemb) {
+  struct clk_opts opts = {.index = HTABLE_SWISS};
+  return clk_new_ex(size, nmemb, &opts);
+}
+
+static slru_t *slru_adaptive_new(size_t size, size_t nmemb) {
+  struct slru_opts opts = {.protected = 0, .adaptive = 1};
+  return slru_new_ex(size, nmemb, &opts);
+}
+
+static slru_t *slru_ghost_new(size_t size, size_t nmemb) {
+  struct slru_opts opts = {.ghost = 1};
+  return slru_new_ex(size, nmemb, &opts);
+}
+
+static slru_t *slru_adaptive_ghost_new(size_t size, size_t nmemb) {
+  struct slru_opts opts = {.adaptive = 1, .ghost = 1};
+  return slru_new_ex(size, nmemb, &opts);
+}
+
+static twoq_t *twoq_ghost_new(size_t size, size_t nmemb) {
+  struct twoq_opts opts = {.ghost = 1};
+  return twoq_new_ex(size, nmemb, &opts);
+}
+
+static slru_t *slru4_new(size_t size, size_t nmemb) {
+  struct slru_opts opts = {.nsegments = 4};
+  return slru_new_ex(size, nmemb, &opts);
+}
+
+static gclk_t *gclk_cost_new(size_t size, size_t nmemb) {
+  struct gclk_opts opts = {.max = GCLK_COST_MAX, .increment = 1,
+                           .sweep = GCLK_SWEEP_MIN};
+  return gclk_new_ex(size, nmemb, &opts);
+}
+
+static lfu_t *lfu_halve_new(size_t size, size_t nmemb) {
+  struct lfu_opts opts = {.aging = LFU_AGING_HALVE, .period = 0};
+  return lfu_new_ex(size, nmemb, &opts);
+}
+
+static lfu_t *lfu_da_new(size_t size, size_t nmemb) {
+  struct lfu_opts opts = {.aging = LFU_AGING_DA, .period = 0};
+  return lfu_new_ex(size, nmemb, &opts);
+}
+
+static fifo_inline_t *fifo_inline_new_at(size_t size, size_t nmemb) {
+  return fifo_inline_new();
+}
+
+static clk_inline_t *clk_inline_new_at(size_t size, size_t nmemb) {
+  return clk_inline_new();
+}
+
+static clk_swiss_inline_t *clk_swiss_inline_new_at(size_t size,
+                                                   size_t nmemb) {
+  return clk_swiss_inline_new();
+}
+
+static gclk_inline_t *gclk_inline_new_at(size_t size, size_t nmemb) {
+  return gclk_inline_new();
+}
+
+static rnd_inline_t *rnd_inline_new_at(size_t size, size_t nmemb) {
+  return rnd_inline_new();
+}
+
+static lru_inline_t *lru_inline_new_at(size_t size, size_t nmemb) {
+  return lru_inline_new();
+}
 
 struct implementation_s impls[] = {
+  {.name    = "opt",
+   .new_f   = (cache_new_fun)  opt_trace_new,
+   .fetch_f = (cache_fetch_fun)opt_fetch,
+   .free_f  = (cache_free_fun) opt_free},
   {.name    = "lru",
    .new_f   = (cache_new_fun)  lru_new,
    .fetch_f = (cache_fetch_fun)lru_fetch,
    .free_f  = (cache_free_fun) lru_free},
+  {.name    = "lru-prefetch",
+   .new_f   = (cache_new_fun)  lru_new,
+   .fetch_f = (cache_fetch_fun)lru_fetch,
+   .free_f  = (cache_free_fun) lru_free,
+   .prefetch_f = (cache_fetch_fun)lru_prefetch},
   {.name    = "rnd",
    .new_f   = (cache_new_fun)  rnd_new,
    .fetch_f = (cache_fetch_fun)rnd_fetch,
    .free_f  = (cache_free_fun) rnd_free},
+  {.name    = "rnd-lru",
+   .new_f   = (cache_new_fun)  rnd_lru_new,
+   .fetch_f = (cache_fetch_fun)rnd_fetch,
+   .free_f  = (cache_free_fun) rnd_free},
+  {.name    = "rnd-lfu",
+   .new_f   = (cache_new_fun)  rnd_lfu_new,
+   .fetch_f = (cache_fetch_fun)rnd_fetch,
+   .free_f  = (cache_free_fun) rnd_free},
   {.name    = "fifo",
    .new_f   = (cache_new_fun)  fifo_new,
    .fetch_f = (cache_fetch_fun)fifo_fetch,
@@ -49,22 +274,180 @@ struct implementation_s impls[] = {
    .new_f   = (cache_new_fun)  clk_new,
    .fetch_f = (cache_fetch_fun)clk_fetch,
    .free_f  = (cache_free_fun) clk_free},
+  {.name    = "clock-prefetch",
+   .new_f   = (cache_new_fun)  clk_new,
+   .fetch_f = (cache_fetch_fun)clk_fetch,
+   .free_f  = (cache_free_fun) clk_free,
+   .prefetch_f = (cache_fetch_fun)clk_prefetch},
+  {.name    = "clock-cuckoo",
+   .new_f   = (cache_new_fun)  clk_cuckoo_new,
+   .fetch_f = (cache_fetch_fun)clk_fetch,
+   .free_f  = (cache_free_fun) clk_free},
+  {.name    = "clock-swiss",
+   .new_f   = (cache_new_fun)  clk_swiss_new,
+   .fetch_f = (cache_fetch_fun)clk_fetch,
+   .free_f  = (cache_free_fun) clk_free},
   {.name    = "gclock",
    .new_f   = (cache_new_fun)  gclk_new,
    .fetch_f = (cache_fetch_fun)gclk_fetch,
    .free_f  = (cache_free_fun) gclk_free},
+  {.name    = "gclock-cost",
+   .new_f   = (cache_new_fun)  gclk_cost_new,
+   .fetch_f = (cache_fetch_fun)gclk_fetch,
+   .free_f  = (cache_free_fun) gclk_free,
+   .fetch_cost_f = (cache_fetch_cost_fun)gclk_fetch_cost},
+  {.name    = "greedydual",
+   .new_f   = (cache_new_fun)  gd_new,
+   .fetch_f = (cache_fetch_fun)gd_fetch,
+   .free_f  = (cache_free_fun) gd_free,
+   .fetch_cost_f = (cache_fetch_cost_fun)gd_fetch_cost},
   {.name    = "slru",
    .new_f   = (cache_new_fun)  slru_new,
    .fetch_f = (cache_fetch_fun)slru_fetch,
    .free_f  = (cache_free_fun) slru_free},
+  {.name    = "slru-prefetch",
+   .new_f   = (cache_new_fun)  slru_new,
+   .fetch_f = (cache_fetch_fun)slru_fetch,
+   .free_f  = (cache_free_fun) slru_free,
+   .prefetch_f = (cache_fetch_fun)slru_prefetch},
+  {.name    = "slru4",
+   .new_f   = (cache_new_fun)  slru4_new,
+   .fetch_f = (cache_fetch_fun)slru_fetch,
+   .free_f  = (cache_free_fun) slru_free},
+  {.name    = "slru-adaptive",
+   .new_f   = (cache_new_fun)  slru_adaptive_new,
+   .fetch_f = (cache_fetch_fun)slru_fetch,
+   .free_f  = (cache_free_fun) slru_free},
+  {.name    = "slru-ghost",
+   .new_f   = (cache_new_fun)  slru_ghost_new,
+   .fetch_f = (cache_fetch_fun)slru_fetch,
+   .free_f  = (cache_free_fun) slru_free},
+  {.name    = "slru-adaptive-ghost",
+   .new_f   = (cache_new_fun)  slru_adaptive_ghost_new,
+   .fetch_f = (cache_fetch_fun)slru_fetch,
+   .free_f  = (cache_free_fun) slru_free},
+  {.name    = "2q",
+   .new_f   = (cache_new_fun)  twoq_new,
+   .fetch_f = (cache_fetch_fun)twoq_fetch,
+   .free_f  = (cache_free_fun) twoq_free},
+  {.name    = "2q-ghost",
+   .new_f   = (cache_new_fun)  twoq_ghost_new,
+   .fetch_f = (cache_fetch_fun)twoq_fetch,
+   .free_f  = (cache_free_fun) twoq_free},
+  {.name    = "mq",
+   .new_f   = (cache_new_fun)  mq_new,
+   .fetch_f = (cache_fetch_fun)mq_fetch,
+   .free_f  = (cache_free_fun) mq_free},
+  {.name    = "lfu",
+   .new_f   = (cache_new_fun)  lfu_new,
+   .fetch_f = (cache_fetch_fun)lfu_fetch,
+   .free_f  = (cache_free_fun) lfu_free},
+  {.name    = "lfu-halve",
+   .new_f   = (cache_new_fun)  lfu_halve_new,
+   .fetch_f = (cache_fetch_fun)lfu_fetch,
+   .free_f  = (cache_free_fun) lfu_free},
+  {.name    = "lfu-da",
+   .new_f   = (cache_new_fun)  lfu_da_new,
+   .fetch_f = (cache_fetch_fun)lfu_fetch,
+   .free_f  = (cache_free_fun) lfu_free},
+  {.name    = "lecar",
+   .new_f   = (cache_new_fun)  lecar_new,
+   .fetch_f = (cache_fetch_fun)lecar_fetch,
+   .free_f  = (cache_free_fun) lecar_free},
+  {.name    = "sample-lru",
+   .new_f   = (cache_new_fun)  sample_new,
+   .fetch_f = (cache_fetch_fun)sample_fetch,
+   .free_f  = (cache_free_fun) sample_free},
+  {.name    = "sample-lfu",
+   .new_f   = (cache_new_fun)  sample_lfu_new,
+   .fetch_f = (cache_fetch_fun)sample_fetch,
+   .free_f  = (cache_free_fun) sample_free},
+  {.name    = "fifo-inline",
+   .new_f   = (cache_new_fun)  fifo_inline_new_at,
+   .fetch_f = (cache_fetch_fun)fifo_inline_fetch,
+   .free_f  = (cache_free_fun) fifo_inline_free,
+   .nmemb   = DEFAULT_NMEMB},
+  {.name    = "clock-inline",
+   .new_f   = (cache_new_fun)  clk_inline_new_at,
+   .fetch_f = (cache_fetch_fun)clk_inline_fetch,
+   .free_f  = (cache_free_fun) clk_inline_free,
+   .nmemb   = DEFAULT_NMEMB},
+  {.name    = "clock-swiss-inline",
+   .new_f   = (cache_new_fun)  clk_swiss_inline_new_at,
+   .fetch_f = (cache_fetch_fun)clk_swiss_inline_fetch,
+   .free_f  = (cache_free_fun) clk_swiss_inline_free,
+   .nmemb   = DEFAULT_NMEMB},
+  {.name    = "gclock-inline",
+   .new_f   = (cache_new_fun)  gclk_inline_new_at,
+   .fetch_f = (cache_fetch_fun)gclk_inline_fetch,
+   .free_f  = (cache_free_fun) gclk_inline_free,
+   .nmemb   = DEFAULT_NMEMB},
+  {.name    = "rnd-inline",
+   .new_f   = (cache_new_fun)  rnd_inline_new_at,
+   .fetch_f = (cache_fetch_fun)rnd_inline_fetch,
+   .free_f  = (cache_free_fun) rnd_inline_free,
+   .nmemb   = DEFAULT_NMEMB},
+  {.name    = "lru-inline",
+   .new_f   = (cache_new_fun)  lru_inline_new_at,
+   .fetch_f = (cache_fetch_fun)lru_inline_fetch,
+   .free_f  = (cache_free_fun) lru_inline_free,
+   .nmemb   = DEFAULT_NMEMB},
 };
 int num_impls = sizeof(impls) / sizeof(struct implementation_s);
 
 void usage_fail(char *prog) {
-  fprintf(stderr, "Usage: %s <page-file> [nmemb]\n", prog);
+  fprintf(stderr, "Usage: %s [-c] [-w window [-o csv-file]] [-t repeats] "
+          "<page-file> [nmemb]\n", prog);
   exit(1);
 }
 
+/* Counts the distinct keys in each window of the len keys at key[]
+ *
+ * Returns an array of the counts, NULL if out of memory
+ */
+static size_t *working_sets(const uint64_t *key, size_t len, size_t window) {
+  size_t nwin = (len + window - 1) / window;
+  size_t *wss, *set, n, mask, i, h, s;
+  uint32_t *stamp, w;
+
+  /* an open addressing set at most half full, whose slots belong to
+     the window they were stamped with */
+  for (n=1; n < 2 * window; n <<= 1)
+    ;
+  mask = n - 1;
+
+  wss = calloc(nwin ? nwin : 1, sizeof(size_t));
+  set = malloc(n * sizeof(size_t));
+  stamp = calloc(n, sizeof(uint32_t));
+  if (!wss || !set || !stamp)
+    goto fail;
+
+  for (i=0; i<len; i++) {
+    w = i / window + 1;
+    for (h = (key[i] * 0x9e3779b97f4a7c15ULL) >> 17;; h++) {
+      s = h & mask;
+      if (stamp[s] != w) {
+        stamp[s] = w;
+        set[s] = i;
+        wss[w - 1]++;
+        break;
+      }
+      if (key[set[s]] == key[i])
+        break;
+    }
+  }
+
+  free(set);
+  free(stamp);
+  return wss;
+
+ fail:
+  free(wss);
+  free(set);
+  free(stamp);
+  return NULL;
+}
+
 static void write_stuff(void *ptr, uint64_t key) {
   int i;
   uint64_t *p64;
@@ -76,6 +459,15 @@ static void write_stuff(void *ptr, uint64_t key) {
     *p8 = key++;
 }
 
+/* Fetches key from cache, passing on its cost if the policy cares
+ */
+static inline int fetch(struct implementation_s *impl, void *cache,
+                        uint64_t key, uint32_t cost, void **ptr) {
+  if (impl->fetch_cost_f)
+    return impl->fetch_cost_f(cache, key, cost, ptr);
+  return impl->fetch_f(cache, key, ptr);
+}
+
 static int check_stuff(void *ptr, uint64_t key) {
   int i;
   uint64_t *p64;
@@ -90,82 +482,388 @@ static int check_stuff(void *ptr, uint64_t key) {
   return 0;
 }
 
+/* Prefetches the n keys from from on, filling the pages taken for
+ * them, whose keys are remembered in pending until fetched
+ *
+ * Returns the number of pages taken
+ */
+static size_t readahead(struct implementation_s *impl, void *cache,
+                        htable_t *pending, uint64_t from, size_t n) {
+  size_t taken = 0;
+  void *ptr;
+
+  for (; n; n--, from++)
+    if (impl->prefetch_f(cache, from, &ptr) == 1) {
+      write_stuff(ptr, from);
+      /* the table takes duplicates, and from may be there already if
+         it was evicted before being fetched */
+      htable_del(pending, from);
+      htable_set(pending, from, NULL);
+      taken++;
+    }
+
+  return taken;
+}
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int cmp_double(const void *a, const void *b) {
+  double x = *(const double *)a, y = *(const double *)b;
+
+  return (x > y) - (x < y);
+}
+
+/* Fetches the keys key[from] to key[to-1], which cost cost[], writing
+ * and checking the pages if touch is set
+ *
+ * Returns the number of pages that read back wrong
+ */
+static inline int replay(struct implementation_s *impl, void *cache,
+                         const uint64_t *key, const uint32_t *cost,
+                         size_t from, size_t to, int touch) {
+  void *ptr;
+  size_t j;
+  int ecode, fails = 0;
+
+  if (!touch) {
+    for (j=from; j<to; j++)
+      fetch(impl, cache, key[j], cost[j], &ptr);
+    return 0;
+  }
+
+  for (j=from; j<to; j++) {
+    ecode = fetch(impl, cache, key[j], cost[j], &ptr);
+    if (ecode == 0)
+      fails += check_stuff(ptr, key[j]);
+    else if (ecode == 1)
+      write_stuff(ptr, key[j]);
+  }
+  return fails;
+}
+
+/* Replays the len keys at key[], which cost cost[], against a new
+ * cache, writing and checking the pages if touch is set. The first
+ * fetch of each batch of BATCH fetches is timed on its own, and its
+ * ns less clock_ns stored in ns[]. The total time is added to *total.
+ *
+ * Returns 0 on success
+ *         -1 if the cache could not be created or a page read back
+ *         wrong
+ */
+static int timed_replay(struct implementation_s *impl, size_t nmemb,
+                        const uint64_t *key, const uint32_t *cost,
+                        size_t len, int touch, uint64_t clock_ns,
+                        double *ns, uint64_t *total) {
+  void *cache;
+  uint64_t start, single, stop;
+  size_t i, n;
+  int fails = 0;
+
+  cache = impl->new_f(BLOCK_SIZE, nmemb);
+  if (!cache)
+    return -1;
+
+  for (i=0; i<len; i+=n) {
+    n = len - i < BATCH ? len - i : BATCH;
+    start = now_ns();
+    fails += replay(impl, cache, key, cost, i, i + 1, touch);
+    single = now_ns();
+    fails += replay(impl, cache, key, cost, i + 1, i + n, touch);
+    stop = now_ns();
+
+    ns[i / BATCH] = single - start > clock_ns ? single - start - clock_ns : 0;
+    *total += stop - start;
+  }
+
+  impl->free_f(&cache);
+  return fails ? -1 : 0;
+}
+
+/* Returns the least ns between two reads of the clock
+ */
+static uint64_t clock_cost(void) {
+  uint64_t start, ns, least = UINT64_MAX;
+  int i;
+
+  for (i=0; i<1000; i++) {
+    start = now_ns();
+    ns = now_ns() - start;
+    if (ns < least)
+      least = ns;
+  }
+  return least;
+}
+
+/* Times repeats replays of the trace after WARMUP more and prints the
+ * median and 99th percentile ns of the fetches timed on their own,
+ * and the fetches per second
+ *
+ * Returns 0 on success
+ *         -1 if a cache could not be created, a page read back wrong
+ *         or out of memory
+ */
+static int time_impl(FILE *out, struct implementation_s *impl,
+                     size_t nmemb, const uint64_t *key,
+                     const uint32_t *cost, size_t len, int repeats,
+                     int touch) {
+  size_t nbatches = (len + BATCH - 1) / BATCH;
+  uint64_t total = 0, clock_ns;
+  double *ns;
+  int r;
+
+  if (!nbatches)
+    return -1;
+  clock_ns = clock_cost();
+
+  ns = malloc(nbatches * repeats * sizeof(double));
+  if (!ns)
+    return -1;
+
+  for (r=0; r<WARMUP; r++)
+    if (timed_replay(impl, nmemb, key, cost, len, touch, clock_ns, ns,
+                     &total))
+      goto fail;
+
+  total = 0;
+  for (r=0; r<repeats; r++)
+    if (timed_replay(impl, nmemb, key, cost, len, touch, clock_ns,
+                     ns + r * nbatches, &total))
+      goto fail;
+
+  qsort(ns, nbatches * repeats, sizeof(double), cmp_double);
+  fprintf(out, "%s\t%s  median %.1f ns  p99 %.1f ns  %.2f Mops/s\n",
+          impl->name, touch ? "full  " : "policy",
+          ns[nbatches * repeats / 2], ns[nbatches * repeats * 99 / 100],
+          total ? 1e3 * len * repeats / total : 0);
+
+  free(ns);
+  return 0;
+
+ fail:
+  free(ns);
+  return -1;
+}
+
 int main(int argc, char *argv[]) {
-  FILE *page_file;
-  uint64_t *key;
+  FILE *page_file, *csv, *out;
+  uint64_t *key, miss_cost, from;
+  uint32_t *cost;
+  unsigned long long k;
+  unsigned c;
   size_t keysize, keylen;
-  size_t nmemb;
-  int impl_i, i, hit, miss, fail, ecode;
+  size_t nmemb, window, filled, *wss, taken, issued, useful;
+  int impl_i, i, hit, miss, fail, ecode, opt, repeats, costs, n;
+  int whit, wmiss, wevict;
   void *cache, *ptr;
-  clock_t time_start, time_stop;
+  uint64_t time_start, time_stop;
+  char *csv_name;
+  struct htable_opts topts = {.grow = 1, .index = HTABLE_CHAINED};
+  htable_t *pending;
+  seqdet_t *sd;
 
   /* cmd line args */
-  if (!(2 <= argc && argc <= 3))
+  window = 0;
+  csv_name = NULL;
+  repeats = 0;
+  costs = 0;
+  while ((opt = getopt(argc, argv, "cw:o:t:")) != -1) {
+    switch (opt) {
+    case 'c':
+      costs = 1;
+      break;
+    case 'w':
+      if (1 != sscanf(optarg, "%zu", &window) || !window)
+        usage_fail(argv[0]);
+      break;
+    case 'o':
+      csv_name = optarg;
+      break;
+    case 't':
+      if (1 != sscanf(optarg, "%d", &repeats) || repeats < 1)
+        usage_fail(argv[0]);
+      break;
+    default:
+      usage_fail(argv[0]);
+    }
+  }
+  if (!(1 <= argc - optind && argc - optind <= 2) || (csv_name && !window))
     usage_fail(argv[0]);
 
   nmemb = DEFAULT_NMEMB;
-  if (argc >= 3)
-    if (1 != sscanf(argv[2], "%d", &nmemb)) {
-      fprintf(stderr, "bad lru-blocks: \'%s\'\n\n", argv[2]);
+  if (argc - optind >= 2)
+    if (1 != sscanf(argv[optind + 1], "%zu", &nmemb)) {
+      fprintf(stderr, "bad lru-blocks: \'%s\'\n\n", argv[optind + 1]);
       usage_fail(argv[0]);
     }
 
-  page_file = fopen(argv[1], "r");
+  if (!strcmp(argv[optind], "-"))
+    page_file = stdin;
+  else
+    page_file = fopen(argv[optind], "r");
   if (!page_file) {
-    fprintf(stderr, "FAIL: could not open '%s' for reading\n", argv[1]);
+    fprintf(stderr, "FAIL: could not open '%s' for reading\n", argv[optind]);
     exit(1);
   }
 
-  /* load block file */
+  /* the summary makes way for the timeline on stdout */
+  csv = out = stdout;
+  if (window && csv_name) {
+    csv = fopen(csv_name, "w");
+    if (!csv) {
+      fprintf(stderr, "FAIL: could not open '%s' for writing\n", csv_name);
+      exit(1);
+    }
+  } else if (window) {
+    out = stderr;
+  }
+
+  /* load block file, the keys and, with -c, their costs */
   keysize = 100;
   keylen = 0;
   key = malloc(keysize * sizeof(uint64_t));
-  while (1 == fscanf(page_file, "%llx", &key[keylen])) {
+  cost = malloc(keysize * sizeof(uint32_t));
+  c = 1;
+  while (costs ? 2 == fscanf(page_file, "%llx %u", &k, &c) :
+         1 == fscanf(page_file, "%llx", &k)) {
+    key[keylen] = k;
+    cost[keylen] = c;
     keylen++;
     if (keylen >= keysize) {
       keysize *= 2;
       key = realloc(key, keysize * sizeof(uint64_t));
+      cost = realloc(cost, keysize * sizeof(uint32_t));
+    }
+  }
+
+  trace_key = key;
+  trace_len = keylen;
+
+  /* the working sets are the trace's, the same for every policy */
+  wss = NULL;
+  if (window) {
+    wss = working_sets(key, keylen, window);
+    if (!wss) {
+      fprintf(stderr, "FAIL: out of memory\n");
+      exit(1);
     }
+    fprintf(csv, "policy,window,accesses,hit_ratio,working_set,"
+            "eviction_rate\n");
   }
 
   /* and bench */
   for (impl_i=0; impl_i<num_impls; impl_i++) {
+    if (impls[impl_i].nmemb && impls[impl_i].nmemb != nmemb)
+      continue;
+
     cache = impls[impl_i].new_f(BLOCK_SIZE, nmemb);
     if (!cache) {
-      printf("%s\t new() failed\n", impls[impl_i].name);
+      fprintf(out, "%s\t new() failed\n", impls[impl_i].name);
       continue;
     }
 
-    time_start = clock();
+    /* the prefetched pages not fetched yet, to tell which hits are
+       owed to readahead */
+    sd = NULL;
+    pending = NULL;
+    if (impls[impl_i].prefetch_f) {
+      sd = seqdet_new();
+      pending = htable_new_ex(nmemb, &topts);
+      if (!sd || !pending) {
+        fprintf(stderr, "FAIL: out of memory\n");
+        exit(1);
+      }
+    }
+    issued = useful = 0;
+
+    time_start = now_ns();
     miss = hit = fail = 0;
+    miss_cost = 0;
+    whit = wmiss = wevict = 0;
+    filled = 0;
     for (i=0; i<keylen; i++) {
-      ecode = impls[impl_i].fetch_f(cache, key[i], &ptr);
+      ecode = fetch(impls + impl_i, cache, key[i], cost[i], &ptr);
 
       if (ecode == 0) {
         hit++;
+        whit++;
         if (check_stuff(ptr, key[i]))
           fail++;
+        if (pending && !htable_del(pending, key[i]))
+          useful++;
       } else if (ecode == 1) {
         miss++;
+        wmiss++;
+        miss_cost += cost[i];
+        /* every miss takes a page and pages only leave to make room,
+           so once the cache is full, every miss is an eviction */
+        if (filled < nmemb)
+          filled++;
+        else
+          wevict++;
         write_stuff(ptr, key[i]);
+        /* a prefetched page evicted unused */
+        if (pending)
+          htable_del(pending, key[i]);
       } else
         fail++;
+
+      /* prefetched pages take room as missed ones do */
+      if (sd && (n = seqdet_access(sd, key[i], &from))) {
+        taken = readahead(impls + impl_i, cache, pending, from, n);
+        issued += taken;
+        for (; taken; taken--)
+          if (filled < nmemb)
+            filled++;
+          else
+            wevict++;
+      }
+
+      if (window && ((i + 1) % window == 0 || i + 1 == keylen)) {
+        fprintf(csv, "%s,%zu,%d,%.4f,%zu,%.4f\n", impls[impl_i].name,
+                i / window, i + 1, (double)whit / (whit + wmiss),
+                wss[i / window], (double)wevict / (whit + wmiss));
+        whit = wmiss = wevict = 0;
+      }
     }
-    time_stop = clock();
+    time_stop = now_ns();
 
-    printf("%s\t%.02f%% hit ratio (%d / %d)  time %.2f",
-           impls[impl_i].name, 100*(float)hit/(miss+hit), hit, hit + miss,
-           ((double)(time_stop - time_start))/CLOCKS_PER_SEC);
+    fprintf(out, "%s\t%.02f%% hit ratio (%d / %d)  time %.2f",
+            impls[impl_i].name, 100*(float)hit/(miss+hit), hit, hit + miss,
+            (time_stop - time_start) / 1e9);
 
+    if (costs)
+      fprintf(out, "  miss cost %llu", (unsigned long long)miss_cost);
+    if (sd)
+      fprintf(out, "  prefetch accuracy %.02f%% coverage %.02f%% "
+              "(%zu issued)", issued ? 100. * useful / issued : 0,
+              useful + miss ? 100. * useful / (useful + miss) : 0, issued);
     if (fail)
-      printf("  !!! %d fails", fail);
-    printf("\n");
+      fprintf(out, "  !!! %d fails", fail);
+    fprintf(out, "\n");
 
     impls[impl_i].free_f(&cache);
     if (cache)
-      printf("%s\tfree is broken\n", impls[impl_i].name);
+      fprintf(out, "%s\tfree is broken\n", impls[impl_i].name);
     cache = NULL;
+    seqdet_free(&sd);
+    if (pending)
+      htable_free(&pending);
+
+    if (repeats && (time_impl(out, impls + impl_i, nmemb, key, cost,
+                              keylen, repeats, 0) ||
+                    time_impl(out, impls + impl_i, nmemb, key, cost,
+                              keylen, repeats, 1)))
+      fprintf(out, "%s\ttiming failed\n", impls[impl_i].name);
   }
 
+  free(wss);
+  if (csv != stdout)
+    fclose(csv);
+
   return 0;
 }
@@ -1,105 +1,236 @@
 #include <stdlib.h>
+#include <string.h>
+#include "arena.h"
 #include "htable.h"
+#include "sweep.h"
+#include "twheel.h"
 #include "clk.h"
 
 #include <stdio.h>
 
-struct clk_page {
-  uint64_t key;
-  uint8_t referenced;
-  void *data;
-};
-
+/* The table maps keys to page slots in the arena. The referenced bits
+   live in ref[], one byte per slot, packed so that the hand can sweep
+   over many of them at a time. */
 struct clk_s {
-  size_t size;
   size_t nmemb;
-  size_t active;
-  int hand;
+  size_t hand;
   htable_t *t;
-  struct clk_page *page;
-  void *data;
+  arena_t *arena;
+  uint8_t *ref;
+  twheel_t *tw;
+  uint64_t now;
 };
 
 clk_t *clk_new(size_t size, size_t nmemb) {
+  struct clk_opts opts = {.index = HTABLE_CHAINED};
+
+  return clk_new_ex(size, nmemb, &opts);
+}
+
+clk_t *clk_new_ex(size_t size, size_t nmemb, const struct clk_opts *opts) {
+  struct htable_opts topts = {.grow = 0, .index = opts->index};
   clk_t *r;
 
   r = malloc(sizeof(clk_t));
   if (!r)
     goto fail;
 
-  r->page = malloc(nmemb * sizeof(struct clk_page));
-  if (!r->page)
-    goto fail_page;
+  r->ref = calloc(nmemb, 1);
+  if (!r->ref)
+    goto fail_ref;
 
-  r->data = malloc(nmemb * size);
-  if (!r->data)
-    goto fail_data;
+  r->arena = arena_new(size, nmemb);
+  if (!r->arena)
+    goto fail_arena;
 
-  r->t = htable_new(nmemb);
+  r->t = htable_new_ex(nmemb, &topts);
   if (!r->t)
     goto fail_htable;
 
-  r->size = size;
   r->nmemb = nmemb;
-  r->active = 0;
+  r->hand = 0;
+  r->tw = NULL;
+  r->now = 0;
 
   return r;
 
  fail_htable:
-  free(r->data);
- fail_data:
-  free(r->page);
- fail_page:
+  arena_free(&r->arena);
+ fail_arena:
+  free(r->ref);
+ fail_ref:
   free(r);
  fail:
   return NULL;
 }
 
+/* Sets when the page in slot expires, if pages expire at all
+ */
+static void clk_expire(clk_t *clk, size_t slot, uint64_t ttl) {
+  if (!clk->tw)
+    return;
+  if (ttl)
+    twheel_set(clk->tw, slot, clk->now + ttl);
+  else
+    twheel_del(clk->tw, slot);
+}
+
+/* Removes the page in slot from the cache
+ */
+static void clk_drop(clk_t *clk, size_t slot) {
+  htable_del(clk->t, arena_key(clk->arena, slot));
+  clk->ref[slot] = 0;
+  if (clk->tw)
+    twheel_del(clk->tw, slot);
+  arena_release(clk->arena, slot);
+}
+
+/* Frees a page, an expired one if any and otherwise the one the clock
+ * algorithm picks. The hand passes over free pages, which can only be
+ * there while shrinking.
+ */
+static void clk_evict(clk_t *clk) {
+  size_t slot;
+
+  if (clk->tw && !twheel_pop(clk->tw, clk->now, &slot)) {
+    clk_drop(clk, slot);
+    return;
+  }
+
+  do {
+    slot = clk->hand = sweep(clk->ref, clk->nmemb, clk->hand);
+    if (++clk->hand >= clk->nmemb)
+      clk->hand = 0;
+  } while (!arena_in_use(clk->arena, slot));
+
+  clk_drop(clk, slot);
+}
+
 int clk_fetch(clk_t *clk, uint64_t key, void **ptr) {
-  struct clk_page *page;
+  return clk_fetch_ttl(clk, key, clk->now, 0, ptr);
+}
+
+int clk_fetch_ttl(clk_t *clk, uint64_t key, uint64_t now, uint64_t ttl,
+                  void **ptr) {
+  void *val;
+  size_t slot;
+
+  /* the timer wheel is only set up once pages start expiring */
+  if (ttl && !clk->tw) {
+    clk->tw = twheel_new(clk->nmemb, clk->now);
+    if (!clk->tw)
+      return -1;
+  }
+  if (now > clk->now)
+    clk->now = now;
 
   /* if cached, tick the referenced box and return */
-  if (!htable_get(clk->t, key, (void **)&page)) {
-    page->referenced = 1;
-    *ptr = page->data;
+  if (!htable_get(clk->t, key, &val)) {
+    slot = (uintptr_t)val;
+    *ptr = arena_page(clk->arena, slot);
+
+    /* unless it has expired, in which case it is reloaded in place */
+    if (clk->tw && twheel_expired(clk->tw, slot, clk->now)) {
+      clk->ref[slot] = 0;
+      clk_expire(clk, slot, ttl);
+      return 1;
+    }
+
+    clk->ref[slot] = 1;
     return 0;
   }
 
-  /* otherwise, check if there's an unused page available */
-  if (clk->active < clk->nmemb) {
-    page = clk->page + clk->active;
-    page->data = clk->data + clk->active * clk->size;
-    page->key = key;
-    page->referenced = 0;
-    htable_set(clk->t, key, (void *)page);
-    clk->active++;
-    *ptr = page->data;
-    return 1;
+  /* otherwise, take a free page if there is one, or reclaim an expired
+     page, or do eviction according to the clock algorithm */
+  if (arena_alloc(clk->arena, key, &slot)) {
+    clk_evict(clk);
+    arena_alloc(clk->arena, key, &slot);
   }
 
-  /* otherwise, do eviction according to the clock algorithm */
-  while (clk->page[clk->hand].referenced) {
-    clk->page[clk->hand].referenced = 0;
-    if (++clk->hand >= clk->nmemb)
-      clk->hand = 0;
+  clk->ref[slot] = 0;
+  htable_set(clk->t, key, (void *)(uintptr_t)slot);
+  clk_expire(clk, slot, ttl);
+  *ptr = arena_page(clk->arena, slot);
+
+  return 1;
+}
+
+int clk_prefetch(clk_t *clk, uint64_t key, void **ptr) {
+  void *val;
+  size_t slot;
+
+  /* a cached page keeps its referenced box as it is */
+  if (!htable_get(clk->t, key, &val)) {
+    slot = (uintptr_t)val;
+    if (!clk->tw || !twheel_expired(clk->tw, slot, clk->now)) {
+      *ptr = arena_page(clk->arena, slot);
+      return 0;
+    }
   }
-  page = clk->page + clk->hand;
-  if (++clk->hand >= clk->nmemb)
-    clk->hand = 0;
 
-  /* and finally reuse the evicted page */
-  htable_del(clk->t, page->key);
-  htable_set(clk->t, key, page);
-  page->key = key;
-  *ptr = page->data;
+  /* anything else is a miss, which leaves the box unticked */
+  return clk_fetch_ttl(clk, key, clk->now, 0, ptr);
+}
 
-  return 1;
+int clk_invalidate(clk_t *clk, uint64_t key) {
+  void *val;
+
+  if (htable_get(clk->t, key, &val))
+    return 1;
+
+  clk_drop(clk, (uintptr_t)val);
+  return 0;
+}
+
+/* Follows a page the arena moved while shrinking
+ */
+static void clk_move(void *ctx, size_t from, size_t to) {
+  clk_t *clk = ctx;
+  uint64_t key = arena_key(clk->arena, to);
+
+  htable_del(clk->t, key);
+  htable_set(clk->t, key, (void *)(uintptr_t)to);
+  clk->ref[to] = clk->ref[from];
+  if (clk->tw)
+    twheel_move(clk->tw, from, to);
+}
+
+int clk_resize(clk_t *clk, size_t nmemb) {
+  uint8_t *ref;
+
+  if (nmemb < 1)
+    return -1;
+
+  /* new slots are free, and so not referenced */
+  if (nmemb > clk->nmemb) {
+    ref = realloc(clk->ref, nmemb);
+    if (!ref)
+      return -1;
+    clk->ref = ref;
+    memset(ref + clk->nmemb, 0, nmemb - clk->nmemb);
+    if ((clk->tw && twheel_resize(clk->tw, nmemb)) ||
+        htable_grow(clk->t, nmemb) ||
+        arena_resize(clk->arena, nmemb, NULL, NULL))
+      return -1;
+  } else {
+    while (arena_used(clk->arena) > nmemb)
+      clk_evict(clk);
+    arena_resize(clk->arena, nmemb, clk_move, clk);
+    if (clk->tw)
+      twheel_resize(clk->tw, nmemb);
+    if (clk->hand >= nmemb)
+      clk->hand = 0;
+  }
+
+  clk->nmemb = nmemb;
+  return 0;
 }
 
 void clk_free(clk_t **clk) {
-  free((*clk)->data);
-  free((*clk)->page);
+  arena_free(&(*clk)->arena);
+  free((*clk)->ref);
   htable_free(&(*clk)->t);
+  twheel_free(&(*clk)->tw);
   free(*clk);
   *clk = NULL;
 }
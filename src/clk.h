@@ -2,11 +2,37 @@
 #define CLK_H_403dd41a1efbdc2bfb0ea2638ba7ccf5
 
 #include <stdint.h>
+#include "htable.h"
 
 typedef struct clk_s clk_t;
 
+/* Options for clk_new_ex().
+ *
+ * index is the kind of table pages are looked up in, see htable.h.
+ */
+struct clk_opts {
+  enum htable_index index;
+};
+
 clk_t *clk_new(size_t size, size_t nmemb);
+clk_t *clk_new_ex(size_t size, size_t nmemb, const struct clk_opts *opts);
 int clk_fetch(clk_t *clock, uint64_t key, void **ptr);
+
+/* Same as lru_fetch_ttl(), see lru.h
+ */
+int clk_fetch_ttl(clk_t *clock, uint64_t key, uint64_t now, uint64_t ttl,
+                  void **ptr);
+
+/* Same as lru_prefetch(), see lru.h, except that prefetched pages
+ * enter as any missed page, unreferenced, so that the hand takes
+ * those that haven't been fetched the next time it passes.
+ */
+int clk_prefetch(clk_t *clock, uint64_t key, void **ptr);
+
+/* Same as lru_invalidate() and lru_resize(), see lru.h
+ */
+int clk_invalidate(clk_t *clock, uint64_t key);
+int clk_resize(clk_t *clock, size_t nmemb);
 void clk_free(clk_t **clock);
 
 #endif
@@ -0,0 +1,392 @@
+#include <stdlib.h>
+#include <string.h>
+#include "cuckoo.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define MAX(a,b) ((a) > (b) ? (a) : (b))
+
+#define SLOTS 8
+#define STASH 8
+/* how far set() goes moving entries before it gives up */
+#define MAX_KICKS 500
+/* buckets are allocated for the capacity at this load, in percent */
+#define LOAD 90
+/* 4 buckets of tags to a cache line */
+#define MIN_BUCKETS 4
+#define LINE 64
+
+struct cuckoo_entry {
+  uint64_t key;
+  void *val;
+};
+
+struct cuckoo_s {
+  /* SLOTS tags per bucket, 0 for a free slot, and the entries */
+  uint16_t *tag;
+  struct cuckoo_entry *entry;
+  size_t mask;
+  struct cuckoo_entry stash[STASH];
+  int nstash;
+  size_t size;
+  size_t capacity;
+  int grow;
+  /* picks the entries that are moved */
+  unsigned kick;
+  /* odd while the table is being written to */
+  unsigned version;
+};
+
+/* splitmix64's finalizer. The bucket comes from the low bits, the
+ * other bucket and the tag from the high ones.
+ */
+static uint64_t hash(uint64_t k) {
+  k ^= k >> 30;
+  k *= 0xbf58476d1ce4e5b9ULL;
+  k ^= k >> 27;
+  k *= 0x94d049bb133111ebULL;
+  k ^= k >> 31;
+
+  return k;
+}
+
+static uint16_t tag_of(uint64_t h) {
+  return (h >> 48) ? (h >> 48) : 1;
+}
+
+static size_t bucket1(cuckoo_t *c, uint64_t h) {
+  return h & c->mask;
+}
+
+static size_t bucket2(cuckoo_t *c, uint64_t h) {
+  return (h >> 24) & c->mask;
+}
+
+/* Returns the slot in bucket b whose tag is tag and, unless key is
+ * NULL, whose key is *key, or -1 if there is none
+ */
+static long bucket_find(cuckoo_t *c, size_t b, uint16_t tag,
+                        const uint64_t *key) {
+  struct cuckoo_entry *e = c->entry + b * SLOTS;
+#ifdef __SSE2__
+  __m128i tags = _mm_load_si128((__m128i *)(c->tag + b * SLOTS));
+  unsigned m, i;
+
+  /* a matching tag sets two bits of the mask */
+  m = _mm_movemask_epi8(_mm_cmpeq_epi16(tags, _mm_set1_epi16(tag)));
+  while (m) {
+    i = __builtin_ctz(m) >> 1;
+    if (!key || e[i].key == *key)
+      return b * SLOTS + i;
+    m &= ~(3U << (2 * i));
+  }
+#else
+  uint16_t *tags = c->tag + b * SLOTS;
+  unsigned i;
+
+  for (i=0; i<SLOTS; i++)
+    if (tags[i] == tag && (!key || e[i].key == *key))
+      return b * SLOTS + i;
+#endif
+
+  return -1;
+}
+
+/* Returns the slot holding key, -1 if it isn't in a bucket
+ */
+static long find(cuckoo_t *c, uint64_t key) {
+  uint64_t h = hash(key);
+  long s;
+
+  s = bucket_find(c, bucket1(c, h), tag_of(h), &key);
+  if (s < 0)
+    s = bucket_find(c, bucket2(c, h), tag_of(h), &key);
+
+  return s;
+}
+
+static long stash_find(cuckoo_t *c, uint64_t key) {
+  int i;
+
+  for (i=0; i<c->nstash; i++)
+    if (c->stash[i].key == key)
+      return i;
+
+  return -1;
+}
+
+static void slot_put(cuckoo_t *c, size_t s, uint16_t tag,
+                     struct cuckoo_entry *e) {
+  c->tag[s] = tag;
+  c->entry[s] = *e;
+}
+
+/* Places an entry whose key is not in the table, moving others out of
+ * the way if its buckets are full.
+ *
+ * Returns 0 on success
+ *         -1 if some entry couldn't be placed, the stash being full,
+ *            in which case that entry is written back to e
+ */
+static int place(cuckoo_t *c, struct cuckoo_entry *ep) {
+  struct cuckoo_entry e = *ep, victim;
+  uint64_t h = hash(e.key);
+  uint16_t tag = tag_of(h), vtag;
+  size_t b;
+  long s;
+  int n;
+
+  if ((s = bucket_find(c, bucket1(c, h), 0, NULL)) >= 0 ||
+      (s = bucket_find(c, bucket2(c, h), 0, NULL)) >= 0) {
+    slot_put(c, s, tag, &e);
+    return 0;
+  }
+
+  /* evict a slot of one of the buckets, and move what was there to
+     its other bucket, and so on, until some entry finds a free slot */
+  b = (c->kick++ & 1) ? bucket1(c, h) : bucket2(c, h);
+  for (n=0; n<MAX_KICKS; n++) {
+    s = b * SLOTS + c->kick++ % SLOTS;
+    victim = c->entry[s];
+    vtag = c->tag[s];
+    slot_put(c, s, tag, &e);
+    e = victim;
+    tag = vtag;
+
+    h = hash(e.key);
+    b = bucket1(c, h) == b ? bucket2(c, h) : bucket1(c, h);
+    if ((s = bucket_find(c, b, 0, NULL)) >= 0) {
+      slot_put(c, s, tag, &e);
+      return 0;
+    }
+  }
+
+  if (c->nstash == STASH) {
+    *ep = e;
+    return -1;
+  }
+  c->stash[c->nstash++] = e;
+  return 0;
+}
+
+/* Allocates the buckets of a table, all slots free
+ */
+static int alloc_buckets(cuckoo_t *c, size_t nbuckets) {
+  c->tag = aligned_alloc(LINE, nbuckets * SLOTS * sizeof(uint16_t));
+  c->entry = malloc(nbuckets * SLOTS * sizeof(struct cuckoo_entry));
+  if (!c->tag || !c->entry) {
+    free(c->tag);
+    free(c->entry);
+    return -1;
+  }
+
+  memset(c->tag, 0, nbuckets * SLOTS * sizeof(uint16_t));
+  c->mask = nbuckets - 1;
+  c->nstash = 0;
+
+  return 0;
+}
+
+static size_t buckets_for(size_t capacity) {
+  size_t n = MIN_BUCKETS;
+
+  while (n * SLOTS * LOAD / 100 < capacity)
+    n <<= 1;
+
+  return n;
+}
+
+/* Moves every entry to a table of nbuckets buckets, or more if they
+ * don't fit
+ */
+static int rehash(cuckoo_t *c, size_t nbuckets) {
+  struct cuckoo_entry stash[STASH], e;
+  struct cuckoo_entry *entry = c->entry;
+  uint16_t *tag = c->tag;
+  size_t mask = c->mask, i;
+  int nstash = c->nstash;
+
+  memcpy(stash, c->stash, sizeof(stash));
+
+  for (;; nbuckets <<= 1) {
+    if (alloc_buckets(c, nbuckets))
+      goto fail;
+
+    for (i=0; i<(mask + 1) * SLOTS; i++)
+      if (tag[i] && place(c, (e = entry[i], &e)))
+        break;
+    if (i == (mask + 1) * SLOTS) {
+      for (i=0; i<nstash; i++)
+        if (place(c, (e = stash[i], &e)))
+          break;
+      if (i == nstash)
+        break;
+    }
+
+    free(c->tag);
+    free(c->entry);
+  }
+
+  free(tag);
+  free(entry);
+  return 0;
+
+ fail:
+  c->tag = tag;
+  c->entry = entry;
+  c->mask = mask;
+  c->nstash = nstash;
+  memcpy(c->stash, stash, sizeof(stash));
+  return -1;
+}
+
+/* Brackets a change to the table, so that readers can tell
+ */
+static void write_begin(cuckoo_t *c) {
+  __atomic_store_n(&c->version, c->version + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void write_end(cuckoo_t *c) {
+  __atomic_store_n(&c->version, c->version + 1, __ATOMIC_RELEASE);
+}
+
+cuckoo_t *cuckoo_new(size_t capacity, int grow) {
+  cuckoo_t *c;
+
+  capacity = MAX(capacity, 1);
+
+  c = calloc(1, sizeof(cuckoo_t));
+  if (!c)
+    return NULL;
+
+  if (alloc_buckets(c, buckets_for(capacity))) {
+    free(c);
+    return NULL;
+  }
+
+  c->capacity = capacity;
+  c->grow = grow;
+
+  return c;
+}
+
+int cuckoo_set(cuckoo_t *c, uint64_t key, void *val) {
+  struct cuckoo_entry e = {.key = key, .val = val};
+  long s;
+  int r;
+
+  if ((s = find(c, key)) >= 0) {
+    write_begin(c);
+    c->entry[s].val = val;
+    write_end(c);
+    return 0;
+  }
+  if ((s = stash_find(c, key)) >= 0) {
+    write_begin(c);
+    c->stash[s].val = val;
+    write_end(c);
+    return 0;
+  }
+
+  if (c->size >= c->capacity &&
+      (!c->grow || cuckoo_grow(c, 2 * c->capacity)))
+    return -1;
+
+  write_begin(c);
+  r = place(c, &e);
+  write_end(c);
+
+  /* with the stash full there is no choice but more buckets, which
+     makes room for the entry left over */
+  if (r && (rehash(c, 2 * (c->mask + 1)) || place(c, &e)))
+    return -1;
+
+  c->size++;
+  return 0;
+}
+
+int cuckoo_get(cuckoo_t *c, uint64_t key, void **val) {
+  unsigned version;
+  void *v = NULL;
+  long s;
+  int r = 1;
+
+  /* optimistically read, and read again if a writer got in the way */
+  do {
+    version = __atomic_load_n(&c->version, __ATOMIC_ACQUIRE);
+    if (version & 1)
+      continue;
+
+    r = 0;
+    if ((s = find(c, key)) >= 0)
+      v = c->entry[s].val;
+    else if (c->nstash && (s = stash_find(c, key)) >= 0)
+      v = c->stash[s].val;
+    else
+      r = 1;
+
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  } while ((version & 1) ||
+           version != __atomic_load_n(&c->version, __ATOMIC_RELAXED));
+
+  if (!r)
+    *val = v;
+  return r;
+}
+
+int cuckoo_pop(cuckoo_t *c, uint64_t key, void **val) {
+  long s;
+
+  if ((s = find(c, key)) >= 0) {
+    *val = c->entry[s].val;
+    write_begin(c);
+    c->tag[s] = 0;
+    write_end(c);
+  } else if ((s = stash_find(c, key)) >= 0) {
+    *val = c->stash[s].val;
+    write_begin(c);
+    c->stash[s] = c->stash[--c->nstash];
+    write_end(c);
+  } else {
+    return 1;
+  }
+
+  c->size--;
+  return 0;
+}
+
+int cuckoo_del(cuckoo_t *c, uint64_t key) {
+  void *val;
+
+  return cuckoo_pop(c, key, &val);
+}
+
+int cuckoo_grow(cuckoo_t *c, size_t capacity) {
+  size_t nbuckets;
+
+  if (capacity <= c->capacity)
+    return 0;
+
+  nbuckets = buckets_for(capacity);
+  if (nbuckets > c->mask + 1 && rehash(c, nbuckets))
+    return -1;
+
+  c->capacity = capacity;
+  return 0;
+}
+
+size_t cuckoo_size(cuckoo_t *c) {
+  return c->size;
+}
+
+void cuckoo_free(cuckoo_t **c) {
+  if (!c || !*c)
+    return;
+  free((*c)->tag);
+  free((*c)->entry);
+  free(*c);
+  *c = NULL;
+}
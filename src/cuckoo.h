@@ -0,0 +1,88 @@
+#ifndef CUCKOO_H_9c2e51f7a04b4d8e93b6f1a7c5e8d203
+#define CUCKOO_H_9c2e51f7a04b4d8e93b6f1a7c5e8d203
+
+/* Bucketized cuckoo hash table mapping unsigned 64 bit integer to void
+ * pointer.
+ *
+ * Each key can live in one of two buckets of 8 slots. A bucket's
+ * slots carry 16 bit tags taken from the key hashes, kept apart from
+ * the entries so that the tags of a bucket can be compared to a key's
+ * in one SSE2 instruction. A lookup reads the tags of at most two
+ * buckets and the entry of each slot whose tag matches. A set() that
+ * finds both buckets full moves entries to their other bucket to make
+ * room, and the rare entry that can't be placed that way goes to a
+ * small stash.
+ *
+ * Readers may run concurrently with a single writer: get() retries if
+ * set(), pop() or del() changed the table while it was reading, going
+ * by a version counter the writer bumps. Rehashing frees the buckets
+ * readers may be looking at, though, so grow() and a set() that has
+ * to rehash must not run concurrently with readers. set() rehashes
+ * when the table is full and allowed to grow, and, very rarely, when
+ * it runs out of room to move entries around.
+ *
+ * Unlike htable_t, keys are unique: setting a key that is already in
+ * the table replaces its value.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef struct cuckoo_s cuckoo_t;
+
+/* Allocates a new table of the given capacity, which doubles when the
+ * table is full if grow is set.
+ *
+ * If capacity < 1, a capacity of 1 will be used.
+ *
+ * Returns NULL if out of memory.
+ */
+cuckoo_t *cuckoo_new(size_t capacity, int grow);
+
+/* Sets value for key
+ *
+ * Returns 0 on success
+ *        -1 if the table is full and can't grow, or out of memory
+ */
+int cuckoo_set(cuckoo_t *c, uint64_t key, void *val);
+
+/* Retrieves value by key
+ *
+ * Returns 0 on success
+ *         1 if key was not found
+ */
+int cuckoo_get(cuckoo_t *c, uint64_t key, void **val);
+
+/* Retrieves and deletes entry by key
+ *
+ * Returns 0 on success
+ *         1 if entry was not found
+ */
+int cuckoo_pop(cuckoo_t *c, uint64_t key, void **val);
+
+/* Deletes entry by key
+ *
+ * Returns 0 on success
+ *         1 if entry was not found
+ */
+int cuckoo_del(cuckoo_t *c, uint64_t key);
+
+/* Grows the table to hold capacity entries, if it holds fewer,
+ * rehashing every entry if more buckets are needed.
+ *
+ * Returns 0 on success
+ *         -1 if out of memory
+ */
+int cuckoo_grow(cuckoo_t *c, size_t capacity);
+
+/* Returns the number of entries in c
+ */
+size_t cuckoo_size(cuckoo_t *c);
+
+/* Destroys a table and releases all associated resources
+ *
+ * The cuckoo pointer at *c will be set to NULL
+ */
+void cuckoo_free(cuckoo_t **c);
+
+#endif
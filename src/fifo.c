@@ -1,88 +1,242 @@
 #include <stdlib.h>
+#include "arena.h"
 #include "htable.h"
+#include "twheel.h"
 #include "fifo.h"
 
 #include <stdio.h>
 
-struct fifo_page {
-  uint64_t key;
-  void *data;
-};
+#define NIL UINT32_MAX
 
+/* The table maps keys to page slots in the arena. The queue links
+   the slots in use through next[] and prev[], oldest first, so that
+   pages dropped before their turn can leave it. */
 struct fifo_s {
-  size_t size;
   size_t nmemb;
-  size_t active;
-  int head;
   htable_t *t;
-  struct fifo_page *page;
-  void *data;
+  arena_t *arena;
+  uint32_t *next;
+  uint32_t *prev;
+  uint32_t head;
+  uint32_t tail;
+  twheel_t *tw;
+  uint64_t now;
 };
 
 fifo_t *fifo_new(size_t size, size_t nmemb) {
+  struct fifo_opts opts = {.index = HTABLE_CHAINED};
+
+  return fifo_new_ex(size, nmemb, &opts);
+}
+
+fifo_t *fifo_new_ex(size_t size, size_t nmemb, const struct fifo_opts *opts) {
+  struct htable_opts topts = {.grow = 0, .index = opts->index};
   fifo_t *r;
 
+  if (nmemb >= NIL) goto fail;
+
   r = malloc(sizeof(fifo_t));
   if (!r) goto fail;
 
-  r->page = malloc(nmemb * sizeof(struct fifo_page));
-  if (!r->page) goto fail_page;
+  r->next = malloc(nmemb * sizeof(uint32_t));
+  if (!r->next) goto fail_next;
+
+  r->prev = malloc(nmemb * sizeof(uint32_t));
+  if (!r->prev) goto fail_prev;
 
-  r->data = malloc(nmemb * size);
-  if (!r->data) goto fail_data;
+  r->arena = arena_new(size, nmemb);
+  if (!r->arena) goto fail_arena;
 
-  r->t = htable_new(nmemb);
+  r->t = htable_new_ex(nmemb, &topts);
   if (!r->t) goto fail_htable;
 
-  r->size = size;
   r->nmemb = nmemb;
-  r->active = 0;
-  r->head = 0;
+  r->head = r->tail = NIL;
+  r->tw = NULL;
+  r->now = 0;
 
   return r;
 
  fail_htable:
-  free(r->data);
- fail_data:
-  free(r->page);
- fail_page:
+  arena_free(&r->arena);
+ fail_arena:
+  free(r->prev);
+ fail_prev:
+  free(r->next);
+ fail_next:
   free(r);
  fail:
   return NULL;
 }
 
+/* Appends slot to the queue, as its newest page
+ */
+static void fifo_push(fifo_t *fifo, uint32_t slot) {
+  fifo->next[slot] = NIL;
+  fifo->prev[slot] = fifo->tail;
+  if (fifo->tail != NIL)
+    fifo->next[fifo->tail] = slot;
+  else
+    fifo->head = slot;
+  fifo->tail = slot;
+}
+
+/* Removes slot from the queue
+ */
+static void fifo_unlink(fifo_t *fifo, uint32_t slot) {
+  if (fifo->prev[slot] != NIL)
+    fifo->next[fifo->prev[slot]] = fifo->next[slot];
+  else
+    fifo->head = fifo->next[slot];
+  if (fifo->next[slot] != NIL)
+    fifo->prev[fifo->next[slot]] = fifo->prev[slot];
+  else
+    fifo->tail = fifo->prev[slot];
+}
+
+/* Sets when the page in slot expires, if pages expire at all
+ */
+static void fifo_expire(fifo_t *fifo, size_t slot, uint64_t ttl) {
+  if (!fifo->tw)
+    return;
+  if (ttl)
+    twheel_set(fifo->tw, slot, fifo->now + ttl);
+  else
+    twheel_del(fifo->tw, slot);
+}
+
+/* Removes the page in slot from the cache
+ */
+static void fifo_drop(fifo_t *fifo, size_t slot) {
+  htable_del(fifo->t, arena_key(fifo->arena, slot));
+  fifo_unlink(fifo, slot);
+  if (fifo->tw)
+    twheel_del(fifo->tw, slot);
+  arena_release(fifo->arena, slot);
+}
+
+/* Frees a page, an expired one if any and the oldest one otherwise
+ */
+static void fifo_evict(fifo_t *fifo) {
+  size_t slot;
+
+  if (!fifo->tw || twheel_pop(fifo->tw, fifo->now, &slot))
+    slot = fifo->head;
+  fifo_drop(fifo, slot);
+}
+
 int fifo_fetch(fifo_t *fifo, uint64_t key, void **ptr) {
-  struct fifo_page *page;
+  return fifo_fetch_ttl(fifo, key, fifo->now, 0, ptr);
+}
 
-  if (!htable_get(fifo->t, key, (void **)&page)) {
-    *ptr = page->data;
+int fifo_fetch_ttl(fifo_t *fifo, uint64_t key, uint64_t now, uint64_t ttl,
+                   void **ptr) {
+  void *val;
+  size_t slot;
+
+  if (ttl && !fifo->tw) {
+    fifo->tw = twheel_new(fifo->nmemb, fifo->now);
+    if (!fifo->tw)
+      return -1;
+  }
+  if (now > fifo->now)
+    fifo->now = now;
+
+  if (!htable_get(fifo->t, key, &val)) {
+    slot = (uintptr_t)val;
+    *ptr = arena_page(fifo->arena, slot);
+    /* an expired page is reloaded where it is */
+    if (fifo->tw && twheel_expired(fifo->tw, slot, fifo->now)) {
+      fifo_expire(fifo, slot, ttl);
+      return 1;
+    }
     return 0;
   }
 
-  if (fifo->active < fifo->nmemb) {
-    page = fifo->page + fifo->active;
-    page->data = fifo->data + fifo->active * fifo->size;
-    page->key = key;
-    fifo->active++;
-    htable_set(fifo->t, key, (void *)page);
-    *ptr = page->data;
-    return 1;
+  /* expired pages are reclaimed before the oldest page is evicted */
+  if (arena_alloc(fifo->arena, key, &slot)) {
+    fifo_evict(fifo);
+    arena_alloc(fifo->arena, key, &slot);
   }
 
-  page = fifo->page + fifo->head;
-  if (++fifo->head >= fifo->nmemb)
-    fifo->head = 0;
-  htable_del(fifo->t, page->key);
-  htable_set(fifo->t, key, page);
-  page->key = key;
-  *ptr = page->data;
+  htable_set(fifo->t, key, (void *)(uintptr_t)slot);
+  fifo_push(fifo, slot);
+  fifo_expire(fifo, slot, ttl);
+  *ptr = arena_page(fifo->arena, slot);
   return 1;
 }
 
+int fifo_invalidate(fifo_t *fifo, uint64_t key) {
+  void *val;
+
+  if (htable_get(fifo->t, key, &val))
+    return 1;
+
+  fifo_drop(fifo, (uintptr_t)val);
+  return 0;
+}
+
+/* Follows a page the arena moved while shrinking
+ */
+static void fifo_move(void *ctx, size_t from, size_t to) {
+  fifo_t *fifo = ctx;
+  uint64_t key = arena_key(fifo->arena, to);
+
+  htable_del(fifo->t, key);
+  htable_set(fifo->t, key, (void *)(uintptr_t)to);
+
+  /* to takes over from's place in the queue */
+  fifo->next[to] = fifo->next[from];
+  fifo->prev[to] = fifo->prev[from];
+  if (fifo->prev[to] != NIL)
+    fifo->next[fifo->prev[to]] = to;
+  else
+    fifo->head = to;
+  if (fifo->next[to] != NIL)
+    fifo->prev[fifo->next[to]] = to;
+  else
+    fifo->tail = to;
+
+  if (fifo->tw)
+    twheel_move(fifo->tw, from, to);
+}
+
+int fifo_resize(fifo_t *fifo, size_t nmemb) {
+  uint32_t *next, *prev;
+
+  if (nmemb < 1 || nmemb >= NIL)
+    return -1;
+
+  if (nmemb > fifo->nmemb) {
+    next = realloc(fifo->next, nmemb * sizeof(uint32_t));
+    if (next)
+      fifo->next = next;
+    prev = realloc(fifo->prev, nmemb * sizeof(uint32_t));
+    if (prev)
+      fifo->prev = prev;
+    if (!next || !prev ||
+        (fifo->tw && twheel_resize(fifo->tw, nmemb)) ||
+        htable_grow(fifo->t, nmemb) ||
+        arena_resize(fifo->arena, nmemb, NULL, NULL))
+      return -1;
+  } else {
+    while (arena_used(fifo->arena) > nmemb)
+      fifo_evict(fifo);
+    arena_resize(fifo->arena, nmemb, fifo_move, fifo);
+    if (fifo->tw)
+      twheel_resize(fifo->tw, nmemb);
+  }
+
+  fifo->nmemb = nmemb;
+  return 0;
+}
+
 void fifo_free(fifo_t **fifo) {
-  free((*fifo)->data);
-  free((*fifo)->page);
+  arena_free(&(*fifo)->arena);
+  free((*fifo)->next);
+  free((*fifo)->prev);
   htable_free(&(*fifo)->t);
+  twheel_free(&(*fifo)->tw);
   free(*fifo);
   *fifo = NULL;
 }
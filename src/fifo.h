@@ -2,11 +2,31 @@
 #define FIFO_H_b3d1cfd36c988a4d2797b7f86bbe4bce
 
 #include <stdint.h>
+#include "htable.h"
 
 typedef struct fifo_s fifo_t;
 
+/* Options for fifo_new_ex().
+ *
+ * index is the kind of table pages are looked up in, see htable.h.
+ */
+struct fifo_opts {
+  enum htable_index index;
+};
+
 fifo_t *fifo_new(size_t size, size_t nmemb);
+fifo_t *fifo_new_ex(size_t size, size_t nmemb, const struct fifo_opts *opts);
 int fifo_fetch(fifo_t *fifo, uint64_t key, void **ptr);
+
+/* Same as lru_fetch_ttl(), see lru.h
+ */
+int fifo_fetch_ttl(fifo_t *fifo, uint64_t key, uint64_t now, uint64_t ttl,
+                   void **ptr);
+
+/* Same as lru_invalidate() and lru_resize(), see lru.h
+ */
+int fifo_invalidate(fifo_t *fifo, uint64_t key);
+int fifo_resize(fifo_t *fifo, size_t nmemb);
 void fifo_free(fifo_t **fifo);
 
 #endif
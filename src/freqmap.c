@@ -0,0 +1,400 @@
+#include <stdlib.h>
+#include "freqmap.h"
+
+#define MAX(a,b) ((a) > (b) ? (a) : (b))
+
+
+typedef struct freqmap_entry_s freqmap_entry_t;
+typedef struct freqmap_bucket_s freqmap_bucket_t;
+
+struct freqmap_entry_s {
+  uint64_t key;
+  void *val;
+  freqmap_entry_t *tnext;
+  freqmap_entry_t *lnext;
+  freqmap_entry_t *lprev;
+  freqmap_bucket_t *bucket;
+};
+
+/* A bucket holds the entries of one frequency, MRU first. Buckets are
+ * kept in a list ordered by frequency, and there is never an empty
+ * bucket in it.
+ */
+struct freqmap_bucket_s {
+  uint64_t freq;
+  freqmap_entry_t *first;
+  freqmap_entry_t *last;
+  freqmap_bucket_t *next;
+  freqmap_bucket_t *prev;
+};
+
+struct freqmap_s {
+  freqmap_entry_t **table;
+  freqmap_entry_t *entry;
+  freqmap_entry_t *free;
+  freqmap_bucket_t *bucket;
+  freqmap_bucket_t *bfree;
+  freqmap_bucket_t *min;
+  /* entries and buckets added by freqmap_grow() */
+  void **more;
+  size_t nmore;
+  size_t capacity;
+  size_t tsize;
+  size_t size;
+};
+
+
+/* Thomas Wang's hash64shift()
+ */
+static int hash64shift(uint64_t k, int mod) {
+  k = (~k) + (k << 21);
+  k = k ^ (k >> 24);
+  k = (k + (k << 3)) + (k << 8);
+  k = k ^ (k >> 14);
+  k = (k + (k << 2)) + (k << 4);
+  k = k ^ (k >> 28);
+  k = k + (k << 31);
+
+  return k % mod;
+}
+
+/* Scans an entry's table list for a key. Returns 0 if found, 1
+ * otherwise. The entry and its previous entry in the table list are
+ * writtenback to entry and prev on success.
+ */
+static int table_scan(freqmap_entry_t *list, uint64_t key,
+                      freqmap_entry_t **entry,
+                      freqmap_entry_t **prev) {
+  freqmap_entry_t *c = list, *p = NULL;
+
+  while (c) {
+    if (c->key == key) {
+      *entry = c;
+      *prev = p;
+      return 0;
+    }
+    p = c;
+    c = c->tnext;
+  }
+
+  return 1;
+}
+
+/* Allocates a bucket for freq and links it after prev, or first if
+ * prev is NULL. There is always a free bucket, since there are more
+ * buckets than entries.
+ */
+static freqmap_bucket_t *bucket_new(freqmap_t *fm, freqmap_bucket_t *prev,
+                                    uint64_t freq) {
+  freqmap_bucket_t *b;
+
+  b = fm->bfree;
+  fm->bfree = b->next;
+
+  b->freq = freq;
+  b->first = b->last = NULL;
+  b->prev = prev;
+  b->next = prev ? prev->next : fm->min;
+  if (b->next)
+    b->next->prev = b;
+  if (prev)
+    prev->next = b;
+  else
+    fm->min = b;
+
+  return b;
+}
+
+/* Unlinks a bucket from the bucket list and puts it on the free list
+ */
+static void bucket_free(freqmap_t *fm, freqmap_bucket_t *b) {
+  if (b->prev)
+    b->prev->next = b->next;
+  else
+    fm->min = b->next;
+  if (b->next)
+    b->next->prev = b->prev;
+
+  b->next = fm->bfree;
+  fm->bfree = b;
+}
+
+/* Removes entry from its bucket, freeing the bucket if it becomes
+ * empty unless keep is set. Note that the entry will _not_ be removed
+ * from the hash table.
+ */
+static void unlink(freqmap_t *fm, freqmap_entry_t *entry, int keep) {
+  freqmap_bucket_t *b = entry->bucket;
+
+  if (entry->lprev)
+    entry->lprev->lnext = entry->lnext;
+  else
+    b->first = entry->lnext;
+  if (entry->lnext)
+    entry->lnext->lprev = entry->lprev;
+  else
+    b->last = entry->lprev;
+
+  if (!b->first && !keep)
+    bucket_free(fm, b);
+}
+
+/* Inserts entry as head of a bucket
+ */
+static void link_head(freqmap_bucket_t *b, freqmap_entry_t *entry) {
+  if (b->first)
+    b->first->lprev = entry;
+  else
+    b->last = entry;
+  entry->lprev = NULL;
+  entry->lnext = b->first;
+  entry->bucket = b;
+  b->first = entry;
+}
+
+/* Returns the bucket for freq, searching from (and including) the
+ * bucket from, or from the lowest frequency if from is NULL. The
+ * bucket is created if needed.
+ */
+static freqmap_bucket_t *bucket_find(freqmap_t *fm, freqmap_bucket_t *from,
+                                     uint64_t freq) {
+  freqmap_bucket_t *prev = from ? from->prev : NULL, *b;
+
+  for (b = from ? from : fm->min; b && b->freq < freq; b = b->next)
+    prev = b;
+
+  if (b && b->freq == freq)
+    return b;
+
+  return bucket_new(fm, prev, freq);
+}
+
+freqmap_t *freqmap_new(size_t capacity) {
+  int i;
+  freqmap_t *fm;
+  freqmap_entry_t *entry;
+  freqmap_entry_t **table;
+  freqmap_bucket_t *bucket;
+
+  capacity = MAX(capacity, 1);
+
+  fm = calloc(1, sizeof(freqmap_t));
+  entry = malloc(capacity * sizeof(freqmap_entry_t));
+  table = calloc(capacity, sizeof(freqmap_entry_t *));
+  bucket = malloc((capacity + 1) * sizeof(freqmap_bucket_t));
+
+  if (!fm || !entry || !table || !bucket) {
+    free(fm);
+    free(entry);
+    free(table);
+    free(bucket);
+    return NULL;
+  }
+
+  fm->entry = entry;
+  fm->table = table;
+  fm->bucket = bucket;
+  fm->min = NULL;
+  fm->capacity = capacity;
+  fm->tsize = capacity;
+  fm->size = 0;
+
+  /* create the lists of unused entries and buckets */
+  fm->free = fm->entry;
+  for (i=0; i<capacity; i++)
+    fm->entry[i].tnext = &fm->entry[i+1];
+  fm->entry[capacity-1].tnext = NULL;
+
+  fm->bfree = fm->bucket;
+  for (i=0; i<capacity; i++)
+    fm->bucket[i].next = &fm->bucket[i+1];
+  fm->bucket[capacity].next = NULL;
+
+  return fm;
+}
+
+void freqmap_free(freqmap_t **fm) {
+  if (!fm || !*fm)
+    return;
+  while ((*fm)->nmore)
+    free((*fm)->more[--(*fm)->nmore]);
+  free((*fm)->more);
+  free((*fm)->entry);
+  free((*fm)->table);
+  free((*fm)->bucket);
+  free(*fm);
+  *fm = NULL;
+}
+
+int freqmap_grow(freqmap_t *fm, size_t capacity) {
+  freqmap_entry_t *entry;
+  freqmap_bucket_t *bucket;
+  void **more;
+  size_t n, i;
+
+  if (capacity <= fm->capacity)
+    return 0;
+  n = capacity - fm->capacity;
+
+  more = realloc(fm->more, (fm->nmore + 2) * sizeof(*more));
+  if (!more)
+    return -1;
+  fm->more = more;
+
+  /* there has to be a bucket per entry, as before */
+  entry = malloc(n * sizeof(freqmap_entry_t));
+  bucket = malloc(n * sizeof(freqmap_bucket_t));
+  if (!entry || !bucket) {
+    free(entry);
+    free(bucket);
+    return -1;
+  }
+  fm->more[fm->nmore++] = entry;
+  fm->more[fm->nmore++] = bucket;
+
+  for (i=0; i<n-1; i++) {
+    entry[i].tnext = &entry[i+1];
+    bucket[i].next = &bucket[i+1];
+  }
+  entry[n-1].tnext = fm->free;
+  fm->free = entry;
+  bucket[n-1].next = fm->bfree;
+  fm->bfree = bucket;
+  fm->capacity = capacity;
+
+  return 0;
+}
+
+size_t freqmap_size(freqmap_t *fm) {
+  return fm->size;
+}
+
+uint64_t freqmap_min(freqmap_t *fm) {
+  return fm->min ? fm->min->freq : 0;
+}
+
+int freqmap_set(freqmap_t *fm, uint64_t key, void *val, uint64_t freq) {
+  int h;
+  freqmap_entry_t *entry, *prev;
+
+  h = hash64shift(key, fm->tsize);
+
+  /* replace value and frequency if key already exists */
+  if (!table_scan(fm->table[h], key, &entry, &prev)) {
+    unlink(fm, entry, 0);
+  } else {
+    /* otherwise grab an entry from the free list */
+    if (!fm->free)
+      return 1;
+    entry = fm->free;
+    fm->free = entry->tnext;
+
+    /* insert it into the hash table */
+    entry->tnext = fm->table[h];
+    fm->table[h] = entry;
+
+    fm->size++;
+    entry->key = key;
+  }
+
+  entry->val = val;
+  link_head(bucket_find(fm, NULL, freq), entry);
+
+  return 0;
+}
+
+int freqmap_replace(freqmap_t *fm, uint64_t key, void *val) {
+  int h;
+  freqmap_entry_t *entry, *prev;
+
+  h = hash64shift(key, fm->tsize);
+  if (table_scan(fm->table[h], key, &entry, &prev))
+    return 1;
+
+  entry->val = val;
+  return 0;
+}
+
+int freqmap_get(freqmap_t *fm, uint64_t key, void **val) {
+  int h;
+  freqmap_entry_t *entry, *prev;
+  freqmap_bucket_t *b;
+
+  h = hash64shift(key, fm->tsize);
+  if (table_scan(fm->table[h], key, &entry, &prev))
+    return 1;
+
+  /* move to the next bucket up, which the old one may become if the
+     entry was alone in it */
+  b = entry->bucket;
+  if (b->first == entry && b->last == entry &&
+      (!b->next || b->next->freq != b->freq + 1)) {
+    b->freq++;
+  } else {
+    unlink(fm, entry, 1);
+    b = bucket_find(fm, b, b->freq + 1);
+    if (!entry->bucket->first)
+      bucket_free(fm, entry->bucket);
+    link_head(b, entry);
+  }
+
+  *val = entry->val;
+  return 0;
+}
+
+int freqmap_pop(freqmap_t *fm, uint64_t key, void **val, uint64_t *freq) {
+  int h;
+  freqmap_entry_t *entry, *tprev;
+
+  /* find the entry */
+  h = hash64shift(key, fm->tsize);
+  if (table_scan(fm->table[h], key, &entry, &tprev))
+    return 1;
+
+  /* disconnect from table and bucket */
+  if (tprev)
+    tprev->tnext = entry->tnext;
+  else
+    fm->table[h] = entry->tnext;
+  if (freq)
+    *freq = entry->bucket->freq;
+  unlink(fm, entry, 0);
+
+  /* put back the entry on the free list */
+  entry->tnext = fm->free;
+  fm->free = entry;
+
+  fm->size--;
+  *val = entry->val;
+
+  return 0;
+}
+
+int freqmap_pop_min(freqmap_t *fm, uint64_t *key, void **val,
+                    uint64_t *freq) {
+  if (!fm->min)
+    return 1;
+  *key = fm->min->last->key;
+  return freqmap_pop(fm, *key, val, freq);
+}
+
+void freqmap_halve(freqmap_t *fm) {
+  freqmap_bucket_t *b, *next;
+
+  for (b = fm->min; b; b = next) {
+    next = b->next;
+    b->freq = MAX(1, b->freq >> 1);
+
+    /* halving keeps the buckets ordered, but neighbours may now have
+       the same frequency, in which case the lower one's entries go
+       behind the higher one's, i.e. on the LRU side */
+    if (b->prev && b->prev->freq == b->freq) {
+      b->last->lnext = b->prev->first;
+      b->prev->first->lprev = b->last;
+      b->prev->first = b->first;
+      for (; b->first != b->last->lnext; b->first = b->first->lnext)
+        b->first->bucket = b->prev;
+      bucket_free(fm, b);
+    }
+  }
+}
@@ -0,0 +1,100 @@
+#ifndef FREQMAP_H_2b7e94c1d05a4f6e8c3a1d9f7e2b5c40
+#define FREQMAP_H_2b7e94c1d05a4f6e8c3a1d9f7e2b5c40
+
+/* Frequency table.
+ *
+ * A freqmap_t is a hash table whose entries carry an access frequency,
+ * kept in a list of frequency buckets ordered by frequency, each
+ * bucket holding its entries in LRU order. Each entry consists of a
+ * uint64_t key and a void* value. Looking up an entry increments its
+ * frequency, and the least frequently (and among those, least
+ * recently) used entry can be found, in O(1).
+ */
+
+#include <stdint.h>
+
+typedef struct freqmap_s freqmap_t;
+
+/* Allocates a new frequency table of the given capacity.
+ *
+ * If capacity < 1, a capacity of 1 will be used.
+ *
+ * Returns NULL if out of memory.
+ */
+freqmap_t *freqmap_new(size_t capacity);
+
+/* Grows the table to hold capacity entries, if it holds fewer.
+ *
+ * Only the added entries are allocated, and no entry moves. The
+ * number of hash buckets stays as it was, so chains get longer as the
+ * table fills up beyond its original capacity.
+ *
+ * Returns 0 on success
+ *         -1 if out of memory
+ */
+int freqmap_grow(freqmap_t *fm, size_t capacity);
+
+/* Destroys a table and releases all associated resources
+ *
+ * The freqmap pointer at *fm will be set to NULL
+ */
+void freqmap_free(freqmap_t **fm);
+
+/* Returns the number of entries in fm
+ */
+size_t freqmap_size(freqmap_t *fm);
+
+/* Returns the lowest frequency in fm, or 0 if it is empty
+ */
+uint64_t freqmap_min(freqmap_t *fm);
+
+/* Sets value and frequency for key.
+ *
+ * This will overwrite any existing entry with this key. The entry
+ * becomes the MRU entry of its frequency. This is O(1) if freq is at
+ * most one above the lowest frequency in the table, and linear in the
+ * number of distinct frequencies otherwise.
+ *
+ * Returns 0 on sucess
+ *         1 if the table is full
+ */
+int freqmap_set(freqmap_t *fm, uint64_t key, void *val, uint64_t freq);
+
+/* Replaces the value of an existing entry, leaving its frequency and
+ * its position alone.
+ *
+ * Returns 0 on success
+ *         1 if key was not found
+ */
+int freqmap_replace(freqmap_t *fm, uint64_t key, void *val);
+
+/* Retrieves value by key, incrementing the frequency of the entry.
+ *
+ * Returns 0 on success
+ *         1 if key was not found
+ */
+int freqmap_get(freqmap_t *fm, uint64_t key, void **val);
+
+/* These retrieve and delete entries
+ *
+ * _pop() operates on entry identified by key,
+ * _pop_min() on the LRU entry of the lowest frequency
+ *
+ * The frequency of the entry is written to freq unless it is NULL.
+ *
+ * Returns 0 on success
+ *         1 if entry was not found or if freqmap is empty
+ */
+int freqmap_pop(freqmap_t *fm, uint64_t key, void **val, uint64_t *freq);
+int freqmap_pop_min(freqmap_t *fm, uint64_t *key, void **val,
+                    uint64_t *freq);
+
+/* Halves the frequency of every entry, down to a minimum of 1.
+ *
+ * Entries whose frequencies become equal are ordered by their old
+ * frequency, lower first. This is linear in the number of distinct
+ * frequencies.
+ */
+void freqmap_halve(freqmap_t *fm);
+
+#endif
@@ -1,98 +1,252 @@
 #include <stdlib.h>
+#include <string.h>
+#include "arena.h"
 #include "htable.h"
+#include "sweep.h"
+#include "twheel.h"
 #include "gclk.h"
 
 #include <stdio.h>
 
-struct gclk_page {
-  uint64_t key;
-  uint8_t references;
-  void *data;
-};
+#define DEFAULT_MAX 3
+#define DEFAULT_INCREMENT 1
 
+/* The table maps keys to page slots in the arena. The reference
+   counters live in ref[], one byte per slot, packed so that the hand
+   can sweep over many of them at a time. */
 struct gclk_s {
-  size_t size;
   size_t nmemb;
-  size_t active;
-  int hand;
+  size_t hand;
   htable_t *t;
-  struct gclk_page *page;
-  void *data;
+  arena_t *arena;
+  uint8_t *ref;
+  uint8_t max;
+  uint8_t increment;
+  enum gclk_sweep sweep;
+  twheel_t *tw;
+  uint64_t now;
 };
 
 gclk_t *gclk_new(size_t size, size_t nmemb) {
+  struct gclk_opts opts = {.max = DEFAULT_MAX,
+                           .increment = DEFAULT_INCREMENT,
+                           .sweep = GCLK_SWEEP_ONE,
+                           .index = HTABLE_CHAINED};
+
+  return gclk_new_ex(size, nmemb, &opts);
+}
+
+gclk_t *gclk_new_ex(size_t size, size_t nmemb, const struct gclk_opts *opts) {
+  struct htable_opts topts = {.grow = 0, .index = opts->index};
   gclk_t *r;
 
+  if (!opts->max || !opts->increment) goto fail;
+
   r = malloc(sizeof(gclk_t));
   if (!r) goto fail;
 
-  r->page = malloc(nmemb * sizeof(struct gclk_page));
-  if (!r->page) goto fail_page;
+  r->ref = calloc(nmemb, 1);
+  if (!r->ref) goto fail_ref;
 
-  r->data = malloc(nmemb * size);
-  if (!r->data) goto fail_data;
+  r->arena = arena_new(size, nmemb);
+  if (!r->arena) goto fail_arena;
 
-  r->t = htable_new(nmemb);
+  r->t = htable_new_ex(nmemb, &topts);
   if (!r->t) goto fail_htable;
 
-  r->size = size;
   r->nmemb = nmemb;
-  r->active = 0;
+  r->hand = 0;
+  r->max = opts->max;
+  r->increment = opts->increment;
+  r->sweep = opts->sweep;
+  r->tw = NULL;
+  r->now = 0;
 
   return r;
 
  fail_htable:
-  free(r->data);
- fail_data:
-  free(r->page);
- fail_page:
+  arena_free(&r->arena);
+ fail_arena:
+  free(r->ref);
+ fail_ref:
   free(r);
  fail:
   return NULL;
 }
 
-int gclk_fetch(gclk_t *gclk, uint64_t key, void **ptr) {
-  struct gclk_page *page;
+/* Sets when the page in slot expires, if pages expire at all
+ */
+static void gclk_expire(gclk_t *gclk, size_t slot, uint64_t ttl) {
+  if (!gclk->tw)
+    return;
+  if (ttl)
+    twheel_set(gclk->tw, slot, gclk->now + ttl);
+  else
+    twheel_del(gclk->tw, slot);
+}
 
-  if (!htable_get(gclk->t, key, (void **)&page)) {
-    if (page->references < 1)
-      page->references++;
-    *ptr = page->data;
-    return 0;
-  }
+/* Removes the page in slot from the cache
+ */
+static void gclk_drop(gclk_t *gclk, size_t slot) {
+  htable_del(gclk->t, arena_key(gclk->arena, slot));
+  gclk->ref[slot] = 0;
+  if (gclk->tw)
+    twheel_del(gclk->tw, slot);
+  arena_release(gclk->arena, slot);
+}
 
-  if (gclk->active < gclk->nmemb) {
-    page = gclk->page + gclk->active;
-    page->data = gclk->data + gclk->active * gclk->size;
-    page->key = key;
-    page->references = 0;
-    htable_set(gclk->t, key, (void *)page);
-    gclk->active++;
-    *ptr = page->data;
-    return 1;
+/* Frees a page, an expired one if any and otherwise the one the hand
+ * stops at. The hand passes over free pages, which can only be there
+ * while shrinking.
+ */
+static void gclk_evict(gclk_t *gclk) {
+  size_t slot;
+
+  if (gclk->tw && !twheel_pop(gclk->tw, gclk->now, &slot)) {
+    gclk_drop(gclk, slot);
+    return;
   }
 
-  while (gclk->page[gclk->hand].references) {
-    gclk->page[gclk->hand].references--;
+  do {
+    if (gclk->sweep == GCLK_SWEEP_MIN)
+      gclk->hand = sweep_min(gclk->ref, gclk->nmemb, gclk->hand);
+    else
+      gclk->hand = sweep(gclk->ref, gclk->nmemb, gclk->hand);
+
+    slot = gclk->hand;
     if (++gclk->hand >= gclk->nmemb)
       gclk->hand = 0;
+  } while (!arena_in_use(gclk->arena, slot));
+
+  gclk_drop(gclk, slot);
+}
+
+/* Fetches a page, raising its counter to at least least, which must
+ * be at most max
+ */
+static int gclk_fetch_at(gclk_t *gclk, uint64_t key, uint64_t now,
+                         uint64_t ttl, uint8_t least, void **ptr) {
+  uint8_t *ref;
+  void *val;
+  size_t slot;
+
+  if (ttl && !gclk->tw) {
+    gclk->tw = twheel_new(gclk->nmemb, gclk->now);
+    if (!gclk->tw)
+      return -1;
+  }
+  if (now > gclk->now)
+    gclk->now = now;
+
+  if (!htable_get(gclk->t, key, &val)) {
+    slot = (uintptr_t)val;
+    ref = gclk->ref + slot;
+    *ptr = arena_page(gclk->arena, slot);
+
+    /* expired pages are reloaded in place, as if new */
+    if (gclk->tw && twheel_expired(gclk->tw, slot, gclk->now)) {
+      *ref = least;
+      gclk_expire(gclk, slot, ttl);
+      return 1;
+    }
+
+    if (*ref < gclk->max - gclk->increment)
+      *ref += gclk->increment;
+    else
+      *ref = gclk->max;
+    if (*ref < least)
+      *ref = least;
+    return 0;
+  }
+
+  /* expired pages are reclaimed before the hand looks for a victim */
+  if (arena_alloc(gclk->arena, key, &slot)) {
+    gclk_evict(gclk);
+    arena_alloc(gclk->arena, key, &slot);
   }
 
-  page = gclk->page + gclk->hand;
-  if (++gclk->hand >= gclk->nmemb)
-    gclk->hand = 0;
-  htable_del(gclk->t, page->key);
-  htable_set(gclk->t, key, page);
-  page->key = key;
-  *ptr = page->data;
+  gclk->ref[slot] = least;
+  htable_set(gclk->t, key, (void *)(uintptr_t)slot);
+  gclk_expire(gclk, slot, ttl);
+  *ptr = arena_page(gclk->arena, slot);
 
   return 1;
 }
 
+int gclk_fetch(gclk_t *gclk, uint64_t key, void **ptr) {
+  return gclk_fetch_at(gclk, key, gclk->now, 0, 0, ptr);
+}
+
+int gclk_fetch_ttl(gclk_t *gclk, uint64_t key, uint64_t now, uint64_t ttl,
+                   void **ptr) {
+  return gclk_fetch_at(gclk, key, now, ttl, 0, ptr);
+}
+
+int gclk_fetch_cost(gclk_t *gclk, uint64_t key, uint32_t cost, void **ptr) {
+  uint8_t least = cost > gclk->max ? gclk->max : (cost ? cost - 1 : 0);
+
+  return gclk_fetch_at(gclk, key, gclk->now, 0, least, ptr);
+}
+
+int gclk_invalidate(gclk_t *gclk, uint64_t key) {
+  void *val;
+
+  if (htable_get(gclk->t, key, &val))
+    return 1;
+
+  gclk_drop(gclk, (uintptr_t)val);
+  return 0;
+}
+
+/* Follows a page the arena moved while shrinking
+ */
+static void gclk_move(void *ctx, size_t from, size_t to) {
+  gclk_t *gclk = ctx;
+  uint64_t key = arena_key(gclk->arena, to);
+
+  htable_del(gclk->t, key);
+  htable_set(gclk->t, key, (void *)(uintptr_t)to);
+  gclk->ref[to] = gclk->ref[from];
+  if (gclk->tw)
+    twheel_move(gclk->tw, from, to);
+}
+
+int gclk_resize(gclk_t *gclk, size_t nmemb) {
+  uint8_t *ref;
+
+  if (nmemb < 1)
+    return -1;
+
+  /* new slots are free, and so have no references */
+  if (nmemb > gclk->nmemb) {
+    ref = realloc(gclk->ref, nmemb);
+    if (!ref)
+      return -1;
+    gclk->ref = ref;
+    memset(ref + gclk->nmemb, 0, nmemb - gclk->nmemb);
+    if ((gclk->tw && twheel_resize(gclk->tw, nmemb)) ||
+        htable_grow(gclk->t, nmemb) ||
+        arena_resize(gclk->arena, nmemb, NULL, NULL))
+      return -1;
+  } else {
+    while (arena_used(gclk->arena) > nmemb)
+      gclk_evict(gclk);
+    arena_resize(gclk->arena, nmemb, gclk_move, gclk);
+    if (gclk->tw)
+      twheel_resize(gclk->tw, nmemb);
+    if (gclk->hand >= nmemb)
+      gclk->hand = 0;
+  }
+
+  gclk->nmemb = nmemb;
+  return 0;
+}
+
 void gclk_free(gclk_t **gclk) {
-  free((*gclk)->data);
-  free((*gclk)->page);
+  arena_free(&(*gclk)->arena);
+  free((*gclk)->ref);
   htable_free(&(*gclk)->t);
+  twheel_free(&(*gclk)->tw);
   free(*gclk);
   *gclk = NULL;
 }
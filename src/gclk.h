@@ -2,11 +2,55 @@
 #define GCLK_H_87d4dc3995db41633e314d8179ffe74b
 
 #include <stdint.h>
+#include "htable.h"
 
 typedef struct gclk_s gclk_t;
 
+/* How the hand looks for a victim. GCLK_SWEEP_ONE decrements counters
+ * one lap at a time, GCLK_SWEEP_MIN first skips the laps in which no
+ * counter would reach zero. Both evict the same pages, the latter is
+ * faster when counters are large.
+ */
+enum gclk_sweep { GCLK_SWEEP_ONE, GCLK_SWEEP_MIN };
+
+/* Options for gclk_new_ex().
+ *
+ * Each hit adds increment to the page's reference counter, which is
+ * capped at max (at most 255). max 1 and increment 1 is plain CLOCK.
+ * index is the kind of table pages are looked up in, see htable.h.
+ */
+struct gclk_opts {
+  uint8_t max;
+  uint8_t increment;
+  enum gclk_sweep sweep;
+  enum htable_index index;
+};
+
 gclk_t *gclk_new(size_t size, size_t nmemb);
+gclk_t *gclk_new_ex(size_t size, size_t nmemb, const struct gclk_opts *opts);
 int gclk_fetch(gclk_t *clock, uint64_t key, void **ptr);
+
+/* Same as lru_fetch_ttl(), see lru.h
+ */
+int gclk_fetch_ttl(gclk_t *clock, uint64_t key, uint64_t now, uint64_t ttl,
+                   void **ptr);
+
+/* Fetches a page that costs cost to refill, in laps of the hand: the
+ * page's counter is raised to at least cost - 1, capped at max, on a
+ * miss as well as on a hit, so that the hand passes over it that many
+ * times more before evicting it. Costs of 0 and 1 are the same as
+ * gclk_fetch(). max should be set with the highest cost in mind, and
+ * GCLK_SWEEP_MIN makes large counters cheap.
+ *
+ * Returns 0 on hit
+ *         1 on miss
+ */
+int gclk_fetch_cost(gclk_t *clock, uint64_t key, uint32_t cost, void **ptr);
+
+/* Same as lru_invalidate() and lru_resize(), see lru.h
+ */
+int gclk_invalidate(gclk_t *clock, uint64_t key);
+int gclk_resize(gclk_t *clock, size_t nmemb);
 void gclk_free(gclk_t **clock);
 
 #endif
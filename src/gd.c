@@ -0,0 +1,213 @@
+#include <stdlib.h>
+#include <assert.h>
+#include "arena.h"
+#include "htable.h"
+#include "gd.h"
+
+/* The table maps keys to page slots in the arena. Pages are kept in a
+ * min heap of slots ordered by priority, and among equals by when
+ * they were last fetched, each page knowing its position in it, so
+ * that a fetch moves its page in O(log nmemb) whatever the priorities.
+ */
+struct gd_page {
+  uint64_t h;
+  uint64_t stamp;
+  size_t pos;
+};
+
+struct gd_s {
+  htable_t *t;
+  arena_t *arena;
+  struct gd_page *page;
+  size_t *heap;
+  size_t active;
+  /* the priority of the last victim */
+  uint64_t l;
+  uint64_t now;
+  size_t nmemb;
+};
+
+gd_t *gd_new(size_t size, size_t nmemb) {
+  gd_t *gd;
+
+  assert(nmemb >= 2);
+
+  gd = calloc(1, sizeof(gd_t));
+  if (!gd)
+    return NULL;
+
+  gd->t = htable_new(nmemb);
+  gd->arena = arena_new(size, nmemb);
+  gd->page = malloc(nmemb * sizeof(struct gd_page));
+  gd->heap = malloc(nmemb * sizeof(size_t));
+  if (!gd->t || !gd->arena || !gd->page || !gd->heap)
+    goto fail;
+
+  gd->nmemb = nmemb;
+
+  return gd;
+
+ fail:
+  if (gd->t)
+    htable_free(&gd->t);
+  arena_free(&gd->arena);
+  free(gd->page);
+  free(gd->heap);
+  free(gd);
+  return NULL;
+}
+
+/* Returns non-zero if the page in slot a goes before that in slot b
+ */
+static int gd_less(gd_t *gd, size_t a, size_t b) {
+  struct gd_page *pa = gd->page + a, *pb = gd->page + b;
+
+  return pa->h < pb->h || (pa->h == pb->h && pa->stamp < pb->stamp);
+}
+
+static void heap_place(gd_t *gd, size_t slot, size_t pos) {
+  gd->heap[pos] = slot;
+  gd->page[slot].pos = pos;
+}
+
+/* Moves the page in slot to where it belongs in the heap
+ */
+static void heap_fix(gd_t *gd, size_t slot) {
+  size_t pos = gd->page[slot].pos, parent, child;
+
+  while (pos > 0) {
+    parent = (pos - 1) / 2;
+    if (!gd_less(gd, slot, gd->heap[parent]))
+      break;
+    heap_place(gd, gd->heap[parent], pos);
+    pos = parent;
+  }
+
+  while ((child = 2 * pos + 1) < gd->active) {
+    if (child + 1 < gd->active &&
+        gd_less(gd, gd->heap[child + 1], gd->heap[child]))
+      child++;
+    if (!gd_less(gd, gd->heap[child], slot))
+      break;
+    heap_place(gd, gd->heap[child], pos);
+    pos = child;
+  }
+
+  heap_place(gd, slot, pos);
+}
+
+/* Removes the page in slot from the cache
+ */
+static void gd_drop(gd_t *gd, size_t slot) {
+  size_t last = gd->heap[--gd->active];
+
+  if (last != slot) {
+    heap_place(gd, last, gd->page[slot].pos);
+    heap_fix(gd, last);
+  }
+  htable_del(gd->t, arena_key(gd->arena, slot));
+  arena_release(gd->arena, slot);
+}
+
+/* Evicts the page of lowest priority, which raises L to it
+ */
+static void gd_evict(gd_t *gd) {
+  size_t slot = gd->heap[0];
+
+  gd->l = gd->page[slot].h;
+  gd_drop(gd, slot);
+}
+
+int gd_fetch(gd_t *gd, uint64_t key, void **ptr) {
+  return gd_fetch_cost(gd, key, 1, ptr);
+}
+
+int gd_fetch_cost(gd_t *gd, uint64_t key, uint32_t cost, void **ptr) {
+  void *val;
+  size_t slot;
+  int r = 0;
+
+  if (!cost)
+    cost = 1;
+
+  /* a hit renews the page's priority, a miss takes a free page if
+     possible and evicts the lowest priority page otherwise */
+  if (!htable_get(gd->t, key, &val)) {
+    slot = (uintptr_t)val;
+  } else {
+    if (arena_alloc(gd->arena, key, &slot)) {
+      gd_evict(gd);
+      arena_alloc(gd->arena, key, &slot);
+    }
+    htable_set(gd->t, key, (void *)(uintptr_t)slot);
+    heap_place(gd, slot, gd->active++);
+    r = 1;
+  }
+
+  gd->page[slot].h = gd->l + cost;
+  gd->page[slot].stamp = ++gd->now;
+  heap_fix(gd, slot);
+  *ptr = arena_page(gd->arena, slot);
+
+  return r;
+}
+
+int gd_invalidate(gd_t *gd, uint64_t key) {
+  void *val;
+
+  if (htable_get(gd->t, key, &val))
+    return 1;
+
+  gd_drop(gd, (uintptr_t)val);
+  return 0;
+}
+
+/* Follows a page the arena moved while shrinking
+ */
+static void gd_move(void *ctx, size_t from, size_t to) {
+  gd_t *gd = ctx;
+  uint64_t key = arena_key(gd->arena, to);
+
+  htable_del(gd->t, key);
+  htable_set(gd->t, key, (void *)(uintptr_t)to);
+  gd->page[to] = gd->page[from];
+  gd->heap[gd->page[to].pos] = to;
+}
+
+int gd_resize(gd_t *gd, size_t nmemb) {
+  struct gd_page *page;
+  size_t *heap;
+
+  if (nmemb < 2)
+    return -1;
+
+  if (nmemb > gd->nmemb) {
+    page = realloc(gd->page, nmemb * sizeof(struct gd_page));
+    if (!page)
+      return -1;
+    gd->page = page;
+    heap = realloc(gd->heap, nmemb * sizeof(size_t));
+    if (!heap)
+      return -1;
+    gd->heap = heap;
+    if (htable_grow(gd->t, nmemb) ||
+        arena_resize(gd->arena, nmemb, NULL, NULL))
+      return -1;
+  } else {
+    while (arena_used(gd->arena) > nmemb)
+      gd_evict(gd);
+    arena_resize(gd->arena, nmemb, gd_move, gd);
+  }
+
+  gd->nmemb = nmemb;
+  return 0;
+}
+
+void gd_free(gd_t **gd) {
+  arena_free(&(*gd)->arena);
+  htable_free(&(*gd)->t);
+  free((*gd)->page);
+  free((*gd)->heap);
+  free(*gd);
+  *gd = NULL;
+}
@@ -0,0 +1,43 @@
+#ifndef GD_H_e3c96a0b7f1d4b25a8e0d4c6b9f2a731
+#define GD_H_e3c96a0b7f1d4b25a8e0d4c6b9f2a731
+
+/* GreedyDual (Young, Algorithmica '94), for pages that cost
+ * different amounts to refill.
+ *
+ * Each page has a priority H, set to L plus the cost of refilling it
+ * whenever it is fetched, and the page with the lowest H is evicted,
+ * the least recently used among equals. L is the H of the last
+ * victim, so that pages that go unreferenced age relative to those
+ * fetched since, and a page that is expensive to refill survives
+ * longer than a cheap one fetched at the same time. With equal costs,
+ * this is LRU.
+ *
+ * Pages are kept in a binary heap ordered by priority, so fetches
+ * take O(log nmemb) time however spread out the costs are.
+ */
+
+#include <stdint.h>
+
+typedef struct gd_s gd_t;
+
+gd_t *gd_new(size_t size, size_t nmemb);
+
+/* Fetches a page with a cost of 1
+ */
+int gd_fetch(gd_t *gd, uint64_t key, void **ptr);
+
+/* Fetches a page that costs cost to refill, in any unit as long as
+ * it is the same for all pages. A cost of 0 is taken as 1.
+ *
+ * Returns 0 on hit
+ *         1 on miss
+ */
+int gd_fetch_cost(gd_t *gd, uint64_t key, uint32_t cost, void **ptr);
+
+/* Same as lru_invalidate() and lru_resize(), see lru.h
+ */
+int gd_invalidate(gd_t *gd, uint64_t key);
+int gd_resize(gd_t *gd, size_t nmemb);
+void gd_free(gd_t **gd);
+
+#endif
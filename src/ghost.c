@@ -0,0 +1,127 @@
+#include <stdlib.h>
+#include <string.h>
+#include "ghost.h"
+
+#define MAX(a,b) ((a) > (b) ? (a) : (b))
+
+/* filter bits per key and generation, and bits set per key, all in
+   the same word */
+#define BITS_PER_KEY 12
+#define K 4
+
+struct ghost_s {
+  /* nwords words for each generation, cur being the one added to */
+  uint64_t *bits;
+  size_t nwords;
+  int cur;
+  size_t n[2];
+  size_t nmemb;
+};
+
+/* splitmix64's finalizer. The word comes from the high bits, the bits
+ * within it from the low ones.
+ */
+static uint64_t hash(uint64_t k) {
+  k ^= k >> 30;
+  k *= 0xbf58476d1ce4e5b9ULL;
+  k ^= k >> 27;
+  k *= 0x94d049bb133111ebULL;
+  k ^= k >> 31;
+
+  return k;
+}
+
+static size_t word_of(ghost_t *g, uint64_t h) {
+  return ((h >> 32) * g->nwords) >> 32;
+}
+
+static uint64_t mask_of(uint64_t h) {
+  uint64_t m = 0;
+  int i;
+
+  for (i=0; i<K; i++, h >>= 6)
+    m |= 1ULL << (h & 63);
+
+  return m;
+}
+
+static size_t words_for(size_t nmemb) {
+  return MAX(1, (nmemb * BITS_PER_KEY + 63) / 64);
+}
+
+ghost_t *ghost_new(size_t nmemb) {
+  ghost_t *g;
+
+  nmemb = MAX(nmemb, 1);
+
+  g = malloc(sizeof(ghost_t));
+  if (!g)
+    return NULL;
+
+  g->nwords = words_for(nmemb);
+  g->bits = calloc(2 * g->nwords, sizeof(uint64_t));
+  if (!g->bits) {
+    free(g);
+    return NULL;
+  }
+
+  g->cur = 0;
+  g->n[0] = g->n[1] = 0;
+  g->nmemb = nmemb;
+
+  return g;
+}
+
+void ghost_add(ghost_t *g, uint64_t key) {
+  uint64_t h = hash(key);
+
+  /* the newer generation is full, so it becomes the older one and the
+     older one is forgotten */
+  if (g->n[g->cur] >= g->nmemb) {
+    g->cur ^= 1;
+    memset(g->bits + g->cur * g->nwords, 0, g->nwords * sizeof(uint64_t));
+    g->n[g->cur] = 0;
+  }
+
+  g->bits[g->cur * g->nwords + word_of(g, h)] |= mask_of(h);
+  g->n[g->cur]++;
+}
+
+int ghost_has(ghost_t *g, uint64_t key) {
+  uint64_t h = hash(key), m = mask_of(h);
+  size_t w = word_of(g, h);
+
+  return (g->bits[w] & m) == m || (g->bits[g->nwords + w] & m) == m;
+}
+
+size_t ghost_size(ghost_t *g) {
+  return g->n[0] + g->n[1];
+}
+
+int ghost_resize(ghost_t *g, size_t nmemb) {
+  uint64_t *bits;
+  size_t nwords;
+
+  nmemb = MAX(nmemb, 1);
+  nwords = words_for(nmemb);
+
+  bits = calloc(2 * nwords, sizeof(uint64_t));
+  if (!bits)
+    return -1;
+
+  free(g->bits);
+  g->bits = bits;
+  g->nwords = nwords;
+  g->n[0] = g->n[1] = 0;
+  g->nmemb = nmemb;
+
+  return 0;
+}
+
+void ghost_free(ghost_t **g) {
+  if (!g || !*g)
+    return;
+  free((*g)->bits);
+  free(*g);
+  *g = NULL;
+}
@@ -0,0 +1,60 @@
+#ifndef GHOST_H_a4f81c0e6b2d47939e5c1d7b08f3a265
+#define GHOST_H_a4f81c0e6b2d47939e5c1d7b08f3a265
+
+/* Compact memory of recently evicted keys.
+ *
+ * Adaptive policies only need to know whether a key was evicted
+ * recently, not anything about it, which a linkmap_t of keys answers
+ * at the cost of a record, a bucket pointer and list links per key.
+ * A ghost_t is instead a rolling Bloom filter: two generations of a
+ * blocked Bloom filter, the older of which is forgotten whenever the
+ * newer has had nmemb keys added. This takes 3 bytes per ghost and
+ * answers whether a key is a ghost in a single read of a word per
+ * generation. The answer is wrong, in that a key that was never added
+ * is taken for a ghost, about 1-2% of the time. Keys can't be
+ * removed, they age out.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef struct ghost_s ghost_t;
+
+/* Allocates a ghost store remembering at least the last nmemb keys
+ * added, and at most the last 2 * nmemb.
+ *
+ * If nmemb < 1, 1 will be used.
+ *
+ * Returns NULL if out of memory.
+ */
+ghost_t *ghost_new(size_t nmemb);
+
+/* Remembers key
+ */
+void ghost_add(ghost_t *g, uint64_t key);
+
+/* Returns non-zero if key is probably among the keys remembered,
+ * zero if it definitely isn't.
+ */
+int ghost_has(ghost_t *g, uint64_t key);
+
+/* Returns the number of keys remembered, counting keys added more
+ * than once each time
+ */
+size_t ghost_size(ghost_t *g);
+
+/* Changes the number of keys remembered to nmemb, forgetting all of
+ * them.
+ *
+ * Returns 0 on success
+ *         -1 if out of memory, leaving g as it was
+ */
+int ghost_resize(ghost_t *g, size_t nmemb);
+
+/* Destroys a ghost store and releases all associated resources
+ *
+ * The ghost pointer at *g will be set to NULL
+ */
+void ghost_free(ghost_t **g);
+
+#endif
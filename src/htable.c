@@ -1,5 +1,7 @@
 #include <stdlib.h>
 #include <assert.h>
+#include "cuckoo.h"
+#include "swiss.h"
 #include "htable.h"
 
 #include <stdio.h>
@@ -15,9 +17,26 @@ struct htable_record {
 
 struct htable_s {
   struct htable_record **table;
+  /* while growing, the buckets of the previous table that are yet to
+     be rehashed into table, those below rehash having been already */
+  struct htable_record **old;
+  size_t osize;
+  size_t rehash;
   struct htable_record *record;
   struct htable_record *free;
+  /* records added by htable_grow(), the last nfresh of which have not
+     been handed out yet */
+  struct htable_record **more;
+  size_t nmore;
+  struct htable_record *fresh;
+  size_t nfresh;
   size_t capacity;
+  size_t tsize;
+  int grow;
+  /* set for HTABLE_CUCKOO or HTABLE_SWISS, which leave the rest
+     alone */
+  cuckoo_t *cuckoo;
+  swiss_t *swiss;
 };
 
 /* Thomas Wang's hash64shift()
@@ -38,7 +57,7 @@ void pt(htable_t *t) {
   struct htable_record *rec;
   int i;
 
-  for (i=0; i<t->capacity; i++) {
+  for (i=0; i<t->tsize; i++) {
     fprintf(stderr, "table[%d]: ", i);
     rec = t->table[i];
     while(rec) {
@@ -50,13 +69,40 @@ void pt(htable_t *t) {
 }
 
 htable_t *htable_new(size_t capacity) {
+  struct htable_opts opts = {.grow = 0, .index = HTABLE_CHAINED};
+
+  return htable_new_ex(capacity, &opts);
+}
+
+htable_t *htable_new_ex(size_t capacity, const struct htable_opts *opts) {
   int i;
   htable_t *htable;
 
+  if (capacity < 1)
+    capacity = 1;
+
   htable = calloc(1, sizeof(htable_t));
   if (!htable)
     return NULL;
 
+  if (opts->index == HTABLE_CUCKOO) {
+    htable->cuckoo = cuckoo_new(capacity, opts->grow);
+    if (!htable->cuckoo) {
+      free(htable);
+      return NULL;
+    }
+    return htable;
+  }
+
+  if (opts->index == HTABLE_SWISS) {
+    htable->swiss = swiss_new(capacity, opts->grow);
+    if (!htable->swiss) {
+      free(htable);
+      return NULL;
+    }
+    return htable;
+  }
+
   htable->record = malloc(capacity * sizeof(struct htable_record));
   if (!htable->record) {
     free(htable);
@@ -76,21 +122,116 @@ htable_t *htable_new(size_t capacity) {
 
   htable->free = &htable->record[0];
   htable->capacity = capacity;
+  htable->tsize = capacity;
+  htable->grow = opts->grow;
 
   return htable;
 }
 
+/* Rehashes up to n buckets of the previous table, or passes over up
+ * to 10*n empty ones, so that growing is spread over the operations
+ * that follow it. Records are appended to their new chains, which
+ * keeps stacked entries in order.
+ */
+static void htable_rehash(htable_t *htable, size_t n) {
+  struct htable_record *rec, *next, **tail;
+  size_t empty = 10 * n;
+
+  while (n && htable->old) {
+    rec = htable->old[htable->rehash];
+    if (rec) {
+      htable->old[htable->rehash] = NULL;
+      for (; rec; rec = next) {
+        next = rec->next;
+        tail = &htable->table[hash64shift(rec->key, htable->tsize)];
+        while (*tail)
+          tail = &(*tail)->next;
+        rec->next = NULL;
+        *tail = rec;
+      }
+      n--;
+    } else if (!empty--) {
+      break;
+    }
+
+    if (++htable->rehash >= htable->osize) {
+      free(htable->old);
+      htable->old = NULL;
+    }
+  }
+}
+
+/* Scans a chain for key. Returns the record, NULL if not found, and
+ * writes back the record before it to prev.
+ */
+static struct htable_record *htable_scan(struct htable_record *rec,
+                                         uint64_t key,
+                                         struct htable_record **prev) {
+  *prev = NULL;
+  for (; rec; rec = rec->next) {
+    if (rec->key == key)
+      return rec;
+    *prev = rec;
+  }
+
+  return NULL;
+}
+
+/* Finds the latest entry for key, in the table or, while growing, in
+ * the previous one, whose entries are all older. The chain it is in
+ * and the record before it are written back to head and prev.
+ */
+static struct htable_record *htable_find(htable_t *htable, uint64_t key,
+                                         struct htable_record ***head,
+                                         struct htable_record **prev) {
+  struct htable_record *rec;
+
+  *head = &htable->table[hash64shift(key, htable->tsize)];
+  rec = htable_scan(**head, key, prev);
+  if (rec || !htable->old)
+    return rec;
+
+  *head = &htable->old[hash64shift(key, htable->osize)];
+  return htable_scan(**head, key, prev);
+}
+
+/* Takes a record off the free list or from those added last, growing
+ * the table first if it is full and allowed to grow
+ */
+static struct htable_record *htable_alloc(htable_t *htable) {
+  struct htable_record *rec;
+
+  if (!htable->free && !htable->nfresh &&
+      (!htable->grow || htable_grow(htable, 2 * htable->capacity)))
+    return NULL;
+
+  if (htable->free) {
+    rec = htable->free;
+    htable->free = rec->next;
+  } else {
+    rec = htable->fresh++;
+    htable->nfresh--;
+  }
+
+  return rec;
+}
+
 int htable_set(htable_t *htable, uint64_t key, void *val) {
   int h;
   struct htable_record *rec;
 
-  rec = htable->free;
+  if (htable->cuckoo)
+    return cuckoo_set(htable->cuckoo, key, val);
+  if (htable->swiss)
+    return swiss_set(htable->swiss, key, val);
+
+  htable_rehash(htable, 1);
+
+  rec = htable_alloc(htable);
   if (!rec)
     return -1;
 
-  htable->free = rec->next;
-
-  h = hash64shift(key, htable->capacity);
+  h = hash64shift(key, htable->tsize);
 
   rec->next = htable->table[h];
   htable->table[h] = rec;
@@ -101,51 +242,46 @@ int htable_set(htable_t *htable, uint64_t key, void *val) {
 }
 
 int htable_get(htable_t *htable, uint64_t key, void **val) {
-  int h;
-  struct htable_record *rec;
+  struct htable_record *rec, **head, *prev;
 
-  h = hash64shift(key, htable->capacity);
+  if (htable->cuckoo)
+    return cuckoo_get(htable->cuckoo, key, val);
+  if (htable->swiss)
+    return swiss_get(htable->swiss, key, val);
 
-  rec = htable->table[h];
+  htable_rehash(htable, 1);
 
-  while (rec) {
-    if (rec->key == key) {
-      *val = rec->val;
-      return 0;
-    }
-    rec = rec->next;
-  }
+  rec = htable_find(htable, key, &head, &prev);
+  if (!rec)
+    return 1;
 
-  return 1;
+  *val = rec->val;
+  return 0;
 }
 
 int htable_pop(htable_t *htable, uint64_t key, void **val) {
-  int h;
-  struct htable_record *rec, *prev;
+  struct htable_record *rec, **head, *prev;
 
-  h = hash64shift(key, htable->capacity);
+  if (htable->cuckoo)
+    return cuckoo_pop(htable->cuckoo, key, val);
+  if (htable->swiss)
+    return swiss_pop(htable->swiss, key, val);
 
-  prev = NULL;
-  rec = htable->table[h];
+  htable_rehash(htable, 1);
 
-  while (rec) {
-    if (rec->key == key) {
-      if (prev)
-        prev->next = rec->next;
-      else
-        htable->table[h] = rec->next;
-      rec->next = htable->free;
-      htable->free = rec;
-
-      *val = rec->val;
-      return 0;
-    }
+  rec = htable_find(htable, key, &head, &prev);
+  if (!rec)
+    return 1;
 
-    prev = rec;
-    rec = rec->next;
-  }
+  if (prev)
+    prev->next = rec->next;
+  else
+    *head = rec->next;
+  rec->next = htable->free;
+  htable->free = rec;
 
-  return 1;
+  *val = rec->val;
+  return 0;
 }
 
 int htable_del(htable_t *htable, uint64_t key) {
@@ -154,7 +290,63 @@ int htable_del(htable_t *htable, uint64_t key) {
   return htable_pop(htable, key, &val);
 }
 
+int htable_grow(htable_t *htable, size_t capacity) {
+  struct htable_record *rec, **more, **table;
+  size_t n;
+
+  if (htable->cuckoo)
+    return cuckoo_grow(htable->cuckoo, capacity);
+  if (htable->swiss)
+    return swiss_grow(htable->swiss, capacity);
+
+  if (capacity <= htable->capacity)
+    return 0;
+  n = capacity - htable->capacity;
+
+  /* one growth at a time */
+  while (htable->old)
+    htable_rehash(htable, 1);
+
+  more = realloc(htable->more, (htable->nmore + 1) * sizeof(*more));
+  if (!more)
+    return -1;
+  htable->more = more;
+
+  rec = malloc(n * sizeof(struct htable_record));
+  table = calloc(capacity, sizeof(struct htable_record *));
+  if (!rec || !table) {
+    free(rec);
+    free(table);
+    return -1;
+  }
+  htable->more[htable->nmore++] = rec;
+
+  /* records left over from the last growth go on the free list */
+  while (htable->nfresh) {
+    htable->fresh->next = htable->free;
+    htable->free = htable->fresh++;
+    htable->nfresh--;
+  }
+  htable->fresh = rec;
+  htable->nfresh = n;
+  htable->capacity = capacity;
+
+  htable->old = htable->table;
+  htable->osize = htable->tsize;
+  htable->rehash = 0;
+  htable->table = table;
+  htable->tsize = capacity;
+
+  return 0;
+}
+
  void htable_free(htable_t **htable) {
+   cuckoo_free(&(*htable)->cuckoo);
+   swiss_free(&(*htable)->swiss);
+   while ((*htable)->nmore)
+     free((*htable)->more[--(*htable)->nmore]);
+   free((*htable)->more);
+   free((*htable)->old);
    free((*htable)->record);
    free((*htable)->table);
    free(*htable);
@@ -4,23 +4,46 @@
 /* Hash table mapping unsigned 64 bit integer to void pointer.
  *
  * Entries with identical keys are stacked, i.e. get() and del() will
- * operate on the latest set() entry.
+ * operate on the latest set() entry, except with the cuckoo and swiss
+ * indexes.
  */
 
 #include <stdint.h>
 
 typedef struct htable_s htable_t;
 
+/* How the table is laid out. HTABLE_CHAINED chains entries off an
+ * array of buckets, HTABLE_CUCKOO is a cuckoo_t (see cuckoo.h), which
+ * bounds the cost of get() and lets it run concurrently with a writer,
+ * HTABLE_SWISS is a swiss_t (see swiss.h), which keeps misses cheap at
+ * high load. Both replace rather than stack entries with identical
+ * keys.
+ */
+enum htable_index { HTABLE_CHAINED, HTABLE_CUCKOO, HTABLE_SWISS };
+
+/* Options for htable_new_ex().
+ *
+ * If grow is set, a full table doubles its capacity rather than fail
+ * a set().
+ */
+struct htable_opts {
+  int grow;
+  enum htable_index index;
+};
+
 /* Allocates a new table of the given capacity.
+ *
+ * If capacity < 1, a capacity of 1 will be used.
  *
  * Returns NULL if out of memory.
  */
 htable_t *htable_new(size_t entries);
+htable_t *htable_new_ex(size_t entries, const struct htable_opts *opts);
 
 /* Sets value for key
  *
  * Returns 0 on sucess
- *        -1 if the table is full
+ *        -1 if the table is full and can't grow, or out of memory
  */
 int htable_set(htable_t *h, uint64_t key, void *val);
 
@@ -45,6 +68,20 @@ int htable_pop(htable_t *h, uint64_t key, void **val);
  */
 int htable_del(htable_t *h, uint64_t key);
 
+/* Grows the table to hold capacity entries, if it holds fewer.
+ *
+ * Only the added entries are allocated, and no entry moves. The hash
+ * buckets grow along, but entries are rehashed into the new buckets
+ * incrementally, a bucket or so per set(), get() or pop(), so that no
+ * single operation pays for the whole table. Growing again before
+ * that is done finishes the rehash first. The cuckoo and swiss
+ * indexes rehash all at once.
+ *
+ * Returns 0 on success
+ *         -1 if out of memory
+ */
+int htable_grow(htable_t *h, size_t capacity);
+
 /* Destroys a table and releases all associated resources
  *
  * The htable pointer at *h will be set to NULL
@@ -0,0 +1,295 @@
+#include <stdlib.h>
+#include <assert.h>
+#include <math.h>
+#include "arena.h"
+#include "htable.h"
+#include "linkmap.h"
+#include "freqmap.h"
+#include "rng.h"
+#include "twheel.h"
+#include "lecar.h"
+
+#include <stdio.h>
+
+#define DEFAULT_RATE 0.45
+#define DEFAULT_SEED 1
+#define FINAL_REGRET 0.005
+
+#define LRU 0
+#define LFU 1
+
+/* A key in one of the histories, with the fetch it was evicted at and
+ * the frequency it had
+ */
+struct lecar_ghost {
+  uint64_t key;
+  uint64_t evicted;
+  uint64_t freq;
+  int policy;
+  int live;
+};
+
+/* both orderings map keys to page slots in the arena */
+struct lecar_s {
+  linkmap_t *lru;
+  freqmap_t *lfu;
+  /* the histories are rings, sharing a table of live ghosts */
+  struct lecar_ghost *history[2];
+  size_t head[2];
+  size_t hsize;
+  htable_t *ghosts;
+  double weight[2];
+  double rate;
+  double log_discount;
+  /* counts fetches, while time is what pages expire by, and the wheel
+     is only set up once pages start expiring */
+  uint64_t now;
+  uint64_t time;
+  twheel_t *tw;
+  rng_t rng;
+  size_t nmemb;
+  arena_t *arena;
+};
+
+lecar_t *lecar_new(size_t size, size_t nmemb) {
+  struct lecar_opts opts = {.rate = 0, .history = 0, .seed = DEFAULT_SEED};
+
+  return lecar_new_ex(size, nmemb, &opts);
+}
+
+lecar_t *lecar_new_ex(size_t size, size_t nmemb,
+                      const struct lecar_opts *opts) {
+  lecar_t *lecar;
+
+  assert(nmemb >= 2);
+
+  lecar = calloc(1, sizeof(lecar_t));
+  if (!lecar)
+    return NULL;
+
+  lecar->hsize = opts->history ? opts->history : nmemb;
+  lecar->rate = opts->rate > 0 ? opts->rate : DEFAULT_RATE;
+  lecar->log_discount = log(FINAL_REGRET) / lecar->hsize;
+  lecar->weight[LRU] = lecar->weight[LFU] = 0.5;
+  lecar->now = 0;
+  rng_seed(&lecar->rng, opts->seed);
+  lecar->nmemb = nmemb;
+
+  lecar->lru = linkmap_new(nmemb);
+  lecar->lfu = freqmap_new(nmemb);
+  lecar->history[LRU] = calloc(lecar->hsize, sizeof(struct lecar_ghost));
+  lecar->history[LFU] = calloc(lecar->hsize, sizeof(struct lecar_ghost));
+  lecar->ghosts = htable_new(2 * lecar->hsize);
+  lecar->arena = arena_new(size, nmemb);
+  if (!lecar->lru || !lecar->lfu || !lecar->history[LRU] ||
+      !lecar->history[LFU] || !lecar->ghosts || !lecar->arena) {
+    lecar_free(&lecar);
+    return NULL;
+  }
+
+  return lecar;
+}
+
+/* Shifts weight away from the policy whose history holds key, if any.
+ *
+ * Returns the frequency the key had when evicted, 0 if not found.
+ */
+static uint64_t lecar_regret(lecar_t *lecar, uint64_t key) {
+  struct lecar_ghost *ghost;
+  double regret;
+  int p;
+
+  if (htable_pop(lecar->ghosts, key, (void **)&ghost))
+    return 0;
+  ghost->live = 0;
+  p = ghost->policy;
+
+  regret = exp(lecar->log_discount * (lecar->now - ghost->evicted));
+  lecar->weight[!p] *= exp(lecar->rate * regret);
+  lecar->weight[!p] /= lecar->weight[LRU] + lecar->weight[LFU];
+  lecar->weight[p] = 1.0 - lecar->weight[!p];
+
+  return ghost->freq;
+}
+
+/* Sets when the page in slot expires, if pages expire at all
+ */
+static void lecar_expire(lecar_t *lecar, size_t slot, uint64_t ttl) {
+  if (!lecar->tw)
+    return;
+  if (ttl)
+    twheel_set(lecar->tw, slot, lecar->time + ttl);
+  else
+    twheel_del(lecar->tw, slot);
+}
+
+/* Removes the page in slot from the cache
+ */
+static void lecar_drop(lecar_t *lecar, size_t slot) {
+  uint64_t key = arena_key(lecar->arena, slot);
+  void *val;
+
+  linkmap_pop(lecar->lru, key, &val);
+  freqmap_pop(lecar->lfu, key, &val, NULL);
+  if (lecar->tw)
+    twheel_del(lecar->tw, slot);
+  arena_release(lecar->arena, slot);
+}
+
+/* Frees a page, an expired one if any. Otherwise evicts a page chosen
+ * by LRU or LFU, at random according to their weights, and remembers
+ * its key in that policy's history.
+ */
+static void lecar_evict(lecar_t *lecar) {
+  struct lecar_ghost *ghost;
+  uint64_t k, freq;
+  void *data;
+  size_t slot;
+  int p;
+
+  /* no policy chose it, so neither has anything to regret */
+  if (lecar->tw && !twheel_pop(lecar->tw, lecar->time, &slot)) {
+    lecar_drop(lecar, slot);
+    return;
+  }
+
+  if (rng_double(&lecar->rng) < lecar->weight[LRU]) {
+    p = LRU;
+    linkmap_pop_tail(lecar->lru, &k, &data);
+    freqmap_pop(lecar->lfu, k, &data, &freq);
+  } else {
+    p = LFU;
+    freqmap_pop_min(lecar->lfu, &k, &data, &freq);
+    linkmap_pop(lecar->lru, k, &data);
+  }
+
+  /* the oldest ghost gives way, unless it was hit already */
+  ghost = lecar->history[p] + lecar->head[p];
+  if (++lecar->head[p] >= lecar->hsize)
+    lecar->head[p] = 0;
+  if (ghost->live)
+    htable_del(lecar->ghosts, ghost->key);
+
+  ghost->key = k;
+  ghost->evicted = lecar->now;
+  ghost->freq = freq;
+  ghost->policy = p;
+  ghost->live = 1;
+  htable_set(lecar->ghosts, k, ghost);
+
+  if (lecar->tw)
+    twheel_del(lecar->tw, (uintptr_t)data);
+  arena_release(lecar->arena, (uintptr_t)data);
+}
+
+int lecar_fetch(lecar_t *lecar, uint64_t key, void **ptr) {
+  return lecar_fetch_ttl(lecar, key, lecar->time, 0, ptr);
+}
+
+int lecar_fetch_ttl(lecar_t *lecar, uint64_t key, uint64_t now,
+                    uint64_t ttl, void **ptr) {
+  uint64_t freq;
+  void *val;
+  size_t slot;
+
+  if (ttl && !lecar->tw) {
+    lecar->tw = twheel_new(lecar->nmemb, lecar->time);
+    if (!lecar->tw)
+      return -1;
+  }
+  if (now > lecar->time)
+    lecar->time = now;
+
+  lecar->now++;
+
+  /* hit cache, which updates both orderings */
+  if (!freqmap_get(lecar->lfu, key, &val)) {
+    linkmap_move(lecar->lru, key, 0, NULL, NULL);
+    slot = (uintptr_t)val;
+    *ptr = arena_page(lecar->arena, slot);
+
+    /* unless it has expired, in which case it is reloaded in place,
+       counting as a new page */
+    if (lecar->tw && twheel_expired(lecar->tw, slot, lecar->time)) {
+      freqmap_pop(lecar->lfu, key, &val, NULL);
+      freqmap_set(lecar->lfu, key, val, 1);
+      lecar_expire(lecar, slot, ttl);
+      return 1;
+    }
+    return 0;
+  }
+
+  freq = lecar_regret(lecar, key);
+
+  /* take a free page if possible, evict otherwise */
+  if (arena_alloc(lecar->arena, key, &slot)) {
+    lecar_evict(lecar);
+    arena_alloc(lecar->arena, key, &slot);
+  }
+
+  linkmap_set(lecar->lru, key, (void *)(uintptr_t)slot);
+  freqmap_set(lecar->lfu, key, (void *)(uintptr_t)slot, freq + 1);
+  lecar_expire(lecar, slot, ttl);
+
+  *ptr = arena_page(lecar->arena, slot);
+
+  return 1;
+}
+
+int lecar_invalidate(lecar_t *lecar, uint64_t key) {
+  void *val;
+
+  if (linkmap_get(lecar->lru, key, &val))
+    return 1;
+
+  lecar_drop(lecar, (uintptr_t)val);
+  return 0;
+}
+
+/* Follows a page the arena moved while shrinking
+ */
+static void lecar_move(void *ctx, size_t from, size_t to) {
+  lecar_t *lecar = ctx;
+  uint64_t key = arena_key(lecar->arena, to);
+
+  linkmap_set(lecar->lru, key, (void *)(uintptr_t)to);
+  freqmap_replace(lecar->lfu, key, (void *)(uintptr_t)to);
+  if (lecar->tw)
+    twheel_move(lecar->tw, from, to);
+}
+
+int lecar_resize(lecar_t *lecar, size_t nmemb) {
+  if (nmemb < 2)
+    return -1;
+
+  /* the histories keep their size, and so the regret its scale */
+  if (nmemb > lecar->nmemb) {
+    if ((lecar->tw && twheel_resize(lecar->tw, nmemb)) ||
+        linkmap_grow(lecar->lru, nmemb) ||
+        freqmap_grow(lecar->lfu, nmemb) ||
+        arena_resize(lecar->arena, nmemb, NULL, NULL))
+      return -1;
+  } else {
+    while (arena_used(lecar->arena) > nmemb)
+      lecar_evict(lecar);
+    arena_resize(lecar->arena, nmemb, lecar_move, lecar);
+    if (lecar->tw)
+      twheel_resize(lecar->tw, nmemb);
+  }
+
+  lecar->nmemb = nmemb;
+  return 0;
+}
+
+void lecar_free(lecar_t **lecar) {
+  arena_free(&(*lecar)->arena);
+  linkmap_free(&(*lecar)->lru);
+  freqmap_free(&(*lecar)->lfu);
+  free((*lecar)->history[LRU]);
+  free((*lecar)->history[LFU]);
+  if ((*lecar)->ghosts)
+    htable_free(&(*lecar)->ghosts);
+  twheel_free(&(*lecar)->tw);
+  free(*lecar);
+  *lecar = NULL;
+}
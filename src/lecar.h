@@ -0,0 +1,51 @@
+#ifndef LECAR_H_6f1a9c3e5b2d4e78a0c7f3b9d1e5a264
+#define LECAR_H_6f1a9c3e5b2d4e78a0c7f3b9d1e5a264
+
+/* LeCaR: learning cache replacement (Vietri et al., HotStorage '18).
+ *
+ * Pages are kept in both LRU and LFU order. Each eviction follows
+ * one of the two, chosen at random according to a pair of weights,
+ * and the victim's key is remembered in that policy's history. A miss
+ * on a key in a history is regret for the policy that evicted it, and
+ * shifts weight towards the other policy, the more so the more
+ * recently the key was evicted.
+ */
+
+#include <stdint.h>
+
+typedef struct lecar_s lecar_t;
+
+/* Options for lecar_new_ex().
+ *
+ * rate is the learning rate and history the number of keys each
+ * history remembers. Regret is discounted by discount^age, age being
+ * the number of fetches since the eviction, and discount is chosen
+ * such that regret for a key evicted history fetches ago is 0.005.
+ * 0 means the paper's defaults, a rate of 0.45 and a history of
+ * nmemb. seed seeds the instance's random number generator.
+ */
+struct lecar_opts {
+  double rate;
+  size_t history;
+  uint64_t seed;
+};
+
+lecar_t *lecar_new(size_t size, size_t nmemb);
+lecar_t *lecar_new_ex(size_t size, size_t nmemb,
+                      const struct lecar_opts *opts);
+int lecar_fetch(lecar_t *lecar, uint64_t key, void **ptr);
+
+/* Same as lru_fetch_ttl(), see lru.h. An expired page starts over
+ * with the frequency of a new one. Reclaiming an expired page leaves
+ * no ghost.
+ */
+int lecar_fetch_ttl(lecar_t *lecar, uint64_t key, uint64_t now,
+                    uint64_t ttl, void **ptr);
+
+/* Same as lru_invalidate() and lru_resize(), see lru.h
+ */
+int lecar_invalidate(lecar_t *lecar, uint64_t key);
+int lecar_resize(lecar_t *lecar, size_t nmemb);
+void lecar_free(lecar_t **lecar);
+
+#endif
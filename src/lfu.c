@@ -0,0 +1,202 @@
+#include <stdlib.h>
+#include <assert.h>
+#include "arena.h"
+#include "freqmap.h"
+#include "twheel.h"
+#include "lfu.h"
+
+#include <stdio.h>
+
+#define DEFAULT_PERIOD(nmemb) (10 * (nmemb))
+
+/* the freqmap maps keys to page slots in the arena */
+struct lfu_s {
+  freqmap_t *fm;
+  enum lfu_aging aging;
+  size_t period;
+  size_t fetches;
+  uint64_t age;
+  size_t nmemb;
+  arena_t *arena;
+  /* only once pages start expiring */
+  twheel_t *tw;
+  uint64_t now;
+};
+
+lfu_t *lfu_new(size_t size, size_t nmemb) {
+  struct lfu_opts opts = {.aging = LFU_AGING_NONE, .period = 0};
+
+  return lfu_new_ex(size, nmemb, &opts);
+}
+
+lfu_t *lfu_new_ex(size_t size, size_t nmemb, const struct lfu_opts *opts) {
+  lfu_t *lfu;
+  freqmap_t *fm;
+  arena_t *arena;
+
+  assert(nmemb >= 2);
+
+  lfu = malloc(sizeof(lfu_t));
+  fm = freqmap_new(nmemb);
+  arena = arena_new(size, nmemb);
+
+  if (!lfu || !fm || !arena) {
+    free(lfu);
+    freqmap_free(&fm);
+    arena_free(&arena);
+    return NULL;
+  }
+
+  lfu->fm = fm;
+  lfu->arena = arena;
+  lfu->aging = opts->aging;
+  lfu->period = opts->period ? opts->period : DEFAULT_PERIOD(nmemb);
+  lfu->fetches = 0;
+  lfu->age = 0;
+  lfu->nmemb = nmemb;
+  lfu->tw = NULL;
+  lfu->now = 0;
+
+  return lfu;
+}
+
+/* Sets when the page in slot expires, if pages expire at all
+ */
+static void lfu_expire(lfu_t *lfu, size_t slot, uint64_t ttl) {
+  if (!lfu->tw)
+    return;
+  if (ttl)
+    twheel_set(lfu->tw, slot, lfu->now + ttl);
+  else
+    twheel_del(lfu->tw, slot);
+}
+
+/* Frees a page, an expired one if any and the LFU one otherwise. Only
+ * the latter ages the cache.
+ */
+static void lfu_evict(lfu_t *lfu) {
+  uint64_t k, freq;
+  void *val;
+  size_t slot;
+
+  if (lfu->tw && !twheel_pop(lfu->tw, lfu->now, &slot)) {
+    freqmap_pop(lfu->fm, arena_key(lfu->arena, slot), &val, NULL);
+    arena_release(lfu->arena, slot);
+    return;
+  }
+
+  freqmap_pop_min(lfu->fm, &k, &val, &freq);
+  if (lfu->aging == LFU_AGING_DA)
+    lfu->age = freq;
+  if (lfu->tw)
+    twheel_del(lfu->tw, (uintptr_t)val);
+  arena_release(lfu->arena, (uintptr_t)val);
+}
+
+int lfu_fetch(lfu_t *lfu, uint64_t key, void **ptr) {
+  return lfu_fetch_ttl(lfu, key, lfu->now, 0, ptr);
+}
+
+int lfu_fetch_ttl(lfu_t *lfu, uint64_t key, uint64_t now, uint64_t ttl,
+                  void **ptr) {
+  void *val;
+  size_t slot;
+
+  if (ttl && !lfu->tw) {
+    lfu->tw = twheel_new(lfu->nmemb, lfu->now);
+    if (!lfu->tw)
+      return -1;
+  }
+  if (now > lfu->now)
+    lfu->now = now;
+
+  if (lfu->aging == LFU_AGING_HALVE && ++lfu->fetches >= lfu->period) {
+    freqmap_halve(lfu->fm);
+    lfu->fetches = 0;
+  }
+
+  /* hit cache, which bumps the frequency */
+  if (!freqmap_get(lfu->fm, key, &val)) {
+    slot = (uintptr_t)val;
+    *ptr = arena_page(lfu->arena, slot);
+
+    /* unless it has expired, in which case it is reloaded in place,
+       counting as a new page */
+    if (lfu->tw && twheel_expired(lfu->tw, slot, lfu->now)) {
+      freqmap_pop(lfu->fm, key, &val, NULL);
+      freqmap_set(lfu->fm, key, val, lfu->age + 1);
+      lfu_expire(lfu, slot, ttl);
+      return 1;
+    }
+    return 0;
+  }
+
+  /* take a free page if possible, evict LFU otherwise */
+  if (arena_alloc(lfu->arena, key, &slot)) {
+    lfu_evict(lfu);
+    arena_alloc(lfu->arena, key, &slot);
+  }
+
+  /* the victim had the lowest frequency, so this stays O(1) */
+  freqmap_set(lfu->fm, key, (void *)(uintptr_t)slot, lfu->age + 1);
+  lfu_expire(lfu, slot, ttl);
+
+  *ptr = arena_page(lfu->arena, slot);
+
+  return 1;
+}
+
+int lfu_invalidate(lfu_t *lfu, uint64_t key) {
+  void *val;
+
+  if (freqmap_pop(lfu->fm, key, &val, NULL))
+    return 1;
+
+  if (lfu->tw)
+    twheel_del(lfu->tw, (uintptr_t)val);
+  arena_release(lfu->arena, (uintptr_t)val);
+  return 0;
+}
+
+/* Follows a page the arena moved while shrinking
+ */
+static void lfu_move(void *ctx, size_t from, size_t to) {
+  lfu_t *lfu = ctx;
+
+  freqmap_replace(lfu->fm, arena_key(lfu->arena, to), (void *)(uintptr_t)to);
+  if (lfu->tw)
+    twheel_move(lfu->tw, from, to);
+}
+
+int lfu_resize(lfu_t *lfu, size_t nmemb) {
+  if (nmemb < 2)
+    return -1;
+
+  if (nmemb > lfu->nmemb) {
+    if ((lfu->tw && twheel_resize(lfu->tw, nmemb)) ||
+        freqmap_grow(lfu->fm, nmemb) ||
+        arena_resize(lfu->arena, nmemb, NULL, NULL))
+      return -1;
+  } else {
+    while (arena_used(lfu->arena) > nmemb)
+      lfu_evict(lfu);
+    arena_resize(lfu->arena, nmemb, lfu_move, lfu);
+    if (lfu->tw)
+      twheel_resize(lfu->tw, nmemb);
+  }
+
+  /* the halving period keeps its proportion to the cache */
+  lfu->period = lfu->period * nmemb / lfu->nmemb;
+  if (!lfu->period)
+    lfu->period = 1;
+  lfu->nmemb = nmemb;
+  return 0;
+}
+
+void lfu_free(lfu_t **lfu) {
+  arena_free(&(*lfu)->arena);
+  freqmap_free(&(*lfu)->fm);
+  twheel_free(&(*lfu)->tw);
+  free(*lfu);
+  *lfu = NULL;
+}
@@ -0,0 +1,41 @@
+#ifndef LFU_H_8d3f6a1e92c74b05a7e4c1d8b6f3e927
+#define LFU_H_8d3f6a1e92c74b05a7e4c1d8b6f3e927
+
+#include <stdint.h>
+
+typedef struct lfu_s lfu_t;
+
+/* How page frequencies are aged, so that pages that were popular
+ * once don't stay forever. LFU_AGING_HALVE halves all frequencies
+ * every period fetches. LFU_AGING_DA is LFU with dynamic aging: new
+ * pages start out one above the frequency of the last victim rather
+ * than at 1.
+ */
+enum lfu_aging { LFU_AGING_NONE, LFU_AGING_HALVE, LFU_AGING_DA };
+
+/* Options for lfu_new_ex().
+ *
+ * period is only used with LFU_AGING_HALVE, 0 meaning 10*nmemb.
+ */
+struct lfu_opts {
+  enum lfu_aging aging;
+  size_t period;
+};
+
+lfu_t *lfu_new(size_t size, size_t nmemb);
+lfu_t *lfu_new_ex(size_t size, size_t nmemb, const struct lfu_opts *opts);
+int lfu_fetch(lfu_t *lfu, uint64_t key, void **ptr);
+
+/* Same as lru_fetch_ttl(), see lru.h. An expired page starts over
+ * with the frequency of a new one.
+ */
+int lfu_fetch_ttl(lfu_t *lfu, uint64_t key, uint64_t now, uint64_t ttl,
+                  void **ptr);
+
+/* Same as lru_invalidate() and lru_resize(), see lru.h
+ */
+int lfu_invalidate(lfu_t *lfu, uint64_t key);
+int lfu_resize(lfu_t *lfu, size_t nmemb);
+void lfu_free(lfu_t **lfu);
+
+#endif
@@ -12,16 +12,36 @@ struct linkmap_entry_s {
   linkmap_entry_t *tnext;
   linkmap_entry_t *lnext;
   linkmap_entry_t *lprev;
+  int list;
+};
+
+struct linkmap_list_s {
+  linkmap_entry_t *first;
+  linkmap_entry_t *last;
+  size_t size;
 };
 
 struct linkmap_s {
   linkmap_entry_t **table;
+  /* while growing, the buckets of the previous table that are yet to
+     be rehashed into table, those below rehash having been already */
+  linkmap_entry_t **old;
+  size_t osize;
+  size_t rehash;
   linkmap_entry_t *entry;
-  linkmap_entry_t *lfirst;
-  linkmap_entry_t *llast;
+  struct linkmap_list_s *list;
   linkmap_entry_t *free;
+  /* entries added by linkmap_grow(), the last nfresh of which have not
+     been handed out yet */
+  linkmap_entry_t **more;
+  size_t nmore;
+  linkmap_entry_t *fresh;
+  size_t nfresh;
   size_t capacity;
+  size_t tsize;
   size_t size;
+  int nlists;
+  int grow;
 };
 
 
@@ -61,43 +81,151 @@ static int table_scan(linkmap_entry_t *list, uint64_t key,
   return 1;
 }
 
-/* Removes entry from the linked list. Note that the entry will _not_
+/* Rehashes up to n buckets of the previous table, or passes over up
+ * to 10*n empty ones, so that growing is spread over the operations
+ * that follow it
+ */
+static void rehash(linkmap_t *lm, size_t n) {
+  linkmap_entry_t *entry, *next;
+  size_t empty = 10 * n;
+  int h;
+
+  while (n && lm->old) {
+    entry = lm->old[lm->rehash];
+    if (entry) {
+      lm->old[lm->rehash] = NULL;
+      for (; entry; entry = next) {
+        next = entry->tnext;
+        h = hash64shift(entry->key, lm->tsize);
+        entry->tnext = lm->table[h];
+        lm->table[h] = entry;
+      }
+      n--;
+    } else if (!empty--) {
+      break;
+    }
+
+    if (++lm->rehash >= lm->osize) {
+      free(lm->old);
+      lm->old = NULL;
+    }
+  }
+}
+
+/* Finds the entry for key in the table or, while growing, in the
+ * previous one. Returns 0 if found, 1 otherwise. The entry, the chain
+ * it is in and the entry before it are written back on success.
+ */
+static int find(linkmap_t *lm, uint64_t key, linkmap_entry_t **entry,
+                linkmap_entry_t ***head, linkmap_entry_t **prev) {
+  rehash(lm, 1);
+
+  *head = &lm->table[hash64shift(key, lm->tsize)];
+  if (!table_scan(**head, key, entry, prev))
+    return 0;
+  if (!lm->old)
+    return 1;
+
+  *head = &lm->old[hash64shift(key, lm->osize)];
+  return table_scan(**head, key, entry, prev);
+}
+
+/* Takes an entry off the free list or from those added last, growing
+ * the table first if it is full and allowed to grow. Returns NULL if
+ * there is none.
+ */
+static linkmap_entry_t *alloc(linkmap_t *lm) {
+  linkmap_entry_t *entry;
+
+  if (!lm->free && !lm->nfresh &&
+      (!lm->grow || linkmap_grow(lm, 2 * lm->capacity)))
+    return NULL;
+
+  if (lm->free) {
+    entry = lm->free;
+    lm->free = entry->tnext;
+  } else {
+    entry = lm->fresh++;
+    lm->nfresh--;
+  }
+
+  return entry;
+}
+
+/* Removes entry from its linked list. Note that the entry will _not_
  * be removed from the hash table.
  */
 static void unlink(linkmap_t *lm, linkmap_entry_t *entry) {
+  struct linkmap_list_s *list = lm->list + entry->list;
+
   if (entry->lprev)
     entry->lprev->lnext = entry->lnext;
   else
-    lm->lfirst = entry->lnext;
+    list->first = entry->lnext;
   if (entry->lnext)
     entry->lnext->lprev = entry->lprev;
   else
-    lm->llast = entry->lprev;
+    list->last = entry->lprev;
+  list->size--;
+}
+
+/* Inserts entry as head of a linked list
+ */
+static void link_head(linkmap_t *lm, linkmap_entry_t *entry, int list) {
+  struct linkmap_list_s *l = lm->list + list;
+
+  if (l->first)
+    l->first->lprev = entry;
+  else
+    l->last = entry;
+  entry->lprev = NULL;
+  entry->lnext = l->first;
+  entry->list = list;
+  l->first = entry;
+  l->size++;
 }
 
 linkmap_t *linkmap_new(size_t capacity) {
-  int i;
+  return linkmap_new_lists(capacity, 1);
+}
+
+linkmap_t *linkmap_new_lists(size_t capacity, int nlists) {
+  struct linkmap_opts opts = {.nlists = nlists, .grow = 0};
+
+  return linkmap_new_ex(capacity, &opts);
+}
+
+linkmap_t *linkmap_new_ex(size_t capacity, const struct linkmap_opts *opts) {
+  int i, nlists;
   linkmap_t *lm;
   linkmap_entry_t *entry;
   linkmap_entry_t **table;
+  struct linkmap_list_s *list;
 
   capacity = MAX(capacity, 1);
+  nlists = MAX(opts->nlists, 1);
 
   lm = calloc(1, sizeof(linkmap_t));
   entry = malloc(capacity * sizeof(linkmap_entry_t));
   table = calloc(capacity, sizeof(linkmap_entry_t *));
+  list = calloc(nlists, sizeof(struct linkmap_list_s));
 
-  if (!lm || !entry || !table) {
+  if (!lm || !entry || !table || !list) {
     free(lm);
     free(entry);
     free(table);
+    free(list);
     return NULL;
   }
 
   lm->entry = entry;
   lm->table = table;
+  lm->list = list;
+  lm->nlists = nlists;
   lm->capacity = capacity;
+  lm->tsize = capacity;
   lm->size = 0;
+  lm->grow = opts->grow;
 
   /* create the list of unused entries */
   lm->free = lm->entry;
@@ -111,46 +239,96 @@ linkmap_t *linkmap_new(size_t capacity) {
 void linkmap_free(linkmap_t **lm) {
   if (!lm || !*lm)
     return;
+  while ((*lm)->nmore)
+    free((*lm)->more[--(*lm)->nmore]);
+  free((*lm)->more);
+  free((*lm)->old);
   free((*lm)->entry);
   free((*lm)->table);
+  free((*lm)->list);
   free(*lm);
   *lm = NULL;
 }
 
+int linkmap_grow(linkmap_t *lm, size_t capacity) {
+  linkmap_entry_t *entry, **more, **table;
+  size_t n;
+
+  if (capacity <= lm->capacity)
+    return 0;
+  n = capacity - lm->capacity;
+
+  /* one growth at a time */
+  while (lm->old)
+    rehash(lm, 1);
+
+  more = realloc(lm->more, (lm->nmore + 1) * sizeof(*more));
+  if (!more)
+    return -1;
+  lm->more = more;
+
+  entry = malloc(n * sizeof(linkmap_entry_t));
+  table = calloc(capacity, sizeof(linkmap_entry_t *));
+  if (!entry || !table) {
+    free(entry);
+    free(table);
+    return -1;
+  }
+  lm->more[lm->nmore++] = entry;
+
+  /* entries left over from the last growth go on the free list */
+  while (lm->nfresh) {
+    lm->fresh->tnext = lm->free;
+    lm->free = lm->fresh++;
+    lm->nfresh--;
+  }
+  lm->fresh = entry;
+  lm->nfresh = n;
+  lm->capacity = capacity;
+
+  lm->old = lm->table;
+  lm->osize = lm->tsize;
+  lm->rehash = 0;
+  lm->table = table;
+  lm->tsize = capacity;
+
+  return 0;
+}
+
 size_t linkmap_size(linkmap_t *lm) {
   return lm->size;
 }
 
+size_t linkmap_size_in(linkmap_t *lm, int list) {
+  return lm->list[list].size;
+}
+
 int linkmap_set(linkmap_t *lm, uint64_t key, void *val) {
-  int h;
-  linkmap_entry_t *entry, *prev;
+  return linkmap_set_in(lm, 0, key, val);
+}
 
-  h = hash64shift(key, lm->capacity);
+int linkmap_set_in(linkmap_t *lm, int list, uint64_t key, void *val) {
+  int h;
+  linkmap_entry_t *entry, **head, *prev;
 
   /* replace value if key already exists*/
-  if (!table_scan(lm->table[h], key, &entry, &prev)) {
+  if (!find(lm, key, &entry, &head, &prev)) {
     entry->val = val;
     return 0;
   }
 
-  /* otherwise grab an entry from the free list */
-  if (!lm->free)
+  /* otherwise grab a free entry */
+  entry = alloc(lm);
+  if (!entry)
     return 1;
-  entry = lm->free;
-  lm->free = entry->tnext;
 
   /* insert it into the hash table */
+  h = hash64shift(key, lm->tsize);
   entry->tnext = lm->table[h];
   lm->table[h] = entry;
 
   /* insert as head in list */
-  if (lm->lfirst)
-    lm->lfirst->lprev = entry;
-  else
-    lm->llast = entry;
-  entry->lprev = NULL;
-  entry->lnext = lm->lfirst;
-  lm->lfirst = entry;
+  link_head(lm, entry, list);
 
   lm->size++;
   entry->key = key;
@@ -160,12 +338,22 @@ int linkmap_set(linkmap_t *lm, uint64_t key, void *val) {
 }
 
 int linkmap_get(linkmap_t *lm, uint64_t key, void **val) {
-  int h;
-  linkmap_entry_t *entry, *prev;
+  linkmap_entry_t *entry, **head, *prev;
+
+  if (!find(lm, key, &entry, &head, &prev)) {
+    *val = entry->val;
+    return 0;
+  }
+
+  return 1;
+}
 
-  h = hash64shift(key, lm->capacity);
-  if (!table_scan(lm->table[h], key, &entry, &prev)) {
+int linkmap_get_list(linkmap_t *lm, uint64_t key, void **val, int *list) {
+  linkmap_entry_t *entry, **head, *prev;
+
+  if (!find(lm, key, &entry, &head, &prev)) {
     *val = entry->val;
+    *list = entry->list;
     return 0;
   }
 
@@ -173,35 +361,57 @@ int linkmap_get(linkmap_t *lm, uint64_t key, void **val) {
 }
 
 int linkmap_get_head(linkmap_t *lm, uint64_t *key, void **val) {
-  if (!lm->lfirst)
+  if (!lm->list[0].first)
     return 1;
-  *key = lm->lfirst->key;
-  *val = lm->lfirst->val;
+  *key = lm->list[0].first->key;
+  *val = lm->list[0].first->val;
   return 0;
 }
 
 int linkmap_get_tail(linkmap_t *lm, uint64_t *key, void **val) {
-  if (!lm->llast)
+  return linkmap_get_tail_in(lm, 0, key, val);
+}
+
+int linkmap_get_tail_in(linkmap_t *lm, int list, uint64_t *key, void **val) {
+  if (!lm->list[list].last)
+    return 1;
+  *key = lm->list[list].last->key;
+  *val = lm->list[list].last->val;
+  return 0;
+}
+
+int linkmap_move(linkmap_t *lm, uint64_t key, int list, void **val,
+                 int *from) {
+  linkmap_entry_t *entry, **head, *prev;
+
+  if (find(lm, key, &entry, &head, &prev))
     return 1;
-  *key = lm->llast->key;
-  *val = lm->llast->val;
+
+  if (from)
+    *from = entry->list;
+  if (val)
+    *val = entry->val;
+
+  if (lm->list[list].first != entry) {
+    unlink(lm, entry);
+    link_head(lm, entry, list);
+  }
+
   return 0;
 }
 
 int linkmap_pop(linkmap_t *lm, uint64_t key, void **val) {
-  int h;
-  linkmap_entry_t *entry, *tprev;
+  linkmap_entry_t *entry, **head, *tprev;
 
   /* find the entry */
-  h = hash64shift(key, lm->capacity);
-  if (table_scan(lm->table[h], key, &entry, &tprev))
+  if (find(lm, key, &entry, &head, &tprev))
     return 1;
 
   /* disconnect from table and list */
   if (tprev)
     tprev->tnext = entry->tnext;
   else
-    lm->table[h] = entry->tnext;
+    *head = entry->tnext;
   unlink(lm, entry);
 
   /* put back the entry on the free list */
@@ -215,16 +425,20 @@ int linkmap_pop(linkmap_t *lm, uint64_t key, void **val) {
 }
 
 int linkmap_pop_head(linkmap_t *lm, uint64_t *key, void **val) {
-  if (!lm->lfirst)
+  if (!lm->list[0].first)
     return 1;
-  *key = lm->lfirst->key;
+  *key = lm->list[0].first->key;
   return linkmap_pop(lm, *key, val);
 }
 
 int linkmap_pop_tail(linkmap_t *lm, uint64_t *key, void **val) {
-  if (!lm->llast)
+  return linkmap_pop_tail_in(lm, 0, key, val);
+}
+
+int linkmap_pop_tail_in(linkmap_t *lm, int list, uint64_t *key, void **val) {
+  if (!lm->list[list].last)
     return 1;
-  *key = lm->llast->key;
+  *key = lm->list[list].last->key;
   return linkmap_pop(lm, *key, val);
 }
 
@@ -6,6 +6,12 @@
  * A linkmap_t is a doubly linked list coupled with a hash table. Each
  * entry consists of a uint64_t key and a void* value. Entries can be
  * manipulated by key.
+ *
+ * A linkmap_t can also hold several lists sharing the same table and
+ * the same pool of entries, e.g. the segments of a segmented LRU, so
+ * that entries can move between lists without being freed and
+ * reallocated. The functions without an _in suffix operate on list
+ * 0, except that lookups by key find entries in any list.
  */
 
 #include <stdint.h>
@@ -20,15 +26,50 @@ typedef struct linkmap_s linkmap_t;
  */
 linkmap_t *linkmap_new(size_t capacity);
 
+/* Allocates a new linked table with nlists lists, numbered 0 to
+ * nlists-1, sharing capacity entries.
+ *
+ * If nlists < 1, 1 list will be used.
+ *
+ * Returns NULL if out of memory.
+ */
+linkmap_t *linkmap_new_lists(size_t capacity, int nlists);
+
+/* Options for linkmap_new_ex().
+ *
+ * nlists is as for linkmap_new_lists(). If grow is set, a full table
+ * doubles its capacity rather than fail a set().
+ */
+struct linkmap_opts {
+  int nlists;
+  int grow;
+};
+
+linkmap_t *linkmap_new_ex(size_t capacity, const struct linkmap_opts *opts);
+
+/* Grows the table to hold capacity entries, if it holds fewer.
+ *
+ * Only the added entries are allocated, and no entry moves. The hash
+ * buckets grow along, but entries are rehashed into the new buckets
+ * incrementally, a bucket or so per operation by key, so that no
+ * single operation pays for the whole table. Growing again before
+ * that is done finishes the rehash first.
+ *
+ * Returns 0 on success
+ *         -1 if out of memory
+ */
+int linkmap_grow(linkmap_t *lm, size_t capacity);
+
 /* Destroys a table and releases all associated resources
  *
  * The htable pointer at *h will be set to NULL
  */
 void linkmap_free(linkmap_t **lm);
 
-/* Returns the number of entries in t
+/* Returns the number of entries in t, or in one of its lists
  */
 size_t linkmap_size(linkmap_t *lm);
+size_t linkmap_size_in(linkmap_t *lm, int list);
 
 /* Sets value for key.
  *
@@ -37,21 +78,35 @@ size_t linkmap_size(linkmap_t *lm);
  * head of the list.
  *
  * Returns 0 on sucess
- *         1 if the table is full
+ *         1 if the table is full and can't grow, or out of memory
  */
 int linkmap_set(linkmap_t *lm, uint64_t key, void *val);
+int linkmap_set_in(linkmap_t *lm, int list, uint64_t key, void *val);
+
+/* Moves entry by key to head of list, which may be the list it is
+ * already in. The value and the list the entry was in are written to
+ * val and from, unless they are NULL.
+ *
+ * Returns 0 on success
+ *         1 if key was not found
+ */
+int linkmap_move(linkmap_t *lm, uint64_t key, int list, void **val,
+                 int *from);
 
 /* These retrieve entries.
  *
  * _get() retrieves value by key,
+ * _get_list() also retrieves the list the entry is in,
  * _get_head/tail() retrieves key and value for list head/tail
  *
  * Returns 0 on success
  *         1 if key was not found or if linkmap is empty
  */
 int linkmap_get(linkmap_t *lm, uint64_t key, void **val);
+int linkmap_get_list(linkmap_t *lm, uint64_t key, void **val, int *list);
 int linkmap_get_head(linkmap_t *lm, uint64_t *key, void **val);
 int linkmap_get_tail(linkmap_t *lm, uint64_t *key, void **val);
+int linkmap_get_tail_in(linkmap_t *lm, int list, uint64_t *key, void **val);
 
 /* These retrieves and deletes entries
  *
@@ -64,6 +119,7 @@ int linkmap_get_tail(linkmap_t *lm, uint64_t *key, void **val);
 int linkmap_pop(linkmap_t *lm, uint64_t key, void **val);
 int linkmap_pop_head(linkmap_t *lm, uint64_t *key, void **val);
 int linkmap_pop_tail(linkmap_t *lm, uint64_t *key, void **val);
+int linkmap_pop_tail_in(linkmap_t *lm, int list, uint64_t *key, void **val);
 
 /* These delete entries.
  *
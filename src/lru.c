@@ -1,75 +1,255 @@
 #include <stdlib.h>
 #include <assert.h>
+#include "arena.h"
 #include "linkmap.h"
+#include "twheel.h"
 #include "lru.h"
 
 #include <stdio.h>
 
+/* the linkmap maps keys to page slots in the arena rather than to
+   pointers, so that pages can move when the cache shrinks. Its first
+   list is in LRU order, its second holds the prefetched pages that
+   haven't been fetched yet, in the order they were prefetched. */
+#define RECENT 0
+#define PREFETCHED 1
+
+/* prefetched pages go first once there are more than this many */
+#define MAX_PREFETCHED(nmemb) ((nmemb) / 4)
+
+/* the index a shared cache starts out with */
+#define SHARED_CAPACITY(nmemb) ((nmemb) < 64 ? (nmemb) : 64)
+
 struct lru_s {
   linkmap_t *lm;
-  size_t size;
+  arena_t *arena;
   size_t nmemb;
-  size_t active;
-  void *data;
+  /* the arena belongs to someone else */
+  int shared;
+  /* only once pages start expiring */
+  twheel_t *tw;
+  uint64_t now;
 };
 
 lru_t *lru_new(size_t size, size_t nmemb) {
   lru_t *lru;
   linkmap_t *lm;
-  void *data;
+  arena_t *arena;
 
   assert(nmemb >= 2);
 
-  lru = malloc(sizeof(lru_t));
-  lm = linkmap_new(nmemb);
-  data = malloc(nmemb * size);
+  lru = calloc(1, sizeof(lru_t));
+  lm = linkmap_new_lists(nmemb, 2);
+  arena = arena_new(size, nmemb);
 
-  if (!lru || !lm || !data) {
+  if (!lru || !lm || !arena) {
     free(lru);
-    free(lm);
-    free(data);
+    linkmap_free(&lm);
+    arena_free(&arena);
     return NULL;
   }
 
   lru->lm = lm;
-  lru->data = data;
-  lru->size = size;
+  lru->arena = arena;
   lru->nmemb = nmemb;
-  lru->active = 0;
 
   return lru;
 }
 
-int lru_fetch(lru_t *lru, uint64_t key, void **ptr) {
-  void *data, *val;
+lru_t *lru_new_shared(arena_t *arena) {
+  struct linkmap_opts opts = {.nlists = 2, .grow = 1};
+  lru_t *lru;
+
+  lru = calloc(1, sizeof(lru_t));
+  if (!lru)
+    return NULL;
+
+  /* any number of the arena's pages may end up ours, so start with
+     a small index and let it grow with what we actually hold */
+  lru->nmemb = arena_nmemb(arena);
+  lru->lm = linkmap_new_ex(SHARED_CAPACITY(lru->nmemb), &opts);
+  if (!lru->lm) {
+    free(lru);
+    return NULL;
+  }
+  lru->arena = arena;
+  lru->shared = 1;
+
+  return lru;
+}
+
+/* Sets when the page in slot expires, if pages expire at all
+ */
+static void lru_expire(lru_t *lru, size_t slot, uint64_t ttl) {
+  if (!lru->tw)
+    return;
+  if (ttl)
+    twheel_set(lru->tw, slot, lru->now + ttl);
+  else
+    twheel_del(lru->tw, slot);
+}
+
+/* Removes the page in slot from the cache
+ */
+static void lru_drop(lru_t *lru, size_t slot) {
+  linkmap_del(lru->lm, arena_key(lru->arena, slot));
+  if (lru->tw)
+    twheel_del(lru->tw, slot);
+  arena_release(lru->arena, slot);
+}
+
+/* Frees a page, an expired one if any, the oldest prefetched one if
+ * there are too many, and the LRU one otherwise
+ */
+static void lru_evict(lru_t *lru) {
   uint64_t k;
+  void *v;
+  size_t slot;
+  int list;
+
+  if (lru->tw && !twheel_pop(lru->tw, lru->now, &slot)) {
+    lru_drop(lru, slot);
+    return;
+  }
+
+  list = RECENT;
+  if (linkmap_size_in(lru->lm, PREFETCHED) > MAX_PREFETCHED(lru->nmemb) ||
+      !linkmap_size_in(lru->lm, RECENT))
+    list = PREFETCHED;
+  linkmap_get_tail_in(lru->lm, list, &k, &v);
+  lru_drop(lru, (uintptr_t)v);
+}
+
+int lru_fetch(lru_t *lru, uint64_t key, void **ptr) {
+  return lru_fetch_ttl(lru, key, lru->now, 0, ptr);
+}
+
+int lru_fetch_ttl(lru_t *lru, uint64_t key, uint64_t now, uint64_t ttl,
+                  void **ptr) {
+  void *val;
+  size_t slot;
+
+  if (ttl && !lru->tw) {
+    lru->tw = twheel_new(lru->nmemb, lru->now);
+    if (!lru->tw)
+      return -1;
+  }
+  if (now > lru->now)
+    lru->now = now;
 
-  /* hit cache */
-  if (!linkmap_pop(lru->lm, key, ptr)) {
-    /* reinsert as head, i.e. MRU, if found */
-    linkmap_set(lru->lm, key, *ptr);
+  /* hit cache, moving it to head, i.e. MRU, if found */
+  if (!linkmap_move(lru->lm, key, RECENT, &val, NULL)) {
+    slot = (uintptr_t)val;
+    *ptr = arena_page(lru->arena, slot);
+    /* which is also where a reloaded expired page goes */
+    if (lru->tw && twheel_expired(lru->tw, slot, lru->now)) {
+      lru_expire(lru, slot, ttl);
+      return 1;
+    }
     return 0;
   }
 
-  /* create new page if possible, evict LRU otherwise */
-  if (lru->active < lru->nmemb) {
-    val = lru->data + lru->active * lru->size;
-    lru->active++;
-  } else {
-    linkmap_pop_tail(lru->lm, &k, &val);
+  /* take a free page if possible, reclaim an expired page or evict
+     LRU otherwise */
+  if (arena_alloc(lru->arena, key, &slot) &&
+      (lru_reclaim(lru) || arena_alloc(lru->arena, key, &slot)))
+    return -1;
+
+  /* insert as MRU */
+  linkmap_set(lru->lm, key, (void *)(uintptr_t)slot);
+  lru_expire(lru, slot, ttl);
+
+  *ptr = arena_page(lru->arena, slot);
+
+  return 1;
+}
+
+int lru_prefetch(lru_t *lru, uint64_t key, void **ptr) {
+  void *val;
+  size_t slot;
+
+  /* a page that is cached stays where it is, unless it has expired */
+  if (!linkmap_get(lru->lm, key, &val)) {
+    slot = (uintptr_t)val;
+    if (!lru->tw || !twheel_expired(lru->tw, slot, lru->now)) {
+      *ptr = arena_page(lru->arena, slot);
+      return 0;
+    }
+    lru_drop(lru, slot);
   }
 
-  /* insert as LRU */
-  linkmap_set(lru->lm, key, val);
+  if (arena_alloc(lru->arena, key, &slot) &&
+      (lru_reclaim(lru) || arena_alloc(lru->arena, key, &slot)))
+    return -1;
+
+  linkmap_set_in(lru->lm, PREFETCHED, key, (void *)(uintptr_t)slot);
+  lru_expire(lru, slot, 0);
 
-  *ptr = val;
+  *ptr = arena_page(lru->arena, slot);
 
   return 1;
 }
 
+int lru_invalidate(lru_t *lru, uint64_t key) {
+  void *val;
+
+  if (linkmap_get(lru->lm, key, &val))
+    return 1;
+
+  lru_drop(lru, (uintptr_t)val);
+  return 0;
+}
+
+int lru_reclaim(lru_t *lru) {
+  if (!linkmap_size(lru->lm))
+    return 1;
+
+  lru_evict(lru);
+  return 0;
+}
+
+size_t lru_size(lru_t *lru) {
+  return linkmap_size(lru->lm);
+}
+
+/* Follows a page the arena moved while shrinking
+ */
+static void lru_move(void *ctx, size_t from, size_t to) {
+  lru_t *lru = ctx;
+
+  linkmap_set(lru->lm, arena_key(lru->arena, to), (void *)(uintptr_t)to);
+  if (lru->tw)
+    twheel_move(lru->tw, from, to);
+}
+
+int lru_resize(lru_t *lru, size_t nmemb) {
+  if (nmemb < 2 || lru->shared)
+    return -1;
+
+  /* the arena goes last when growing, as it decides which pages can
+     be handed out */
+  if (nmemb > lru->nmemb) {
+    if ((lru->tw && twheel_resize(lru->tw, nmemb)) ||
+        linkmap_grow(lru->lm, nmemb) ||
+        arena_resize(lru->arena, nmemb, NULL, NULL))
+      return -1;
+  } else {
+    while (arena_used(lru->arena) > nmemb)
+      lru_evict(lru);
+    arena_resize(lru->arena, nmemb, lru_move, lru);
+    if (lru->tw)
+      twheel_resize(lru->tw, nmemb);
+  }
+
+  lru->nmemb = nmemb;
+  return 0;
+}
+
 void lru_free(lru_t **lru) {
-  free((*lru)->data);
+  if (!(*lru)->shared)
+    arena_free(&(*lru)->arena);
   linkmap_free(&(*lru)->lm);
+  twheel_free(&(*lru)->tw);
   free(*lru);
   *lru = NULL;
 }
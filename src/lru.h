@@ -4,9 +4,92 @@
 #include <stdint.h>
 
 typedef struct lru_s lru_t;
+struct arena_s;
 
 lru_t *lru_new(size_t size, size_t nmemb);
+
+/* Allocates an LRU cache that takes its pages from an arena it shares
+ * with other caches, each of which is free to use any of its pages.
+ *
+ * A miss takes a free page from the arena, and the cache only evicts
+ * a page of its own if there is none, so it is up to the owner of the
+ * arena to keep pages free, e.g. with lru_reclaim() on whichever
+ * cache should give one up. Keys need only be unique within a cache.
+ * lru_resize() fails, the arena being the owner's to resize, and
+ * lru_free() leaves the arena alone.
+ *
+ * Returns NULL if out of memory.
+ */
+lru_t *lru_new_shared(struct arena_s *arena);
+
 int lru_fetch(lru_t *lru, uint64_t key, void **ptr);
+
+/* Fetches a page that expires.
+ *
+ * now is the current time, in any unit as long as it never goes
+ * back, and ttl is how long the page lives if this fetch misses, 0
+ * meaning forever. Hits don't extend the life of a page. A page that
+ * has expired is a miss, and expired pages are reclaimed before the
+ * policy evicts any live page. lru_fetch() is lru_fetch_ttl() at the
+ * last time seen, with a ttl of 0.
+ *
+ * Returns 0 on hit
+ *         1 on miss
+ *         -1 if out of memory for expiry bookkeeping, or if a shared
+ *            arena is full and none of its pages are this cache's
+ */
+int lru_fetch_ttl(lru_t *lru, uint64_t key, uint64_t now, uint64_t ttl,
+                  void **ptr);
+
+/* Loads a page ahead of its first fetch, because the client is
+ * likely to want it soon, see seqdet.h.
+ *
+ * A page that is cached is left as it is. Otherwise a page is taken
+ * for key as on a miss, which the caller must fill, and it enters
+ * apart from the LRU order, among the other prefetched pages. A fetch
+ * makes it the MRU page. Prefetched pages that haven't been fetched
+ * are evicted before any other once they are more than a quarter of
+ * the cache, so that wrong guesses can't push out more than that.
+ *
+ * Returns 0 if key was cached
+ *         1 if a page was taken for it
+ *         -1 as lru_fetch_ttl()
+ */
+int lru_prefetch(lru_t *lru, uint64_t key, void **ptr);
+
+/* Drops the page holding key, e.g. because the data behind it has
+ * changed. The page is reused before the policy evicts another.
+ *
+ * Returns 0 on success
+ *         1 if key was not cached
+ */
+int lru_invalidate(lru_t *lru, uint64_t key);
+
+/* Evicts the page the policy would evict next, giving it back to the
+ * arena.
+ *
+ * Returns 0 on success
+ *         1 if the cache is empty
+ */
+int lru_reclaim(lru_t *lru);
+
+/* Returns the number of pages cached
+ */
+size_t lru_size(lru_t *lru);
+
+/* Resizes the cache to nmemb pages.
+ *
+ * Growing allocates the pages added and makes room for them in the
+ * table, without moving what is cached, and the table is rehashed a
+ * little on each fetch that follows. Shrinking evicts
+ * pages as the policy would until at most nmemb are left, then moves
+ * the pages beyond nmemb below it and frees the memory they were in,
+ * so pointers from earlier fetches may be invalid afterwards.
+ *
+ * Returns 0 on success
+ *         -1 if out of memory or if nmemb is too small for the policy
+ */
+int lru_resize(lru_t *lru, size_t nmemb);
 void lru_free(lru_t **lru);
 
 #endif
@@ -0,0 +1,480 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "htable.h"
+#include "linkmap.h"
+#include "swiss.h"
+#include "tracegen.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+/* Microbenchmarks for the data structures below the policies.
+ *
+ * Each benchmark exercises a single htable or linkmap operation in
+ * isolation, the htable ones with each index. Table capacity is
+ * chosen so that the structure's footprint lands in L1, L2, L3 or
+ * DRAM, the table is filled to a given load factor and keys are drawn
+ * from a sequential, uniform or Zipf distribution. A swiss table's
+ * load factor is the share of its slots that are taken, which goes up
+ * to SWISS_LOAD. Results are reported as ns/op and, if the kernel lets
+ * us open a hardware counter, cache misses per op.
+ *
+ * An optional filter argument restricts the run to benchmarks whose
+ * name contains the given substring, e.g. "linkmap_get/zipf".
+ */
+
+#define MIN_OPS (1 << 21)
+#define ZIPF_ALPHA 0.99
+#define SEED 0x5eed
+
+/* approximate footprint per entry: the record plus a bucket pointer,
+   or the entry and its tag at the load a cuckoo table is sized for */
+#define HTABLE_ENTRY_BYTES  32
+#define CUCKOO_ENTRY_BYTES  20
+#define LINKMAP_ENTRY_BYTES 48
+/* footprint per swiss slot: the entry and its control byte */
+#define SWISS_SLOT_BYTES    17
+
+enum dist { DIST_SEQ, DIST_UNIFORM, DIST_ZIPF };
+
+struct level_s {
+  const char *name;
+  size_t bytes;
+};
+
+struct level_s levels[] = {
+  {.name = "L1",   .bytes = 16 << 10},
+  {.name = "L2",   .bytes = 256 << 10},
+  {.name = "L3",   .bytes = 8 << 20},
+  {.name = "DRAM", .bytes = 128 << 20},
+};
+int num_levels = sizeof(levels) / sizeof(struct level_s);
+
+const char *dist_names[] = {"seq", "uniform", "zipf"};
+int num_dists = sizeof(dist_names) / sizeof(char *);
+
+int load_factors[] = {50, 90, 100};
+int num_load_factors = sizeof(load_factors) / sizeof(int);
+
+
+/* Wall clock time and (optionally) cache misses, accumulated over a
+ * number of start/stop intervals.
+ */
+struct meter_s {
+  int fd;
+  uint64_t ns;
+  uint64_t misses;
+  struct timespec start;
+};
+
+static void meter_init(struct meter_s *m) {
+#ifdef __linux__
+  struct perf_event_attr attr;
+
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = PERF_COUNT_HW_CACHE_MISSES;
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  m->fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+  m->fd = -1;
+#endif
+  m->ns = 0;
+  m->misses = 0;
+}
+
+static void meter_reset(struct meter_s *m) {
+  m->ns = 0;
+  m->misses = 0;
+}
+
+static void meter_start(struct meter_s *m) {
+#ifdef __linux__
+  if (m->fd >= 0) {
+    ioctl(m->fd, PERF_EVENT_IOC_RESET, 0);
+    ioctl(m->fd, PERF_EVENT_IOC_ENABLE, 0);
+  }
+#endif
+  clock_gettime(CLOCK_MONOTONIC, &m->start);
+}
+
+static void meter_stop(struct meter_s *m) {
+  struct timespec stop;
+  uint64_t count;
+
+  clock_gettime(CLOCK_MONOTONIC, &stop);
+#ifdef __linux__
+  if (m->fd >= 0) {
+    ioctl(m->fd, PERF_EVENT_IOC_DISABLE, 0);
+    if (read(m->fd, &count, sizeof(count)) == sizeof(count))
+      m->misses += count;
+  }
+#endif
+  m->ns += (stop.tv_sec - m->start.tv_sec) * 1000000000ULL +
+    stop.tv_nsec - m->start.tv_nsec;
+}
+
+
+/* Fills key[] with len keys in [0, n) drawn from distribution d
+ */
+static void gen_keys(uint64_t *key, size_t len, size_t n, enum dist d) {
+  struct tracegen_phase phase;
+  tracegen_t *tg;
+
+  memset(&phase, 0, sizeof(phase));
+  phase.n = n;
+  phase.len = len;
+  phase.alpha = ZIPF_ALPHA;
+  switch (d) {
+  case DIST_SEQ:
+    phase.kind = TRACEGEN_LOOP;
+    break;
+  case DIST_UNIFORM:
+    phase.kind = TRACEGEN_UNIFORM;
+    break;
+  case DIST_ZIPF:
+    phase.kind = TRACEGEN_ZIPF;
+    break;
+  }
+
+  tg = tracegen_new(&phase, 1, SEED);
+  tracegen_fill(tg, key, len);
+  tracegen_free(&tg);
+}
+
+
+/* A benchmark run gets a structure of the given capacity, holding (or
+ * about to hold) n keys, and a stream of len keys drawn from the
+ * distribution under test. It returns the number of operations
+ * measured by m.
+ */
+struct bm_args_s {
+  enum htable_index index;
+  size_t capacity;
+  size_t n;
+  uint64_t *key;
+  size_t len;
+  struct meter_s *m;
+};
+
+typedef size_t (*bm_fun)(struct bm_args_s *);
+
+static size_t bm_htable_set(struct bm_args_s *a) {
+  struct htable_opts opts = {.grow = 0, .index = a->index};
+  htable_t *t;
+  size_t i, ops;
+
+  t = htable_new_ex(a->capacity, &opts);
+  for (ops=0; ops<MIN_OPS; ops+=a->n) {
+    meter_start(a->m);
+    for (i=0; i<a->n; i++)
+      htable_set(t, a->key[i], (void *)a->key[i]);
+    meter_stop(a->m);
+    for (i=0; i<a->n; i++)
+      htable_del(t, a->key[i]);
+  }
+  htable_free(&t);
+
+  return ops;
+}
+
+static size_t bm_htable_set_grow(struct bm_args_s *a) {
+  struct htable_opts opts = {.grow = 1, .index = a->index};
+  htable_t *t;
+  size_t i, ops;
+
+  /* from a single entry up, rehashing as it goes */
+  for (ops=0; ops<MIN_OPS; ops+=a->n) {
+    t = htable_new_ex(1, &opts);
+    meter_start(a->m);
+    for (i=0; i<a->n; i++)
+      htable_set(t, a->key[i], (void *)a->key[i]);
+    meter_stop(a->m);
+    htable_free(&t);
+  }
+
+  return ops;
+}
+
+static htable_t *htable_filled(struct bm_args_s *a) {
+  struct htable_opts opts = {.grow = 0, .index = a->index};
+  htable_t *t;
+  size_t i;
+
+  t = htable_new_ex(a->capacity, &opts);
+  for (i=0; i<a->n; i++)
+    htable_set(t, i, (void *)i);
+
+  return t;
+}
+
+static size_t bm_htable_get(struct bm_args_s *a) {
+  htable_t *t;
+  void *val;
+  size_t i;
+
+  t = htable_filled(a);
+  meter_start(a->m);
+  for (i=0; i<a->len; i++)
+    htable_get(t, a->key[i], &val);
+  meter_stop(a->m);
+  htable_free(&t);
+
+  return a->len;
+}
+
+/* Looks up keys that were never set, as a cold cache does
+ */
+static size_t bm_htable_get_miss(struct bm_args_s *a) {
+  htable_t *t;
+  void *val;
+  size_t i;
+
+  t = htable_filled(a);
+  meter_start(a->m);
+  for (i=0; i<a->len; i++)
+    htable_get(t, ~a->key[i], &val);
+  meter_stop(a->m);
+  htable_free(&t);
+
+  return a->len;
+}
+
+static size_t bm_htable_pop(struct bm_args_s *a) {
+  htable_t *t;
+  void *val;
+  uint64_t *popped;
+  uint8_t *seen;
+  size_t i, npopped, ops;
+
+  /* the stream's distinct keys in the order they first come up, so
+     that every pop removes an entry */
+  popped = malloc(a->n * sizeof(uint64_t));
+  seen = calloc(a->n, 1);
+  npopped = 0;
+  for (i=0; i<a->n; i++)
+    if (!seen[a->key[i]]) {
+      seen[a->key[i]] = 1;
+      popped[npopped++] = a->key[i];
+    }
+  free(seen);
+
+  t = htable_filled(a);
+  for (ops=0; ops<MIN_OPS; ops+=npopped) {
+    meter_start(a->m);
+    for (i=0; i<npopped; i++)
+      htable_pop(t, popped[i], &val);
+    meter_stop(a->m);
+    for (i=0; i<npopped; i++)
+      htable_set(t, popped[i], (void *)popped[i]);
+  }
+  htable_free(&t);
+  free(popped);
+
+  return ops;
+}
+
+static size_t bm_linkmap_set(struct bm_args_s *a) {
+  linkmap_t *lm;
+  size_t i, ops;
+
+  lm = linkmap_new(a->capacity);
+  for (ops=0; ops<MIN_OPS; ops+=a->n) {
+    meter_start(a->m);
+    for (i=0; i<a->n; i++)
+      linkmap_set(lm, a->key[i], (void *)a->key[i]);
+    meter_stop(a->m);
+    for (i=0; i<a->n; i++)
+      linkmap_del(lm, a->key[i]);
+  }
+  linkmap_free(&lm);
+
+  return ops;
+}
+
+static size_t bm_linkmap_set_grow(struct bm_args_s *a) {
+  struct linkmap_opts opts = {.nlists = 1, .grow = 1};
+  linkmap_t *lm;
+  size_t i, ops;
+
+  for (ops=0; ops<MIN_OPS; ops+=a->n) {
+    lm = linkmap_new_ex(1, &opts);
+    meter_start(a->m);
+    for (i=0; i<a->n; i++)
+      linkmap_set(lm, a->key[i], (void *)a->key[i]);
+    meter_stop(a->m);
+    linkmap_free(&lm);
+  }
+
+  return ops;
+}
+
+static size_t bm_linkmap_get(struct bm_args_s *a) {
+  linkmap_t *lm;
+  void *val;
+  size_t i;
+
+  lm = linkmap_new(a->capacity);
+  for (i=0; i<a->n; i++)
+    linkmap_set(lm, i, (void *)i);
+  meter_start(a->m);
+  for (i=0; i<a->len; i++)
+    linkmap_get(lm, a->key[i], &val);
+  meter_stop(a->m);
+  linkmap_free(&lm);
+
+  return a->len;
+}
+
+static size_t bm_linkmap_pop_tail(struct bm_args_s *a) {
+  linkmap_t *lm;
+  uint64_t key;
+  void *val;
+  size_t i, n, ops;
+
+  /* the key stream determines list order, and its repeats how many
+     entries there are to pop, so only those are timed */
+  lm = linkmap_new(a->capacity);
+  for (ops=0; ops<MIN_OPS; ops+=n) {
+    for (i=0; i<a->n; i++)
+      linkmap_set(lm, a->key[i], (void *)a->key[i]);
+    n = linkmap_size(lm);
+    meter_start(a->m);
+    for (i=0; i<n; i++)
+      linkmap_pop_tail(lm, &key, &val);
+    meter_stop(a->m);
+  }
+  linkmap_free(&lm);
+
+  return ops;
+}
+
+struct benchmark_s {
+  const char *name;
+  bm_fun f;
+  size_t entry_bytes;
+  /* instead, for tables loaded by the slot, the footprint per slot,
+     of which they get the largest power of 2 that fits the level */
+  size_t slot_bytes;
+  enum htable_index index;
+};
+
+struct benchmark_s benchmarks[] = {
+  {.name = "htable_set",       .f = bm_htable_set,
+   .entry_bytes = HTABLE_ENTRY_BYTES},
+  {.name = "htable_set_grow",  .f = bm_htable_set_grow,
+   .entry_bytes = HTABLE_ENTRY_BYTES},
+  {.name = "htable_get",       .f = bm_htable_get,
+   .entry_bytes = HTABLE_ENTRY_BYTES},
+  {.name = "htable_get_miss",  .f = bm_htable_get_miss,
+   .entry_bytes = HTABLE_ENTRY_BYTES},
+  {.name = "htable_pop",       .f = bm_htable_pop,
+   .entry_bytes = HTABLE_ENTRY_BYTES},
+  {.name = "cuckoo_set",       .f = bm_htable_set,
+   .entry_bytes = CUCKOO_ENTRY_BYTES, .index = HTABLE_CUCKOO},
+  {.name = "cuckoo_set_grow",  .f = bm_htable_set_grow,
+   .entry_bytes = CUCKOO_ENTRY_BYTES, .index = HTABLE_CUCKOO},
+  {.name = "cuckoo_get",       .f = bm_htable_get,
+   .entry_bytes = CUCKOO_ENTRY_BYTES, .index = HTABLE_CUCKOO},
+  {.name = "cuckoo_get_miss",  .f = bm_htable_get_miss,
+   .entry_bytes = CUCKOO_ENTRY_BYTES, .index = HTABLE_CUCKOO},
+  {.name = "cuckoo_pop",       .f = bm_htable_pop,
+   .entry_bytes = CUCKOO_ENTRY_BYTES, .index = HTABLE_CUCKOO},
+  {.name = "swiss_set",        .f = bm_htable_set,
+   .slot_bytes = SWISS_SLOT_BYTES, .index = HTABLE_SWISS},
+  {.name = "swiss_set_grow",   .f = bm_htable_set_grow,
+   .slot_bytes = SWISS_SLOT_BYTES, .index = HTABLE_SWISS},
+  {.name = "swiss_get",        .f = bm_htable_get,
+   .slot_bytes = SWISS_SLOT_BYTES, .index = HTABLE_SWISS},
+  {.name = "swiss_get_miss",   .f = bm_htable_get_miss,
+   .slot_bytes = SWISS_SLOT_BYTES, .index = HTABLE_SWISS},
+  {.name = "swiss_pop",        .f = bm_htable_pop,
+   .slot_bytes = SWISS_SLOT_BYTES, .index = HTABLE_SWISS},
+  {.name = "linkmap_set",      .f = bm_linkmap_set,
+   .entry_bytes = LINKMAP_ENTRY_BYTES},
+  {.name = "linkmap_set_grow", .f = bm_linkmap_set_grow,
+   .entry_bytes = LINKMAP_ENTRY_BYTES},
+  {.name = "linkmap_get",      .f = bm_linkmap_get,
+   .entry_bytes = LINKMAP_ENTRY_BYTES},
+  {.name = "linkmap_pop_tail", .f = bm_linkmap_pop_tail,
+   .entry_bytes = LINKMAP_ENTRY_BYTES},
+};
+int num_benchmarks = sizeof(benchmarks) / sizeof(struct benchmark_s);
+
+void usage_fail(char *prog) {
+  fprintf(stderr, "Usage: %s [filter]\n", prog);
+  exit(1);
+}
+
+int main(int argc, char *argv[]) {
+  struct meter_s m;
+  struct bm_args_s a;
+  char name[128];
+  uint64_t *key;
+  size_t ops, len, slots;
+  int b, l, d, lf;
+
+  if (argc > 2)
+    usage_fail(argv[0]);
+
+  meter_init(&m);
+
+  printf("%-40s %10s %10s %12s\n", "benchmark", "ns/op", "misses/op", "ops");
+  for (b=0; b<num_benchmarks; b++)
+    for (l=0; l<num_levels; l++)
+      for (lf=0; lf<num_load_factors; lf++)
+        for (d=0; d<num_dists; d++) {
+          snprintf(name, sizeof(name), "%s/%s/lf%d/%s", benchmarks[b].name,
+                   dist_names[d], load_factors[lf], levels[l].name);
+          if (argc == 2 && !strstr(name, argv[1]))
+            continue;
+
+          a.index = benchmarks[b].index;
+          if (benchmarks[b].slot_bytes) {
+            if (load_factors[lf] > SWISS_LOAD)
+              continue;
+            for (slots=1; slots * 2 * benchmarks[b].slot_bytes <=
+                   levels[l].bytes; slots*=2);
+            a.n = slots * load_factors[lf] / 100;
+            a.capacity = a.n;
+          } else {
+            a.capacity = levels[l].bytes / benchmarks[b].entry_bytes;
+            a.n = a.capacity * load_factors[lf] / 100;
+          }
+          len = a.n > MIN_OPS ? a.n : MIN_OPS;
+          key = malloc(len * sizeof(uint64_t));
+          if (!key) {
+            printf("%-40s out of memory\n", name);
+            continue;
+          }
+          gen_keys(key, len, a.n, d);
+          a.key = key;
+          a.len = len;
+          a.m = &m;
+
+          meter_reset(&m);
+          ops = benchmarks[b].f(&a);
+
+          printf("%-40s %10.2f ", name, (double)m.ns / ops);
+          if (m.fd >= 0)
+            printf("%10.3f ", (double)m.misses / ops);
+          else
+            printf("%10s ", "-");
+          printf("%12zu\n", ops);
+          fflush(stdout);
+
+          free(key);
+        }
+
+  return 0;
+}
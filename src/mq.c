@@ -0,0 +1,285 @@
+#include <stdlib.h>
+#include <assert.h>
+#include "arena.h"
+#include "linkmap.h"
+#include "twheel.h"
+#include "mq.h"
+
+#include <stdio.h>
+
+#define MAX(a,b) ((a) > (b) ? (a) : (b))
+
+#define DEFAULT_QUEUES 8
+#define MAX_QUEUES 32
+
+/* Multi-Queue (Zhou, Philbin and Li, USENIX ATC '01).
+ *
+ * Pages are kept in several LRU queues according to how often they
+ * have been referenced, and drift down the queues when they go
+ * unreferenced for a while. Victims are taken from the lowest queue.
+ * The queues are lists of one linkmap, mapping keys to page slots in
+ * the arena, the history is a linkmap of reference counts kept in
+ * FIFO order.
+ */
+
+struct mq_page {
+  uint64_t expire;
+  uint32_t freq;
+};
+
+struct mq_s {
+  linkmap_t *lm;
+  linkmap_t *out;
+  struct mq_page *page;
+  arena_t *arena;
+  /* counts fetches, while time is what pages expire by, and the wheel
+     is only set up once pages start expiring */
+  uint64_t now;
+  uint64_t time;
+  twheel_t *tw;
+  size_t lifetime;
+  size_t history;
+  int queues;
+  size_t nmemb;
+};
+
+mq_t *mq_new(size_t size, size_t nmemb) {
+  struct mq_opts opts = {.queues = 0, .lifetime = 0, .history = 0};
+
+  return mq_new_ex(size, nmemb, &opts);
+}
+
+mq_t *mq_new_ex(size_t size, size_t nmemb, const struct mq_opts *opts) {
+  mq_t *mq;
+
+  assert(nmemb >= 2);
+
+  if (opts->queues < 0 || opts->queues > MAX_QUEUES)
+    return NULL;
+
+  mq = calloc(1, sizeof(mq_t));
+  if (!mq)
+    return NULL;
+
+  mq->queues = opts->queues ? opts->queues : DEFAULT_QUEUES;
+  mq->lifetime = opts->lifetime ? opts->lifetime : nmemb;
+  mq->history = opts->history ? opts->history : 4 * nmemb;
+  mq->nmemb = nmemb;
+  mq->now = 0;
+
+  mq->lm = linkmap_new_lists(nmemb, mq->queues);
+  mq->out = linkmap_new(mq->history);
+  mq->page = malloc(nmemb * sizeof(struct mq_page));
+  mq->arena = arena_new(size, nmemb);
+  if (!mq->lm || !mq->out || !mq->page || !mq->arena) {
+    mq_free(&mq);
+    return NULL;
+  }
+
+  return mq;
+}
+
+/* Returns the queue for a page referenced freq times
+ */
+static int mq_queue(mq_t *mq, uint32_t freq) {
+  int q;
+
+  for (q=0; freq > 1 && q < mq->queues - 1; q++)
+    freq >>= 1;
+
+  return q;
+}
+
+
+/* Demotes the LRU page of each queue if it has expired
+ */
+static void mq_adjust(mq_t *mq) {
+  struct mq_page *page;
+  uint64_t k;
+  void *v;
+  int q;
+
+  for (q=1; q<mq->queues; q++) {
+    if (linkmap_get_tail_in(mq->lm, q, &k, &v))
+      continue;
+    page = mq->page + (uintptr_t)v;
+    if (page->expire < mq->now) {
+      linkmap_move(mq->lm, k, q - 1, NULL, NULL);
+      page->expire = mq->now + mq->lifetime;
+    }
+  }
+}
+
+/* Sets when the page in slot expires, if pages expire at all
+ */
+static void mq_expire(mq_t *mq, size_t slot, uint64_t ttl) {
+  if (!mq->tw)
+    return;
+  if (ttl)
+    twheel_set(mq->tw, slot, mq->time + ttl);
+  else
+    twheel_del(mq->tw, slot);
+}
+
+/* Removes the page in slot from the cache
+ */
+static void mq_drop(mq_t *mq, size_t slot) {
+  linkmap_del(mq->lm, arena_key(mq->arena, slot));
+  if (mq->tw)
+    twheel_del(mq->tw, slot);
+  arena_release(mq->arena, slot);
+}
+
+/* Frees a page, an expired one if any, and otherwise evicts the LRU
+ * page of the lowest non-empty queue, remembering its reference count
+ */
+static void mq_evict(mq_t *mq) {
+  uint64_t k;
+  void *v;
+  size_t slot;
+  int q;
+
+  if (mq->tw && !twheel_pop(mq->tw, mq->time, &slot)) {
+    mq_drop(mq, slot);
+    return;
+  }
+
+  for (q=0; linkmap_get_tail_in(mq->lm, q, &k, &v); q++)
+    ;
+  if (linkmap_size(mq->out) >= mq->history)
+    linkmap_del_tail(mq->out);
+  linkmap_set(mq->out, k, (void *)(uintptr_t)mq->page[(uintptr_t)v].freq);
+  mq_drop(mq, (uintptr_t)v);
+}
+
+int mq_fetch(mq_t *mq, uint64_t key, void **ptr) {
+  return mq_fetch_ttl(mq, key, mq->time, 0, ptr);
+}
+
+int mq_fetch_ttl(mq_t *mq, uint64_t key, uint64_t now, uint64_t ttl,
+                 void **ptr) {
+  struct mq_page *page;
+  void *val, *freq;
+  size_t slot;
+
+  if (ttl && !mq->tw) {
+    mq->tw = twheel_new(mq->nmemb, mq->time);
+    if (!mq->tw)
+      return -1;
+  }
+  if (now > mq->time)
+    mq->time = now;
+
+  mq->now++;
+
+  if (!linkmap_get(mq->lm, key, &val)) {
+    slot = (uintptr_t)val;
+    page = mq->page + slot;
+
+    /* an expired page starts over with a single reference */
+    if (mq->tw && twheel_expired(mq->tw, slot, mq->time)) {
+      page->freq = 1;
+      page->expire = mq->now + mq->lifetime;
+      linkmap_move(mq->lm, key, 0, NULL, NULL);
+      mq_expire(mq, slot, ttl);
+      mq_adjust(mq);
+      *ptr = arena_page(mq->arena, slot);
+      return 1;
+    }
+
+    if (page->freq < UINT32_MAX)
+      page->freq++;
+    page->expire = mq->now + mq->lifetime;
+    linkmap_move(mq->lm, key, mq_queue(mq, page->freq), NULL, NULL);
+    mq_adjust(mq);
+    *ptr = arena_page(mq->arena, (uintptr_t)val);
+    return 0;
+  }
+
+  /* take a free page if possible, evict otherwise */
+  if (arena_alloc(mq->arena, key, &slot)) {
+    mq_evict(mq);
+    arena_alloc(mq->arena, key, &slot);
+  }
+
+  page = mq->page + slot;
+  page->freq = 1;
+  if (!linkmap_pop(mq->out, key, &freq))
+    page->freq += (uintptr_t)freq;
+  page->expire = mq->now + mq->lifetime;
+  linkmap_set_in(mq->lm, mq_queue(mq, page->freq), key,
+                 (void *)(uintptr_t)slot);
+  mq_expire(mq, slot, ttl);
+  mq_adjust(mq);
+
+  *ptr = arena_page(mq->arena, slot);
+  return 1;
+}
+
+int mq_invalidate(mq_t *mq, uint64_t key) {
+  void *val;
+
+  if (linkmap_get(mq->lm, key, &val))
+    return 1;
+
+  mq_drop(mq, (uintptr_t)val);
+  return 0;
+}
+
+/* Follows a page the arena moved while shrinking
+ */
+static void mq_move(void *ctx, size_t from, size_t to) {
+  mq_t *mq = ctx;
+
+  linkmap_set(mq->lm, arena_key(mq->arena, to), (void *)(uintptr_t)to);
+  mq->page[to] = mq->page[from];
+  if (mq->tw)
+    twheel_move(mq->tw, from, to);
+}
+
+int mq_resize(mq_t *mq, size_t nmemb) {
+  struct mq_page *page;
+  size_t lifetime, history;
+
+  if (nmemb < 2)
+    return -1;
+
+  /* the lifetime and the history keep their proportion to the cache */
+  lifetime = MAX(1, mq->lifetime * nmemb / mq->nmemb);
+  history = MAX(1, mq->history * nmemb / mq->nmemb);
+
+  if (nmemb > mq->nmemb) {
+    page = realloc(mq->page, nmemb * sizeof(struct mq_page));
+    if (!page)
+      return -1;
+    mq->page = page;
+    if ((mq->tw && twheel_resize(mq->tw, nmemb)) ||
+        linkmap_grow(mq->out, history) ||
+        linkmap_grow(mq->lm, nmemb) ||
+        arena_resize(mq->arena, nmemb, NULL, NULL))
+      return -1;
+  } else {
+    while (arena_used(mq->arena) > nmemb)
+      mq_evict(mq);
+    arena_resize(mq->arena, nmemb, mq_move, mq);
+    if (mq->tw)
+      twheel_resize(mq->tw, nmemb);
+    while (linkmap_size(mq->out) > history)
+      linkmap_del_tail(mq->out);
+  }
+
+  mq->lifetime = lifetime;
+  mq->history = history;
+  mq->nmemb = nmemb;
+  return 0;
+}
+
+void mq_free(mq_t **mq) {
+  arena_free(&(*mq)->arena);
+  free((*mq)->page);
+  linkmap_free(&(*mq)->lm);
+  linkmap_free(&(*mq)->out);
+  twheel_free(&(*mq)->tw);
+  free(*mq);
+  *mq = NULL;
+}
@@ -0,0 +1,38 @@
+#ifndef MQ_H_5e8a2d41c7b94f03a6d1e9b72f4c8a05
+#define MQ_H_5e8a2d41c7b94f03a6d1e9b72f4c8a05
+
+#include <stdint.h>
+
+typedef struct mq_s mq_t;
+
+/* Options for mq_new_ex().
+ *
+ * queues is the number of LRU queues, a page with f references living
+ * in queue log2(f). A page that hasn't been referenced for lifetime
+ * accesses is demoted one queue down. history is the number of evicted
+ * keys whose reference counts are remembered. 0 means the defaults of
+ * 8 queues, a lifetime of nmemb and a history of 4*nmemb.
+ */
+struct mq_opts {
+  int queues;
+  size_t lifetime;
+  size_t history;
+};
+
+mq_t *mq_new(size_t size, size_t nmemb);
+mq_t *mq_new_ex(size_t size, size_t nmemb, const struct mq_opts *opts);
+int mq_fetch(mq_t *mq, uint64_t key, void **ptr);
+
+/* Same as lru_fetch_ttl(), see lru.h. An expired page starts over in
+ * the lowest queue, its references forgotten.
+ */
+int mq_fetch_ttl(mq_t *mq, uint64_t key, uint64_t now, uint64_t ttl,
+                 void **ptr);
+
+/* Same as lru_invalidate() and lru_resize(), see lru.h
+ */
+int mq_invalidate(mq_t *mq, uint64_t key);
+int mq_resize(mq_t *mq, size_t nmemb);
+void mq_free(mq_t **mq);
+
+#endif
@@ -0,0 +1,269 @@
+#include <stdlib.h>
+#include <assert.h>
+#include "htable.h"
+#include "opt.h"
+
+#include <stdio.h>
+
+#define NEVER UINT32_MAX
+#define LAST_INITIAL_SIZE 1024
+
+/* Pages are kept in a max heap ordered by next use, each page knowing
+ * its position in it, so a hit can move its page in O(log nmemb).
+ */
+struct opt_page {
+  uint64_t key;
+  uint32_t next;
+  size_t pos;
+  void *data;
+};
+
+struct opt_s {
+  const uint64_t *key;
+  uint32_t *next;
+  size_t len;
+  size_t i;
+  struct opt_page *page;
+  struct opt_page **heap;
+  htable_t *t;
+  size_t size;
+  size_t nmemb;
+  size_t active;
+  void *data;
+};
+
+/* Open addressing table from key to the index of its last seen
+ * occurrence, used for the backward pass. It grows to stay at most
+ * half full.
+ */
+struct last_s {
+  uint64_t *key;
+  uint32_t *idx;
+  size_t mask;
+  size_t used;
+};
+
+static size_t last_hash(uint64_t key, size_t mask) {
+  return (key * 0x9e3779b97f4a7c15ULL >> 17) & mask;
+}
+
+static int last_init(struct last_s *l, size_t size) {
+  size_t i;
+
+  l->key = malloc(size * sizeof(uint64_t));
+  l->idx = malloc(size * sizeof(uint32_t));
+  if (!l->key || !l->idx) {
+    free(l->key);
+    free(l->idx);
+    return 1;
+  }
+  for (i=0; i<size; i++)
+    l->idx[i] = NEVER;
+  l->mask = size - 1;
+  l->used = 0;
+
+  return 0;
+}
+
+/* Returns the slot for key, which is empty if key isn't there
+ */
+static size_t last_find(struct last_s *l, uint64_t key) {
+  size_t h;
+
+  for (h = last_hash(key, l->mask); l->idx[h] != NEVER;
+       h = (h + 1) & l->mask)
+    if (l->key[h] == key)
+      break;
+
+  return h;
+}
+
+static int last_grow(struct last_s *l) {
+  struct last_s g;
+  size_t i, h;
+
+  if (last_init(&g, 2 * (l->mask + 1)))
+    return 1;
+
+  for (i=0; i<=l->mask; i++)
+    if (l->idx[i] != NEVER) {
+      h = last_find(&g, l->key[i]);
+      g.key[h] = l->key[i];
+      g.idx[h] = l->idx[i];
+    }
+  g.used = l->used;
+
+  free(l->key);
+  free(l->idx);
+  *l = g;
+
+  return 0;
+}
+
+/* Fills next[] with the index of the following occurrence of each
+ * key, NEVER if there is none, in a single backward pass
+ */
+static int next_uses(const uint64_t *key, size_t len, uint32_t *next) {
+  struct last_s l;
+  size_t i, h;
+
+  if (last_init(&l, LAST_INITIAL_SIZE))
+    return 1;
+
+  for (i=len; i-- > 0; ) {
+    h = last_find(&l, key[i]);
+    if (l.idx[h] == NEVER) {
+      if (2 * (l.used + 1) > l.mask + 1) {
+        if (last_grow(&l))
+          goto fail;
+        h = last_find(&l, key[i]);
+      }
+      l.key[h] = key[i];
+      l.used++;
+    }
+    next[i] = l.idx[h];
+    l.idx[h] = i;
+  }
+
+  free(l.key);
+  free(l.idx);
+  return 0;
+
+ fail:
+  free(l.key);
+  free(l.idx);
+  return 1;
+}
+
+opt_t *opt_new(size_t size, size_t nmemb, const uint64_t *key, size_t len) {
+  opt_t *opt;
+
+  assert(nmemb >= 1);
+
+  if (len >= NEVER)
+    return NULL;
+
+  opt = calloc(1, sizeof(opt_t));
+  if (!opt) goto fail;
+
+  opt->key = key;
+  opt->len = len;
+  opt->i = 0;
+  opt->size = size;
+  opt->nmemb = nmemb;
+  opt->active = 0;
+
+  opt->next = malloc((len ? len : 1) * sizeof(uint32_t));
+  if (!opt->next) goto fail_next;
+  if (next_uses(key, len, opt->next)) goto fail_page;
+
+  opt->page = malloc(nmemb * sizeof(struct opt_page));
+  if (!opt->page) goto fail_page;
+
+  opt->heap = malloc(nmemb * sizeof(struct opt_page *));
+  if (!opt->heap) goto fail_heap;
+
+  opt->data = malloc(nmemb * size);
+  if (!opt->data) goto fail_data;
+
+  opt->t = htable_new(nmemb);
+  if (!opt->t) goto fail_htable;
+
+  return opt;
+
+ fail_htable:
+  free(opt->data);
+ fail_data:
+  free(opt->heap);
+ fail_heap:
+  free(opt->page);
+ fail_page:
+  free(opt->next);
+ fail_next:
+  free(opt);
+ fail:
+  return NULL;
+}
+
+static void heap_place(opt_t *opt, struct opt_page *page, size_t pos) {
+  opt->heap[pos] = page;
+  page->pos = pos;
+}
+
+static void sift_up(opt_t *opt, struct opt_page *page) {
+  size_t pos = page->pos, parent;
+
+  while (pos > 0) {
+    parent = (pos - 1) / 2;
+    if (opt->heap[parent]->next >= page->next)
+      break;
+    heap_place(opt, opt->heap[parent], pos);
+    pos = parent;
+  }
+  heap_place(opt, page, pos);
+}
+
+static void sift_down(opt_t *opt, struct opt_page *page) {
+  size_t pos = page->pos, child;
+
+  while ((child = 2 * pos + 1) < opt->active) {
+    if (child + 1 < opt->active &&
+        opt->heap[child + 1]->next > opt->heap[child]->next)
+      child++;
+    if (opt->heap[child]->next <= page->next)
+      break;
+    heap_place(opt, opt->heap[child], pos);
+    pos = child;
+  }
+  heap_place(opt, page, pos);
+}
+
+int opt_fetch(opt_t *opt, uint64_t key, void **ptr) {
+  struct opt_page *page;
+  uint32_t next;
+
+  if (opt->i >= opt->len || opt->key[opt->i] != key)
+    return -1;
+  next = opt->next[opt->i++];
+
+  /* on a hit the page's next use moves from now, the nearest
+     possible, to later */
+  if (!htable_get(opt->t, key, (void **)&page)) {
+    page->next = next;
+    sift_up(opt, page);
+    *ptr = page->data;
+    return 0;
+  }
+
+  if (opt->active < opt->nmemb) {
+    page = opt->page + opt->active;
+    page->data = opt->data + opt->active * opt->size;
+    page->pos = opt->active++;
+    page->key = key;
+    page->next = next;
+    htable_set(opt->t, key, page);
+    sift_up(opt, page);
+    *ptr = page->data;
+    return 1;
+  }
+
+  /* evict the root, needed farthest in the future */
+  page = opt->heap[0];
+  htable_del(opt->t, page->key);
+  htable_set(opt->t, key, page);
+  page->key = key;
+  page->next = next;
+  sift_down(opt, page);
+  *ptr = page->data;
+  return 1;
+}
+
+void opt_free(opt_t **opt) {
+  free((*opt)->data);
+  free((*opt)->heap);
+  free((*opt)->page);
+  free((*opt)->next);
+  htable_free(&(*opt)->t);
+  free(*opt);
+  *opt = NULL;
+}
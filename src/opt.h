@@ -0,0 +1,34 @@
+#ifndef OPT_H_a41c7e9d3b5f4a2e8d6c0b1f9e7a3c58
+#define OPT_H_a41c7e9d3b5f4a2e8d6c0b1f9e7a3c58
+
+/* Belady's MIN, the optimal offline policy.
+ *
+ * OPT needs to know the future, so it is given the whole trace up
+ * front and must then be fetched exactly the keys of the trace, in
+ * order. It is meant as an upper bound in bench, not as a cache.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef struct opt_s opt_t;
+
+/* Allocates an OPT cache for the len keys at key[], which must stay
+ * valid until opt_free(). Next uses are precomputed here in O(len).
+ *
+ * Returns NULL if out of memory or if len >= 2^32-1.
+ */
+opt_t *opt_new(size_t size, size_t nmemb, const uint64_t *key, size_t len);
+
+/* Fetches the next key of the trace, evicting the page whose next
+ * use is farthest away.
+ *
+ * Returns 0 on hit
+ *         1 on miss
+ *         -1 if key isn't the next key of the trace
+ */
+int opt_fetch(opt_t *opt, uint64_t key, void **ptr);
+
+void opt_free(opt_t **opt);
+
+#endif
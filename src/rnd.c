@@ -1,81 +1,253 @@
 #include <stdlib.h>
+#include "arena.h"
 #include "htable.h"
+#include "rng.h"
+#include "twheel.h"
 #include "rnd.h"
 
-struct rnd_page {
-  uint64_t key;
-  void *data;
-};
+#define DEFAULT_SEED 1
 
+/* The table maps keys to page slots in the arena. used[] holds the
+   time of last access for RND_SAMPLE_LRU and the number of accesses
+   for RND_SAMPLE_LFU, per slot. */
 struct rnd_s {
-  size_t size;
   size_t nmemb;
-  size_t active;
   htable_t *t;
-  struct rnd_page *page;
-  void *data;
+  arena_t *arena;
+  uint32_t *used;
+  rng_t rng;
+  int samples;
+  enum rnd_sample sample;
+  uint32_t now;
+  twheel_t *tw;
+  uint64_t time;
 };
 
 rnd_t *rnd_new(size_t size, size_t nmemb) {
+  struct rnd_opts opts = {.seed = DEFAULT_SEED, .samples = 1,
+                          .index = HTABLE_CHAINED};
+
+  return rnd_new_ex(size, nmemb, &opts);
+}
+
+rnd_t *rnd_new_ex(size_t size, size_t nmemb, const struct rnd_opts *opts) {
+  struct htable_opts topts = {.grow = 0, .index = opts->index};
   rnd_t *r;
 
   r = malloc(sizeof(rnd_t));
   if (!r) goto fail;
 
-  r->page = malloc(nmemb * sizeof(struct rnd_page));
-  if (!r->page) goto fail_page;
+  r->used = malloc(nmemb * sizeof(uint32_t));
+  if (!r->used) goto fail_used;
 
-  r->data = malloc(nmemb * size);
-  if (!r->data) goto fail_data;
+  r->arena = arena_new(size, nmemb);
+  if (!r->arena) goto fail_arena;
 
-  r->t = htable_new(nmemb);
+  r->t = htable_new_ex(nmemb, &topts);
   if (!r->t) goto fail_htable;
 
-  r->size = size;
   r->nmemb = nmemb;
-  r->active = 0;
+  rng_seed(&r->rng, opts->seed);
+  r->samples = opts->samples;
+  r->sample = opts->sample;
+  r->now = 0;
+  r->tw = NULL;
+  r->time = 0;
 
   return r;
 
  fail_htable:
-  free(r->data);
- fail_data:
-  free(r->page);
- fail_page:
+  arena_free(&r->arena);
+ fail_arena:
+  free(r->used);
+ fail_used:
   free(r);
  fail:
   return NULL;
 }
 
+/* Returns true if slot a is a better eviction candidate than b
+ */
+static int rnd_better(rnd_t *rnd, size_t a, size_t b) {
+  if (rnd->sample == RND_SAMPLE_LFU)
+    return rnd->used[a] < rnd->used[b];
+  /* unsigned difference is the age, even when now has wrapped */
+  return (uint32_t)(rnd->now - rnd->used[a]) >
+    (uint32_t)(rnd->now - rnd->used[b]);
+}
+
+/* Marks slot as used, one way or another
+ */
+static void rnd_touch(rnd_t *rnd, size_t slot) {
+  if (rnd->sample == RND_SAMPLE_LFU) {
+    if (rnd->used[slot] < UINT32_MAX)
+      rnd->used[slot]++;
+  } else
+    rnd->used[slot] = rnd->now;
+}
+
+/* Returns a random page in use. Free pages can only be there while
+ * shrinking, and are passed over.
+ */
+static size_t rnd_pick(rnd_t *rnd) {
+  size_t slot;
+
+  do
+    slot = rng_range(&rnd->rng, rnd->nmemb);
+  while (!arena_in_use(rnd->arena, slot));
+
+  return slot;
+}
+
+static size_t rnd_victim(rnd_t *rnd) {
+  size_t slot, cand;
+  int i;
+
+  slot = rnd_pick(rnd);
+  for (i=1; i<rnd->samples; i++) {
+    cand = rnd_pick(rnd);
+    if (rnd_better(rnd, cand, slot))
+      slot = cand;
+  }
+
+  return slot;
+}
+
+/* Sets when the page in slot expires, if pages expire at all
+ */
+static void rnd_expire(rnd_t *rnd, size_t slot, uint64_t ttl) {
+  if (!rnd->tw)
+    return;
+  if (ttl)
+    twheel_set(rnd->tw, slot, rnd->time + ttl);
+  else
+    twheel_del(rnd->tw, slot);
+}
+
+/* Removes the page in slot from the cache
+ */
+static void rnd_drop(rnd_t *rnd, size_t slot) {
+  htable_del(rnd->t, arena_key(rnd->arena, slot));
+  if (rnd->tw)
+    twheel_del(rnd->tw, slot);
+  arena_release(rnd->arena, slot);
+}
+
+/* Frees a page, an expired one if any and a random one otherwise
+ */
+static void rnd_evict(rnd_t *rnd) {
+  size_t slot;
+
+  if (!rnd->tw || twheel_pop(rnd->tw, rnd->time, &slot))
+    slot = rnd_victim(rnd);
+  rnd_drop(rnd, slot);
+}
+
 int rnd_fetch(rnd_t *rnd, uint64_t key, void **ptr) {
-  struct rnd_page *page;
+  return rnd_fetch_ttl(rnd, key, rnd->time, 0, ptr);
+}
+
+int rnd_fetch_ttl(rnd_t *rnd, uint64_t key, uint64_t now, uint64_t ttl,
+                  void **ptr) {
+  void *val;
+  size_t slot;
+
+  /* now is the caller's clock for expiry, while rnd->now counts
+     fetches for sampled LRU */
+  if (ttl && !rnd->tw) {
+    rnd->tw = twheel_new(rnd->nmemb, rnd->time);
+    if (!rnd->tw)
+      return -1;
+  }
+  if (now > rnd->time)
+    rnd->time = now;
+
+  rnd->now++;
 
-  if (!htable_get(rnd->t, key, (void **)&page)) {
-    *ptr = page->data;
+  if (!htable_get(rnd->t, key, &val)) {
+    slot = (uintptr_t)val;
+    *ptr = arena_page(rnd->arena, slot);
+    if (rnd->tw && twheel_expired(rnd->tw, slot, rnd->time)) {
+      rnd->used[slot] = 0;
+      rnd_touch(rnd, slot);
+      rnd_expire(rnd, slot, ttl);
+      return 1;
+    }
+
+    if (rnd->samples > 1)
+      rnd_touch(rnd, slot);
     return 0;
   }
 
-  if (rnd->active < rnd->nmemb) {
-    page = rnd->page + rnd->active;
-    page->data = rnd->data + rnd->active * rnd->size;
-    page->key = key;
-    htable_set(rnd->t, key, (void *)page);
-    rnd->active++;
-    *ptr = page->data;
-    return 1;
+  /* expired pages are reclaimed before random ones */
+  if (arena_alloc(rnd->arena, key, &slot)) {
+    rnd_evict(rnd);
+    arena_alloc(rnd->arena, key, &slot);
   }
 
-  page = rnd->page + (random() % rnd->nmemb);
-  htable_del(rnd->t, page->key);
-  htable_set(rnd->t, key, page);
-  page->key = key;
-  *ptr = page->data;
+  htable_set(rnd->t, key, (void *)(uintptr_t)slot);
+  rnd->used[slot] = 0;
+  rnd_touch(rnd, slot);
+  rnd_expire(rnd, slot, ttl);
+  *ptr = arena_page(rnd->arena, slot);
   return 1;
 }
 
+int rnd_invalidate(rnd_t *rnd, uint64_t key) {
+  void *val;
+
+  if (htable_get(rnd->t, key, &val))
+    return 1;
+
+  rnd_drop(rnd, (uintptr_t)val);
+  return 0;
+}
+
+/* Follows a page the arena moved while shrinking
+ */
+static void rnd_move(void *ctx, size_t from, size_t to) {
+  rnd_t *rnd = ctx;
+  uint64_t key = arena_key(rnd->arena, to);
+
+  htable_del(rnd->t, key);
+  htable_set(rnd->t, key, (void *)(uintptr_t)to);
+  rnd->used[to] = rnd->used[from];
+  if (rnd->tw)
+    twheel_move(rnd->tw, from, to);
+}
+
+int rnd_resize(rnd_t *rnd, size_t nmemb) {
+  uint32_t *used;
+
+  if (nmemb < 1)
+    return -1;
+
+  if (nmemb > rnd->nmemb) {
+    used = realloc(rnd->used, nmemb * sizeof(uint32_t));
+    if (!used)
+      return -1;
+    rnd->used = used;
+    if ((rnd->tw && twheel_resize(rnd->tw, nmemb)) ||
+        htable_grow(rnd->t, nmemb) ||
+        arena_resize(rnd->arena, nmemb, NULL, NULL))
+      return -1;
+  } else {
+    while (arena_used(rnd->arena) > nmemb)
+      rnd_evict(rnd);
+    arena_resize(rnd->arena, nmemb, rnd_move, rnd);
+    if (rnd->tw)
+      twheel_resize(rnd->tw, nmemb);
+  }
+
+  rnd->nmemb = nmemb;
+  return 0;
+}
+
 void rnd_free(rnd_t **rnd) {
-  free((*rnd)->page);
+  arena_free(&(*rnd)->arena);
+  free((*rnd)->used);
   htable_free(&(*rnd)->t);
+  twheel_free(&(*rnd)->tw);
   free(*rnd);
   *rnd = NULL;
 }
@@ -2,11 +2,44 @@
 #define RND_H_c97b0748be1dee4c84cc90a0ffce5142
 
 #include <stdint.h>
+#include "htable.h"
 
 typedef struct rnd_s rnd_t;
 
+/* What a sampling rnd_t evicts among its candidates: the least
+ * recently or the least frequently used.
+ */
+enum rnd_sample { RND_SAMPLE_LRU, RND_SAMPLE_LFU };
+
+/* Options for rnd_new_ex().
+ *
+ * seed seeds the instance's own random number generator, so that
+ * eviction order is reproducible. If samples > 1, each eviction picks
+ * that many random candidates and evicts the best of them according
+ * to sample, approximating LRU or LFU. Otherwise the victim is chosen
+ * uniformly at random. index is the kind of table pages are looked up
+ * in, see htable.h.
+ */
+struct rnd_opts {
+  uint64_t seed;
+  int samples;
+  enum rnd_sample sample;
+  enum htable_index index;
+};
+
 rnd_t *rnd_new(size_t size, size_t nmemb);
+rnd_t *rnd_new_ex(size_t size, size_t nmemb, const struct rnd_opts *opts);
 int rnd_fetch(rnd_t *rnd, uint64_t key, void **ptr);
+
+/* Same as lru_fetch_ttl(), see lru.h
+ */
+int rnd_fetch_ttl(rnd_t *rnd, uint64_t key, uint64_t now, uint64_t ttl,
+                  void **ptr);
+
+/* Same as lru_invalidate() and lru_resize(), see lru.h
+ */
+int rnd_invalidate(rnd_t *rnd, uint64_t key);
+int rnd_resize(rnd_t *rnd, size_t nmemb);
 void rnd_free(rnd_t **rnd);
 
 #endif
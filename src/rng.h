@@ -0,0 +1,76 @@
+#ifndef RNG_H_8379c66b875f6973817bba37e88b2c07
+#define RNG_H_8379c66b875f6973817bba37e88b2c07
+
+/* Small, fast, seedable pseudo random number generator.
+ *
+ * This is wyrand: 64 bits of state, one multiplication per number.
+ * Each rng_t is independent, so two generators seeded alike produce
+ * identical sequences regardless of what else is going on in the
+ * process.
+ *
+ * The functions are defined here so that they can be inlined into
+ * the hot paths that use them.
+ */
+
+#include <stdint.h>
+
+typedef struct rng_s {
+  uint64_t state;
+} rng_t;
+
+static inline void rng_seed(rng_t *rng, uint64_t seed) {
+  rng->state = seed;
+}
+
+/* Returns a uniformly distributed 64 bit number
+ */
+static inline uint64_t rng_next(rng_t *rng) {
+#ifdef __SIZEOF_INT128__
+  __uint128_t t;
+
+  rng->state += 0xa0761d6478bd642fULL;
+  t = (__uint128_t)rng->state * (rng->state ^ 0xe7037ed1a0b428dbULL);
+  return (uint64_t)(t >> 64) ^ (uint64_t)t;
+#else
+  /* splitmix64 where 128 bit multiplication isn't available */
+  uint64_t z;
+
+  z = (rng->state += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+#endif
+}
+
+/* Returns a uniformly distributed double in [0, 1)
+ */
+static inline double rng_double(rng_t *rng) {
+  return (rng_next(rng) >> 11) * (1.0 / (1ULL << 53));
+}
+
+/* Returns a uniformly distributed number in [0, n), n > 0
+ *
+ * This is Lemire's multiply-shift range reduction, which avoids both
+ * the division and the bias of rng_next() % n.
+ */
+static inline uint64_t rng_range(rng_t *rng, uint64_t n) {
+#ifdef __SIZEOF_INT128__
+  __uint128_t m;
+  uint64_t l, t;
+
+  m = (__uint128_t)rng_next(rng) * n;
+  l = (uint64_t)m;
+  if (l < n) {
+    t = -n % n;
+    while (l < t) {
+      m = (__uint128_t)rng_next(rng) * n;
+      l = (uint64_t)m;
+    }
+  }
+  return m >> 64;
+#else
+  return rng_next(rng) % n;
+#endif
+}
+
+#endif
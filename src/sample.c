@@ -0,0 +1,332 @@
+#include <stdlib.h>
+#include "arena.h"
+#include "htable.h"
+#include "rng.h"
+#include "twheel.h"
+#include "sample.h"
+
+#define DEFAULT_SAMPLES 5
+#define DEFAULT_POOL 16
+#define DEFAULT_SEED 1
+#define MAX_POOL 64
+
+/* An eviction pool candidate. The candidate is stale if the page has
+   been used since it was sampled, i.e. if meta has changed. */
+struct sample_cand {
+  uint32_t slot;
+  uint32_t meta;
+  uint32_t score;
+};
+
+struct sample_s {
+  size_t nmemb;
+  htable_t *t;
+  arena_t *arena;
+  uint32_t *meta;
+  enum sample_policy policy;
+  int samples;
+  int pool_max;
+  int pool_size;
+  struct sample_cand pool[MAX_POOL];
+  /* counts fetches, while time is what pages expire by, and the wheel
+     is only set up once pages start expiring */
+  uint32_t now;
+  uint64_t time;
+  twheel_t *tw;
+  rng_t rng;
+};
+
+sample_t *sample_new(size_t size, size_t nmemb) {
+  struct sample_opts opts = {.policy = SAMPLE_LRU,
+                             .samples = DEFAULT_SAMPLES,
+                             .pool = DEFAULT_POOL,
+                             .seed = DEFAULT_SEED};
+
+  return sample_new_ex(size, nmemb, &opts);
+}
+
+sample_t *sample_new_ex(size_t size, size_t nmemb,
+                        const struct sample_opts *opts) {
+  sample_t *r;
+
+  if (opts->pool < 0 || opts->pool > MAX_POOL || nmemb > UINT32_MAX)
+    goto fail;
+
+  r = malloc(sizeof(sample_t));
+  if (!r) goto fail;
+
+  r->meta = malloc(nmemb * sizeof(uint32_t));
+  if (!r->meta) goto fail_meta;
+
+  r->arena = arena_new(size, nmemb);
+  if (!r->arena) goto fail_arena;
+
+  r->t = htable_new(nmemb);
+  if (!r->t) goto fail_htable;
+
+  r->nmemb = nmemb;
+  r->policy = opts->policy;
+  r->samples = opts->samples > 1 ? opts->samples : 1;
+  r->pool_max = opts->pool;
+  r->pool_size = 0;
+  r->now = 0;
+  r->time = 0;
+  r->tw = NULL;
+  rng_seed(&r->rng, opts->seed);
+
+  return r;
+
+ fail_htable:
+  arena_free(&r->arena);
+ fail_arena:
+  free(r->meta);
+ fail_meta:
+  free(r);
+ fail:
+  return NULL;
+}
+
+/* Returns how good a victim slot is, higher is better
+ */
+static uint32_t sample_score(sample_t *s, uint32_t slot) {
+  if (s->policy == SAMPLE_LFU)
+    return UINT32_MAX - s->meta[slot];
+  /* unsigned difference is the idle time, even when now has wrapped */
+  return s->now - s->meta[slot];
+}
+
+/* Offers slot to the eviction pool, which is kept sorted by
+ * ascending score.
+ */
+static void pool_offer(sample_t *s, uint32_t slot) {
+  struct sample_cand c;
+  int i;
+
+  /* a slot is in the pool at most once, with its latest meta */
+  for (i=0; i<s->pool_size; i++)
+    if (s->pool[i].slot == slot) {
+      if (s->pool[i].meta == s->meta[slot])
+        return;
+      for (; i<s->pool_size-1; i++)
+        s->pool[i] = s->pool[i+1];
+      s->pool_size--;
+      break;
+    }
+
+  c.slot = slot;
+  c.meta = s->meta[slot];
+  c.score = sample_score(s, slot);
+
+  if (s->pool_size < s->pool_max) {
+    i = s->pool_size++;
+  } else {
+    /* full, so c must beat the worst candidate, which it replaces */
+    if (c.score <= s->pool[0].score)
+      return;
+    for (i=0; i<s->pool_size-1; i++)
+      s->pool[i] = s->pool[i+1];
+    i = s->pool_size - 1;
+  }
+
+  while (i > 0 && s->pool[i-1].score > c.score) {
+    s->pool[i] = s->pool[i-1];
+    i--;
+  }
+  s->pool[i] = c;
+}
+
+/* Returns a random slot in use. Free slots can only be there while
+ * shrinking, and are passed over.
+ */
+static uint32_t sample_pick(sample_t *s) {
+  uint32_t slot;
+
+  do
+    slot = rng_range(&s->rng, s->nmemb);
+  while (!arena_in_use(s->arena, slot));
+
+  return slot;
+}
+
+static uint32_t sample_victim(sample_t *s) {
+  struct sample_cand *c;
+  uint32_t slot, best;
+  int i;
+
+  if (!s->pool_max) {
+    best = sample_pick(s);
+    for (i=1; i<s->samples; i++) {
+      slot = sample_pick(s);
+      if (sample_score(s, slot) > sample_score(s, best))
+        best = slot;
+    }
+    return best;
+  }
+
+  while (1) {
+    for (i=0; i<s->samples; i++)
+      pool_offer(s, sample_pick(s));
+
+    /* take the best candidate that hasn't been used, or dropped, since
+       sampled */
+    while (s->pool_size > 0) {
+      c = s->pool + --s->pool_size;
+      if (s->meta[c->slot] == c->meta && arena_in_use(s->arena, c->slot))
+        return c->slot;
+    }
+  }
+}
+
+/* Marks slot as used, one way or another
+ */
+static void sample_touch(sample_t *s, uint32_t slot) {
+  if (s->policy == SAMPLE_LFU) {
+    if (s->meta[slot] < UINT32_MAX)
+      s->meta[slot]++;
+  } else
+    s->meta[slot] = s->now;
+}
+
+/* Sets when the page in slot expires, if pages expire at all
+ */
+static void sample_expire(sample_t *s, size_t slot, uint64_t ttl) {
+  if (!s->tw)
+    return;
+  if (ttl)
+    twheel_set(s->tw, slot, s->time + ttl);
+  else
+    twheel_del(s->tw, slot);
+}
+
+/* Removes the page in slot from the cache
+ */
+static void sample_drop(sample_t *s, size_t slot) {
+  htable_del(s->t, arena_key(s->arena, slot));
+  if (s->tw)
+    twheel_del(s->tw, slot);
+  arena_release(s->arena, slot);
+}
+
+/* Frees a page, an expired one if any and a sampled one otherwise
+ */
+static void sample_evict(sample_t *s) {
+  size_t slot;
+
+  if (s->tw && !twheel_pop(s->tw, s->time, &slot)) {
+    sample_drop(s, slot);
+    return;
+  }
+
+  sample_drop(s, sample_victim(s));
+}
+
+int sample_fetch(sample_t *s, uint64_t key, void **ptr) {
+  return sample_fetch_ttl(s, key, s->time, 0, ptr);
+}
+
+int sample_fetch_ttl(sample_t *s, uint64_t key, uint64_t now, uint64_t ttl,
+                     void **ptr) {
+  void *val;
+  size_t slot;
+
+  if (ttl && !s->tw) {
+    s->tw = twheel_new(s->nmemb, s->time);
+    if (!s->tw)
+      return -1;
+  }
+  if (now > s->time)
+    s->time = now;
+
+  s->now++;
+
+  /* the table holds slot numbers rather than pointers */
+  if (!htable_get(s->t, key, &val)) {
+    slot = (uintptr_t)val;
+    *ptr = arena_page(s->arena, slot);
+
+    /* an expired page is reloaded in place, counting as a new page */
+    if (s->tw && twheel_expired(s->tw, slot, s->time)) {
+      s->meta[slot] = 0;
+      sample_touch(s, slot);
+      sample_expire(s, slot, ttl);
+      return 1;
+    }
+
+    sample_touch(s, slot);
+    return 0;
+  }
+
+  if (arena_alloc(s->arena, key, &slot)) {
+    sample_evict(s);
+    arena_alloc(s->arena, key, &slot);
+  }
+
+  htable_set(s->t, key, (void *)(uintptr_t)slot);
+  s->meta[slot] = 0;
+  sample_touch(s, slot);
+  sample_expire(s, slot, ttl);
+  *ptr = arena_page(s->arena, slot);
+
+  return 1;
+}
+
+int sample_invalidate(sample_t *s, uint64_t key) {
+  void *val;
+
+  if (htable_get(s->t, key, &val))
+    return 1;
+
+  sample_drop(s, (uintptr_t)val);
+  return 0;
+}
+
+/* Follows a page the arena moved while shrinking
+ */
+static void sample_move(void *ctx, size_t from, size_t to) {
+  sample_t *s = ctx;
+  uint64_t key = arena_key(s->arena, to);
+
+  htable_del(s->t, key);
+  htable_set(s->t, key, (void *)(uintptr_t)to);
+  s->meta[to] = s->meta[from];
+  if (s->tw)
+    twheel_move(s->tw, from, to);
+}
+
+int sample_resize(sample_t *s, size_t nmemb) {
+  uint32_t *meta;
+
+  if (nmemb < 1 || nmemb > UINT32_MAX)
+    return -1;
+
+  if (nmemb > s->nmemb) {
+    meta = realloc(s->meta, nmemb * sizeof(uint32_t));
+    if (!meta)
+      return -1;
+    s->meta = meta;
+    if ((s->tw && twheel_resize(s->tw, nmemb)) ||
+        htable_grow(s->t, nmemb) ||
+        arena_resize(s->arena, nmemb, NULL, NULL))
+      return -1;
+  } else {
+    while (arena_used(s->arena) > nmemb)
+      sample_evict(s);
+    arena_resize(s->arena, nmemb, sample_move, s);
+    if (s->tw)
+      twheel_resize(s->tw, nmemb);
+    /* the pool may hold slots that have moved or are gone */
+    s->pool_size = 0;
+  }
+
+  s->nmemb = nmemb;
+  return 0;
+}
+
+void sample_free(sample_t **sample) {
+  arena_free(&(*sample)->arena);
+  free((*sample)->meta);
+  htable_free(&(*sample)->t);
+  twheel_free(&(*sample)->tw);
+  free(*sample);
+  *sample = NULL;
+}
@@ -0,0 +1,48 @@
+#ifndef SAMPLE_H_94d9ccc62dbc1bcbe3fe55bf7f53848d
+#define SAMPLE_H_94d9ccc62dbc1bcbe3fe55bf7f53848d
+
+/* Sampled LRU/LFU approximation.
+ *
+ * Recency or frequency is a single 32 bit word per page, kept in a
+ * flat array next to the hash table, so a hit is a lookup and a
+ * store. Evictions sample random pages and evict the best candidate,
+ * optionally keeping the best candidates seen so far in a small
+ * eviction pool, as Redis does.
+ */
+
+#include <stdint.h>
+
+typedef struct sample_s sample_t;
+
+enum sample_policy { SAMPLE_LRU, SAMPLE_LFU };
+
+/* Options for sample_new_ex().
+ *
+ * samples is the number of pages sampled per eviction and pool the
+ * size of the eviction pool, 0 disabling it. seed seeds the
+ * instance's random number generator.
+ */
+struct sample_opts {
+  enum sample_policy policy;
+  int samples;
+  int pool;
+  uint64_t seed;
+};
+
+sample_t *sample_new(size_t size, size_t nmemb);
+sample_t *sample_new_ex(size_t size, size_t nmemb,
+                        const struct sample_opts *opts);
+int sample_fetch(sample_t *sample, uint64_t key, void **ptr);
+
+/* Same as lru_fetch_ttl(), see lru.h
+ */
+int sample_fetch_ttl(sample_t *sample, uint64_t key, uint64_t now,
+                     uint64_t ttl, void **ptr);
+
+/* Same as lru_invalidate() and lru_resize(), see lru.h
+ */
+int sample_invalidate(sample_t *sample, uint64_t key);
+int sample_resize(sample_t *sample, size_t nmemb);
+void sample_free(sample_t **sample);
+
+#endif
@@ -0,0 +1,118 @@
+#include <stdlib.h>
+#include "seqdet.h"
+
+#define MIN(a,b) ((a) < (b) ? (a) : (b))
+
+#define DEFAULT_STREAMS 8
+#define DEFAULT_TRIGGER 2
+#define DEFAULT_WINDOW 32
+/* the window a stream starts prefetching with */
+#define FIRST_WINDOW 4
+
+struct seqdet_stream {
+  /* the last key of the run, and one past the last key prefetched */
+  uint64_t last;
+  uint64_t ahead;
+  unsigned run;
+  unsigned window;
+  /* when the stream last advanced, to pick one to replace */
+  uint64_t stamp;
+};
+
+struct seqdet_s {
+  struct seqdet_stream *stream;
+  int nstreams;
+  unsigned trigger;
+  unsigned window;
+  uint64_t now;
+};
+
+seqdet_t *seqdet_new(void) {
+  struct seqdet_opts opts = {.streams = 0, .trigger = 0, .window = 0};
+
+  return seqdet_new_ex(&opts);
+}
+
+seqdet_t *seqdet_new_ex(const struct seqdet_opts *opts) {
+  seqdet_t *sd;
+
+  if (opts->streams < 0)
+    return NULL;
+
+  sd = calloc(1, sizeof(seqdet_t));
+  if (!sd)
+    return NULL;
+
+  sd->nstreams = opts->streams ? opts->streams : DEFAULT_STREAMS;
+  sd->trigger = opts->trigger ? opts->trigger : DEFAULT_TRIGGER;
+  sd->window = opts->window ? opts->window : DEFAULT_WINDOW;
+
+  sd->stream = calloc(sd->nstreams, sizeof(struct seqdet_stream));
+  if (!sd->stream) {
+    free(sd);
+    return NULL;
+  }
+
+  return sd;
+}
+
+/* Returns the stream key continues or repeats, or a new one for it
+ * in place of the stream that has been idle the longest
+ */
+static struct seqdet_stream *seqdet_find(seqdet_t *sd, uint64_t key) {
+  struct seqdet_stream *s, *lru = sd->stream;
+  int i;
+
+  for (i=0; i<sd->nstreams; i++) {
+    s = sd->stream + i;
+    if (s->run && (key == s->last + 1 || key == s->last))
+      return s;
+    if (s->stamp < lru->stamp)
+      lru = s;
+  }
+
+  lru->last = key - 1;
+  lru->ahead = key;
+  lru->run = 0;
+  lru->window = 0;
+  return lru;
+}
+
+size_t seqdet_access(seqdet_t *sd, uint64_t key, uint64_t *from) {
+  struct seqdet_stream *s;
+  uint64_t start;
+
+  s = seqdet_find(sd, key);
+  if (key == s->last)
+    return 0;
+
+  s->last = key;
+  s->run++;
+  s->stamp = ++sd->now;
+  if (s->ahead <= key)
+    s->ahead = key + 1;
+
+  /* prefetch once the run is long enough, and again each time half
+     of the window ahead has been consumed */
+  if (s->run < sd->trigger ||
+      (s->window && s->ahead - key - 1 > s->window / 2))
+    return 0;
+
+  s->window = s->window ? MIN(2 * s->window, sd->window) :
+                          MIN(FIRST_WINDOW, sd->window);
+  start = s->ahead;
+  s->ahead = key + 1 + s->window;
+  if (s->ahead <= start)
+    return 0;
+
+  *from = start;
+  return s->ahead - start;
+}
+
+void seqdet_free(seqdet_t **sd) {
+  if (!sd || !*sd)
+    return;
+  free((*sd)->stream);
+  free(*sd);
+  *sd = NULL;
+}
@@ -0,0 +1,49 @@
+#ifndef SEQDET_H_71d0a6e4c39b4f2a8e5b6c1d0f7a9e34
+#define SEQDET_H_71d0a6e4c39b4f2a8e5b6c1d0f7a9e34
+
+/* Sequential stream detector, for readahead.
+ *
+ * A seqdet_t watches the keys a client fetches for runs of
+ * consecutive keys, tracking a few such streams at once so that
+ * interleaved scans of different key ranges are each recognized.
+ * Once a stream has run for trigger keys, it asks for the keys ahead
+ * of it to be prefetched, starting with a small window that doubles
+ * each time half of it has been consumed, up to window keys, much
+ * like readahead in an operating system's page cache. Keys are only
+ * asked for once per stream.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef struct seqdet_s seqdet_t;
+
+/* Options for seqdet_new_ex().
+ *
+ * streams is the number of streams tracked, the least recently
+ * advanced one being replaced by a key that continues none of them.
+ * trigger is the length a run must reach before keys are prefetched
+ * and window the most keys prefetched ahead of a stream. 0 means the
+ * defaults, 8 streams, a trigger of 2 and a window of 32.
+ */
+struct seqdet_opts {
+  int streams;
+  unsigned trigger;
+  unsigned window;
+};
+
+seqdet_t *seqdet_new(void);
+seqdet_t *seqdet_new_ex(const struct seqdet_opts *opts);
+
+/* Notes a fetch of key, and returns the number of keys to prefetch
+ * from *from on, 0 if none, in which case *from is left alone
+ */
+size_t seqdet_access(seqdet_t *sd, uint64_t key, uint64_t *from);
+
+/* Destroys a detector and releases all associated resources
+ *
+ * The seqdet pointer at *sd will be set to NULL
+ */
+void seqdet_free(seqdet_t **sd);
+
+#endif
@@ -1,6 +1,10 @@
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
+#include "arena.h"
+#include "ghost.h"
 #include "linkmap.h"
+#include "twheel.h"
 #include "slru.h"
 
 #include <stdio.h>
@@ -9,136 +13,477 @@
 #define MIN(a,b) ((a) < (b) ? (a) : (b))
 #define MAX(a,b) ((a) > (b) ? (a) : (b))
 
+/* the segments are lists in one linkmap, mapping keys to page slots in
+   the arena, the probationary one being list 0 and the most protected
+   one list nsegs-1. Prefetched pages that haven't been fetched yet
+   are in list nsegs, and share the room of the probationary segment,
+   of which they may take a quarter before going first. */
+#define PROBATIONARY 0
+#define PROTECTED 1
+#define PREFETCHED(slru) ((slru)->nsegs)
+#define MAX_PREFETCHED(max) ((max) / 4)
+
+/* ghosts of pages evicted that were never protected (G1) and that had
+   been protected (G2), kept in ghost[] or, with the ghost option, in
+   filter[], which has all ghosts in G1 unless adaptive */
+#define G1 0
+#define G2 1
+
 struct slru_s {
-  linkmap_t *A_t;
-  linkmap_t *B_t;
-  void *data;
-  size_t A_max;
-  size_t A_size;
-  size_t B_max;
-  size_t B_size;
-  size_t active;
-  size_t size;
+  linkmap_t *lm;
+  linkmap_t *ghost[2];
+  ghost_t *filter[2];
+  uint8_t *protected;
+  arena_t *arena;
+  size_t *max;
+  int nsegs;
   size_t nmemb;
+  /* only once pages start expiring */
+  twheel_t *tw;
+  uint64_t now;
 };
 
 slru_t *slru_new(size_t size, size_t nmemb) {
+  struct slru_opts opts = {.protected = 0, .adaptive = 0,
+                           .nsegments = 2, .segment = NULL};
+
+  return slru_new_ex(size, nmemb, &opts);
+}
+
+slru_t *slru_new_ex(size_t size, size_t nmemb, const struct slru_opts *opts) {
   slru_t *slru;
-  int i;
+  size_t upper;
+  int nsegs, i;
 
-  assert(nmemb >= 2);
+  nsegs = opts->nsegments ? opts->nsegments : 2;
 
-  slru = malloc(sizeof(slru_t));
+  assert(nsegs >= 2);
+  assert(nmemb >= nsegs);
+
+  if (opts->adaptive && nsegs != 2)
+    return NULL;
+
+  slru = calloc(1, sizeof(slru_t));
   if (!slru)
     return NULL;
 
-  slru->A_max = MAX(1, MIN(nmemb, PROTECTED_SIZE(nmemb)));
-  slru->B_max = nmemb - slru->A_max;
-  slru->A_size = 0;
-  slru->B_size = 0;
-  slru->size = size;
   slru->nmemb = nmemb;
-  slru->active = 0;
+  slru->nsegs = nsegs;
 
-  slru->data = malloc(nmemb * size);
-  if (!slru->data){
-    free(slru);
-    return NULL;
+  slru->max = malloc(nsegs * sizeof(size_t));
+  slru->arena = arena_new(size, nmemb);
+  slru->lm = linkmap_new_lists(nmemb, nsegs + 1);
+  if (!slru->max || !slru->arena || !slru->lm)
+    goto fail;
+
+  /* every segment gets at least one page, the probationary one what
+     is left over */
+  upper = 0;
+  for (i=PROTECTED; i<nsegs; i++) {
+    if (opts->segment)
+      slru->max[i] = opts->segment[i];
+    else if (nsegs == 2 && opts->protected)
+      slru->max[i] = opts->protected;
+    else
+      slru->max[i] = PROTECTED_SIZE(nmemb) / (nsegs - 1);
+    slru->max[i] = MAX(1, MIN(nmemb - upper - (nsegs - i), slru->max[i]));
+    upper += slru->max[i];
   }
+  slru->max[PROBATIONARY] = nmemb - upper;
 
-  slru->A_t = linkmap_new(slru->A_max);
-  if (!slru->A_t) {
-    free(slru->data);
-    free(slru);
-    return NULL;
+  if (opts->ghost) {
+    slru->filter[G1] = ghost_new(nmemb);
+    if (!slru->filter[G1])
+      goto fail;
   }
 
-  slru->B_t = linkmap_new(slru->B_max);
-  if (!slru->B_t) {
-    linkmap_free(&slru->B_t);
-    free(slru->data);
-    free(slru);
-    return NULL;
+  if (opts->adaptive) {
+    if (opts->ghost) {
+      slru->filter[G2] = ghost_new(nmemb);
+    } else {
+      slru->ghost[G1] = linkmap_new(nmemb);
+      slru->ghost[G2] = linkmap_new(nmemb);
+    }
+    slru->protected = calloc(nmemb, 1);
+    if ((!slru->filter[G2] && (!slru->ghost[G1] || !slru->ghost[G2])) ||
+        !slru->protected)
+      goto fail;
   }
 
   return slru;
+
+ fail:
+  slru_free(&slru);
+  return NULL;
+}
+
+/* Demotes LRU entries one segment down, starting with segment seg,
+ * until all segments above the probationary one are within bounds
+ */
+static void slru_cascade(slru_t *slru, int seg) {
+  uint64_t k;
+  void *v;
+
+  for (; seg > PROBATIONARY; seg--)
+    while (linkmap_size_in(slru->lm, seg) > slru->max[seg]) {
+      linkmap_get_tail_in(slru->lm, seg, &k, &v);
+      linkmap_move(slru->lm, k, seg - 1, NULL, NULL);
+    }
 }
 
 /* Retrieves entry by key from cache.
  *
- * The entry will be promoted to A MRU if found.
+ * The entry will be promoted to the MRU of the segment above its
+ * own, or of its own if it is in the top segment. A prefetched entry
+ * enters the probationary segment, as on a miss.
  *
  * Returns 0 if the key was found
  *         1 if the key was not found
  */
 static int slru_get(slru_t *slru, uint64_t key, void **ptr) {
-  void *data, *v;
-  uint64_t k;
+  void *val;
+  int from, to;
 
-  /* hit A */
-  if (!linkmap_pop(slru->A_t, key, ptr)) {
-    /* reinsert as head, i.e. MRU, if found */
-    linkmap_set(slru->A_t, key, *ptr);
-    return 0;
+  if (linkmap_get_list(slru->lm, key, &val, &from))
+    return 1;
+
+  if (from == PREFETCHED(slru))
+    to = PROBATIONARY;
+  else
+    to = MIN(from + 1, slru->nsegs - 1);
+  linkmap_move(slru->lm, key, to, NULL, NULL);
+
+  if (from == PROBATIONARY && slru->protected)
+    slru->protected[(uintptr_t)val] = 1;
+
+  /* if the segment above overflowed, its LRU cascades down */
+  slru_cascade(slru, to);
+
+  *ptr = arena_page(slru->arena, (uintptr_t)val);
+  return 0;
+}
+
+/* Remembers key as a ghost of kind g
+ */
+static void slru_ghost_add(slru_t *slru, int g, uint64_t key) {
+  if (slru->filter[g]) {
+    ghost_add(slru->filter[g], key);
+    return;
   }
 
-  /* else check B, promote to A MRU if found */
-  if (!linkmap_pop(slru->B_t, key, &data)) {
-    slru->B_size--;
+  if (linkmap_size(slru->ghost[g]) >= slru->nmemb)
+    linkmap_del_tail(slru->ghost[g]);
+  linkmap_set(slru->ghost[g], key, NULL);
+}
 
-    /* if A is full, we demote A's LRU to B */
-    if (slru->A_size >= slru->A_max) {
-      linkmap_pop_tail(slru->A_t, &k, &v);
-      linkmap_set(slru->B_t, k, v);
-      slru->A_size--;
-      slru->B_size++;
-    }
+static size_t slru_ghost_size(slru_t *slru, int g) {
+  return slru->filter[g] ? ghost_size(slru->filter[g]) :
+                           linkmap_size(slru->ghost[g]);
+}
 
-    linkmap_set(slru->A_t, key, data);
-    slru->A_size++;
-    *ptr = data;
+/* Returns the kind of ghost key is, forgetting it unless it is in a
+ * ghost_t, or -1 if it isn't one
+ */
+static int slru_ghost_hit(slru_t *slru, uint64_t key) {
+  int g;
 
-    return 0;
+  for (g=G1; g<=G2; g++)
+    if (slru->filter[g] ? ghost_has(slru->filter[g], key) :
+                          slru->ghost[g] && !linkmap_del(slru->ghost[g], key))
+      return g;
+
+  return -1;
+}
+
+/* Moves the segment boundary if key is a ghost
+ *
+ * Returns the kind of ghost key is, -1 if none
+ */
+static int slru_adapt(slru_t *slru, uint64_t key) {
+  size_t g1, g2;
+  int g;
+
+  g1 = slru_ghost_size(slru, G1);
+  g2 = slru_ghost_size(slru, G2);
+
+  /* a ghost_t may take a key for a ghost of an empty kind */
+  g = slru_ghost_hit(slru, key);
+  if (g == G1) {
+    slru->max[PROTECTED] -= MIN(slru->max[PROTECTED] - 1,
+                                MAX(1, g2 / MAX(1, g1)));
+    slru_cascade(slru, PROTECTED);
+  } else if (g == G2) {
+    slru->max[PROTECTED] += MIN(slru->nmemb - 1 - slru->max[PROTECTED],
+                                MAX(1, g1 / MAX(1, g2)));
   }
+  slru->max[PROBATIONARY] = slru->nmemb - slru->max[PROTECTED];
 
-  return 1;
+  return g;
 }
 
-static int slru_evict(slru_t *slru, uint64_t *key, void **ptr) {
-  return 0;
+/* Removes the page in slot from the cache
+ */
+static void slru_drop(slru_t *slru, size_t slot) {
+  linkmap_del(slru->lm, arena_key(slru->arena, slot));
+  if (slru->protected)
+    slru->protected[slot] = 0;
+  if (slru->tw)
+    twheel_del(slru->tw, slot);
+  arena_release(slru->arena, slot);
 }
 
-int slru_fetch(slru_t *slru, uint64_t key, void **ptr) {
-  int rc;
-  void *data, *v;
+/* Evicts the LRU entry of a segment, remembering it as a ghost if
+ * adaptive or with the ghost option. Prefetched pages that were never
+ * fetched say nothing of reuse, and leave no ghost.
+ */
+static void slru_evict(slru_t *slru, int seg) {
   uint64_t k;
+  void *v;
+
+  linkmap_get_tail_in(slru->lm, seg, &k, &v);
+
+  if (seg == PREFETCHED(slru))
+    ;
+  else if (slru->protected)
+    slru_ghost_add(slru, slru->protected[(uintptr_t)v] ? G2 : G1, k);
+  else if (slru->filter[G1])
+    slru_ghost_add(slru, G1, k);
+
+  slru_drop(slru, (uintptr_t)v);
+}
+
+/* Evicts the LRU entry of the lowest non-empty segment
+ */
+static void slru_evict_lowest(slru_t *slru) {
+  int seg;
+
+  for (seg=PROBATIONARY; !linkmap_size_in(slru->lm, seg); seg++)
+    ;
+  slru_evict(slru, seg);
+}
+
+/* Sets when the page in slot expires, if pages expire at all
+ */
+static void slru_expire(slru_t *slru, size_t slot, uint64_t ttl) {
+  if (!slru->tw)
+    return;
+  if (ttl)
+    twheel_set(slru->tw, slot, slru->now + ttl);
+  else
+    twheel_del(slru->tw, slot);
+}
+
+/* Reclaims an expired page, or makes room in the probationary
+ * segment by evicting its LRU entry, or the oldest prefetched one if
+ * there are too many. It may have to shed more than one entry if the
+ * protected segment has grown.
+ */
+static void slru_make_room(slru_t *slru) {
+  size_t s, pf;
+  int seg;
+
+  if (slru->tw && !twheel_pop(slru->tw, slru->now, &s)) {
+    slru_drop(slru, s);
+    return;
+  }
+
+  while (linkmap_size_in(slru->lm, PROBATIONARY) +
+         (pf = linkmap_size_in(slru->lm, PREFETCHED(slru))) >=
+         slru->max[PROBATIONARY]) {
+    seg = PROBATIONARY;
+    if (pf > MAX_PREFETCHED(slru->max[PROBATIONARY]) ||
+        !linkmap_size_in(slru->lm, PROBATIONARY))
+      seg = PREFETCHED(slru);
+    slru_evict(slru, seg);
+  }
+}
+
+int slru_fetch(slru_t *slru, uint64_t key, void **ptr) {
+  return slru_fetch_ttl(slru, key, slru->now, 0, ptr);
+}
+
+int slru_fetch_ttl(slru_t *slru, uint64_t key, uint64_t now, uint64_t ttl,
+                   void **ptr) {
+  void *val;
+  size_t s;
+  int ghost, seg;
+
+  if (ttl && !slru->tw) {
+    slru->tw = twheel_new(slru->nmemb, slru->now);
+    if (!slru->tw)
+      return -1;
+  }
+  if (now > slru->now)
+    slru->now = now;
+
+  /* an expired page starts over in the probationary segment */
+  if (slru->tw && !linkmap_get(slru->lm, key, &val) &&
+      twheel_expired(slru->tw, (uintptr_t)val, slru->now)) {
+    s = (uintptr_t)val;
+    linkmap_move(slru->lm, key, PROBATIONARY, NULL, NULL);
+    if (slru->protected)
+      slru->protected[s] = 0;
+    slru_expire(slru, s, ttl);
+    *ptr = arena_page(slru->arena, s);
+    return 1;
+  }
 
   /* try to get from cache */
   if (!slru_get(slru, key, ptr))
     return 0;
 
-  /* if that fails, we either create a new page and insert that into
-     B, or we evict the LRU entry from B to make room. */
+  if (slru->protected)
+    ghost = slru_adapt(slru, key);
+  else
+    ghost = slru_ghost_hit(slru, key);
 
-  if (slru->active < slru->nmemb && slru->B_size < slru->B_max) {
-    data = slru->data + slru->active * slru->size;
-    slru->active++;
-  } else {
-    linkmap_pop_tail(slru->B_t, &k, &data);
-    slru->B_size--;
+  /* if that fails, we make room for the page */
+  slru_make_room(slru);
+
+  /* can't fail while the segments are within bounds, but evict from
+     the lowest non-empty one rather than fail */
+  if (arena_alloc(slru->arena, key, &s)) {
+    slru_evict_lowest(slru);
+    arena_alloc(slru->arena, key, &s);
+  }
+
+  /* a ghost in a ghost_t has been reused, and skips probation */
+  seg = slru->filter[G1] && ghost >= 0 ? PROTECTED : PROBATIONARY;
+  linkmap_set_in(slru->lm, seg, key, (void *)(uintptr_t)s);
+  if (seg == PROTECTED) {
+    if (slru->protected)
+      slru->protected[s] = 1;
+    slru_cascade(slru, PROTECTED);
+  }
+  slru_expire(slru, s, ttl);
+  *ptr = arena_page(slru->arena, s);
+
+  return 1;
+}
+
+int slru_prefetch(slru_t *slru, uint64_t key, void **ptr) {
+  void *val;
+  size_t s;
+
+  /* a page that is cached stays where it is, unless it has expired */
+  if (!linkmap_get(slru->lm, key, &val)) {
+    s = (uintptr_t)val;
+    if (!slru->tw || !twheel_expired(slru->tw, s, slru->now)) {
+      *ptr = arena_page(slru->arena, s);
+      return 0;
+    }
+    slru_drop(slru, s);
   }
 
-  linkmap_set(slru->B_t, key, data);
-  slru->B_size++;
-  *ptr = data;
+  /* ghosts are left alone, as the page hasn't been asked for */
+  slru_make_room(slru);
+  if (arena_alloc(slru->arena, key, &s)) {
+    slru_evict_lowest(slru);
+    arena_alloc(slru->arena, key, &s);
+  }
+
+  linkmap_set_in(slru->lm, PREFETCHED(slru), key, (void *)(uintptr_t)s);
+  slru_expire(slru, s, 0);
+  *ptr = arena_page(slru->arena, s);
 
   return 1;
 }
 
+int slru_invalidate(slru_t *slru, uint64_t key) {
+  void *val;
+
+  if (linkmap_get(slru->lm, key, &val))
+    return 1;
+
+  slru_drop(slru, (uintptr_t)val);
+  return 0;
+}
+
+/* Follows a page the arena moved while shrinking
+ */
+static void slru_move(void *ctx, size_t from, size_t to) {
+  slru_t *slru = ctx;
+
+  linkmap_set(slru->lm, arena_key(slru->arena, to), (void *)(uintptr_t)to);
+  if (slru->protected)
+    slru->protected[to] = slru->protected[from];
+  if (slru->tw)
+    twheel_move(slru->tw, from, to);
+}
+
+/* Scales the segment sizes to a total of nmemb, each upper segment
+ * keeping at least one page
+ */
+static void slru_scale(slru_t *slru, size_t nmemb) {
+  size_t upper;
+  int i;
+
+  upper = 0;
+  for (i=PROTECTED; i<slru->nsegs; i++) {
+    slru->max[i] = MAX(1, slru->max[i] * nmemb / slru->nmemb);
+    slru->max[i] = MIN(nmemb - upper - (slru->nsegs - i), slru->max[i]);
+    upper += slru->max[i];
+  }
+  slru->max[PROBATIONARY] = nmemb - upper;
+}
+
+int slru_resize(slru_t *slru, size_t nmemb) {
+  uint8_t *protected;
+  int g;
+
+  if (nmemb < slru->nsegs)
+    return -1;
+
+  if (nmemb > slru->nmemb) {
+    if (slru->protected) {
+      protected = realloc(slru->protected, nmemb);
+      if (!protected)
+        return -1;
+      slru->protected = protected;
+      memset(protected + slru->nmemb, 0, nmemb - slru->nmemb);
+    }
+    for (g=G1; g<=G2; g++)
+      if ((slru->ghost[g] && linkmap_grow(slru->ghost[g], nmemb)) ||
+          (slru->filter[g] && ghost_resize(slru->filter[g], nmemb)))
+        return -1;
+    if ((slru->tw && twheel_resize(slru->tw, nmemb)) ||
+        linkmap_grow(slru->lm, nmemb) ||
+        arena_resize(slru->arena, nmemb, NULL, NULL))
+      return -1;
+    slru_scale(slru, nmemb);
+  } else {
+    /* the segments shrink alike, overflowing downwards, and the
+       lowest ones give up pages until the rest fit */
+    slru_scale(slru, nmemb);
+    slru_cascade(slru, slru->nsegs - 1);
+    while (arena_used(slru->arena) > nmemb)
+      slru_evict_lowest(slru);
+    arena_resize(slru->arena, nmemb, slru_move, slru);
+    if (slru->tw)
+      twheel_resize(slru->tw, nmemb);
+    for (g=G1; g<=G2; g++) {
+      if (slru->ghost[g])
+        while (linkmap_size(slru->ghost[g]) > nmemb)
+          linkmap_del_tail(slru->ghost[g]);
+      if (slru->filter[g])
+        ghost_resize(slru->filter[g], nmemb);
+    }
+  }
+
+  slru->nmemb = nmemb;
+  return 0;
+}
+
 void slru_free(slru_t **slru) {
-  free((*slru)->data);
-  linkmap_free(&(*slru)->A_t);
-  linkmap_free(&(*slru)->B_t);
+  free((*slru)->max);
+  free((*slru)->protected);
+  arena_free(&(*slru)->arena);
+  linkmap_free(&(*slru)->lm);
+  linkmap_free(&(*slru)->ghost[G1]);
+  linkmap_free(&(*slru)->ghost[G2]);
+  ghost_free(&(*slru)->filter[G1]);
+  ghost_free(&(*slru)->filter[G2]);
+  twheel_free(&(*slru)->tw);
   free(*slru);
   *slru = NULL;
 }
@@ -5,8 +5,55 @@
 
 typedef struct slru_s slru_t;
 
+/* Options for slru_new_ex().
+ *
+ * The cache is split into nsegments segments (0 meaning 2), segment 0
+ * being the probationary one where new pages enter. A hit promotes a
+ * page one segment up, and a segment that overflows demotes its LRU
+ * page one segment down. segment[1] to segment[nsegments-1] give the
+ * sizes of the upper segments, segment 0 gets what remains of nmemb.
+ * If segment is NULL, the upper segments share half of nmemb equally.
+ *
+ * With two segments, protected may be used instead to set the size of
+ * segment 1 (0 meaning half of nmemb). If adaptive is set, the
+ * boundary between the two moves at runtime, ARC style: a miss on a
+ * recently evicted page that never made it out of the probationary
+ * segment grows the probationary segment, and a miss on a recently
+ * evicted page that had been protected grows the protected segment.
+ * adaptive requires two segments.
+ *
+ * If ghost is set, recently evicted pages are remembered in a ghost_t
+ * (see ghost.h) rather than in a linkmap_t, which takes a few bytes
+ * per page instead of a few dozen, and a miss on one of them enters
+ * the protected segment directly, as it has proven to be reused. With
+ * adaptive, it also moves the boundary as above.
+ */
+struct slru_opts {
+  size_t protected;
+  int adaptive;
+  int nsegments;
+  const size_t *segment;
+  int ghost;
+};
+
 slru_t *slru_new(size_t size, size_t nmemb);
+slru_t *slru_new_ex(size_t size, size_t nmemb, const struct slru_opts *opts);
 int slru_fetch(slru_t *slru, uint64_t key, void **ptr);
+
+/* Same as lru_fetch_ttl(), see lru.h
+ */
+int slru_fetch_ttl(slru_t *slru, uint64_t key, uint64_t now, uint64_t ttl,
+                   void **ptr);
+
+/* Same as lru_prefetch(), see lru.h. Prefetched pages share the room
+ * of the probationary segment, and enter it once fetched.
+ */
+int slru_prefetch(slru_t *slru, uint64_t key, void **ptr);
+
+/* Same as lru_invalidate() and lru_resize(), see lru.h
+ */
+int slru_invalidate(slru_t *slru, uint64_t key);
+int slru_resize(slru_t *slru, size_t nmemb);
 void slru_free(slru_t **slru);
 
 #endif
@@ -0,0 +1,231 @@
+#include "sweep.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SWEEP_X86
+#include <immintrin.h>
+#endif
+
+/* The kernels scan c[from..to) and return the index of the first
+   zero counter, decrementing those before it, or return to after
+   decrementing the whole range. */
+typedef size_t (*sweep_fun)(uint8_t *c, size_t from, size_t to);
+
+/* The lap kernels find the smallest of n counters and subtract m
+   from all of them. */
+typedef uint8_t (*lap_min_fun)(const uint8_t *c, size_t n);
+typedef void (*lap_sub_fun)(uint8_t *c, size_t n, uint8_t m);
+
+struct kernels {
+  sweep_fun sweep;
+  lap_min_fun min;
+  lap_sub_fun sub;
+};
+
+static size_t sweep_scalar(uint8_t *c, size_t from, size_t to) {
+  size_t i;
+
+  for (i=from; i<to; i++) {
+    if (!c[i])
+      return i;
+    c[i]--;
+  }
+
+  return to;
+}
+
+static uint8_t lap_min_scalar(const uint8_t *c, size_t n) {
+  uint8_t m = UINT8_MAX;
+  size_t i;
+
+  for (i=0; i<n && m; i++)
+    if (c[i] < m)
+      m = c[i];
+
+  return m;
+}
+
+static void lap_sub_scalar(uint8_t *c, size_t n, uint8_t m) {
+  size_t i;
+
+  for (i=0; i<n; i++)
+    c[i] -= m;
+}
+
+#ifdef SWEEP_X86
+
+__attribute__((target("sse2")))
+static size_t sweep_sse2(uint8_t *c, size_t from, size_t to) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i one = _mm_set1_epi8(1);
+  const __m128i idx = _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7,
+                                    8, 9, 10, 11, 12, 13, 14, 15);
+  __m128i v, dec;
+  unsigned mask;
+  size_t i;
+  int z;
+
+  for (i=from; i+16<=to; i+=16) {
+    v = _mm_loadu_si128((__m128i *)(c + i));
+    mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, zero));
+    if (mask) {
+      /* decrement only the counters before the first zero */
+      z = __builtin_ctz(mask);
+      dec = _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(z), idx), one);
+      _mm_storeu_si128((__m128i *)(c + i), _mm_subs_epu8(v, dec));
+      return i + z;
+    }
+    _mm_storeu_si128((__m128i *)(c + i), _mm_sub_epi8(v, one));
+  }
+
+  return sweep_scalar(c, i, to);
+}
+
+__attribute__((target("sse2")))
+static uint8_t lap_min_sse2(const uint8_t *c, size_t n) {
+  __m128i v;
+  uint8_t m, lane[16];
+  size_t i;
+
+  v = _mm_set1_epi8(-1);
+  for (i=0; i+16<=n; i+=16)
+    v = _mm_min_epu8(v, _mm_loadu_si128((__m128i *)(c + i)));
+  _mm_storeu_si128((__m128i *)lane, v);
+
+  m = lap_min_scalar(lane, 16);
+  if (i < n && m) {
+    lane[0] = lap_min_scalar(c + i, n - i);
+    if (lane[0] < m)
+      m = lane[0];
+  }
+
+  return m;
+}
+
+__attribute__((target("sse2")))
+static void lap_sub_sse2(uint8_t *c, size_t n, uint8_t m) {
+  const __m128i vm = _mm_set1_epi8(m);
+  size_t i;
+
+  for (i=0; i+16<=n; i+=16)
+    _mm_storeu_si128((__m128i *)(c + i),
+                     _mm_sub_epi8(_mm_loadu_si128((__m128i *)(c + i)), vm));
+  lap_sub_scalar(c + i, n - i, m);
+}
+
+__attribute__((target("avx2,bmi")))
+static size_t sweep_avx2(uint8_t *c, size_t from, size_t to) {
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i one = _mm256_set1_epi8(1);
+  const __m256i idx = _mm256_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7,
+                                       8, 9, 10, 11, 12, 13, 14, 15,
+                                       16, 17, 18, 19, 20, 21, 22, 23,
+                                       24, 25, 26, 27, 28, 29, 30, 31);
+  __m256i v, dec;
+  unsigned mask;
+  size_t i;
+  int z;
+
+  for (i=from; i+32<=to; i+=32) {
+    v = _mm256_loadu_si256((__m256i *)(c + i));
+    mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, zero));
+    if (mask) {
+      z = _tzcnt_u32(mask);
+      dec = _mm256_and_si256(_mm256_cmpgt_epi8(_mm256_set1_epi8(z), idx),
+                             one);
+      _mm256_storeu_si256((__m256i *)(c + i), _mm256_subs_epu8(v, dec));
+      return i + z;
+    }
+    _mm256_storeu_si256((__m256i *)(c + i), _mm256_sub_epi8(v, one));
+  }
+
+  return sweep_sse2(c, i, to);
+}
+
+__attribute__((target("avx2")))
+static uint8_t lap_min_avx2(const uint8_t *c, size_t n) {
+  __m256i v;
+  uint8_t m, lane[32];
+  size_t i;
+
+  v = _mm256_set1_epi8(-1);
+  for (i=0; i+32<=n; i+=32)
+    v = _mm256_min_epu8(v, _mm256_loadu_si256((__m256i *)(c + i)));
+  _mm256_storeu_si256((__m256i *)lane, v);
+
+  m = lap_min_scalar(lane, 32);
+  if (i < n && m) {
+    lane[0] = lap_min_sse2(c + i, n - i);
+    if (lane[0] < m)
+      m = lane[0];
+  }
+
+  return m;
+}
+
+__attribute__((target("avx2")))
+static void lap_sub_avx2(uint8_t *c, size_t n, uint8_t m) {
+  const __m256i vm = _mm256_set1_epi8(m);
+  size_t i;
+
+  for (i=0; i+32<=n; i+=32)
+    _mm256_storeu_si256((__m256i *)(c + i),
+                        _mm256_sub_epi8(_mm256_loadu_si256((__m256i *)(c + i)),
+                                        vm));
+  lap_sub_sse2(c + i, n - i, m);
+}
+
+#endif
+
+/* Picks the widest kernels the CPU supports
+ */
+static const struct kernels *kernels_select(void) {
+  static const struct kernels scalar = {sweep_scalar, lap_min_scalar,
+                                        lap_sub_scalar};
+#ifdef SWEEP_X86
+  static const struct kernels sse2 = {sweep_sse2, lap_min_sse2,
+                                      lap_sub_sse2};
+  static const struct kernels avx2 = {sweep_avx2, lap_min_avx2,
+                                      lap_sub_avx2};
+
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi"))
+    return &avx2;
+  if (__builtin_cpu_supports("sse2"))
+    return &sse2;
+#endif
+  return &scalar;
+}
+
+static const struct kernels *kernels_get(void) {
+  static const struct kernels *k = NULL;
+
+  if (!k)
+    k = kernels_select();
+
+  return k;
+}
+
+size_t sweep(uint8_t *c, size_t n, size_t hand) {
+  sweep_fun kernel = kernels_get()->sweep;
+  size_t i;
+
+  /* each lap decrements every non-zero counter, so this terminates */
+  while (1) {
+    i = kernel(c, hand, n);
+    if (i < n)
+      return i;
+    hand = 0;
+  }
+}
+
+size_t sweep_min(uint8_t *c, size_t n, size_t hand) {
+  const struct kernels *k = kernels_get();
+  uint8_t m;
+
+  /* m full laps would decrement everything by m, leaving a zero */
+  m = k->min(c, n);
+  if (m)
+    k->sub(c, n, m);
+
+  return sweep(c, n, hand);
+}
@@ -0,0 +1,34 @@
+#ifndef SWEEP_H_003d1a90e2087f8900111cd9be21e23f
+#define SWEEP_H_003d1a90e2087f8900111cd9be21e23f
+
+/* Clock hand sweep over a packed array of reference counters.
+ *
+ * CLOCK and GCLOCK keep one byte per page, separate from the pages
+ * themselves, so that the hand can be advanced over many pages per
+ * instruction. Where available, AVX2 or SSE2 is used to examine 32
+ * or 16 counters at a time.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Advances a clock hand over the n counters c[], starting at c[hand]
+ * and wrapping around at the end. Every non-zero counter passed over
+ * is decremented by one and the hand stops at the first zero counter.
+ * For CLOCK, where the counters are reference bits, this is exactly
+ * the clearing of reference bits.
+ *
+ * n must be at least 1.
+ *
+ * Returns the index of the zero counter, i.e. the victim
+ */
+size_t sweep(uint8_t *c, size_t n, size_t hand);
+
+/* Like sweep(), but first skips the laps where no counter reaches
+ * zero, by subtracting the smallest counter from all of them. The
+ * result is the same as that of sweep(), at the price of a pass over
+ * c[] to find the minimum. This pays off when counters are large.
+ */
+size_t sweep_min(uint8_t *c, size_t n, size_t hand);
+
+#endif
@@ -0,0 +1,308 @@
+#include <stdlib.h>
+#include <string.h>
+#include "swiss.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define MAX(a,b) ((a) > (b) ? (a) : (b))
+
+#define GROUP 16
+/* control bytes of slots not holding an entry, the 7 bits of hash of
+   those that do are never negative */
+#define EMPTY   ((int8_t)-128)
+#define DELETED ((int8_t)-2)
+/* slots are allocated for the capacity at SWISS_LOAD, and set() clears
+   deleted slots out when entries and those take up MAX_USED */
+#define LOAD(n)     ((n) * SWISS_LOAD / 100)
+#define MAX_USED(n) ((n) * 31 / 32)
+/* 4 groups of control bytes to a cache line */
+#define MIN_GROUPS 4
+#define LINE 64
+
+struct swiss_entry {
+  uint64_t key;
+  void *val;
+};
+
+struct swiss_s {
+  int8_t *ctrl;
+  struct swiss_entry *entry;
+  size_t mask;
+  size_t size;
+  size_t ndeleted;
+  size_t capacity;
+  int grow;
+};
+
+/* splitmix64's finalizer. The control byte comes from the low bits,
+ * the group from the others.
+ */
+static uint64_t hash(uint64_t k) {
+  k ^= k >> 30;
+  k *= 0xbf58476d1ce4e5b9ULL;
+  k ^= k >> 27;
+  k *= 0x94d049bb133111ebULL;
+  k ^= k >> 31;
+
+  return k;
+}
+
+static int8_t ctrl_of(uint64_t h) {
+  return h & 0x7f;
+}
+
+static size_t group_of(swiss_t *t, uint64_t h) {
+  return (h >> 7) & t->mask;
+}
+
+/* Returns a mask of the slots of group g whose control byte is c
+ */
+static unsigned group_match(swiss_t *t, size_t g, int8_t c) {
+#ifdef __SSE2__
+  __m128i ctrl = _mm_load_si128((__m128i *)(t->ctrl + g * GROUP));
+
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(c)));
+#else
+  int8_t *ctrl = t->ctrl + g * GROUP;
+  unsigned m = 0, i;
+
+  for (i=0; i<GROUP; i++)
+    if (ctrl[i] == c)
+      m |= 1U << i;
+
+  return m;
+#endif
+}
+
+/* Returns a mask of the slots of group g that don't hold an entry
+ */
+static unsigned group_free(swiss_t *t, size_t g) {
+#ifdef __SSE2__
+  __m128i ctrl = _mm_load_si128((__m128i *)(t->ctrl + g * GROUP));
+
+  return _mm_movemask_epi8(ctrl);
+#else
+  int8_t *ctrl = t->ctrl + g * GROUP;
+  unsigned m = 0, i;
+
+  for (i=0; i<GROUP; i++)
+    if (ctrl[i] < 0)
+      m |= 1U << i;
+
+  return m;
+#endif
+}
+
+/* Returns the slot holding key, whose hash is h, or -1 if there is
+ * none.
+ *
+ * Groups are probed at triangular offsets from the key's, which visits
+ * every group as there is a power of two of them. An entry is never
+ * placed past a group with an empty slot, so the search can stop at
+ * the first such group.
+ */
+static long find(swiss_t *t, uint64_t key, uint64_t h) {
+  size_t g = group_of(t, h), i;
+  unsigned m;
+  long s;
+
+  for (i=0; i<=t->mask; i++) {
+    m = group_match(t, g, ctrl_of(h));
+    while (m) {
+      s = g * GROUP + __builtin_ctz(m);
+      if (t->entry[s].key == key)
+        return s;
+      m &= m - 1;
+    }
+    if (group_match(t, g, EMPTY))
+      return -1;
+    g = (g + i + 1) & t->mask;
+  }
+
+  return -1;
+}
+
+/* Returns the first free slot on the probe sequence of hash h, there
+ * always being one
+ */
+static size_t free_slot(swiss_t *t, uint64_t h) {
+  size_t g = group_of(t, h), i;
+  unsigned m;
+
+  for (i=0; !(m = group_free(t, g)); i++)
+    g = (g + i + 1) & t->mask;
+
+  return g * GROUP + __builtin_ctz(m);
+}
+
+static void slot_put(swiss_t *t, size_t s, uint64_t h, uint64_t key,
+                     void *val) {
+  t->ctrl[s] = ctrl_of(h);
+  t->entry[s].key = key;
+  t->entry[s].val = val;
+}
+
+static size_t groups_for(size_t capacity) {
+  size_t n = MIN_GROUPS;
+
+  while (LOAD(n * GROUP) < capacity)
+    n <<= 1;
+
+  return n;
+}
+
+/* Moves every entry to a table of ngroups groups, leaving out the
+ * deleted slots
+ */
+static int rehash(swiss_t *t, size_t ngroups) {
+  struct swiss_entry *entry = t->entry;
+  int8_t *ctrl = t->ctrl;
+  size_t n = (t->mask + 1) * GROUP, i;
+
+  t->ctrl = aligned_alloc(LINE, ngroups * GROUP);
+  t->entry = malloc(ngroups * GROUP * sizeof(struct swiss_entry));
+  if (!t->ctrl || !t->entry) {
+    free(t->ctrl);
+    free(t->entry);
+    t->ctrl = ctrl;
+    t->entry = entry;
+    return -1;
+  }
+
+  memset(t->ctrl, EMPTY, ngroups * GROUP);
+  t->mask = ngroups - 1;
+  t->ndeleted = 0;
+
+  for (i=0; i<n; i++)
+    if (ctrl[i] >= 0)
+      slot_put(t, free_slot(t, hash(entry[i].key)), hash(entry[i].key),
+               entry[i].key, entry[i].val);
+
+  free(ctrl);
+  free(entry);
+  return 0;
+}
+
+swiss_t *swiss_new(size_t capacity, int grow) {
+  size_t ngroups;
+  swiss_t *t;
+
+  capacity = MAX(capacity, 1);
+  ngroups = groups_for(capacity);
+
+  t = calloc(1, sizeof(swiss_t));
+  if (!t)
+    return NULL;
+
+  t->ctrl = aligned_alloc(LINE, ngroups * GROUP);
+  t->entry = malloc(ngroups * GROUP * sizeof(struct swiss_entry));
+  if (!t->ctrl || !t->entry) {
+    swiss_free(&t);
+    return NULL;
+  }
+
+  memset(t->ctrl, EMPTY, ngroups * GROUP);
+  t->mask = ngroups - 1;
+  t->capacity = capacity;
+  t->grow = grow;
+
+  return t;
+}
+
+int swiss_set(swiss_t *t, uint64_t key, void *val) {
+  uint64_t h = hash(key);
+  size_t s;
+  long f;
+
+  if ((f = find(t, key, h)) >= 0) {
+    t->entry[f].val = val;
+    return 0;
+  }
+
+  if (t->size >= t->capacity &&
+      (!t->grow || swiss_grow(t, 2 * t->capacity)))
+    return -1;
+
+  /* taking an empty slot may leave too few, then it's time to get rid
+     of the deleted ones */
+  s = free_slot(t, h);
+  if (t->ctrl[s] == EMPTY &&
+      t->size + t->ndeleted >= MAX_USED((t->mask + 1) * GROUP)) {
+    if (rehash(t, t->mask + 1))
+      return -1;
+    s = free_slot(t, h);
+  }
+
+  if (t->ctrl[s] == DELETED)
+    t->ndeleted--;
+  slot_put(t, s, h, key, val);
+  t->size++;
+
+  return 0;
+}
+
+int swiss_get(swiss_t *t, uint64_t key, void **val) {
+  long s;
+
+  if ((s = find(t, key, hash(key))) < 0)
+    return 1;
+
+  *val = t->entry[s].val;
+  return 0;
+}
+
+int swiss_pop(swiss_t *t, uint64_t key, void **val) {
+  long s;
+
+  if ((s = find(t, key, hash(key))) < 0)
+    return 1;
+
+  *val = t->entry[s].val;
+
+  /* lookups stop at a group with an empty slot, so one more doesn't
+     hide anything there, but a full group has to stay that way */
+  if (group_match(t, s / GROUP, EMPTY)) {
+    t->ctrl[s] = EMPTY;
+  } else {
+    t->ctrl[s] = DELETED;
+    t->ndeleted++;
+  }
+  t->size--;
+
+  return 0;
+}
+
+int swiss_del(swiss_t *t, uint64_t key) {
+  void *val;
+
+  return swiss_pop(t, key, &val);
+}
+
+int swiss_grow(swiss_t *t, size_t capacity) {
+  size_t ngroups;
+
+  if (capacity <= t->capacity)
+    return 0;
+
+  ngroups = groups_for(capacity);
+  if (ngroups > t->mask + 1 && rehash(t, ngroups))
+    return -1;
+
+  t->capacity = capacity;
+  return 0;
+}
+
+size_t swiss_size(swiss_t *t) {
+  return t->size;
+}
+
+void swiss_free(swiss_t **t) {
+  if (!t || !*t)
+    return;
+  free((*t)->ctrl);
+  free((*t)->entry);
+  free(*t);
+  *t = NULL;
+}
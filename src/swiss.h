@@ -0,0 +1,89 @@
+#ifndef SWISS_H_51d0a8e3c7f94b26a1e98c4d0b7f3e62
+#define SWISS_H_51d0a8e3c7f94b26a1e98c4d0b7f3e62
+
+/* Open addressing hash table mapping unsigned 64 bit integer to void
+ * pointer, in the manner of Abseil's SwissTable and Folly's F14.
+ *
+ * Every slot has a control byte, kept apart from the entries: either
+ * 7 bits of the hash of the key in the slot, or a mark for a free or a
+ * deleted slot. Slots come in groups of 16, whose control bytes are
+ * compared to a key's in one SSE2 instruction. A key is looked for in
+ * the group its hash points at, then in other groups along a fixed
+ * probe sequence, up to the first group with a free slot. At the load
+ * the table is sized for, most lookups read one line of control bytes
+ * and, on a hit, the one entry whose control byte matches. A miss
+ * rarely looks at an entry at all.
+ *
+ * Deleted slots are reused by set(), and the table rehashes to clear
+ * them out when too few free slots are left.
+ *
+ * Unlike htable_t, keys are unique: setting a key that is already in
+ * the table replaces its value.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef struct swiss_s swiss_t;
+
+/* Slots are allocated so that a table at capacity fills this share of
+ * them, in percent
+ */
+#define SWISS_LOAD 90
+
+/* Allocates a new table of the given capacity, which doubles when the
+ * table is full if grow is set.
+ *
+ * If capacity < 1, a capacity of 1 will be used.
+ *
+ * Returns NULL if out of memory.
+ */
+swiss_t *swiss_new(size_t capacity, int grow);
+
+/* Sets value for key
+ *
+ * Returns 0 on success
+ *        -1 if the table is full and can't grow, or out of memory
+ */
+int swiss_set(swiss_t *t, uint64_t key, void *val);
+
+/* Retrieves value by key
+ *
+ * Returns 0 on success
+ *         1 if key was not found
+ */
+int swiss_get(swiss_t *t, uint64_t key, void **val);
+
+/* Retrieves and deletes entry by key
+ *
+ * Returns 0 on success
+ *         1 if entry was not found
+ */
+int swiss_pop(swiss_t *t, uint64_t key, void **val);
+
+/* Deletes entry by key
+ *
+ * Returns 0 on success
+ *         1 if entry was not found
+ */
+int swiss_del(swiss_t *t, uint64_t key);
+
+/* Grows the table to hold capacity entries, if it holds fewer,
+ * rehashing every entry if more slots are needed.
+ *
+ * Returns 0 on success
+ *         -1 if out of memory
+ */
+int swiss_grow(swiss_t *t, size_t capacity);
+
+/* Returns the number of entries in t
+ */
+size_t swiss_size(swiss_t *t);
+
+/* Destroys a table and releases all associated resources
+ *
+ * The swiss pointer at *t will be set to NULL
+ */
+void swiss_free(swiss_t **t);
+
+#endif
@@ -0,0 +1,171 @@
+#include <stdlib.h>
+#include "arena.h"
+#include "lru.h"
+#include "tenant.h"
+
+/* The arena has a page more than the cache, which is taken by the
+ * miss that finds the others in use. A page is then evicted, so that
+ * between fetches the spare is always free and a tenant's LRU never
+ * evicts one of its own pages on its own accord.
+ */
+
+struct tenant {
+  lru_t *lru;
+  size_t min;
+  size_t max;
+  /* pages proportional to the tenant's weight */
+  double fair;
+  struct tenant_stats st;
+};
+
+struct tenant_s {
+  arena_t *arena;
+  struct tenant *tenant;
+  int ntenants;
+  size_t nmemb;
+};
+
+tenant_t *tenant_new(size_t size, size_t nmemb, int ntenants) {
+  return tenant_new_ex(size, nmemb, ntenants, NULL);
+}
+
+tenant_t *tenant_new_ex(size_t size, size_t nmemb, int ntenants,
+                        const struct tenant_opts *opts) {
+  struct tenant_opts o = {.min = 0, .max = 0, .weight = 0};
+  tenant_t *tc;
+  double weight = 0;
+  size_t min = 0;
+  int t;
+
+  if (ntenants < 1 || nmemb < 1)
+    return NULL;
+
+  tc = calloc(1, sizeof(tenant_t));
+  if (!tc)
+    return NULL;
+
+  tc->ntenants = ntenants;
+  tc->nmemb = nmemb;
+  tc->arena = arena_new(size, nmemb + 1);
+  tc->tenant = calloc(ntenants, sizeof(struct tenant));
+  if (!tc->arena || !tc->tenant)
+    goto fail;
+
+  for (t=0; t<ntenants; t++) {
+    if (opts)
+      o = opts[t];
+    tc->tenant[t].min = o.min;
+    tc->tenant[t].max = o.max ? o.max : nmemb;
+    tc->tenant[t].fair = o.weight ? o.weight : 1;
+    if (o.min > tc->tenant[t].max)
+      goto fail;
+    min += o.min;
+    weight += tc->tenant[t].fair;
+
+    tc->tenant[t].lru = lru_new_shared(tc->arena);
+    if (!tc->tenant[t].lru)
+      goto fail;
+  }
+
+  /* some tenant must be above its min when a page has to go */
+  if (min >= nmemb)
+    goto fail;
+
+  for (t=0; t<ntenants; t++)
+    tc->tenant[t].fair *= nmemb / weight;
+
+  return tc;
+
+ fail:
+  tenant_free(&tc);
+  return NULL;
+}
+
+/* Returns the tenant that should give up a page after a miss of
+ * tenant self, the one most over its fair share among those above
+ * their min. The page self just fetched is its MRU page and can only
+ * be evicted if it is its only one, which is not allowed.
+ */
+static int tenant_victim(tenant_t *tc, int self) {
+  struct tenant *tn;
+  double over, most = 0;
+  size_t used;
+  int t, victim = -1;
+
+  for (t=0; t<tc->ntenants; t++) {
+    tn = tc->tenant + t;
+    used = lru_size(tn->lru);
+    if (used <= tn->min || (t == self && used == 1))
+      continue;
+    over = used - tn->fair;
+    if (victim < 0 || over > most) {
+      victim = t;
+      most = over;
+    }
+  }
+
+  return victim;
+}
+
+int tenant_fetch(tenant_t *tc, int tenant, uint64_t key, void **ptr) {
+  struct tenant *tn;
+  int r, victim;
+
+  if (tenant < 0 || tenant >= tc->ntenants)
+    return -1;
+  tn = tc->tenant + tenant;
+
+  r = lru_fetch(tn->lru, key, ptr);
+  if (r == 0) {
+    tn->st.hits++;
+    return 0;
+  }
+  if (r < 0)
+    return -1;
+  tn->st.misses++;
+
+  /* a tenant at its max makes room itself, otherwise the spare page
+     is freed by whoever is most over their share */
+  if (lru_size(tn->lru) > tn->max)
+    victim = tenant;
+  else if (arena_used(tc->arena) > tc->nmemb)
+    victim = tenant_victim(tc, tenant);
+  else
+    return 1;
+
+  lru_reclaim(tc->tenant[victim].lru);
+  tc->tenant[victim].st.evictions++;
+  return 1;
+}
+
+int tenant_invalidate(tenant_t *tc, int tenant, uint64_t key) {
+  if (tenant < 0 || tenant >= tc->ntenants)
+    return -1;
+
+  return lru_invalidate(tc->tenant[tenant].lru, key);
+}
+
+int tenant_stats(tenant_t *tc, int tenant, struct tenant_stats *st) {
+  if (tenant < 0 || tenant >= tc->ntenants)
+    return -1;
+
+  *st = tc->tenant[tenant].st;
+  st->used = lru_size(tc->tenant[tenant].lru);
+  return 0;
+}
+
+void tenant_free(tenant_t **tc) {
+  int t;
+
+  if (!tc || !*tc)
+    return;
+
+  if ((*tc)->tenant)
+    for (t=0; t<(*tc)->ntenants; t++)
+      if ((*tc)->tenant[t].lru)
+        lru_free(&(*tc)->tenant[t].lru);
+  free((*tc)->tenant);
+  arena_free(&(*tc)->arena);
+  free(*tc);
+  *tc = NULL;
+}
@@ -0,0 +1,86 @@
+#ifndef TENANT_H_5b0e7c3a91d24f68a2c8e4f1d6b39a07
+#define TENANT_H_5b0e7c3a91d24f68a2c8e4f1d6b39a07
+
+/* Cache shared by several tenants.
+ *
+ * Each tenant has an LRU cache of its own, see lru_new_shared(), and
+ * all of them take their pages from one arena of nmemb pages, so that
+ * pages an idle tenant isn't using go to those that are busy. A
+ * tenant is guaranteed min pages and never holds more than max. Its
+ * fair share is the part of the pages proportional to its weight, and
+ * when the pages run out, the page evicted is that of the tenant most
+ * over its fair share, among those above their min.
+ *
+ * Keys are per tenant, the same key of two tenants being two pages.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef struct tenant_s tenant_t;
+
+struct tenant_opts {
+  /* pages the tenant keeps however much others want them */
+  size_t min;
+  /* pages the tenant may hold at most, 0 for no limit */
+  size_t max;
+  /* the tenant's fair share relative to others', 0 for 1 */
+  unsigned weight;
+};
+
+struct tenant_stats {
+  uint64_t hits;
+  uint64_t misses;
+  /* pages of the tenant evicted, by its own fetches or others' */
+  uint64_t evictions;
+  /* pages the tenant holds now */
+  size_t used;
+};
+
+/* Allocates a cache of nmemb pages of size bytes for ntenants
+ * tenants, each with equal weight and no quotas.
+ *
+ * Returns NULL if out of memory.
+ */
+tenant_t *tenant_new(size_t size, size_t nmemb, int ntenants);
+
+/* Like tenant_new(), with the quotas and weight of each tenant in
+ * opts[0] to opts[ntenants-1].
+ *
+ * Returns NULL if out of memory, if a tenant's min exceeds its max
+ * or if the mins add up to nmemb or more.
+ */
+tenant_t *tenant_new_ex(size_t size, size_t nmemb, int ntenants,
+                        const struct tenant_opts *opts);
+
+/* Fetches the page of tenant's key. The page stays valid at least
+ * until the next call.
+ *
+ * Returns 0 on hit
+ *         1 on miss
+ *         -1 if tenant doesn't exist or out of memory
+ */
+int tenant_fetch(tenant_t *tc, int tenant, uint64_t key, void **ptr);
+
+/* Drops the page of tenant's key
+ *
+ * Returns 0 on success
+ *         1 if key was not cached
+ *         -1 if tenant doesn't exist
+ */
+int tenant_invalidate(tenant_t *tc, int tenant, uint64_t key);
+
+/* Writes the statistics of tenant to *st
+ *
+ * Returns 0 on success
+ *         -1 if tenant doesn't exist
+ */
+int tenant_stats(tenant_t *tc, int tenant, struct tenant_stats *st);
+
+/* Destroys a cache and releases all associated resources
+ *
+ * The tenant pointer at *tc will be set to NULL
+ */
+void tenant_free(tenant_t **tc);
+
+#endif
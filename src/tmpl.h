@@ -0,0 +1,430 @@
+/* Header-only policy templates.
+ *
+ * The library policies are opaque, and each fetch goes through calls
+ * into other translation units for the index and the arena. This
+ * header instead generates a policy whose page size, number of pages
+ * and index are fixed at compile time, all of it static inline, so
+ * that the compiler can inline and constant-fold the whole fetch path
+ * into the caller. It is included once per policy wanted, with the
+ * parameters defined beforehand:
+ *
+ *   #define TMPL_NAME   clk4k
+ *   #define TMPL_POLICY TMPL_CLK
+ *   #define TMPL_SIZE   4096
+ *   #define TMPL_NMEMB  1024
+ *   #define TMPL_INDEX  TMPL_SWISS
+ *   #include "tmpl.h"
+ *
+ * which declares clk4k_t, clk4k_new(), clk4k_fetch() and clk4k_free(),
+ * behaving as clk_new(4096, 1024), clk_fetch() and clk_free() do.
+ *
+ * TMPL_POLICY is one of TMPL_FIFO, TMPL_CLK, TMPL_GCLK, TMPL_RND and
+ * TMPL_LRU. TMPL_GCLK is gclk_new()'s GCLOCK, with counters up to 3,
+ * and TMPL_RND rnd_new()'s random eviction, with the same seed, so
+ * that both evict the same pages as their library counterparts.
+ * TMPL_INDEX, which defaults to TMPL_CHAINED, is either that or
+ * TMPL_SWISS, the same layouts as HTABLE_CHAINED and HTABLE_SWISS (see
+ * htable.h) sized for TMPL_NMEMB keys. TMPL_NMEMB must be at least 2.
+ *
+ * Pages neither expire nor can be invalidated, and the cache can't be
+ * resized. The parameters are undefined at the end, so that the header
+ * can be included again.
+ */
+
+#ifndef TMPL_H_7e0b4d2a91c64f5fa83d16b9c2e05a47
+#define TMPL_H_7e0b4d2a91c64f5fa83d16b9c2e05a47
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "rng.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define TMPL_FIFO 1
+#define TMPL_CLK  2
+#define TMPL_LRU  3
+#define TMPL_GCLK 4
+#define TMPL_RND  5
+
+/* as in gclk.c and rnd.c */
+#define TMPL_GCLK_MAX 3
+#define TMPL_RND_SEED 1
+
+#define TMPL_CHAINED 1
+#define TMPL_SWISS   2
+
+#define TMPL_CAT_(a, b) a ## _ ## b
+#define TMPL_CAT(a, b) TMPL_CAT_(a, b)
+
+/* the smallest power of two no less than n, n > 1 */
+#define TMPL_POW2(n) \
+  ((size_t)1 << (64 - __builtin_clzll((unsigned long long)(n) - 1)))
+
+#define TMPL_EMPTY   ((int8_t)-128)
+#define TMPL_DELETED ((int8_t)-2)
+#define TMPL_GROUP   16
+
+/* splitmix64's finalizer, as in cuckoo.c and swiss.c
+ */
+static inline uint64_t tmpl_hash(uint64_t k) {
+  k ^= k >> 30;
+  k *= 0xbf58476d1ce4e5b9ULL;
+  k ^= k >> 27;
+  k *= 0x94d049bb133111ebULL;
+  k ^= k >> 31;
+
+  return k;
+}
+
+/* Returns a mask of the slots of the group at ctrl whose control byte
+ * is c, or that are free if c is TMPL_EMPTY and free is set
+ */
+static inline unsigned tmpl_group_match(const int8_t *ctrl, int8_t c,
+                                        int free) {
+#ifdef __SSE2__
+  __m128i g = _mm_load_si128((const __m128i *)ctrl);
+
+  if (free)
+    return _mm_movemask_epi8(g);
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8(c)));
+#else
+  unsigned m = 0, i;
+
+  for (i=0; i<TMPL_GROUP; i++)
+    if (free ? ctrl[i] < 0 : ctrl[i] == c)
+      m |= 1U << i;
+
+  return m;
+#endif
+}
+
+#endif
+
+
+#if !defined(TMPL_NAME) || !defined(TMPL_POLICY) || \
+    !defined(TMPL_SIZE) || !defined(TMPL_NMEMB)
+#error "tmpl.h needs TMPL_NAME, TMPL_POLICY, TMPL_SIZE and TMPL_NMEMB"
+#endif
+
+#ifndef TMPL_INDEX
+#define TMPL_INDEX TMPL_CHAINED
+#endif
+
+#define TMPL_F(x) TMPL_CAT(TMPL_NAME, x)
+
+#if TMPL_INDEX == TMPL_CHAINED
+#define TMPL_BUCKETS TMPL_POW2(TMPL_NMEMB)
+#elif TMPL_INDEX == TMPL_SWISS
+/* sized for 90% load, like swiss.c, and at least a cache line */
+#define TMPL_SLOTS TMPL_POW2((TMPL_NMEMB * 10 / 9 + 1) | 64)
+#else
+#error "TMPL_INDEX is neither TMPL_CHAINED nor TMPL_SWISS"
+#endif
+
+typedef struct TMPL_F(s) TMPL_F(t);
+
+/* Slots are handed out in order until all are used, after which the
+ * slot of the victim is reused. key[] has the key of each slot, which
+ * the index maps back to it.
+ */
+struct TMPL_F(s) {
+#if TMPL_INDEX == TMPL_CHAINED
+  /* slot + 1 of the first key and the next key in a bucket, 0 ending
+     the chain */
+  uint32_t bucket[TMPL_BUCKETS];
+  uint32_t chain[TMPL_NMEMB];
+#else
+  int8_t ctrl[TMPL_SLOTS] __attribute__((aligned(64)));
+  struct {
+    uint64_t key;
+    uint32_t slot;
+  } entry[TMPL_SLOTS];
+  size_t ndeleted;
+#endif
+  uint64_t key[TMPL_NMEMB];
+  size_t used;
+  uint8_t *page;
+#if TMPL_POLICY == TMPL_FIFO
+  /* the oldest page, slots being filled in order */
+  size_t hand;
+#elif TMPL_POLICY == TMPL_CLK || TMPL_POLICY == TMPL_GCLK
+  size_t hand;
+  uint8_t ref[TMPL_NMEMB];
+#elif TMPL_POLICY == TMPL_RND
+  rng_t rng;
+#elif TMPL_POLICY == TMPL_LRU
+  /* a ring through the slots in use, most recently used first, with
+     TMPL_NMEMB as its head */
+  uint32_t next[TMPL_NMEMB + 1];
+  uint32_t prev[TMPL_NMEMB + 1];
+#else
+#error "TMPL_POLICY is none of the policies above"
+#endif
+};
+
+#if TMPL_INDEX == TMPL_CHAINED
+
+static inline long TMPL_F(find)(TMPL_F(t) *c, uint64_t key) {
+  uint32_t s;
+
+  s = c->bucket[tmpl_hash(key) & (TMPL_BUCKETS - 1)];
+  for (; s; s = c->chain[s - 1])
+    if (c->key[s - 1] == key)
+      return s - 1;
+
+  return -1;
+}
+
+static inline void TMPL_F(index_set)(TMPL_F(t) *c, uint64_t key,
+                                     size_t slot) {
+  uint32_t *b = c->bucket + (tmpl_hash(key) & (TMPL_BUCKETS - 1));
+
+  c->chain[slot] = *b;
+  *b = slot + 1;
+}
+
+static inline void TMPL_F(index_del)(TMPL_F(t) *c, uint64_t key,
+                                     size_t slot) {
+  uint32_t *p = c->bucket + (tmpl_hash(key) & (TMPL_BUCKETS - 1));
+
+  while (*p != slot + 1)
+    p = c->chain + *p - 1;
+  *p = c->chain[slot];
+}
+
+#else
+
+/* Groups are probed as in swiss.c, see there
+ */
+static inline long TMPL_F(find)(TMPL_F(t) *c, uint64_t key) {
+  uint64_t h = tmpl_hash(key);
+  size_t g = (h >> 7) & (TMPL_SLOTS / TMPL_GROUP - 1), i, s;
+  unsigned m;
+
+  for (i=0; i<TMPL_SLOTS / TMPL_GROUP; i++) {
+    m = tmpl_group_match(c->ctrl + g * TMPL_GROUP, h & 0x7f, 0);
+    while (m) {
+      s = g * TMPL_GROUP + __builtin_ctz(m);
+      if (c->entry[s].key == key)
+        return c->entry[s].slot;
+      m &= m - 1;
+    }
+    if (tmpl_group_match(c->ctrl + g * TMPL_GROUP, TMPL_EMPTY, 0))
+      return -1;
+    g = (g + i + 1) & (TMPL_SLOTS / TMPL_GROUP - 1);
+  }
+
+  return -1;
+}
+
+static inline size_t TMPL_F(free_slot)(TMPL_F(t) *c, uint64_t h) {
+  size_t g = (h >> 7) & (TMPL_SLOTS / TMPL_GROUP - 1), i;
+  unsigned m;
+
+  for (i=0; !(m = tmpl_group_match(c->ctrl + g * TMPL_GROUP,
+                                   TMPL_EMPTY, 1)); i++)
+    g = (g + i + 1) & (TMPL_SLOTS / TMPL_GROUP - 1);
+
+  return g * TMPL_GROUP + __builtin_ctz(m);
+}
+
+static inline void TMPL_F(index_put)(TMPL_F(t) *c, uint64_t key,
+                                     size_t slot) {
+  uint64_t h = tmpl_hash(key);
+  size_t s = TMPL_F(free_slot)(c, h);
+
+  if (c->ctrl[s] == TMPL_DELETED)
+    c->ndeleted--;
+  c->ctrl[s] = h & 0x7f;
+  c->entry[s].key = key;
+  c->entry[s].slot = slot;
+}
+
+static inline void TMPL_F(index_set)(TMPL_F(t) *c, uint64_t key,
+                                     size_t slot) {
+  size_t i;
+
+  /* clear out deleted slots when they crowd out the empty ones, the
+     keys of the pages being all there is to the index */
+  if (c->used + c->ndeleted >= TMPL_SLOTS * 31 / 32) {
+    memset(c->ctrl, TMPL_EMPTY, TMPL_SLOTS);
+    c->ndeleted = 0;
+    for (i=0; i<c->used; i++)
+      if (i != slot)
+        TMPL_F(index_put)(c, c->key[i], i);
+  }
+
+  TMPL_F(index_put)(c, key, slot);
+}
+
+static inline void TMPL_F(index_del)(TMPL_F(t) *c, uint64_t key,
+                                     size_t slot) {
+  uint64_t h = tmpl_hash(key);
+  size_t g = (h >> 7) & (TMPL_SLOTS / TMPL_GROUP - 1), i, s;
+  unsigned m;
+
+  for (i=0;; i++) {
+    m = tmpl_group_match(c->ctrl + g * TMPL_GROUP, h & 0x7f, 0);
+    while (m) {
+      s = g * TMPL_GROUP + __builtin_ctz(m);
+      if (c->entry[s].slot == slot) {
+        if (tmpl_group_match(c->ctrl + g * TMPL_GROUP, TMPL_EMPTY, 0)) {
+          c->ctrl[s] = TMPL_EMPTY;
+        } else {
+          c->ctrl[s] = TMPL_DELETED;
+          c->ndeleted++;
+        }
+        return;
+      }
+      m &= m - 1;
+    }
+    g = (g + i + 1) & (TMPL_SLOTS / TMPL_GROUP - 1);
+  }
+}
+
+#endif
+
+static inline TMPL_F(t) *TMPL_F(new)(void) {
+  TMPL_F(t) *c;
+
+  c = aligned_alloc(64, (sizeof(TMPL_F(t)) + 63) & ~(size_t)63);
+  if (!c)
+    goto fail;
+
+  c->page = malloc((size_t)TMPL_NMEMB * TMPL_SIZE);
+  if (!c->page)
+    goto fail_page;
+
+#if TMPL_INDEX == TMPL_CHAINED
+  memset(c->bucket, 0, sizeof(c->bucket));
+#else
+  memset(c->ctrl, TMPL_EMPTY, sizeof(c->ctrl));
+  c->ndeleted = 0;
+#endif
+  c->used = 0;
+#if TMPL_POLICY == TMPL_FIFO
+  c->hand = 0;
+#elif TMPL_POLICY == TMPL_CLK || TMPL_POLICY == TMPL_GCLK
+  c->hand = 0;
+#elif TMPL_POLICY == TMPL_RND
+  rng_seed(&c->rng, TMPL_RND_SEED);
+#elif TMPL_POLICY == TMPL_LRU
+  c->next[TMPL_NMEMB] = c->prev[TMPL_NMEMB] = TMPL_NMEMB;
+#endif
+
+  return c;
+
+ fail_page:
+  free(c);
+ fail:
+  return NULL;
+}
+
+#if TMPL_POLICY == TMPL_LRU
+
+static inline void TMPL_F(unlink)(TMPL_F(t) *c, size_t slot) {
+  c->next[c->prev[slot]] = c->next[slot];
+  c->prev[c->next[slot]] = c->prev[slot];
+}
+
+static inline void TMPL_F(push)(TMPL_F(t) *c, size_t slot) {
+  c->next[slot] = c->next[TMPL_NMEMB];
+  c->prev[slot] = TMPL_NMEMB;
+  c->prev[c->next[TMPL_NMEMB]] = slot;
+  c->next[TMPL_NMEMB] = slot;
+}
+
+#endif
+
+/* Returns the slot of the page to evict, the cache being full
+ */
+static inline size_t TMPL_F(victim)(TMPL_F(t) *c) {
+  size_t slot;
+
+#if TMPL_POLICY == TMPL_FIFO
+  slot = c->hand;
+  c->hand = (c->hand + 1) % TMPL_NMEMB;
+#elif TMPL_POLICY == TMPL_CLK
+  while (c->ref[c->hand]) {
+    c->ref[c->hand] = 0;
+    c->hand = (c->hand + 1) % TMPL_NMEMB;
+  }
+  slot = c->hand;
+  c->hand = (c->hand + 1) % TMPL_NMEMB;
+#elif TMPL_POLICY == TMPL_GCLK
+  while (c->ref[c->hand]) {
+    c->ref[c->hand]--;
+    c->hand = (c->hand + 1) % TMPL_NMEMB;
+  }
+  slot = c->hand;
+  c->hand = (c->hand + 1) % TMPL_NMEMB;
+#elif TMPL_POLICY == TMPL_RND
+  slot = rng_range(&c->rng, TMPL_NMEMB);
+#elif TMPL_POLICY == TMPL_LRU
+  slot = c->prev[TMPL_NMEMB];
+  TMPL_F(unlink)(c, slot);
+#endif
+
+  return slot;
+}
+
+/* Same as fifo_fetch(), clk_fetch(), gclk_fetch(), rnd_fetch() or
+ * lru_fetch()
+ *
+ * Returns 0 on hit
+ *         1 on miss
+ */
+static inline int TMPL_F(fetch)(TMPL_F(t) *c, uint64_t key, void **ptr) {
+  long hit;
+  size_t slot;
+
+  if ((hit = TMPL_F(find)(c, key)) >= 0) {
+#if TMPL_POLICY == TMPL_CLK
+    c->ref[hit] = 1;
+#elif TMPL_POLICY == TMPL_GCLK
+    if (c->ref[hit] < TMPL_GCLK_MAX)
+      c->ref[hit]++;
+#elif TMPL_POLICY == TMPL_LRU
+    TMPL_F(unlink)(c, hit);
+    TMPL_F(push)(c, hit);
+#endif
+    *ptr = c->page + (size_t)hit * TMPL_SIZE;
+    return 0;
+  }
+
+  if (c->used < TMPL_NMEMB) {
+    slot = c->used++;
+  } else {
+    slot = TMPL_F(victim)(c);
+    TMPL_F(index_del)(c, c->key[slot], slot);
+  }
+
+  c->key[slot] = key;
+  TMPL_F(index_set)(c, key, slot);
+#if TMPL_POLICY == TMPL_CLK || TMPL_POLICY == TMPL_GCLK
+  c->ref[slot] = 0;
+#elif TMPL_POLICY == TMPL_LRU
+  TMPL_F(push)(c, slot);
+#endif
+
+  *ptr = c->page + slot * TMPL_SIZE;
+  return 1;
+}
+
+static inline void TMPL_F(free)(TMPL_F(t) **c) {
+  free((*c)->page);
+  free(*c);
+  *c = NULL;
+}
+
+#undef TMPL_F
+#undef TMPL_BUCKETS
+#undef TMPL_SLOTS
+#undef TMPL_NAME
+#undef TMPL_POLICY
+#undef TMPL_SIZE
+#undef TMPL_NMEMB
+#undef TMPL_INDEX
@@ -0,0 +1,283 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "rng.h"
+#include "tracegen.h"
+
+#define DEFAULT_N      1000000
+#define DEFAULT_LEN    1000000
+#define DEFAULT_ALPHA  0.99
+#define DEFAULT_HOT    1000
+#define DEFAULT_P      0.9
+#define DEFAULT_PERIOD 100000
+
+/* Zipf constants for sampling by rejection-inversion (Hörmann and
+ * Derflinger), which needs no table proportional to n.
+ */
+struct zipf_s {
+  double alpha;
+  double n;
+  double h_x1;
+  double h_n;
+  double s;
+};
+
+struct phase_state {
+  struct tracegen_phase p;
+  struct zipf_s zipf;
+  uint64_t pos;
+};
+
+struct tracegen_s {
+  struct phase_state *phase;
+  int nphases;
+  int cur;
+  size_t done;
+  rng_t rng;
+};
+
+static double zipf_h(struct zipf_s *z, double x) {
+  if (z->alpha == 1.0)
+    return log(x);
+  return (pow(x, 1.0 - z->alpha) - 1.0) / (1.0 - z->alpha);
+}
+
+static double zipf_hinv(struct zipf_s *z, double x) {
+  if (z->alpha == 1.0)
+    return exp(x);
+  return pow(1.0 + x * (1.0 - z->alpha), 1.0 / (1.0 - z->alpha));
+}
+
+static void zipf_init(struct zipf_s *z, uint64_t n, double alpha) {
+  z->alpha = alpha;
+  z->n = n;
+  z->h_x1 = zipf_h(z, 1.5) - 1.0;
+  z->h_n = zipf_h(z, n + 0.5);
+  z->s = 2.0 - zipf_hinv(z, zipf_h(z, 2.5) - pow(2.0, -alpha));
+}
+
+/* Returns a rank in [0, n), rank 0 being the most popular
+ */
+static uint64_t zipf_next(struct zipf_s *z, rng_t *rng) {
+  double u, x, k;
+
+  while (1) {
+    u = z->h_n + rng_double(rng) * (z->h_x1 - z->h_n);
+    x = zipf_hinv(z, u);
+    k = floor(x + 0.5);
+    if (k < 1)
+      k = 1;
+    else if (k > z->n)
+      k = z->n;
+    if (k - x <= z->s || u >= zipf_h(z, k + 0.5) - pow(k, -z->alpha))
+      return (uint64_t)k - 1;
+  }
+}
+
+tracegen_t *tracegen_new(const struct tracegen_phase *phase, int nphases,
+                         uint64_t seed) {
+  tracegen_t *tg;
+  int i;
+
+  if (nphases < 1)
+    return NULL;
+  for (i=0; i<nphases; i++) {
+    if (!phase[i].len)
+      return NULL;
+    if (phase[i].kind != TRACEGEN_SCAN && !phase[i].n)
+      return NULL;
+    if (phase[i].kind == TRACEGEN_ZIPF && phase[i].alpha <= 0)
+      return NULL;
+    if (phase[i].kind == TRACEGEN_HOTSET &&
+        (!phase[i].hot || phase[i].hot > phase[i].n || !phase[i].period))
+      return NULL;
+  }
+
+  tg = malloc(sizeof(tracegen_t));
+  if (!tg)
+    return NULL;
+
+  tg->phase = malloc(nphases * sizeof(struct phase_state));
+  if (!tg->phase) {
+    free(tg);
+    return NULL;
+  }
+
+  for (i=0; i<nphases; i++) {
+    tg->phase[i].p = phase[i];
+    tg->phase[i].pos = 0;
+    if (phase[i].kind == TRACEGEN_ZIPF)
+      zipf_init(&tg->phase[i].zipf, phase[i].n, phase[i].alpha);
+  }
+
+  tg->nphases = nphases;
+  tg->cur = 0;
+  tg->done = 0;
+  rng_seed(&tg->rng, seed);
+
+  return tg;
+}
+
+uint64_t tracegen_next(tracegen_t *tg) {
+  struct phase_state *ps;
+  uint64_t key, shift;
+
+  ps = tg->phase + tg->cur;
+
+  switch (ps->p.kind) {
+  case TRACEGEN_UNIFORM:
+    key = rng_next(&tg->rng) % ps->p.n;
+    break;
+  case TRACEGEN_ZIPF:
+    key = zipf_next(&ps->zipf, &tg->rng);
+    break;
+  case TRACEGEN_SCAN:
+    key = ps->pos++;
+    break;
+  case TRACEGEN_LOOP:
+    key = ps->pos;
+    if (++ps->pos >= ps->p.n)
+      ps->pos = 0;
+    break;
+  case TRACEGEN_HOTSET:
+    /* ps->pos counts accesses, the hot set moves by its own size
+       every period of them */
+    shift = (ps->pos++ / ps->p.period) * ps->p.hot;
+    if (rng_double(&tg->rng) < ps->p.p)
+      key = (shift + rng_next(&tg->rng) % ps->p.hot) % ps->p.n;
+    else
+      key = rng_next(&tg->rng) % ps->p.n;
+    break;
+  default:
+    key = 0;
+  }
+
+  if (++tg->done >= ps->p.len) {
+    tg->done = 0;
+    if (++tg->cur >= tg->nphases)
+      tg->cur = 0;
+  }
+
+  return ps->p.base + key;
+}
+
+void tracegen_fill(tracegen_t *tg, uint64_t *key, size_t len) {
+  size_t i;
+
+  for (i=0; i<len; i++)
+    key[i] = tracegen_next(tg);
+}
+
+void tracegen_free(tracegen_t **tg) {
+  free((*tg)->phase);
+  free(*tg);
+  *tg = NULL;
+}
+
+struct kind_name {
+  const char *name;
+  enum tracegen_kind kind;
+};
+
+static const struct kind_name kinds[] = {
+  {"uniform", TRACEGEN_UNIFORM},
+  {"zipf",    TRACEGEN_ZIPF},
+  {"scan",    TRACEGEN_SCAN},
+  {"loop",    TRACEGEN_LOOP},
+  {"hotset",  TRACEGEN_HOTSET},
+};
+
+/* Parses one "name=value" parameter into p. Returns 0 on success, 1
+ * otherwise.
+ */
+static int parse_param(const char *s, size_t len, struct tracegen_phase *p) {
+  char buf[64], *eq, *end;
+  double d;
+
+  if (len >= sizeof(buf))
+    return 1;
+  memcpy(buf, s, len);
+  buf[len] = '\0';
+
+  eq = strchr(buf, '=');
+  if (!eq || eq[1] == '\0')
+    return 1;
+  *eq = '\0';
+  d = strtod(eq + 1, &end);
+  if (*end != '\0' || d < 0)
+    return 1;
+
+  if (!strcmp(buf, "n"))
+    p->n = d;
+  else if (!strcmp(buf, "base"))
+    p->base = d;
+  else if (!strcmp(buf, "len"))
+    p->len = d;
+  else if (!strcmp(buf, "alpha"))
+    p->alpha = d;
+  else if (!strcmp(buf, "hot"))
+    p->hot = d;
+  else if (!strcmp(buf, "p"))
+    p->p = d;
+  else if (!strcmp(buf, "period"))
+    p->period = d;
+  else
+    return 1;
+
+  return 0;
+}
+
+int tracegen_parse(const char *spec, struct tracegen_phase *phase,
+                   int maxphases) {
+  struct tracegen_phase *p;
+  const char *end, *sep;
+  size_t len;
+  int n, i;
+
+  for (n=0; *spec; n++) {
+    if (n >= maxphases)
+      return -1;
+
+    p = phase + n;
+    p->n = DEFAULT_N;
+    p->base = 0;
+    p->len = DEFAULT_LEN;
+    p->alpha = DEFAULT_ALPHA;
+    p->hot = DEFAULT_HOT;
+    p->p = DEFAULT_P;
+    p->period = DEFAULT_PERIOD;
+
+    end = strchr(spec, '+');
+    if (!end)
+      end = spec + strlen(spec);
+
+    /* the kind */
+    sep = memchr(spec, ':', end - spec);
+    if (!sep)
+      sep = end;
+    len = sep - spec;
+    for (i=0; i<sizeof(kinds)/sizeof(kinds[0]); i++)
+      if (strlen(kinds[i].name) == len && !strncmp(kinds[i].name, spec, len))
+        break;
+    if (i == sizeof(kinds)/sizeof(kinds[0]))
+      return -1;
+    p->kind = kinds[i].kind;
+
+    /* and its parameters */
+    spec = sep;
+    while (spec < end) {
+      spec++;
+      sep = memchr(spec, ',', end - spec);
+      if (!sep)
+        sep = end;
+      if (parse_param(spec, sep - spec, p))
+        return -1;
+      spec = sep;
+    }
+
+    if (*spec == '+')
+      spec++;
+  }
+
+  return n;
+}
@@ -0,0 +1,77 @@
+#ifndef TRACEGEN_H_4871a95d9efa5307052bee352ca7ad33
+#define TRACEGEN_H_4871a95d9efa5307052bee352ca7ad33
+
+/* Synthetic page access traces.
+ *
+ * A trace is a sequence of phases, each producing len keys according
+ * to one access pattern. When the last phase is done, the trace
+ * starts over with the first one, so a tracegen_t never runs dry.
+ * Two generators created from the same phases and seed produce the
+ * same keys.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef struct tracegen_s tracegen_t;
+
+enum tracegen_kind {
+  TRACEGEN_UNIFORM,  /* uniformly random over n keys */
+  TRACEGEN_ZIPF,     /* zipf(alpha) over n keys, key base+0 the hottest */
+  TRACEGEN_SCAN,     /* base, base+1, ... never repeating a key */
+  TRACEGEN_LOOP,     /* base, base+1, ..., base+n-1, base, ... */
+  TRACEGEN_HOTSET,   /* p of accesses to a hot set of hot keys that
+                        moves every period accesses, rest uniform */
+};
+
+struct tracegen_phase {
+  enum tracegen_kind kind;
+  uint64_t n;
+  uint64_t base;
+  size_t len;
+  double alpha;
+  uint64_t hot;
+  double p;
+  size_t period;
+};
+
+/* Allocates a generator for the given phases.
+ *
+ * Returns NULL if out of memory or if a phase is invalid, e.g. has
+ * len or n of 0.
+ */
+tracegen_t *tracegen_new(const struct tracegen_phase *phase, int nphases,
+                         uint64_t seed);
+
+/* Returns the next key in the trace
+ */
+uint64_t tracegen_next(tracegen_t *tg);
+
+/* Writes the next len keys to key[]
+ */
+void tracegen_fill(tracegen_t *tg, uint64_t *key, size_t len);
+
+/* Destroys a generator and releases all associated resources
+ *
+ * The tracegen pointer at *tg will be set to NULL
+ */
+void tracegen_free(tracegen_t **tg);
+
+/* Parses a textual trace description into phase[].
+ *
+ * Phases are separated by '+', each phase is a kind optionally
+ * followed by ':' and comma separated parameters, e.g.
+ *
+ *   zipf:n=100000,alpha=0.8,len=1000000+scan:base=1000000,len=50000
+ *
+ * Kinds are uniform, zipf, scan, loop and hotset. Parameters are n,
+ * base, len, alpha, hot, p and period. Unspecified parameters take
+ * the defaults listed in tracegen.c.
+ *
+ * Returns the number of phases parsed
+ *         -1 on syntax error or if there are more than maxphases
+ */
+int tracegen_parse(const char *spec, struct tracegen_phase *phase,
+                   int maxphases);
+
+#endif
@@ -0,0 +1,72 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include "tracegen.h"
+
+/* Writes a synthetic trace to stdout in the page-file format read by
+ * bench, i.e. one hex key per line. The trace is described as in
+ * tracegen_parse(), e.g.
+ *
+ *   tracegen -n 2000000 zipf:alpha=0.8 | bench - 1024
+ *
+ * Without -n, the length of one pass through all phases is used.
+ */
+
+#define MAX_PHASES 64
+#define DEFAULT_SEED 1
+
+void usage_fail(char *prog) {
+  fprintf(stderr, "Usage: %s [-s seed] [-n count] <spec>\n", prog);
+  exit(1);
+}
+
+int main(int argc, char *argv[]) {
+  struct tracegen_phase phase[MAX_PHASES];
+  tracegen_t *tg;
+  unsigned long long seed, count;
+  int nphases, opt, i;
+
+  seed = DEFAULT_SEED;
+  count = 0;
+  while ((opt = getopt(argc, argv, "s:n:")) != -1) {
+    switch (opt) {
+    case 's':
+      if (1 != sscanf(optarg, "%llu", &seed))
+        usage_fail(argv[0]);
+      break;
+    case 'n':
+      if (1 != sscanf(optarg, "%llu", &count))
+        usage_fail(argv[0]);
+      break;
+    default:
+      usage_fail(argv[0]);
+    }
+  }
+  if (optind != argc - 1)
+    usage_fail(argv[0]);
+
+  nphases = tracegen_parse(argv[optind], phase, MAX_PHASES);
+  if (nphases < 1) {
+    fprintf(stderr, "bad trace spec: '%s'\n\n", argv[optind]);
+    usage_fail(argv[0]);
+  }
+
+  tg = tracegen_new(phase, nphases, seed);
+  if (!tg) {
+    fprintf(stderr, "FAIL: invalid trace spec or out of memory\n");
+    exit(1);
+  }
+
+  if (!count)
+    for (i=0; i<nphases; i++)
+      count += phase[i].len;
+
+  while (count--)
+    if (printf("%llx\n", (unsigned long long)tracegen_next(tg)) < 0)
+      break;
+
+  tracegen_free(&tg);
+
+  return 0;
+}
@@ -0,0 +1,255 @@
+#include <stdlib.h>
+#include "twheel.h"
+
+#define WHEEL_BITS 6
+#define WHEEL_LEN (1 << WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_LEN - 1)
+#define LEVELS ((64 + WHEEL_BITS - 1) / WHEEL_BITS)
+
+#define NIL UINT32_MAX
+
+/* where a slot is, other than in a bucket */
+#define UNSCHEDULED (LEVELS * WHEEL_LEN)
+#define EXPIRED (LEVELS * WHEEL_LEN + 1)
+
+/* Each slot is on a doubly linked list, either of a bucket or of the
+ * expired slots, through next[] and prev[]. The head of each list is
+ * in head[], indexed as where[] is.
+ */
+struct twheel_s {
+  uint64_t now;
+  uint64_t *expire;
+  uint32_t *next;
+  uint32_t *prev;
+  uint16_t *where;
+  uint32_t head[LEVELS * WHEEL_LEN + 2];
+  uint64_t pending[LEVELS];
+  size_t nslots;
+};
+
+twheel_t *twheel_new(size_t nslots, uint64_t now) {
+  twheel_t *tw;
+  size_t i;
+
+  if (nslots >= NIL)
+    return NULL;
+
+  tw = malloc(sizeof(twheel_t));
+  if (!tw) goto fail;
+
+  tw->expire = malloc(nslots * sizeof(uint64_t));
+  if (!tw->expire) goto fail_expire;
+
+  tw->next = malloc(nslots * sizeof(uint32_t));
+  if (!tw->next) goto fail_next;
+
+  tw->prev = malloc(nslots * sizeof(uint32_t));
+  if (!tw->prev) goto fail_prev;
+
+  tw->where = malloc(nslots * sizeof(uint16_t));
+  if (!tw->where) goto fail_where;
+
+  for (i=0; i<nslots; i++)
+    tw->where[i] = UNSCHEDULED;
+  for (i=0; i<sizeof(tw->head)/sizeof(tw->head[0]); i++)
+    tw->head[i] = NIL;
+  for (i=0; i<LEVELS; i++)
+    tw->pending[i] = 0;
+  tw->now = now;
+  tw->nslots = nslots;
+
+  return tw;
+
+ fail_where:
+  free(tw->prev);
+ fail_prev:
+  free(tw->next);
+ fail_next:
+  free(tw->expire);
+ fail_expire:
+  free(tw);
+ fail:
+  return NULL;
+}
+
+void twheel_free(twheel_t **tw) {
+  if (!tw || !*tw)
+    return;
+  free((*tw)->expire);
+  free((*tw)->next);
+  free((*tw)->prev);
+  free((*tw)->where);
+  free(*tw);
+  *tw = NULL;
+}
+
+static uint64_t rotl(uint64_t v, int c) {
+  c &= 63;
+  return c ? (v << c) | (v >> (64 - c)) : v;
+}
+
+/* Removes slot from whatever list it is on
+ */
+static void unlink(twheel_t *tw, uint32_t slot) {
+  uint16_t w = tw->where[slot];
+
+  if (tw->prev[slot] != NIL)
+    tw->next[tw->prev[slot]] = tw->next[slot];
+  else
+    tw->head[w] = tw->next[slot];
+  if (tw->next[slot] != NIL)
+    tw->prev[tw->next[slot]] = tw->prev[slot];
+
+  /* clear the pending bit of a bucket that became empty */
+  if (w < UNSCHEDULED && tw->head[w] == NIL)
+    tw->pending[w / WHEEL_LEN] &= ~(1ULL << (w % WHEEL_LEN));
+
+  tw->where[slot] = UNSCHEDULED;
+}
+
+/* Puts slot on the list it belongs on according to its expiry
+ */
+static void link(twheel_t *tw, uint32_t slot) {
+  uint64_t diff;
+  uint16_t w;
+  int level;
+
+  if (tw->expire[slot] <= tw->now) {
+    w = EXPIRED;
+  } else {
+    /* the level of the highest bits that differ from now */
+    diff = tw->expire[slot] ^ tw->now;
+    for (level=0; diff >> WHEEL_BITS; level++)
+      diff >>= WHEEL_BITS;
+    w = level * WHEEL_LEN +
+      ((tw->expire[slot] >> (level * WHEEL_BITS)) & WHEEL_MASK);
+    tw->pending[level] |= 1ULL << (w % WHEEL_LEN);
+  }
+
+  tw->prev[slot] = NIL;
+  tw->next[slot] = tw->head[w];
+  if (tw->head[w] != NIL)
+    tw->prev[tw->head[w]] = slot;
+  tw->head[w] = slot;
+  tw->where[slot] = w;
+}
+
+void twheel_set(twheel_t *tw, size_t slot, uint64_t expire) {
+  if (tw->where[slot] != UNSCHEDULED)
+    unlink(tw, slot);
+  tw->expire[slot] = expire;
+  link(tw, slot);
+}
+
+void twheel_del(twheel_t *tw, size_t slot) {
+  if (tw->where[slot] != UNSCHEDULED)
+    unlink(tw, slot);
+}
+
+int twheel_expired(twheel_t *tw, size_t slot, uint64_t now) {
+  return tw->where[slot] != UNSCHEDULED && tw->expire[slot] <= now;
+}
+
+/* Moves the time to now, relinking the slots of every bucket whose
+ * time has come. These either have expired or move to a lower level.
+ */
+static void twheel_advance(twheel_t *tw, uint64_t now) {
+  uint64_t mask, from, to;
+  uint32_t todo, slot, next;
+  int level, bucket, n;
+
+  todo = NIL;
+  for (level=0; level<LEVELS; level++) {
+    from = tw->now >> (level * WHEEL_BITS);
+    to = now >> (level * WHEEL_BITS);
+    if (from == to)
+      break;
+
+    /* the buckets passed, i.e. after from up to and including to */
+    if (to - from >= WHEEL_LEN) {
+      mask = ~0ULL;
+    } else {
+      n = (to - from) & WHEEL_MASK;
+      mask = rotl((1ULL << n) - 1, (from & WHEEL_MASK) + 1);
+    }
+    mask &= tw->pending[level];
+
+    /* gather their slots on a singly linked todo list */
+    while (mask) {
+      bucket = __builtin_ctzll(mask);
+      mask &= mask - 1;
+      for (slot = tw->head[level * WHEEL_LEN + bucket]; slot != NIL;
+           slot = next) {
+        next = tw->next[slot];
+        tw->where[slot] = UNSCHEDULED;
+        tw->next[slot] = todo;
+        todo = slot;
+      }
+      tw->head[level * WHEEL_LEN + bucket] = NIL;
+      tw->pending[level] &= ~(1ULL << bucket);
+    }
+  }
+
+  tw->now = now;
+
+  for (slot = todo; slot != NIL; slot = next) {
+    next = tw->next[slot];
+    link(tw, slot);
+  }
+}
+
+void twheel_move(twheel_t *tw, size_t from, size_t to) {
+  twheel_del(tw, to);
+  if (tw->where[from] == UNSCHEDULED)
+    return;
+  tw->expire[to] = tw->expire[from];
+  unlink(tw, from);
+  link(tw, to);
+}
+
+int twheel_resize(twheel_t *tw, size_t nslots) {
+  uint64_t *expire;
+  uint32_t *next, *prev;
+  uint16_t *where;
+  size_t i;
+
+  if (nslots >= NIL)
+    return -1;
+
+  /* when shrinking, the old arrays will do if realloc() fails */
+  expire = realloc(tw->expire, nslots * sizeof(uint64_t));
+  if (expire)
+    tw->expire = expire;
+  next = realloc(tw->next, nslots * sizeof(uint32_t));
+  if (next)
+    tw->next = next;
+  prev = realloc(tw->prev, nslots * sizeof(uint32_t));
+  if (prev)
+    tw->prev = prev;
+  where = realloc(tw->where, nslots * sizeof(uint16_t));
+  if (where)
+    tw->where = where;
+
+  if (nslots > tw->nslots) {
+    if (!expire || !next || !prev || !where)
+      return -1;
+    for (i=tw->nslots; i<nslots; i++)
+      tw->where[i] = UNSCHEDULED;
+  }
+  tw->nslots = nslots;
+
+  return 0;
+}
+
+int twheel_pop(twheel_t *tw, uint64_t now, size_t *slot) {
+  if (now > tw->now)
+    twheel_advance(tw, now);
+
+  if (tw->head[EXPIRED] == NIL)
+    return 1;
+
+  *slot = tw->head[EXPIRED];
+  unlink(tw, *slot);
+
+  return 0;
+}
@@ -0,0 +1,71 @@
+#ifndef TWHEEL_H_3c8e1f5a7b9d4c20a6e2f4b8d0c7a915
+#define TWHEEL_H_3c8e1f5a7b9d4c20a6e2f4b8d0c7a915
+
+/* Hierarchical timer wheel.
+ *
+ * A twheel_t schedules expiry times for a fixed number of slots,
+ * numbered 0 to nslots-1, e.g. the pages of a cache. Time is a
+ * uint64_t in whatever unit the caller likes, and only moves forward.
+ *
+ * Each level of the wheel has 64 buckets covering 6 bits of the expiry
+ * time, with a bitmap of non-empty buckets. A slot is kept at the
+ * level of the highest bits in which its expiry differs from the
+ * current time, and cascades down as time approaches, so each slot
+ * is moved at most once per level. Setting, deleting and popping are
+ * thus amortized O(1), and advancing the time only visits non-empty
+ * buckets.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef struct twheel_s twheel_t;
+
+/* Allocates a wheel for nslots slots, none of them scheduled, with
+ * the current time at now.
+ *
+ * Returns NULL if out of memory or if nslots >= 2^32-1.
+ */
+twheel_t *twheel_new(size_t nslots, uint64_t now);
+
+/* Destroys a wheel and releases all associated resources
+ *
+ * The twheel pointer at *tw will be set to NULL
+ */
+void twheel_free(twheel_t **tw);
+
+/* Schedules slot to expire at time expire, replacing any earlier
+ * schedule. A slot expires once the time is >= expire.
+ */
+void twheel_set(twheel_t *tw, size_t slot, uint64_t expire);
+
+/* Unschedules slot, if scheduled
+ */
+void twheel_del(twheel_t *tw, size_t slot);
+
+/* Returns true if slot is scheduled to expire at or before now
+ */
+int twheel_expired(twheel_t *tw, size_t slot, uint64_t now);
+
+/* Moves the schedule of slot from, if any, to slot to, unscheduling
+ * from and replacing any schedule of to
+ */
+void twheel_move(twheel_t *tw, size_t from, size_t to);
+
+/* Resizes the wheel to nslots slots. Slots added are unscheduled,
+ * and slots removed must be unscheduled beforehand.
+ *
+ * Returns 0 on success
+ *         -1 if out of memory or if nslots >= 2^32-1
+ */
+int twheel_resize(twheel_t *tw, size_t nslots);
+
+/* Advances the time to now, unless it is already later, and
+ * unschedules and retrieves an expired slot.
+ *
+ * Returns 0 on success
+ *         1 if no slot has expired
+ */
+int twheel_pop(twheel_t *tw, uint64_t now, size_t *slot);
+
+#endif
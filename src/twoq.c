@@ -0,0 +1,259 @@
+#include <stdlib.h>
+#include <assert.h>
+#include "arena.h"
+#include "ghost.h"
+#include "linkmap.h"
+#include "twheel.h"
+#include "twoq.h"
+
+#include <stdio.h>
+
+#define MAX(a,b) ((a) > (b) ? (a) : (b))
+
+/* Full 2Q (Johnson and Shasha, VLDB '94).
+ *
+ * New pages enter A1in, a FIFO. Pages falling out of A1in are
+ * remembered by key only in A1out, and a page that is missed while in
+ * A1out goes to Am, an LRU. Hits in A1in do nothing, so correlated
+ * references right after a miss don't make a page look hot.
+ *
+ * Am and A1in are lists of one linkmap, mapping keys to page slots in
+ * the arena. A1out is a linkmap of keys, or a ghost_t.
+ */
+
+#define AM 0
+#define A1IN 1
+
+struct twoq_s {
+  size_t nmemb;
+  size_t kin;
+  size_t kout;
+  linkmap_t *lm;
+  linkmap_t *out;
+  ghost_t *ghost;
+  arena_t *arena;
+  /* only once pages start expiring */
+  twheel_t *tw;
+  uint64_t now;
+};
+
+twoq_t *twoq_new(size_t size, size_t nmemb) {
+  struct twoq_opts opts = {.kin = 0, .kout = 0, .ghost = 0};
+
+  return twoq_new_ex(size, nmemb, &opts);
+}
+
+twoq_t *twoq_new_ex(size_t size, size_t nmemb, const struct twoq_opts *opts) {
+  twoq_t *r;
+
+  assert(nmemb >= 2);
+
+  r = calloc(1, sizeof(twoq_t));
+  if (!r) goto fail;
+
+  r->nmemb = nmemb;
+  r->kin = opts->kin ? opts->kin : MAX(1, nmemb >> 2);
+  r->kout = opts->kout ? opts->kout : MAX(1, nmemb >> 1);
+  if (r->kin >= nmemb)
+    r->kin = nmemb - 1;
+
+  r->arena = arena_new(size, nmemb);
+  if (!r->arena) goto fail_arena;
+
+  r->lm = linkmap_new_lists(nmemb, 2);
+  if (!r->lm) goto fail_lm;
+
+  if (opts->ghost) {
+    r->ghost = ghost_new(r->kout);
+    if (!r->ghost) goto fail_out;
+  } else {
+    r->out = linkmap_new(r->kout);
+    if (!r->out) goto fail_out;
+  }
+
+  return r;
+
+ fail_out:
+  linkmap_free(&r->lm);
+ fail_lm:
+  arena_free(&r->arena);
+ fail_arena:
+  free(r);
+ fail:
+  return NULL;
+}
+
+/* Sets when the page in slot expires, if pages expire at all
+ */
+static void twoq_expire(twoq_t *twoq, size_t slot, uint64_t ttl) {
+  if (!twoq->tw)
+    return;
+  if (ttl)
+    twheel_set(twoq->tw, slot, twoq->now + ttl);
+  else
+    twheel_del(twoq->tw, slot);
+}
+
+/* Removes the page in slot from the cache
+ */
+static void twoq_drop(twoq_t *twoq, size_t slot) {
+  linkmap_del(twoq->lm, arena_key(twoq->arena, slot));
+  if (twoq->tw)
+    twheel_del(twoq->tw, slot);
+  arena_release(twoq->arena, slot);
+}
+
+/* Frees a page, an expired one if any, otherwise from A1in if it
+ * holds more than kin pages and from Am if not. Keys leaving A1in are
+ * remembered in A1out, but expired ones aren't, as they weren't
+ * pushed out.
+ */
+static void twoq_evict(twoq_t *twoq) {
+  uint64_t k;
+  void *v;
+  size_t slot;
+
+  if (twoq->tw && !twheel_pop(twoq->tw, twoq->now, &slot)) {
+    twoq_drop(twoq, slot);
+    return;
+  }
+
+  if (linkmap_size_in(twoq->lm, A1IN) > twoq->kin ||
+      !linkmap_size_in(twoq->lm, AM)) {
+    linkmap_get_tail_in(twoq->lm, A1IN, &k, &v);
+
+    if (twoq->ghost) {
+      ghost_add(twoq->ghost, k);
+    } else {
+      if (linkmap_size(twoq->out) >= twoq->kout)
+        linkmap_del_tail(twoq->out);
+      linkmap_set(twoq->out, k, NULL);
+    }
+  } else {
+    linkmap_get_tail_in(twoq->lm, AM, &k, &v);
+  }
+
+  twoq_drop(twoq, (uintptr_t)v);
+}
+
+int twoq_fetch(twoq_t *twoq, uint64_t key, void **ptr) {
+  return twoq_fetch_ttl(twoq, key, twoq->now, 0, ptr);
+}
+
+int twoq_fetch_ttl(twoq_t *twoq, uint64_t key, uint64_t now, uint64_t ttl,
+                   void **ptr) {
+  void *val;
+  size_t slot;
+  int list;
+
+  if (ttl && !twoq->tw) {
+    twoq->tw = twheel_new(twoq->nmemb, twoq->now);
+    if (!twoq->tw)
+      return -1;
+  }
+  if (now > twoq->now)
+    twoq->now = now;
+
+  if (!linkmap_get_list(twoq->lm, key, &val, &list)) {
+    slot = (uintptr_t)val;
+
+    /* an expired page starts over in A1in */
+    if (twoq->tw && twheel_expired(twoq->tw, slot, twoq->now)) {
+      linkmap_move(twoq->lm, key, A1IN, NULL, NULL);
+      twoq_expire(twoq, slot, ttl);
+      *ptr = arena_page(twoq->arena, slot);
+      return 1;
+    }
+
+    /* hit in Am moves to MRU, hit in A1in leaves the page be */
+    if (list == AM)
+      linkmap_move(twoq->lm, key, AM, NULL, NULL);
+    *ptr = arena_page(twoq->arena, (uintptr_t)val);
+    return 0;
+  }
+
+  if (arena_alloc(twoq->arena, key, &slot)) {
+    twoq_evict(twoq);
+    arena_alloc(twoq->arena, key, &slot);
+  }
+
+  /* seen recently enough to be in A1out, so it goes to Am */
+  if (twoq->ghost)
+    list = ghost_has(twoq->ghost, key) ? AM : A1IN;
+  else
+    list = linkmap_del(twoq->out, key) ? A1IN : AM;
+  linkmap_set_in(twoq->lm, list, key, (void *)(uintptr_t)slot);
+  twoq_expire(twoq, slot, ttl);
+
+  *ptr = arena_page(twoq->arena, slot);
+  return 1;
+}
+
+int twoq_invalidate(twoq_t *twoq, uint64_t key) {
+  void *val;
+
+  if (linkmap_get(twoq->lm, key, &val))
+    return 1;
+
+  twoq_drop(twoq, (uintptr_t)val);
+  return 0;
+}
+
+/* Follows a page the arena moved while shrinking
+ */
+static void twoq_move(void *ctx, size_t from, size_t to) {
+  twoq_t *twoq = ctx;
+
+  linkmap_set(twoq->lm, arena_key(twoq->arena, to), (void *)(uintptr_t)to);
+  if (twoq->tw)
+    twheel_move(twoq->tw, from, to);
+}
+
+int twoq_resize(twoq_t *twoq, size_t nmemb) {
+  size_t kin, kout;
+
+  if (nmemb < 2)
+    return -1;
+
+  /* A1in and A1out keep their share of the cache */
+  kin = MAX(1, twoq->kin * nmemb / twoq->nmemb);
+  if (kin >= nmemb)
+    kin = nmemb - 1;
+  kout = MAX(1, twoq->kout * nmemb / twoq->nmemb);
+
+  if (nmemb > twoq->nmemb) {
+    if ((twoq->out && linkmap_grow(twoq->out, kout)) ||
+        (twoq->ghost && ghost_resize(twoq->ghost, kout)) ||
+        (twoq->tw && twheel_resize(twoq->tw, nmemb)) ||
+        linkmap_grow(twoq->lm, nmemb) ||
+        arena_resize(twoq->arena, nmemb, NULL, NULL))
+      return -1;
+    twoq->kin = kin;
+  } else {
+    twoq->kin = kin;
+    while (arena_used(twoq->arena) > nmemb)
+      twoq_evict(twoq);
+    arena_resize(twoq->arena, nmemb, twoq_move, twoq);
+    if (twoq->tw)
+      twheel_resize(twoq->tw, nmemb);
+    if (twoq->out)
+      while (linkmap_size(twoq->out) > kout)
+        linkmap_del_tail(twoq->out);
+    if (twoq->ghost)
+      ghost_resize(twoq->ghost, kout);
+  }
+
+  twoq->kout = kout;
+  twoq->nmemb = nmemb;
+  return 0;
+}
+
+void twoq_free(twoq_t **twoq) {
+  arena_free(&(*twoq)->arena);
+  linkmap_free(&(*twoq)->lm);
+  linkmap_free(&(*twoq)->out);
+  ghost_free(&(*twoq)->ghost);
+  twheel_free(&(*twoq)->tw);
+  free(*twoq);
+  *twoq = NULL;
+}
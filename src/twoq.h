@@ -0,0 +1,41 @@
+#ifndef TWOQ_H_0c1f3b7d2a6e4f19b8d5e7a0c3f6b912
+#define TWOQ_H_0c1f3b7d2a6e4f19b8d5e7a0c3f6b912
+
+#include <stdint.h>
+
+typedef struct twoq_s twoq_t;
+
+/* Options for twoq_new_ex().
+ *
+ * kin is the number of pages in the A1in FIFO before it starts losing
+ * pages to the A1out ghost queue, and kout the number of keys A1out
+ * remembers. 0 means the defaults of nmemb/4 and nmemb/2 suggested by
+ * Johnson and Shasha.
+ *
+ * If ghost is set, A1out is a ghost_t (see ghost.h) rather than a
+ * linkmap_t, which takes a few bytes per key instead of a few dozen.
+ * A key that goes to Am stays in it until it ages out, though.
+ */
+struct twoq_opts {
+  size_t kin;
+  size_t kout;
+  int ghost;
+};
+
+twoq_t *twoq_new(size_t size, size_t nmemb);
+twoq_t *twoq_new_ex(size_t size, size_t nmemb, const struct twoq_opts *opts);
+int twoq_fetch(twoq_t *twoq, uint64_t key, void **ptr);
+
+/* Same as lru_fetch_ttl(), see lru.h. An expired page starts over in
+ * A1in.
+ */
+int twoq_fetch_ttl(twoq_t *twoq, uint64_t key, uint64_t now, uint64_t ttl,
+                   void **ptr);
+
+/* Same as lru_invalidate() and lru_resize(), see lru.h
+ */
+int twoq_invalidate(twoq_t *twoq, uint64_t key);
+int twoq_resize(twoq_t *twoq, size_t nmemb);
+void twoq_free(twoq_t **twoq);
+
+#endif
@@ -0,0 +1,188 @@
+#include <stdio.h>
+#include <string.h>
+#include <check.h>
+#include "arena.h"
+
+
+#define ALLOC(key, data)                                    \
+  do {                                                      \
+    size_t s;                                               \
+    fail_unless(0 == arena_alloc(a, key, &s));              \
+    fail_unless(arena_key(a, s) == key);                    \
+    memcpy(arena_page(a, s), data, strlen(data));           \
+    slot[key] = s;                                          \
+  } while(0)
+
+#define CHECK(key, data)                                    \
+  do {                                                      \
+    fail_unless(arena_in_use(a, slot[key]));                \
+    fail_unless(arena_key(a, slot[key]) == key);            \
+    fail_unless(!memcmp(arena_page(a, slot[key]), data,     \
+                        strlen(data)));                     \
+  } while(0)
+
+/* follows pages around like a cache would */
+static void move(void *ctx, size_t from, size_t to) {
+  size_t *slot = ctx;
+  size_t i;
+
+  for (i=0; slot[i] != from; i++)
+    ;
+  slot[i] = to;
+}
+
+START_TEST(test_alloc) {
+  arena_t *a = arena_new(10, 4);
+  size_t slot[8], s;
+
+  fail_unless(a != NULL);
+  fail_unless(arena_nmemb(a) == 4);
+  fail_unless(arena_used(a) == 0);
+
+  ALLOC(0, "aaaaaaaaaa");
+  ALLOC(1, "bbbbbbbbbb");
+  ALLOC(2, "cccccccccc");
+  ALLOC(3, "dddddddddd");
+  fail_unless(arena_used(a) == 4);
+
+  /* all pages are distinct and hold their data */
+  fail_unless(slot[0] != slot[1] && slot[1] != slot[2] &&
+              slot[2] != slot[3] && slot[0] != slot[3]);
+  CHECK(0, "aaaaaaaaaa");
+  CHECK(1, "bbbbbbbbbb");
+  CHECK(2, "cccccccccc");
+  CHECK(3, "dddddddddd");
+
+  /* full */
+  fail_unless(1 == arena_alloc(a, 4, &s));
+
+  /* the page released last is handed out first */
+  arena_release(a, slot[1]);
+  arena_release(a, slot[3]);
+  fail_unless(!arena_in_use(a, slot[1]));
+  fail_unless(arena_used(a) == 2);
+  fail_unless(0 == arena_alloc(a, 4, &s) && s == slot[3]);
+  fail_unless(0 == arena_alloc(a, 5, &s) && s == slot[1]);
+  fail_unless(arena_key(a, s) == 5);
+
+  arena_free(&a);
+  fail_unless(a == NULL);
+}
+END_TEST
+
+START_TEST(test_grow) {
+  /* a page this big leaves room for 4 pages per chunk */
+  arena_t *a = arena_new(300000, 6);
+  size_t slot[16], s;
+  void *p;
+
+  fail_unless(a != NULL);
+
+  ALLOC(0, "aaaaaaaaaa");
+  ALLOC(1, "bbbbbbbbbb");
+  ALLOC(2, "cccccccccc");
+  ALLOC(3, "dddddddddd");
+  ALLOC(4, "eeeeeeeeee");
+  ALLOC(5, "ffffffffff");
+  p = arena_page(a, slot[4]);
+
+  /* growing keeps pages where they are */
+  fail_unless(0 == arena_resize(a, 16, NULL, NULL));
+  fail_unless(arena_nmemb(a) == 16);
+  fail_unless(p == arena_page(a, slot[4]));
+  CHECK(0, "aaaaaaaaaa");
+  CHECK(5, "ffffffffff");
+
+  ALLOC(6, "gggggggggg");
+  ALLOC(7, "hhhhhhhhhh");
+  ALLOC(8, "iiiiiiiiii");
+  ALLOC(9, "jjjjjjjjjj");
+  ALLOC(10, "kkkkkkkkkk");
+  ALLOC(11, "llllllllll");
+  ALLOC(12, "mmmmmmmmmm");
+  ALLOC(13, "nnnnnnnnnn");
+  ALLOC(14, "oooooooooo");
+  ALLOC(15, "pppppppppp");
+  fail_unless(1 == arena_alloc(a, 16, &s));
+  CHECK(10, "kkkkkkkkkk");
+  CHECK(15, "pppppppppp");
+
+  arena_free(&a);
+}
+END_TEST
+
+START_TEST(test_shrink) {
+  arena_t *a = arena_new(300000, 12);
+  size_t slot[13], s;
+
+  fail_unless(a != NULL);
+
+  ALLOC(0, "aaaaaaaaaa");
+  ALLOC(1, "bbbbbbbbbb");
+  ALLOC(2, "cccccccccc");
+  ALLOC(3, "dddddddddd");
+  ALLOC(4, "eeeeeeeeee");
+  ALLOC(5, "ffffffffff");
+  ALLOC(6, "gggggggggg");
+  ALLOC(7, "hhhhhhhhhh");
+  ALLOC(8, "iiiiiiiiii");
+  ALLOC(9, "jjjjjjjjjj");
+  slot[12] = SIZE_MAX;
+
+  /* can't shrink below the pages in use */
+  fail_unless(-1 == arena_resize(a, 6, move, slot));
+
+  /* pages beyond the new size move down into free ones */
+  arena_release(a, slot[1]);
+  arena_release(a, slot[2]);
+  arena_release(a, slot[6]);
+  arena_release(a, slot[8]);
+  slot[1] = slot[2] = slot[6] = slot[8] = SIZE_MAX - 1;
+  fail_unless(0 == arena_resize(a, 6, move, slot));
+  fail_unless(arena_nmemb(a) == 6);
+  fail_unless(arena_used(a) == 6);
+  fail_unless(slot[7] < 6 && slot[9] < 6);
+  CHECK(0, "aaaaaaaaaa");
+  CHECK(3, "dddddddddd");
+  CHECK(4, "eeeeeeeeee");
+  CHECK(5, "ffffffffff");
+  CHECK(7, "hhhhhhhhhh");
+  CHECK(9, "jjjjjjjjjj");
+  fail_unless(1 == arena_alloc(a, 10, &s));
+
+  /* and it can grow again */
+  fail_unless(0 == arena_resize(a, 8, NULL, NULL));
+  ALLOC(10, "kkkkkkkkkk");
+  ALLOC(11, "llllllllll");
+  fail_unless(1 == arena_alloc(a, 12, &s));
+  CHECK(7, "hhhhhhhhhh");
+  CHECK(11, "llllllllll");
+
+  arena_free(&a);
+}
+END_TEST
+
+Suite *arena_suite() {
+  TCase *tc;
+  Suite *s;
+
+  s = suite_create ("arena");
+
+  tc = tcase_create ("foo");
+  tcase_add_test (tc, test_alloc);
+  tcase_add_test (tc, test_grow);
+  tcase_add_test (tc, test_shrink);
+  suite_add_tcase (s, tc);
+
+  return s;
+}
+
+int main(void) {
+  int number_failed;
+  Suite *s = arena_suite();
+  SRunner *sr = srunner_create(s);
+  srunner_run_all (sr, CK_NORMAL);
+  number_failed = srunner_ntests_failed (sr);
+  srunner_free (sr);
+  return (number_failed == 0) ? 0 : 1;
+}
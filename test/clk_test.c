@@ -17,6 +17,26 @@
       memcpy(p, data, strlen(data));                          \
   } while(0)
 
+#define FETCH_TTL(key, now, ttl, data, cached)                \
+  do {                                                        \
+    void *p;                                                  \
+    fail_unless(cached == clk_fetch_ttl(clk, key, now, ttl, &p)); \
+    if (cached == CACHED)                                     \
+      fail_unless(!memcmp(p, data, strlen(data)));            \
+    else                                                      \
+      memcpy(p, data, strlen(data));                          \
+  } while(0)
+
+#define PREFETCH(key, data, cached)                       \
+  do {                                                    \
+    void *p;                                              \
+    fail_unless(cached == clk_prefetch(clk, key, &p));    \
+    if (cached == CACHED)                                 \
+      fail_unless(!memcmp(p, data, strlen(data)));        \
+    else                                                  \
+      memcpy(p, data, strlen(data));                      \
+  } while(0)
+
 START_TEST(test_no_eviction) {
   clk_t *clk = clk_new(10, 8);
 
@@ -126,6 +146,130 @@ START_TEST(test_eviction_order) {
 END_TEST
 
 
+START_TEST(test_ttl) {
+  clk_t *clk = clk_new(10, 4);
+
+  /* 0 and 1 live forever, 2 and 3 until 10, 3 being referenced */
+  FETCH_TTL(0, 0, 0, "aaaaaaaaaa", !CACHED);
+  FETCH_TTL(1, 0, 0, "bbbbbbbbbb", !CACHED);
+  FETCH_TTL(2, 0, 10, "cccccccccc", !CACHED);
+  FETCH_TTL(3, 0, 10, "dddddddddd", !CACHED);
+  FETCH_TTL(3, 9, 10, "dddddddddd", CACHED);
+
+  /* an expired page is a miss, and reloading it gives it a new ttl */
+  FETCH_TTL(2, 10, 100, "CCCCCCCCCC", !CACHED);
+  FETCH_TTL(2, 11, 100, "CCCCCCCCCC", CACHED);
+
+  /* 3 has expired too, and is reclaimed before the hand evicts 0,
+     though it is referenced */
+  FETCH_TTL(4, 20, 0, "eeeeeeeeee", !CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(1, "bbbbbbbbbb", CACHED);
+  FETCH(2, "CCCCCCCCCC", CACHED);
+  FETCH(4, "eeeeeeeeee", CACHED);
+  FETCH(3, "dddddddddd", !CACHED);
+
+  clk_free(&clk);
+  fail_unless(clk == NULL);
+}
+END_TEST
+
+START_TEST(test_invalidate) {
+  clk_t *clk = clk_new(10, 4);
+
+  fail_unless(clk != NULL);
+
+  FETCH(0, "aaaaaaaaaa", !CACHED);
+  FETCH(1, "bbbbbbbbbb", !CACHED);
+  FETCH(2, "cccccccccc", !CACHED);
+  FETCH(3, "dddddddddd", !CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(1, "bbbbbbbbbb", CACHED);
+
+  /* an invalidated page is gone, and makes room without evicting,
+     after which the hand passes over the referenced pages 0 and 1
+     to take the new one */
+  fail_unless(0 == clk_invalidate(clk, 2));
+  fail_unless(1 == clk_invalidate(clk, 2));
+  fail_unless(1 == clk_invalidate(clk, 100));
+  FETCH(4, "eeeeeeeeee", !CACHED);
+  FETCH(5, "ffffffffff", !CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(1, "bbbbbbbbbb", CACHED);
+  FETCH(3, "dddddddddd", CACHED);
+  FETCH(5, "ffffffffff", CACHED);
+  FETCH(4, "eeeeeeeeee", !CACHED);
+
+  clk_free(&clk);
+  fail_unless(clk == NULL);
+}
+END_TEST
+
+START_TEST(test_resize) {
+  clk_t *clk = clk_new(10, 4);
+
+  FETCH(0, "aaaaaaaaaa", !CACHED);
+  FETCH(1, "bbbbbbbbbb", !CACHED);
+  FETCH(2, "cccccccccc", !CACHED);
+  FETCH(3, "dddddddddd", !CACHED);
+
+  /* growing keeps every page, and adds room for more */
+  fail_unless(0 == clk_resize(clk, 8));
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(1, "bbbbbbbbbb", CACHED);
+  FETCH(2, "cccccccccc", CACHED);
+  FETCH(3, "dddddddddd", CACHED);
+  FETCH(4, "eeeeeeeeee", !CACHED);
+  FETCH(5, "ffffffffff", !CACHED);
+  FETCH(6, "gggggggggg", !CACHED);
+  FETCH(7, "hhhhhhhhhh", !CACHED);
+  FETCH(5, "ffffffffff", CACHED);
+
+  /* shrinking sweeps the hand once round, clearing the references
+     of 0-3 and 5 and dropping 4, 6 and 7, then takes 0 */
+  fail_unless(0 == clk_resize(clk, 4));
+  FETCH(1, "bbbbbbbbbb", CACHED);
+  FETCH(2, "cccccccccc", CACHED);
+  FETCH(3, "dddddddddd", CACHED);
+  FETCH(5, "ffffffffff", CACHED);
+  FETCH(0, "aaaaaaaaaa", !CACHED);
+
+  clk_free(&clk);
+  fail_unless(clk == NULL);
+}
+END_TEST
+
+START_TEST(test_prefetch) {
+  clk_t *clk = clk_new(10, 4);
+
+  fail_unless(clk != NULL);
+
+  FETCH(0, "aaaaaaaaaa", !CACHED);
+  FETCH(1, "bbbbbbbbbb", !CACHED);
+  FETCH(2, "cccccccccc", !CACHED);
+  FETCH(3, "dddddddddd", !CACHED);
+  FETCH(1, "bbbbbbbbbb", CACHED);
+  FETCH(2, "cccccccccc", CACHED);
+  FETCH(3, "dddddddddd", CACHED);
+
+  /* prefetching a cached page doesn't reference it */
+  PREFETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(4, "eeeeeeeeee", !CACHED);
+  FETCH(0, "aaaaaaaaaa", !CACHED);
+
+  /* and a prefetched page goes unless fetched before the hand is
+     back */
+  PREFETCH(5, "ffffffffff", !CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(2, "cccccccccc", CACHED);
+  FETCH(3, "dddddddddd", CACHED);
+  FETCH(6, "gggggggggg", !CACHED);
+  FETCH(5, "ffffffffff", !CACHED);
+
+  clk_free(&clk);
+}
+END_TEST
+
 Suite *clk_suite() {
   TCase *tc;
   Suite *s;
@@ -135,6 +279,10 @@ Suite *clk_suite() {
   tc = tcase_create ("foo");
   tcase_add_test (tc, test_no_eviction);
   tcase_add_test (tc, test_eviction_order);
+  tcase_add_test (tc, test_ttl);
+  tcase_add_test (tc, test_invalidate);
+  tcase_add_test (tc, test_resize);
+  tcase_add_test (tc, test_prefetch);
   suite_add_tcase (s, tc);
 
   return s;
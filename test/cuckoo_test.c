@@ -0,0 +1,185 @@
+#include <check.h>
+#include "cuckoo.h"
+#include "htable.h"
+
+#define GET_AND_CHECK(t, k, v)                          \
+  do {                                                  \
+    void *val;                                          \
+    fail_unless(!cuckoo_get(t, k, (void **)&val));      \
+    fail_unless(val == (void *)v,                       \
+                "expected %x got %x", v, val);          \
+  } while (0)
+
+
+START_TEST(test_set_get) {
+  cuckoo_t *t = cuckoo_new(10, 0);
+  void *val;
+
+  fail_unless(!cuckoo_set(t, 42, (void *)1337));
+  GET_AND_CHECK(t, 42, 1337);
+
+  fail_unless(!cuckoo_set(t, 1, (void *)101));
+  fail_unless(!cuckoo_set(t, 2, (void *)102));
+  fail_unless(!cuckoo_set(t, 0xdeadbeefdeadbeefLL, (void *)0xcafebabe));
+  fail_unless(!cuckoo_set(t, 4711, NULL));
+  GET_AND_CHECK(t, 42, 1337);
+  GET_AND_CHECK(t, 1, 101);
+  GET_AND_CHECK(t, 2, 102);
+  GET_AND_CHECK(t, 0xdeadbeefdeadbeefLL, 0xcafebabe);
+  GET_AND_CHECK(t, 4711, NULL);
+  fail_unless(1 == cuckoo_get(t, 3, &val));
+  fail_unless(cuckoo_size(t) == 5);
+
+  /* setting a key again replaces its value */
+  fail_unless(!cuckoo_set(t, 42, (void *)1338));
+  GET_AND_CHECK(t, 42, 1338);
+  fail_unless(cuckoo_size(t) == 5);
+
+  cuckoo_free(&t);
+  fail_unless(t == NULL);
+}
+END_TEST
+
+START_TEST(test_set_full) {
+  cuckoo_t *t = cuckoo_new(5, 0);
+
+  fail_unless(!cuckoo_set(t, 1, (void *)101));
+  fail_unless(!cuckoo_set(t, 2, (void *)102));
+  fail_unless(!cuckoo_set(t, 3, (void *)103));
+  fail_unless(!cuckoo_set(t, 4, (void *)104));
+  fail_unless(!cuckoo_set(t, 5, (void *)105));
+  fail_unless(-1 == cuckoo_set(t, 6, (void *)106));
+
+  /* replacing still works when full */
+  fail_unless(!cuckoo_set(t, 1, (void *)1231));
+  GET_AND_CHECK(t, 1, 1231);
+  GET_AND_CHECK(t, 5, 105);
+
+  cuckoo_free(&t);
+}
+END_TEST
+
+START_TEST(test_pop_del) {
+  cuckoo_t *t = cuckoo_new(5, 0);
+  void *val;
+
+  fail_unless(!cuckoo_set(t, 1, (void *)101));
+  fail_unless(!cuckoo_set(t, 2, (void *)102));
+  fail_unless(!cuckoo_set(t, 3, (void *)103));
+
+  fail_unless(!cuckoo_pop(t, 2, &val));
+  fail_unless(val == (void *)102);
+  fail_unless(1 == cuckoo_pop(t, 2, &val));
+  fail_unless(1 == cuckoo_get(t, 2, &val));
+  fail_unless(!cuckoo_del(t, 1));
+  fail_unless(1 == cuckoo_del(t, 1));
+  fail_unless(cuckoo_size(t) == 1);
+  GET_AND_CHECK(t, 3, 103);
+
+  cuckoo_free(&t);
+}
+END_TEST
+
+START_TEST(test_many) {
+  /* enough keys that entries get moved to their other bucket */
+  cuckoo_t *t = cuckoo_new(100000, 0);
+  uint64_t k;
+  void *val;
+
+  for (k=0; k<100000; k++)
+    fail_unless(!cuckoo_set(t, k * 7919, (void *)(uintptr_t)k));
+  fail_unless(-1 == cuckoo_set(t, 1, NULL));
+  fail_unless(cuckoo_size(t) == 100000);
+
+  for (k=0; k<100000; k++)
+    GET_AND_CHECK(t, k * 7919, k);
+  fail_unless(1 == cuckoo_get(t, 1, &val));
+
+  for (k=0; k<100000; k+=2)
+    fail_unless(!cuckoo_del(t, k * 7919));
+  for (k=0; k<100000; k++)
+    fail_unless(cuckoo_get(t, k * 7919, &val) == !(k & 1));
+
+  cuckoo_free(&t);
+}
+END_TEST
+
+START_TEST(test_grow) {
+  cuckoo_t *t = cuckoo_new(4, 1);
+  uint64_t k;
+
+  /* doubles whenever it is full */
+  for (k=0; k<10000; k++)
+    fail_unless(!cuckoo_set(t, k, (void *)(uintptr_t)(k + 1)));
+  fail_unless(cuckoo_size(t) == 10000);
+  for (k=0; k<10000; k++)
+    GET_AND_CHECK(t, k, k + 1);
+  cuckoo_free(&t);
+
+  /* or on request */
+  t = cuckoo_new(4, 0);
+  for (k=0; k<4; k++)
+    fail_unless(!cuckoo_set(t, k, (void *)(uintptr_t)(k + 1)));
+  fail_unless(-1 == cuckoo_set(t, 4, NULL));
+  fail_unless(!cuckoo_grow(t, 1000));
+  for (k=4; k<1000; k++)
+    fail_unless(!cuckoo_set(t, k, (void *)(uintptr_t)(k + 1)));
+  fail_unless(-1 == cuckoo_set(t, 1000, NULL));
+  for (k=0; k<1000; k++)
+    GET_AND_CHECK(t, k, k + 1);
+
+  cuckoo_free(&t);
+}
+END_TEST
+
+START_TEST(test_htable) {
+  struct htable_opts opts = {.grow = 0, .index = HTABLE_CUCKOO};
+  htable_t *t = htable_new_ex(3, &opts);
+  void *val;
+
+  /* an htable with the cuckoo index replaces instead of stacking */
+  fail_unless(!htable_set(t, 1, (void *)101));
+  fail_unless(!htable_set(t, 1, (void *)102));
+  fail_unless(!htable_set(t, 2, (void *)103));
+  fail_unless(!htable_set(t, 3, (void *)104));
+  fail_unless(-1 == htable_set(t, 4, NULL));
+  fail_unless(!htable_get(t, 1, &val) && val == (void *)102);
+  fail_unless(!htable_pop(t, 1, &val) && val == (void *)102);
+  fail_unless(1 == htable_get(t, 1, &val));
+
+  fail_unless(!htable_grow(t, 10));
+  fail_unless(!htable_set(t, 4, (void *)105));
+  fail_unless(!htable_get(t, 4, &val) && val == (void *)105);
+  fail_unless(!htable_get(t, 3, &val) && val == (void *)104);
+
+  htable_free(&t);
+}
+END_TEST
+
+Suite *cuckoo_suite() {
+  TCase *tc;
+  Suite *s;
+
+  s = suite_create ("cuckoo");
+
+  tc = tcase_create ("foo");
+  tcase_add_test (tc, test_set_get);
+  tcase_add_test (tc, test_set_full);
+  tcase_add_test (tc, test_pop_del);
+  tcase_add_test (tc, test_many);
+  tcase_add_test (tc, test_grow);
+  tcase_add_test (tc, test_htable);
+  suite_add_tcase (s, tc);
+
+  return s;
+}
+
+int main(void) {
+  int number_failed;
+  Suite *s = cuckoo_suite();
+  SRunner *sr = srunner_create(s);
+  srunner_run_all (sr, CK_NORMAL);
+  number_failed = srunner_ntests_failed (sr);
+  srunner_free (sr);
+  return (number_failed == 0) ? 0 : 1;
+}
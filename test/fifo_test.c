@@ -17,6 +17,16 @@
       memcpy(p, data, strlen(data));                          \
   } while(0)
 
+#define FETCH_TTL(key, now, ttl, data, cached)                \
+  do {                                                        \
+    void *p;                                                  \
+    fail_unless(cached == fifo_fetch_ttl(fifo, key, now, ttl, &p)); \
+    if (cached == CACHED)                                     \
+      fail_unless(!memcmp(p, data, strlen(data)));            \
+    else                                                      \
+      memcpy(p, data, strlen(data));                          \
+  } while(0)
+
 START_TEST(test_no_eviction) {
   fifo_t *fifo = fifo_new(10, 8);
 
@@ -115,6 +125,97 @@ START_TEST(test_eviction_order) {
 END_TEST
 
 
+START_TEST(test_ttl) {
+  fifo_t *fifo = fifo_new(10, 4);
+
+  /* 0 and 1 live forever, 2 and 3 until 10 */
+  FETCH_TTL(0, 0, 0, "aaaaaaaaaa", !CACHED);
+  FETCH_TTL(1, 0, 0, "bbbbbbbbbb", !CACHED);
+  FETCH_TTL(2, 0, 10, "cccccccccc", !CACHED);
+  FETCH_TTL(3, 0, 10, "dddddddddd", !CACHED);
+
+  /* an expired page is a miss, and reloading it gives it a new ttl */
+  FETCH_TTL(2, 10, 100, "CCCCCCCCCC", !CACHED);
+  FETCH_TTL(2, 11, 100, "CCCCCCCCCC", CACHED);
+
+  /* 3 has expired too, and is reclaimed before the oldest page 0 is
+     evicted, though it came in last */
+  FETCH_TTL(4, 20, 0, "eeeeeeeeee", !CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(1, "bbbbbbbbbb", CACHED);
+  FETCH(2, "CCCCCCCCCC", CACHED);
+  FETCH(4, "eeeeeeeeee", CACHED);
+  FETCH(3, "dddddddddd", !CACHED);
+
+  fifo_free(&fifo);
+  fail_unless(fifo == NULL);
+}
+END_TEST
+
+START_TEST(test_invalidate) {
+  fifo_t *fifo = fifo_new(10, 4);
+
+  fail_unless(fifo != NULL);
+
+  FETCH(0, "aaaaaaaaaa", !CACHED);
+  FETCH(1, "bbbbbbbbbb", !CACHED);
+  FETCH(2, "cccccccccc", !CACHED);
+  FETCH(3, "dddddddddd", !CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+
+  /* an invalidated page is gone, and makes room without evicting,
+     after which the oldest page goes, hit or not */
+  fail_unless(0 == fifo_invalidate(fifo, 2));
+  fail_unless(1 == fifo_invalidate(fifo, 2));
+  fail_unless(1 == fifo_invalidate(fifo, 100));
+  FETCH(4, "eeeeeeeeee", !CACHED);
+  FETCH(5, "ffffffffff", !CACHED);
+  FETCH(1, "bbbbbbbbbb", CACHED);
+  FETCH(3, "dddddddddd", CACHED);
+  FETCH(4, "eeeeeeeeee", CACHED);
+  FETCH(5, "ffffffffff", CACHED);
+  FETCH(0, "aaaaaaaaaa", !CACHED);
+
+  fifo_free(&fifo);
+  fail_unless(fifo == NULL);
+}
+END_TEST
+
+START_TEST(test_resize) {
+  fifo_t *fifo = fifo_new(10, 4);
+
+  FETCH(0, "aaaaaaaaaa", !CACHED);
+  FETCH(1, "bbbbbbbbbb", !CACHED);
+  FETCH(2, "cccccccccc", !CACHED);
+  FETCH(3, "dddddddddd", !CACHED);
+
+  /* growing keeps every page, and adds room for more */
+  fail_unless(0 == fifo_resize(fifo, 8));
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(1, "bbbbbbbbbb", CACHED);
+  FETCH(2, "cccccccccc", CACHED);
+  FETCH(3, "dddddddddd", CACHED);
+  FETCH(4, "eeeeeeeeee", !CACHED);
+  FETCH(5, "ffffffffff", !CACHED);
+  FETCH(6, "gggggggggg", !CACHED);
+  FETCH(7, "hhhhhhhhhh", !CACHED);
+  FETCH(5, "ffffffffff", CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+
+  /* shrinking drops the pages that came in first, however recently
+     they were hit */
+  fail_unless(0 == fifo_resize(fifo, 4));
+  FETCH(4, "eeeeeeeeee", CACHED);
+  FETCH(5, "ffffffffff", CACHED);
+  FETCH(6, "gggggggggg", CACHED);
+  FETCH(7, "hhhhhhhhhh", CACHED);
+  FETCH(0, "aaaaaaaaaa", !CACHED);
+
+  fifo_free(&fifo);
+  fail_unless(fifo == NULL);
+}
+END_TEST
+
 Suite *fifo_suite() {
   TCase *tc;
   Suite *s;
@@ -123,6 +224,9 @@ Suite *fifo_suite() {
 
   tc = tcase_create ("foo");
   tcase_add_test (tc, test_eviction_order);
+  tcase_add_test (tc, test_ttl);
+  tcase_add_test (tc, test_invalidate);
+  tcase_add_test (tc, test_resize);
   suite_add_tcase (s, tc);
 
   return s;
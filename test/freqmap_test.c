@@ -0,0 +1,148 @@
+#include <check.h>
+#include "freqmap.h"
+
+START_TEST(test_new) {
+  freqmap_t *fm = freqmap_new(10);
+
+  fail_unless(fm != NULL);
+  fail_unless(0 == freqmap_size(fm));
+  fail_unless(0 == freqmap_min(fm));
+
+  freqmap_free(&fm);
+  fail_unless(fm == NULL);
+}
+END_TEST
+
+START_TEST(test_set_get) {
+  freqmap_t *fm = freqmap_new(3);
+  void *ptr;
+  uint64_t freq;
+
+  fail_unless(!freqmap_set(fm, 1, (void *)101, 1));
+  fail_unless(!freqmap_set(fm, 2, (void *)102, 1));
+  fail_unless(!freqmap_set(fm, 3, (void *)103, 1));
+  fail_unless(1 == freqmap_set(fm, 4, (void *)104, 1));
+  fail_unless(3 == freqmap_size(fm));
+
+  fail_unless(!freqmap_get(fm, 2, &ptr));
+  fail_unless(ptr == (void *)102);
+  fail_unless(1 == freqmap_get(fm, 4, &ptr));
+
+  /* overwriting sets value and frequency */
+  fail_unless(!freqmap_set(fm, 3, (void *)203, 5));
+  fail_unless(3 == freqmap_size(fm));
+  fail_unless(!freqmap_pop(fm, 3, &ptr, &freq));
+  fail_unless(ptr == (void *)203 && freq == 5);
+  fail_unless(!freqmap_pop(fm, 2, &ptr, &freq));
+  fail_unless(ptr == (void *)102 && freq == 2);
+  fail_unless(1 == freqmap_pop(fm, 2, &ptr, &freq));
+  fail_unless(1 == freqmap_size(fm));
+
+  freqmap_free(&fm);
+}
+END_TEST
+
+START_TEST(test_pop_min) {
+  freqmap_t *fm = freqmap_new(10);
+  uint64_t key, freq;
+  void *ptr;
+  int i;
+
+  for (i=0; i<5; i++)
+    fail_unless(!freqmap_set(fm, i, (void *)(uintptr_t)(100 + i), 1));
+
+  /* 0 gets 3 hits, 1 and 2 get 1 each, 3 and 4 none */
+  fail_unless(!freqmap_get(fm, 0, &ptr));
+  fail_unless(!freqmap_get(fm, 0, &ptr));
+  fail_unless(!freqmap_get(fm, 0, &ptr));
+  fail_unless(!freqmap_get(fm, 2, &ptr));
+  fail_unless(!freqmap_get(fm, 1, &ptr));
+  fail_unless(1 == freqmap_min(fm));
+
+  /* least frequent first, least recent among equals */
+  fail_unless(!freqmap_pop_min(fm, &key, &ptr, &freq));
+  fail_unless(key == 3 && ptr == (void *)103 && freq == 1);
+  fail_unless(!freqmap_pop_min(fm, &key, &ptr, &freq));
+  fail_unless(key == 4 && freq == 1);
+  fail_unless(2 == freqmap_min(fm));
+  fail_unless(!freqmap_pop_min(fm, &key, &ptr, &freq));
+  fail_unless(key == 2 && freq == 2);
+  fail_unless(!freqmap_pop_min(fm, &key, &ptr, &freq));
+  fail_unless(key == 1 && freq == 2);
+  fail_unless(!freqmap_pop_min(fm, &key, &ptr, &freq));
+  fail_unless(key == 0 && freq == 4);
+  fail_unless(1 == freqmap_pop_min(fm, &key, &ptr, &freq));
+  fail_unless(0 == freqmap_min(fm));
+
+  /* frequencies above min+1 are found too */
+  fail_unless(!freqmap_set(fm, 1, NULL, 10));
+  fail_unless(!freqmap_set(fm, 2, NULL, 30));
+  fail_unless(!freqmap_set(fm, 3, NULL, 20));
+  fail_unless(!freqmap_set(fm, 4, NULL, 20));
+  fail_unless(!freqmap_pop_min(fm, &key, &ptr, &freq));
+  fail_unless(key == 1 && freq == 10);
+  fail_unless(!freqmap_pop_min(fm, &key, &ptr, &freq));
+  fail_unless(key == 3 && freq == 20);
+  fail_unless(!freqmap_pop_min(fm, &key, &ptr, &freq));
+  fail_unless(key == 4 && freq == 20);
+  fail_unless(!freqmap_pop_min(fm, &key, &ptr, &freq));
+  fail_unless(key == 2 && freq == 30);
+
+  freqmap_free(&fm);
+}
+END_TEST
+
+START_TEST(test_halve) {
+  freqmap_t *fm = freqmap_new(10);
+  uint64_t key, freq;
+  void *ptr;
+
+  fail_unless(!freqmap_set(fm, 1, NULL, 1));
+  fail_unless(!freqmap_set(fm, 2, NULL, 4));
+  fail_unless(!freqmap_set(fm, 3, NULL, 5));
+  fail_unless(!freqmap_set(fm, 4, NULL, 9));
+
+  /* 4 and 5 both become 2, with 4 on the LRU side */
+  freqmap_halve(fm);
+  fail_unless(!freqmap_pop_min(fm, &key, &ptr, &freq));
+  fail_unless(key == 1 && freq == 1);
+  fail_unless(!freqmap_pop_min(fm, &key, &ptr, &freq));
+  fail_unless(key == 2 && freq == 2);
+
+  /* and the merged bucket still works */
+  fail_unless(!freqmap_get(fm, 3, &ptr));
+  fail_unless(!freqmap_pop_min(fm, &key, &ptr, &freq));
+  fail_unless(key == 3 && freq == 3);
+  fail_unless(!freqmap_pop_min(fm, &key, &ptr, &freq));
+  fail_unless(key == 4 && freq == 4);
+  fail_unless(0 == freqmap_size(fm));
+
+  freqmap_free(&fm);
+}
+END_TEST
+
+Suite *freqmap_suite() {
+  TCase *tc;
+  Suite *s;
+
+  s = suite_create ("freqmap");
+
+  tc = tcase_create ("foo");
+  tcase_add_test (tc, test_new);
+  tcase_add_test (tc, test_set_get);
+  tcase_add_test (tc, test_pop_min);
+  tcase_add_test (tc, test_halve);
+  suite_add_tcase (s, tc);
+
+  return s;
+}
+
+int main(void) {
+  int number_failed;
+  Suite *s = freqmap_suite();
+  SRunner *sr = srunner_create(s);
+  srunner_run_all (sr, CK_NORMAL);
+  number_failed = srunner_ntests_failed (sr);
+  srunner_free (sr);
+  return (number_failed == 0) ? 0 : 1;
+}
@@ -0,0 +1,371 @@
+#include <stdio.h>
+#include <string.h>
+#include <check.h>
+#include "clk.h"
+#include "gclk.h"
+#include "tracegen.h"
+
+#define CACHED 0
+#define FETCH(key, data, cached)                              \
+  do {                                                        \
+    void *p;                                                  \
+    fail_unless(cached == gclk_fetch(gclk, key, &p));         \
+    if (cached == CACHED)                                     \
+      fail_unless(!memcmp(p, data, strlen(data)));            \
+    else                                                      \
+      memcpy(p, data, strlen(data));                          \
+  } while(0)
+
+#define FETCH_TTL(key, now, ttl, data, cached)                \
+  do {                                                        \
+    void *p;                                                  \
+    fail_unless(cached == gclk_fetch_ttl(gclk, key, now, ttl, &p)); \
+    if (cached == CACHED)                                     \
+      fail_unless(!memcmp(p, data, strlen(data)));            \
+    else                                                      \
+      memcpy(p, data, strlen(data));                          \
+  } while(0)
+
+#define FETCH_COST(key, cost, data, cached)                   \
+  do {                                                        \
+    void *p;                                                  \
+    fail_unless(cached == gclk_fetch_cost(gclk, key, cost, &p)); \
+    if (cached == CACHED)                                     \
+      fail_unless(!memcmp(p, data, strlen(data)));            \
+    else                                                      \
+      memcpy(p, data, strlen(data));                          \
+  } while(0)
+
+START_TEST(test_no_eviction) {
+  gclk_t *gclk = gclk_new(10, 8);
+
+  fail_unless(gclk != NULL);
+
+  FETCH(0, "aaaaaaaaaa", !CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+
+  FETCH(1, "bbbbbbbbbb", !CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(1, "bbbbbbbbbb", CACHED);
+
+  FETCH(2, "cccccccccc", !CACHED);
+  FETCH(3, "dddddddddd", !CACHED);
+  FETCH(4, "eeeeeeeeee", !CACHED);
+  FETCH(5, "ffffffffff", !CACHED);
+  FETCH(6, "gggggggggg", !CACHED);
+  FETCH(7, "hhhhhhhhhh", !CACHED);
+
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(1, "bbbbbbbbbb", CACHED);
+  FETCH(2, "cccccccccc", CACHED);
+  FETCH(3, "dddddddddd", CACHED);
+  FETCH(4, "eeeeeeeeee", CACHED);
+  FETCH(5, "ffffffffff", CACHED);
+  FETCH(6, "gggggggggg", CACHED);
+  FETCH(7, "hhhhhhhhhh", CACHED);
+
+  gclk_free(&gclk);
+  fail_unless(gclk == NULL);
+}
+END_TEST
+
+START_TEST(test_eviction_order) {
+  /* counters are capped at 3 by default */
+  gclk_t *gclk = gclk_new(10, 4);
+
+  fail_unless(gclk != NULL);
+
+  FETCH(0, "aaaaaaaaaa", !CACHED);
+  FETCH(1, "bbbbbbbbbb", !CACHED);
+  FETCH(2, "cccccccccc", !CACHED);
+  FETCH(3, "dddddddddd", !CACHED);
+
+  /* 1/b gets to 3 references, 2/c to 1 */
+  FETCH(1, "bbbbbbbbbb", CACHED);
+  FETCH(1, "bbbbbbbbbb", CACHED);
+  FETCH(1, "bbbbbbbbbb", CACHED);
+  FETCH(1, "bbbbbbbbbb", CACHED);
+  FETCH(2, "cccccccccc", CACHED);
+
+  /* the hand is at 0/a, which is unreferenced and goes first */
+  FETCH(4, "eeeeeeeeee", !CACHED);
+
+  /* then the hand decrements 1/b to 2 and 2/c to 0 before evicting
+     3/d, moving on to the 4/e that took 0/a's place */
+  FETCH(5, "ffffffffff", !CACHED);
+  FETCH(6, "gggggggggg", !CACHED);
+
+  /* now 1/b is decremented to 1, and 2/c goes */
+  FETCH(7, "hhhhhhhhhh", !CACHED);
+
+  /* leaving the hand at 5/f, with 1/b still hanging on */
+  FETCH(1, "bbbbbbbbbb", CACHED);
+  FETCH(5, "ffffffffff", CACHED);
+  FETCH(6, "gggggggggg", CACHED);
+  FETCH(7, "hhhhhhhhhh", CACHED);
+
+  /* so 5/f, 6/g, 1/b, 7/h have 1, 1, 2 and 1 references. one new
+     page decrements all and evicts 5/f, on the second lap */
+  FETCH(0, "aaaaaaaaaa", !CACHED);
+  FETCH(6, "gggggggggg", CACHED);
+  FETCH(1, "bbbbbbbbbb", CACHED);
+  FETCH(7, "hhhhhhhhhh", CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+
+  gclk_free(&gclk);
+  fail_unless(gclk == NULL);
+}
+END_TEST
+
+START_TEST(test_weighted) {
+  struct gclk_opts opts = {.max = 4, .increment = 4,
+                           .sweep = GCLK_SWEEP_ONE};
+  gclk_t *gclk = gclk_new_ex(10, 2, &opts);
+
+  fail_unless(gclk != NULL);
+
+  /* a single hit protects 0/a for four laps */
+  FETCH(0, "aaaaaaaaaa", !CACHED);
+  FETCH(1, "bbbbbbbbbb", !CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+
+  FETCH(2, "cccccccccc", !CACHED);
+  FETCH(3, "dddddddddd", !CACHED);
+  FETCH(4, "eeeeeeeeee", !CACHED);
+  FETCH(5, "ffffffffff", !CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+
+  /* and the ceiling holds no matter how many hits */
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(6, "gggggggggg", !CACHED);
+  FETCH(7, "hhhhhhhhhh", !CACHED);
+  FETCH(8, "iiiiiiiiii", !CACHED);
+  FETCH(9, "jjjjjjjjjj", !CACHED);
+  FETCH(10, "kkkkkkkkkk", !CACHED);
+  FETCH(0, "aaaaaaaaaa", !CACHED);
+
+  gclk_free(&gclk);
+  fail_unless(gclk == NULL);
+}
+END_TEST
+
+START_TEST(test_bad_opts) {
+  struct gclk_opts opts = {.max = 0, .increment = 1,
+                           .sweep = GCLK_SWEEP_ONE};
+
+  fail_unless(NULL == gclk_new_ex(10, 2, &opts));
+  opts.max = 1;
+  opts.increment = 0;
+  fail_unless(NULL == gclk_new_ex(10, 2, &opts));
+}
+END_TEST
+
+/* Replays a zipf trace against a and b, checking that they hit and
+ * miss alike.
+ */
+static void compare(gclk_t *a, void *b,
+                    int (*fetch_b)(void *, uint64_t, void **)) {
+  struct tracegen_phase phase = {.kind = TRACEGEN_ZIPF, .n = 1000,
+                                 .len = 1, .alpha = 0.8};
+  tracegen_t *tg;
+  uint64_t key;
+  void *p;
+  int i;
+
+  tg = tracegen_new(&phase, 1, 1);
+  for (i=0; i<100000; i++) {
+    key = tracegen_next(tg);
+    fail_unless(gclk_fetch(a, key, &p) == fetch_b(b, key, &p));
+  }
+  tracegen_free(&tg);
+}
+
+START_TEST(test_clock) {
+  struct gclk_opts opts = {.max = 1, .increment = 1,
+                           .sweep = GCLK_SWEEP_ONE};
+  gclk_t *gclk = gclk_new_ex(1, 100, &opts);
+  clk_t *clk = clk_new(1, 100);
+
+  /* a ceiling of 1 makes it CLOCK */
+  compare(gclk, clk, (int (*)(void *, uint64_t, void **))clk_fetch);
+
+  gclk_free(&gclk);
+  clk_free(&clk);
+}
+END_TEST
+
+START_TEST(test_sweep_min) {
+  struct gclk_opts opts = {.max = 255, .increment = 7,
+                           .sweep = GCLK_SWEEP_ONE};
+  gclk_t *one, *min;
+
+  /* skipping laps doesn't change what is evicted */
+  one = gclk_new_ex(1, 100, &opts);
+  opts.sweep = GCLK_SWEEP_MIN;
+  min = gclk_new_ex(1, 100, &opts);
+  compare(one, min, (int (*)(void *, uint64_t, void **))gclk_fetch);
+
+  gclk_free(&one);
+  gclk_free(&min);
+}
+END_TEST
+
+START_TEST(test_ttl) {
+  gclk_t *gclk = gclk_new(10, 4);
+
+  /* 0 and 1 live forever, 2 and 3 until 10, 3 being referenced twice */
+  FETCH_TTL(0, 0, 0, "aaaaaaaaaa", !CACHED);
+  FETCH_TTL(1, 0, 0, "bbbbbbbbbb", !CACHED);
+  FETCH_TTL(2, 0, 10, "cccccccccc", !CACHED);
+  FETCH_TTL(3, 0, 10, "dddddddddd", !CACHED);
+  FETCH_TTL(3, 8, 10, "dddddddddd", CACHED);
+  FETCH_TTL(3, 9, 10, "dddddddddd", CACHED);
+
+  /* an expired page is a miss, and reloading it gives it a new ttl */
+  FETCH_TTL(2, 10, 100, "CCCCCCCCCC", !CACHED);
+  FETCH_TTL(2, 11, 100, "CCCCCCCCCC", CACHED);
+
+  /* 3 has expired too, and is reclaimed before the hand evicts 0,
+     though it has the highest count */
+  FETCH_TTL(4, 20, 0, "eeeeeeeeee", !CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(1, "bbbbbbbbbb", CACHED);
+  FETCH(2, "CCCCCCCCCC", CACHED);
+  FETCH(4, "eeeeeeeeee", CACHED);
+  FETCH(3, "dddddddddd", !CACHED);
+
+  gclk_free(&gclk);
+  fail_unless(gclk == NULL);
+}
+END_TEST
+
+START_TEST(test_invalidate) {
+  gclk_t *gclk = gclk_new(10, 4);
+
+  fail_unless(gclk != NULL);
+
+  FETCH(0, "aaaaaaaaaa", !CACHED);
+  FETCH(1, "bbbbbbbbbb", !CACHED);
+  FETCH(2, "cccccccccc", !CACHED);
+  FETCH(3, "dddddddddd", !CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(1, "bbbbbbbbbb", CACHED);
+  FETCH(2, "cccccccccc", CACHED);
+
+  /* an invalidated page is gone, and makes room without evicting,
+     after which the hand takes 4, the one page without references,
+     and then 1, whose reference that pass used up, while 0 had two */
+  fail_unless(0 == gclk_invalidate(gclk, 3));
+  fail_unless(1 == gclk_invalidate(gclk, 3));
+  fail_unless(1 == gclk_invalidate(gclk, 100));
+  FETCH(4, "eeeeeeeeee", !CACHED);
+  FETCH(5, "ffffffffff", !CACHED);
+  FETCH(6, "gggggggggg", !CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(2, "cccccccccc", CACHED);
+  FETCH(5, "ffffffffff", CACHED);
+  FETCH(6, "gggggggggg", CACHED);
+  FETCH(1, "bbbbbbbbbb", !CACHED);
+
+  gclk_free(&gclk);
+  fail_unless(gclk == NULL);
+}
+END_TEST
+
+START_TEST(test_resize) {
+  gclk_t *gclk = gclk_new(10, 4);
+
+  FETCH(0, "aaaaaaaaaa", !CACHED);
+  FETCH(1, "bbbbbbbbbb", !CACHED);
+  FETCH(2, "cccccccccc", !CACHED);
+  FETCH(3, "dddddddddd", !CACHED);
+
+  /* growing keeps every page, and adds room for more */
+  fail_unless(0 == gclk_resize(gclk, 8));
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(1, "bbbbbbbbbb", CACHED);
+  FETCH(2, "cccccccccc", CACHED);
+  FETCH(3, "dddddddddd", CACHED);
+  FETCH(4, "eeeeeeeeee", !CACHED);
+  FETCH(5, "ffffffffff", !CACHED);
+  FETCH(6, "gggggggggg", !CACHED);
+  FETCH(7, "hhhhhhhhhh", !CACHED);
+  FETCH(1, "bbbbbbbbbb", CACHED);
+  FETCH(1, "bbbbbbbbbb", CACHED);
+  FETCH(5, "ffffffffff", CACHED);
+
+  /* shrinking sweeps the hand until two pages are left, 1, which has
+     references to spare, and 5, which its second pass doesn't reach */
+  fail_unless(0 == gclk_resize(gclk, 2));
+  FETCH(1, "bbbbbbbbbb", CACHED);
+  FETCH(5, "ffffffffff", CACHED);
+  FETCH(0, "aaaaaaaaaa", !CACHED);
+
+  gclk_free(&gclk);
+  fail_unless(gclk == NULL);
+}
+END_TEST
+
+START_TEST(test_cost) {
+  struct gclk_opts opts = {.max = 8, .increment = 1,
+                           .sweep = GCLK_SWEEP_ONE};
+  gclk_t *gclk = gclk_new_ex(10, 3, &opts);
+
+  fail_unless(gclk != NULL);
+
+  /* a page that costs 4 survives three laps without a hit, one that
+     costs 1 is plain GCLOCK */
+  FETCH_COST(0, 4, "aaaaaaaaaa", !CACHED);
+  FETCH_COST(1, 1, "bbbbbbbbbb", !CACHED);
+  FETCH(2, "cccccccccc", !CACHED);
+  FETCH_COST(3, 1, "dddddddddd", !CACHED);
+  FETCH_COST(4, 0, "eeeeeeeeee", !CACHED);
+  FETCH_COST(5, 1, "ffffffffff", !CACHED);
+  FETCH_COST(0, 4, "aaaaaaaaaa", CACHED);
+  FETCH_COST(1, 1, "bbbbbbbbbb", !CACHED);
+
+  /* costs beyond max are taken as max */
+  FETCH_COST(6, 100, "gggggggggg", !CACHED);
+  FETCH_COST(7, 1, "hhhhhhhhhh", !CACHED);
+  FETCH_COST(8, 1, "iiiiiiiiii", !CACHED);
+  FETCH_COST(9, 1, "jjjjjjjjjj", !CACHED);
+  FETCH_COST(6, 100, "gggggggggg", CACHED);
+
+  gclk_free(&gclk);
+}
+END_TEST
+
+Suite *gclk_suite() {
+  TCase *tc;
+  Suite *s;
+
+  s = suite_create ("gclk");
+
+  tc = tcase_create ("foo");
+  tcase_add_test (tc, test_no_eviction);
+  tcase_add_test (tc, test_eviction_order);
+  tcase_add_test (tc, test_weighted);
+  tcase_add_test (tc, test_bad_opts);
+  tcase_add_test (tc, test_clock);
+  tcase_add_test (tc, test_sweep_min);
+  tcase_add_test (tc, test_ttl);
+  tcase_add_test (tc, test_invalidate);
+  tcase_add_test (tc, test_resize);
+  tcase_add_test (tc, test_cost);
+  suite_add_tcase (s, tc);
+
+  return s;
+}
+
+int main(void) {
+  int number_failed;
+  Suite *s = gclk_suite();
+  SRunner *sr = srunner_create(s);
+  srunner_run_all (sr, CK_NORMAL);
+  number_failed = srunner_ntests_failed (sr);
+  srunner_free (sr);
+  return (number_failed == 0) ? 0 : 1;
+}
@@ -0,0 +1,198 @@
+#include <stdio.h>
+#include <string.h>
+#include <check.h>
+#include "gd.h"
+
+
+#define CACHED 0
+#define FETCH(key, cost, data, cached)                        \
+  do {                                                        \
+    void *p;                                                  \
+    fail_unless(cached == gd_fetch_cost(gd, key, cost, &p));  \
+    if (cached == CACHED)                                     \
+      fail_unless(!memcmp(p, data, strlen(data)));            \
+    else                                                      \
+      memcpy(p, data, strlen(data));                          \
+  } while(0)
+
+START_TEST(test_lru) {
+  gd_t *gd = gd_new(10, 3);
+
+  fail_unless(gd != NULL);
+
+  /* with equal costs, the LRU page goes */
+  FETCH(0, 1, "aaaaaaaaaa", !CACHED);
+  FETCH(1, 1, "bbbbbbbbbb", !CACHED);
+  FETCH(2, 1, "cccccccccc", !CACHED);
+  FETCH(0, 1, "aaaaaaaaaa", CACHED);
+  FETCH(3, 1, "dddddddddd", !CACHED);
+  FETCH(1, 1, "bbbbbbbbbb", !CACHED);
+  FETCH(0, 1, "aaaaaaaaaa", CACHED);
+  FETCH(3, 1, "dddddddddd", CACHED);
+  FETCH(2, 1, "cccccccccc", !CACHED);
+
+  gd_free(&gd);
+  fail_unless(gd == NULL);
+}
+END_TEST
+
+START_TEST(test_cost) {
+  gd_t *gd = gd_new(10, 3);
+  int i;
+
+  fail_unless(gd != NULL);
+
+  /* an expensive page outlives cheap ones fetched after it */
+  FETCH(0, 10, "aaaaaaaaaa", !CACHED);
+  for (i=1; i<9; i++)
+    FETCH(i, 1, "bbbbbbbbbb", !CACHED);
+  FETCH(0, 10, "aaaaaaaaaa", CACHED);
+
+  /* but not forever, as they raise the bar */
+  for (i=100; i<140; i++)
+    FETCH(i, 1, "bbbbbbbbbb", !CACHED);
+  FETCH(0, 10, "aaaaaaaaaa", !CACHED);
+
+  /* a cost of 0 is 1 */
+  FETCH(1, 0, "bbbbbbbbbb", !CACHED);
+  FETCH(1, 0, "bbbbbbbbbb", CACHED);
+
+  gd_free(&gd);
+}
+END_TEST
+
+START_TEST(test_invalidate) {
+  gd_t *gd = gd_new(10, 2);
+  void *p;
+
+  FETCH(0, 5, "aaaaaaaaaa", !CACHED);
+  FETCH(1, 1, "bbbbbbbbbb", !CACHED);
+
+  fail_unless(0 == gd_invalidate(gd, 0));
+  fail_unless(1 == gd_invalidate(gd, 0));
+
+  /* the freed page is used before evicting */
+  FETCH(2, 1, "cccccccccc", !CACHED);
+  FETCH(1, 1, "bbbbbbbbbb", CACHED);
+  fail_unless(1 == gd_fetch(gd, 0, &p));
+
+  gd_free(&gd);
+}
+END_TEST
+
+START_TEST(test_resize) {
+  gd_t *gd = gd_new(10, 4);
+
+  FETCH(0, 5, "aaaaaaaaaa", !CACHED);
+  FETCH(1, 1, "bbbbbbbbbb", !CACHED);
+  FETCH(2, 1, "cccccccccc", !CACHED);
+  FETCH(3, 2, "dddddddddd", !CACHED);
+
+  /* shrinking evicts the cheapest pages, and moves the rest */
+  fail_unless(0 == gd_resize(gd, 2));
+  FETCH(0, 5, "aaaaaaaaaa", CACHED);
+  FETCH(3, 2, "dddddddddd", CACHED);
+
+  fail_unless(0 == gd_resize(gd, 4));
+  FETCH(1, 1, "bbbbbbbbbb", !CACHED);
+  FETCH(2, 1, "cccccccccc", !CACHED);
+  FETCH(0, 5, "aaaaaaaaaa", CACHED);
+  FETCH(3, 2, "dddddddddd", CACHED);
+
+  fail_unless(-1 == gd_resize(gd, 1));
+
+  gd_free(&gd);
+}
+END_TEST
+
+/* GreedyDual by the book, scanning all pages for the victim */
+#define MODEL_NMEMB 64
+struct model {
+  uint64_t key[MODEL_NMEMB];
+  uint64_t h[MODEL_NMEMB];
+  uint64_t stamp[MODEL_NMEMB];
+  uint64_t l, now;
+  int n;
+};
+
+static int model_fetch(struct model *m, uint64_t key, uint32_t cost) {
+  int i, victim;
+
+  for (i=0; i<m->n; i++)
+    if (m->key[i] == key) {
+      m->h[i] = m->l + cost;
+      m->stamp[i] = ++m->now;
+      return 0;
+    }
+
+  if (m->n < MODEL_NMEMB) {
+    i = m->n++;
+  } else {
+    for (i=victim=0; i<m->n; i++)
+      if (m->h[i] < m->h[victim] ||
+          (m->h[i] == m->h[victim] && m->stamp[i] < m->stamp[victim]))
+        victim = i;
+    i = victim;
+    m->l = m->h[i];
+  }
+  m->key[i] = key;
+  m->h[i] = m->l + cost;
+  m->stamp[i] = ++m->now;
+  return 1;
+}
+
+START_TEST(test_spread) {
+  gd_t *gd = gd_new(sizeof(uint64_t), MODEL_NMEMB);
+  struct model m = {.n = 0, .l = 0, .now = 0};
+  uint64_t x = 88172645463325252ULL, key;
+  uint32_t cost;
+  void *p;
+  int i, r;
+
+  fail_unless(gd != NULL);
+
+  /* costs far apart order pages as they should, e.g. latencies */
+  for (i=0; i<100000; i++) {
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    key = x % 256;
+    cost = 1 + (x >> 32) % 100000;
+    r = gd_fetch_cost(gd, key, cost, &p);
+    fail_unless(r == model_fetch(&m, key, cost));
+    if (r == 0)
+      fail_unless(*(uint64_t *)p == key);
+    else
+      *(uint64_t *)p = key;
+  }
+
+  gd_free(&gd);
+}
+END_TEST
+
+Suite *gd_suite() {
+  TCase *tc;
+  Suite *s;
+
+  s = suite_create ("gd");
+
+  tc = tcase_create ("foo");
+  tcase_add_test (tc, test_lru);
+  tcase_add_test (tc, test_cost);
+  tcase_add_test (tc, test_invalidate);
+  tcase_add_test (tc, test_resize);
+  tcase_add_test (tc, test_spread);
+  suite_add_tcase (s, tc);
+
+  return s;
+}
+
+int main(void) {
+  int number_failed;
+  Suite *s = gd_suite();
+  SRunner *sr = srunner_create(s);
+  srunner_run_all (sr, CK_NORMAL);
+  number_failed = srunner_ntests_failed (sr);
+  srunner_free (sr);
+  return (number_failed == 0) ? 0 : 1;
+}
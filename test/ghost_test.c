@@ -0,0 +1,110 @@
+#include <check.h>
+#include "ghost.h"
+
+
+START_TEST(test_add_has) {
+  ghost_t *g = ghost_new(100);
+  uint64_t k;
+
+  fail_unless(g != NULL);
+  fail_unless(ghost_size(g) == 0);
+
+  for (k=0; k<100; k++)
+    ghost_add(g, k * 7919);
+  fail_unless(ghost_size(g) == 100);
+
+  /* no false negatives */
+  for (k=0; k<100; k++)
+    fail_unless(ghost_has(g, k * 7919));
+
+  ghost_free(&g);
+  fail_unless(g == NULL);
+}
+END_TEST
+
+START_TEST(test_false_positives) {
+  ghost_t *g = ghost_new(10000);
+  uint64_t k;
+  int fp = 0;
+
+  for (k=0; k<10000; k++)
+    ghost_add(g, k);
+
+  for (k=1000000; k<1100000; k++)
+    fp += !!ghost_has(g, k);
+  fail_unless(fp < 3000, "%d false positives in 100000", fp);
+
+  ghost_free(&g);
+}
+END_TEST
+
+START_TEST(test_aging) {
+  ghost_t *g = ghost_new(1000);
+  uint64_t k;
+  int old;
+
+  for (k=0; k<1000; k++)
+    ghost_add(g, k);
+
+  /* the first generation is still remembered while the second fills */
+  for (k=1000; k<2000; k++)
+    ghost_add(g, k);
+  for (k=0; k<2000; k++)
+    fail_unless(ghost_has(g, k));
+
+  /* and forgotten once the third starts */
+  ghost_add(g, 2000);
+  fail_unless(ghost_size(g) == 1001);
+  for (k=1000; k<2001; k++)
+    fail_unless(ghost_has(g, k));
+  for (k=0, old=0; k<1000; k++)
+    old += !!ghost_has(g, k);
+  fail_unless(old < 50);
+
+  ghost_free(&g);
+}
+END_TEST
+
+START_TEST(test_resize) {
+  ghost_t *g = ghost_new(10);
+  uint64_t k;
+
+  ghost_add(g, 1);
+  fail_unless(!ghost_resize(g, 1000));
+  fail_unless(ghost_size(g) == 0);
+  fail_unless(!ghost_has(g, 1));
+
+  for (k=0; k<1000; k++)
+    ghost_add(g, k);
+  for (k=0; k<1000; k++)
+    fail_unless(ghost_has(g, k));
+
+  ghost_free(&g);
+}
+END_TEST
+
+Suite *ghost_suite() {
+  TCase *tc;
+  Suite *s;
+
+  s = suite_create ("ghost");
+
+  tc = tcase_create ("foo");
+  tcase_add_test (tc, test_add_has);
+  tcase_add_test (tc, test_false_positives);
+  tcase_add_test (tc, test_aging);
+  tcase_add_test (tc, test_resize);
+  suite_add_tcase (s, tc);
+
+  return s;
+}
+
+int main(void) {
+  int number_failed;
+  Suite *s = ghost_suite();
+  SRunner *sr = srunner_create(s);
+  srunner_run_all (sr, CK_NORMAL);
+  number_failed = srunner_ntests_failed (sr);
+  srunner_free (sr);
+  return (number_failed == 0) ? 0 : 1;
+}
@@ -229,6 +229,54 @@ START_TEST(test_deletion) {
 }
 END_TEST
 
+START_TEST(test_grow) {
+  struct htable_opts opts = {.grow = 1};
+  htable_t *t = htable_new_ex(4, &opts);
+  void *v;
+  int i;
+
+  fail_unless(t != NULL);
+
+  /* a growing table takes more than it was made for, including
+     stacked entries set while buckets are being rehashed */
+  for (i=0; i<1000; i++)
+    fail_unless(!htable_set(t, i, (void *)(uintptr_t)(i + 1)));
+  fail_unless(!htable_set(t, 7, (void *)7777));
+  for (i=0; i<1000; i++)
+    fail_unless(!htable_set(t, 1000 + i, (void *)(uintptr_t)(1001 + i)));
+  GET_AND_CHECK(t, 7, 7777);
+  fail_unless(!htable_del(t, 7));
+  GET_AND_CHECK(t, 7, 8);
+  for (i=0; i<2000; i++)
+    GET_AND_CHECK(t, i, i + 1);
+  fail_unless(1 == htable_get(t, 2000, &v));
+
+  /* deleting in the middle of a rehash */
+  fail_unless(!htable_grow(t, 8000));
+  for (i=0; i<2000; i+=2)
+    fail_unless(!htable_del(t, i));
+  for (i=0; i<2000; i++)
+    fail_unless(htable_get(t, i, &v) == !(i & 1));
+
+  htable_free(&t);
+  fail_unless(t == NULL);
+
+  /* an explicit grow works without the option too */
+  t = htable_new(2);
+  fail_unless(!htable_set(t, 1, (void *)101));
+  fail_unless(!htable_set(t, 2, (void *)102));
+  fail_unless(-1 == htable_set(t, 3, (void *)103));
+  fail_unless(!htable_grow(t, 3));
+  fail_unless(!htable_set(t, 3, (void *)103));
+  fail_unless(-1 == htable_set(t, 4, (void *)104));
+  GET_AND_CHECK(t, 1, 101);
+  GET_AND_CHECK(t, 2, 102);
+  GET_AND_CHECK(t, 3, 103);
+
+  htable_free(&t);
+}
+END_TEST
+
 START_TEST(test_free) {
   htable_t *t = htable_new(123);
   fail_unless(t != NULL);
@@ -250,6 +298,7 @@ Suite *htable_suite() {
   tcase_add_test (tc, test_free);
   tcase_add_test (tc, test_stacking);
   tcase_add_test (tc, test_set_full);
+  tcase_add_test (tc, test_grow);
   suite_add_tcase (s, tc);
 
   return s;
@@ -0,0 +1,219 @@
+#include <stdio.h>
+#include <string.h>
+#include <check.h>
+#include "lecar.h"
+
+#define CACHED 0
+#define FETCH(key, data, cached)                              \
+  do {                                                        \
+    void *p;                                                  \
+    fail_unless(cached == lecar_fetch(lecar, key, &p));       \
+    if (cached == CACHED)                                     \
+      fail_unless(!memcmp(p, data, strlen(data)));            \
+    else                                                      \
+      memcpy(p, data, strlen(data));                          \
+  } while(0)
+
+#define FETCH_TTL(key, now, ttl, data, cached)            \
+  do {                                                    \
+    void *p;                                              \
+    fail_unless(cached == lecar_fetch_ttl(lecar, key, now, ttl, &p)); \
+    if (cached == CACHED)                                 \
+      fail_unless(!memcmp(p, data, strlen(data)));        \
+    else                                                  \
+      memcpy(p, data, strlen(data));                      \
+  } while(0)
+
+START_TEST(test_no_eviction) {
+  lecar_t *lecar = lecar_new(10, 4);
+
+  fail_unless(lecar != NULL);
+
+  FETCH(0, "aaaaaaaaaa", !CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(1, "bbbbbbbbbb", !CACHED);
+  FETCH(2, "cccccccccc", !CACHED);
+  FETCH(3, "dddddddddd", !CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(1, "bbbbbbbbbb", CACHED);
+  FETCH(2, "cccccccccc", CACHED);
+  FETCH(3, "dddddddddd", CACHED);
+
+  /* one of them has to go */
+  FETCH(4, "eeeeeeeeee", !CACHED);
+  FETCH(4, "eeeeeeeeee", CACHED);
+
+  lecar_free(&lecar);
+  fail_unless(lecar == NULL);
+}
+END_TEST
+
+START_TEST(test_learns_lru) {
+  lecar_t *lecar = lecar_new(10, 64);
+  void *p;
+  int i, j, hits;
+
+  /* 0-63 are popular for a while, then never used again. LFU alone
+     would keep them and miss on every fetch of the new working set,
+     regret moves LeCaR towards LRU. */
+  for (j=0; j<50; j++)
+    for (i=0; i<64; i++)
+      lecar_fetch(lecar, i, &p);
+
+  hits = 0;
+  for (j=0; j<50; j++)
+    for (i=1000; i<1064; i++)
+      hits += CACHED == lecar_fetch(lecar, i, &p);
+  fail_unless(hits > 50 * 64 * 9 / 10);
+
+  lecar_free(&lecar);
+}
+END_TEST
+
+START_TEST(test_learns_lfu) {
+  lecar_t *lecar = lecar_new(10, 64);
+  void *p;
+  int i, j, hits;
+
+  /* 0-31 are used between scans of 64 pages. LRU alone would let each
+     scan flush them, regret moves LeCaR towards LFU. */
+  hits = 0;
+  for (j=0; j<50; j++) {
+    for (i=0; i<32; i++)
+      hits += CACHED == lecar_fetch(lecar, i, &p);
+    for (i=0; i<64; i++)
+      lecar_fetch(lecar, 1000 + j * 64 + i, &p);
+  }
+  fail_unless(hits > 50 * 32 * 3 / 4);
+
+  lecar_free(&lecar);
+}
+END_TEST
+
+START_TEST(test_invalidate) {
+  lecar_t *lecar = lecar_new(10, 4);
+
+  fail_unless(lecar != NULL);
+
+  FETCH(0, "aaaaaaaaaa", !CACHED);
+  FETCH(1, "bbbbbbbbbb", !CACHED);
+  FETCH(2, "cccccccccc", !CACHED);
+  FETCH(3, "dddddddddd", !CACHED);
+  FETCH(2, "cccccccccc", CACHED);
+  FETCH(3, "dddddddddd", CACHED);
+
+  /* an invalidated page is gone, and makes room without evicting,
+     after which 0 goes, being the victim of both LRU and LFU */
+  fail_unless(0 == lecar_invalidate(lecar, 1));
+  fail_unless(1 == lecar_invalidate(lecar, 1));
+  fail_unless(1 == lecar_invalidate(lecar, 100));
+  FETCH(4, "eeeeeeeeee", !CACHED);
+  FETCH(5, "ffffffffff", !CACHED);
+  FETCH(2, "cccccccccc", CACHED);
+  FETCH(3, "dddddddddd", CACHED);
+  FETCH(4, "eeeeeeeeee", CACHED);
+  FETCH(5, "ffffffffff", CACHED);
+  FETCH(0, "aaaaaaaaaa", !CACHED);
+
+  lecar_free(&lecar);
+  fail_unless(lecar == NULL);
+}
+END_TEST
+
+START_TEST(test_resize) {
+  lecar_t *lecar = lecar_new(10, 4);
+
+  FETCH(0, "aaaaaaaaaa", !CACHED);
+  FETCH(1, "bbbbbbbbbb", !CACHED);
+  FETCH(2, "cccccccccc", !CACHED);
+  FETCH(3, "dddddddddd", !CACHED);
+
+  /* growing keeps every page, and adds room for more */
+  fail_unless(0 == lecar_resize(lecar, 8));
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(1, "bbbbbbbbbb", CACHED);
+  FETCH(2, "cccccccccc", CACHED);
+  FETCH(3, "dddddddddd", CACHED);
+  FETCH(4, "eeeeeeeeee", !CACHED);
+  FETCH(5, "ffffffffff", !CACHED);
+  FETCH(6, "gggggggggg", !CACHED);
+  FETCH(7, "hhhhhhhhhh", !CACHED);
+  FETCH(2, "cccccccccc", CACHED);
+  FETCH(3, "dddddddddd", CACHED);
+  FETCH(6, "gggggggggg", CACHED);
+  FETCH(7, "hhhhhhhhhh", CACHED);
+
+  /* shrinking drops the pages both LRU and LFU would, so whichever
+     the weights pick, those fetched last and most survive */
+  fail_unless(0 == lecar_resize(lecar, 4));
+  FETCH(2, "cccccccccc", CACHED);
+  FETCH(3, "dddddddddd", CACHED);
+  FETCH(6, "gggggggggg", CACHED);
+  FETCH(7, "hhhhhhhhhh", CACHED);
+  FETCH(0, "aaaaaaaaaa", !CACHED);
+
+  /* but not below what the policy needs */
+  fail_unless(-1 == lecar_resize(lecar, 1));
+
+  lecar_free(&lecar);
+  fail_unless(lecar == NULL);
+}
+END_TEST
+
+START_TEST(test_ttl) {
+  lecar_t *lecar = lecar_new(10, 4);
+
+  /* 0 and 1 live forever, 2 and 3 until 10, 3 being both the most
+     recently and the most frequently used */
+  FETCH_TTL(0, 0, 0, "aaaaaaaaaa", !CACHED);
+  FETCH_TTL(1, 0, 0, "bbbbbbbbbb", !CACHED);
+  FETCH_TTL(2, 0, 10, "cccccccccc", !CACHED);
+  FETCH_TTL(3, 0, 10, "dddddddddd", !CACHED);
+  FETCH_TTL(3, 8, 10, "dddddddddd", CACHED);
+  FETCH_TTL(3, 9, 10, "dddddddddd", CACHED);
+
+  /* an expired page is a miss, and reloading it gives it a new ttl */
+  FETCH_TTL(2, 10, 100, "CCCCCCCCCC", !CACHED);
+  FETCH_TTL(2, 11, 100, "CCCCCCCCCC", CACHED);
+
+  /* 3 has expired too, and is reclaimed before 0, which both LRU and
+     LFU would evict, is */
+  FETCH_TTL(4, 20, 0, "eeeeeeeeee", !CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(1, "bbbbbbbbbb", CACHED);
+  FETCH(2, "CCCCCCCCCC", CACHED);
+  FETCH(4, "eeeeeeeeee", CACHED);
+  FETCH(3, "dddddddddd", !CACHED);
+
+  lecar_free(&lecar);
+  fail_unless(lecar == NULL);
+}
+END_TEST
+
+Suite *lecar_suite() {
+  TCase *tc;
+  Suite *s;
+
+  s = suite_create ("lecar");
+
+  tc = tcase_create ("foo");
+  tcase_add_test (tc, test_no_eviction);
+  tcase_add_test (tc, test_learns_lru);
+  tcase_add_test (tc, test_learns_lfu);
+  tcase_add_test (tc, test_invalidate);
+  tcase_add_test (tc, test_resize);
+  tcase_add_test (tc, test_ttl);
+  suite_add_tcase (s, tc);
+
+  return s;
+}
+
+int main(void) {
+  int number_failed;
+  Suite *s = lecar_suite();
+  SRunner *sr = srunner_create(s);
+  srunner_run_all (sr, CK_NORMAL);
+  number_failed = srunner_ntests_failed (sr);
+  srunner_free (sr);
+  return (number_failed == 0) ? 0 : 1;
+}
@@ -0,0 +1,223 @@
+#include <stdio.h>
+#include <string.h>
+#include <check.h>
+#include "lfu.h"
+
+#define CACHED 0
+#define FETCH(key, data, cached)                              \
+  do {                                                        \
+    void *p;                                                  \
+    fail_unless(cached == lfu_fetch(lfu, key, &p));           \
+    if (cached == CACHED)                                     \
+      fail_unless(!memcmp(p, data, strlen(data)));            \
+    else                                                      \
+      memcpy(p, data, strlen(data));                          \
+  } while(0)
+
+#define FETCH_TTL(key, now, ttl, data, cached)            \
+  do {                                                    \
+    void *p;                                              \
+    fail_unless(cached == lfu_fetch_ttl(lfu, key, now, ttl, &p)); \
+    if (cached == CACHED)                                 \
+      fail_unless(!memcmp(p, data, strlen(data)));        \
+    else                                                  \
+      memcpy(p, data, strlen(data));                      \
+  } while(0)
+
+START_TEST(test_frequency) {
+  lfu_t *lfu = lfu_new(10, 4);
+  int i;
+
+  fail_unless(lfu != NULL);
+
+  FETCH(0, "aaaaaaaaaa", !CACHED);
+  FETCH(1, "bbbbbbbbbb", !CACHED);
+  FETCH(2, "cccccccccc", !CACHED);
+  FETCH(3, "dddddddddd", !CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(1, "bbbbbbbbbb", CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+
+  /* the least frequently used go first, least recently used among
+     those */
+  FETCH(4, "eeeeeeeeee", !CACHED);
+  FETCH(3, "dddddddddd", CACHED);
+  FETCH(2, "cccccccccc", !CACHED);
+  FETCH(3, "dddddddddd", CACHED);
+
+  /* a scan never gets past the frequent pages */
+  for (i=100; i<120; i++)
+    FETCH(i, "xxxxxxxxxx", !CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(1, "bbbbbbbbbb", CACHED);
+  FETCH(3, "dddddddddd", CACHED);
+
+  lfu_free(&lfu);
+  fail_unless(lfu == NULL);
+}
+END_TEST
+
+#define TOUCH(key)                                            \
+  do {                                                        \
+    void *p;                                                  \
+    lfu_fetch(lfu, key, &p);                                  \
+    memcpy(p, #key "xxxxxxxx", 10);                           \
+  } while(0)
+
+START_TEST(test_aging) {
+  struct lfu_opts opts = {.aging = LFU_AGING_NONE, .period = 16};
+  lfu_t *lfu;
+  int aging, i;
+
+  /* 0 and 1 are popular early on, then 10 and 11 become popular.
+     Without aging, the latter never get to share the cache. */
+  for (aging=LFU_AGING_NONE; aging<=LFU_AGING_DA; aging++) {
+    opts.aging = aging;
+    lfu = lfu_new_ex(10, 3, &opts);
+    fail_unless(lfu != NULL);
+
+    for (i=0; i<20; i++) {
+      TOUCH(0);
+      TOUCH(1);
+    }
+    for (i=0; i<50; i++) {
+      TOUCH(10);
+      TOUCH(11);
+    }
+
+    if (aging == LFU_AGING_NONE) {
+      FETCH(10, "10xxxxxxxx", !CACHED);
+      FETCH(0, "0xxxxxxxx", CACHED);
+    } else {
+      FETCH(10, "10xxxxxxxx", CACHED);
+      FETCH(11, "11xxxxxxxx", CACHED);
+    }
+
+    lfu_free(&lfu);
+    fail_unless(lfu == NULL);
+  }
+}
+END_TEST
+
+START_TEST(test_invalidate) {
+  lfu_t *lfu = lfu_new(10, 4);
+
+  fail_unless(lfu != NULL);
+
+  FETCH(0, "aaaaaaaaaa", !CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(1, "bbbbbbbbbb", !CACHED);
+  FETCH(2, "cccccccccc", !CACHED);
+  FETCH(3, "dddddddddd", !CACHED);
+
+  /* an invalidated page is gone, and makes room without evicting,
+     after which the LRU page of the lowest frequency goes */
+  fail_unless(0 == lfu_invalidate(lfu, 2));
+  fail_unless(1 == lfu_invalidate(lfu, 2));
+  fail_unless(1 == lfu_invalidate(lfu, 100));
+  FETCH(4, "eeeeeeeeee", !CACHED);
+  FETCH(5, "ffffffffff", !CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(3, "dddddddddd", CACHED);
+  FETCH(4, "eeeeeeeeee", CACHED);
+  FETCH(5, "ffffffffff", CACHED);
+  FETCH(1, "bbbbbbbbbb", !CACHED);
+
+  lfu_free(&lfu);
+  fail_unless(lfu == NULL);
+}
+END_TEST
+
+START_TEST(test_resize) {
+  lfu_t *lfu = lfu_new(10, 4);
+
+  FETCH(0, "aaaaaaaaaa", !CACHED);
+  FETCH(1, "bbbbbbbbbb", !CACHED);
+  FETCH(2, "cccccccccc", !CACHED);
+  FETCH(3, "dddddddddd", !CACHED);
+
+  /* growing keeps every page, and adds room for more */
+  fail_unless(0 == lfu_resize(lfu, 8));
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(1, "bbbbbbbbbb", CACHED);
+  FETCH(2, "cccccccccc", CACHED);
+  FETCH(3, "dddddddddd", CACHED);
+  FETCH(4, "eeeeeeeeee", !CACHED);
+  FETCH(5, "ffffffffff", !CACHED);
+  FETCH(6, "gggggggggg", !CACHED);
+  FETCH(7, "hhhhhhhhhh", !CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(5, "ffffffffff", CACHED);
+  FETCH(6, "gggggggggg", CACHED);
+
+  /* shrinking drops the least frequently used pages, LRU first, and
+     keeps 0, fetched three times, and 6, the last fetched twice */
+  fail_unless(0 == lfu_resize(lfu, 2));
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(6, "gggggggggg", CACHED);
+  FETCH(5, "ffffffffff", !CACHED);
+
+  /* but not below what the policy needs */
+  fail_unless(-1 == lfu_resize(lfu, 1));
+
+  lfu_free(&lfu);
+  fail_unless(lfu == NULL);
+}
+END_TEST
+
+START_TEST(test_ttl) {
+  lfu_t *lfu = lfu_new(10, 4);
+
+  /* 0 and 1 live forever, 2 and 3 until 10, 3 being the most
+     frequently used */
+  FETCH_TTL(0, 0, 0, "aaaaaaaaaa", !CACHED);
+  FETCH_TTL(1, 0, 0, "bbbbbbbbbb", !CACHED);
+  FETCH_TTL(2, 0, 10, "cccccccccc", !CACHED);
+  FETCH_TTL(3, 0, 10, "dddddddddd", !CACHED);
+  FETCH_TTL(3, 8, 10, "dddddddddd", CACHED);
+  FETCH_TTL(3, 9, 10, "dddddddddd", CACHED);
+
+  /* an expired page is a miss, and reloading it gives it a new ttl */
+  FETCH_TTL(2, 10, 100, "CCCCCCCCCC", !CACHED);
+  FETCH_TTL(2, 11, 100, "CCCCCCCCCC", CACHED);
+
+  /* 3 has expired too, and is reclaimed before the LFU page 0 is
+     evicted, though it is the most frequently used */
+  FETCH_TTL(4, 20, 0, "eeeeeeeeee", !CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(1, "bbbbbbbbbb", CACHED);
+  FETCH(2, "CCCCCCCCCC", CACHED);
+  FETCH(4, "eeeeeeeeee", CACHED);
+  FETCH(3, "dddddddddd", !CACHED);
+
+  lfu_free(&lfu);
+  fail_unless(lfu == NULL);
+}
+END_TEST
+
+Suite *lfu_suite() {
+  TCase *tc;
+  Suite *s;
+
+  s = suite_create ("lfu");
+
+  tc = tcase_create ("foo");
+  tcase_add_test (tc, test_frequency);
+  tcase_add_test (tc, test_aging);
+  tcase_add_test (tc, test_invalidate);
+  tcase_add_test (tc, test_resize);
+  tcase_add_test (tc, test_ttl);
+  suite_add_tcase (s, tc);
+
+  return s;
+}
+
+int main(void) {
+  int number_failed;
+  Suite *s = lfu_suite();
+  SRunner *sr = srunner_create(s);
+  srunner_run_all (sr, CK_NORMAL);
+  number_failed = srunner_ntests_failed (sr);
+  srunner_free (sr);
+  return (number_failed == 0) ? 0 : 1;
+}
@@ -443,6 +443,118 @@ START_TEST(test_set_overwrite) {
 }
 END_TEST
 
+START_TEST(test_lists) {
+  linkmap_t *lm;
+  uint64_t key;
+  void *ptr;
+  int from;
+
+  /* lists share the capacity */
+  lm = linkmap_new_lists(4, 2);
+  fail_unless(lm != NULL);
+  fail_unless(!linkmap_set_in(lm, 0, 10, (void *)110));
+  fail_unless(!linkmap_set_in(lm, 1, 11, (void *)111));
+  fail_unless(!linkmap_set_in(lm, 1, 12, (void *)112));
+  fail_unless(!linkmap_set_in(lm, 0, 13, (void *)113));
+  fail_unless(1 == linkmap_set_in(lm, 1, 14, (void *)114));
+  fail_unless(4 == linkmap_size(lm));
+  fail_unless(2 == linkmap_size_in(lm, 0));
+  fail_unless(2 == linkmap_size_in(lm, 1));
+
+  /* keys are found in any list */
+  fail_unless(!linkmap_get(lm, 11, &ptr));
+  fail_unless(ptr == (void *)111);
+
+  /* and each list has its own order */
+  fail_unless(!linkmap_get_tail_in(lm, 0, &key, &ptr));
+  fail_unless(key == 10 && ptr == (void *)110);
+  fail_unless(!linkmap_get_tail_in(lm, 1, &key, &ptr));
+  fail_unless(key == 11 && ptr == (void *)111);
+  fail_unless(!linkmap_get_head(lm, &key, &ptr));
+  fail_unless(key == 13 && ptr == (void *)113);
+
+  /* moving between lists keeps the entry */
+  fail_unless(!linkmap_move(lm, 11, 0, &ptr, &from));
+  fail_unless(ptr == (void *)111 && from == 1);
+  fail_unless(3 == linkmap_size_in(lm, 0));
+  fail_unless(1 == linkmap_size_in(lm, 1));
+  fail_unless(!linkmap_get_head(lm, &key, &ptr));
+  fail_unless(key == 11);
+  fail_unless(!linkmap_get_tail_in(lm, 1, &key, &ptr));
+  fail_unless(key == 12);
+  fail_unless(!linkmap_get_list(lm, 12, &ptr, &from));
+  fail_unless(ptr == (void *)112 && from == 1);
+  fail_unless(1 == linkmap_get_list(lm, 99, &ptr, &from));
+
+  /* moving within a list makes it head */
+  fail_unless(!linkmap_move(lm, 10, 0, NULL, NULL));
+  fail_unless(!linkmap_get_head(lm, &key, &ptr));
+  fail_unless(key == 10);
+  fail_unless(!linkmap_get_tail(lm, &key, &ptr));
+  fail_unless(key == 13);
+  fail_unless(1 == linkmap_move(lm, 99, 0, NULL, NULL));
+
+  /* popping from a list */
+  fail_unless(!linkmap_pop_tail_in(lm, 1, &key, &ptr));
+  fail_unless(key == 12 && ptr == (void *)112);
+  fail_unless(1 == linkmap_pop_tail_in(lm, 1, &key, &ptr));
+  fail_unless(0 == linkmap_size_in(lm, 1));
+  fail_unless(!linkmap_pop_tail(lm, &key, &ptr));
+  fail_unless(key == 13);
+  fail_unless(!linkmap_pop_tail(lm, &key, &ptr));
+  fail_unless(key == 11);
+  fail_unless(!linkmap_pop_tail(lm, &key, &ptr));
+  fail_unless(key == 10);
+  fail_unless(0 == linkmap_size(lm));
+
+  linkmap_free(&lm);
+  fail_unless(lm == NULL);
+}
+END_TEST
+
+START_TEST(test_grow) {
+  struct linkmap_opts opts = {.nlists = 2, .grow = 1};
+  linkmap_t *lm;
+  uint64_t key;
+  void *ptr;
+  int i, list;
+
+  lm = linkmap_new_ex(4, &opts);
+  fail_unless(lm != NULL);
+
+  /* a growing table takes more than it was made for, and keeps its
+     lists in order while buckets are being rehashed */
+  for (i=0; i<1000; i++)
+    fail_unless(!linkmap_set_in(lm, i & 1, i, (void *)(uintptr_t)(i + 1)));
+  fail_unless(1000 == linkmap_size(lm));
+  fail_unless(500 == linkmap_size_in(lm, 1));
+  for (i=0; i<1000; i++) {
+    fail_unless(!linkmap_get_list(lm, i, &ptr, &list));
+    fail_unless(ptr == (void *)(uintptr_t)(i + 1) && list == (i & 1));
+  }
+  fail_unless(!linkmap_get_tail_in(lm, 1, &key, &ptr));
+  fail_unless(key == 1);
+
+  /* overwriting and moving in the middle of a rehash */
+  fail_unless(!linkmap_grow(lm, 4000));
+  fail_unless(!linkmap_set(lm, 3, (void *)33));
+  fail_unless(!linkmap_move(lm, 1, 0, &ptr, &list));
+  fail_unless(ptr == (void *)2 && list == 1);
+  fail_unless(!linkmap_get_head(lm, &key, &ptr));
+  fail_unless(key == 1);
+  for (i=0; i<501; i++)
+    fail_unless(!linkmap_pop_tail_in(lm, 0, &key, &ptr));
+  fail_unless(key == 1);
+  fail_unless(1 == linkmap_get(lm, 0, &ptr));
+  fail_unless(!linkmap_get(lm, 3, &ptr) && ptr == (void *)33);
+  fail_unless(0 == linkmap_size_in(lm, 0));
+  fail_unless(499 == linkmap_size_in(lm, 1));
+
+  linkmap_free(&lm);
+  fail_unless(lm == NULL);
+}
+END_TEST
+
 Suite *linkmap_suite() {
   TCase *tc;
   Suite *s;
@@ -461,6 +573,8 @@ Suite *linkmap_suite() {
   tcase_add_test (tc, test_del);
   tcase_add_test (tc, test_size);
   tcase_add_test (tc, test_set_overwrite);
+  tcase_add_test (tc, test_lists);
+  tcase_add_test (tc, test_grow);
   suite_add_tcase (s, tc);
 
   return s;
@@ -15,6 +15,26 @@
       memcpy(p, data, strlen(data));                        \
   } while(0)
 
+#define FETCH_TTL(key, now, ttl, data, cached)                \
+  do {                                                        \
+    void *p;                                                  \
+    fail_unless(cached == lru_fetch_ttl(lru, key, now, ttl, &p)); \
+    if (cached == CACHED)                                     \
+      fail_unless(!memcmp(p, data, strlen(data)));            \
+    else                                                      \
+      memcpy(p, data, strlen(data));                          \
+  } while(0)
+
+#define PREFETCH(key, data, cached)                       \
+  do {                                                    \
+    void *p;                                              \
+    fail_unless(cached == lru_prefetch(lru, key, &p));    \
+    if (cached == CACHED)                                 \
+      fail_unless(!memcmp(p, data, strlen(data)));        \
+    else                                                  \
+      memcpy(p, data, strlen(data));                      \
+  } while(0)
+
 START_TEST(test_no_eviction) {
   lru_t *lru = lru_new(10, 8);
 
@@ -99,6 +119,140 @@ START_TEST(test_eviction_order) {
 END_TEST
 
 
+START_TEST(test_ttl) {
+  lru_t *lru = lru_new(10, 4);
+
+  /* 0 and 1 live forever, 2 and 3 until 10, 3 being hit last */
+  FETCH_TTL(0, 0, 0, "aaaaaaaaaa", !CACHED);
+  FETCH_TTL(1, 0, 0, "bbbbbbbbbb", !CACHED);
+  FETCH_TTL(2, 0, 10, "cccccccccc", !CACHED);
+  FETCH_TTL(3, 0, 10, "dddddddddd", !CACHED);
+  FETCH_TTL(3, 9, 10, "dddddddddd", CACHED);
+
+  /* an expired page is a miss, and reloading it gives it a new ttl */
+  FETCH_TTL(2, 10, 100, "CCCCCCCCCC", !CACHED);
+  FETCH_TTL(2, 11, 100, "CCCCCCCCCC", CACHED);
+
+  /* 3 has expired too, and is reclaimed before the LRU page 0 is
+     evicted, though it is more recently used */
+  FETCH_TTL(4, 20, 0, "eeeeeeeeee", !CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(1, "bbbbbbbbbb", CACHED);
+  FETCH(2, "CCCCCCCCCC", CACHED);
+  FETCH(4, "eeeeeeeeee", CACHED);
+  FETCH(3, "dddddddddd", !CACHED);
+
+  lru_free(&lru);
+  fail_unless(lru == NULL);
+}
+END_TEST
+
+START_TEST(test_invalidate) {
+  lru_t *lru = lru_new(10, 4);
+
+  fail_unless(lru != NULL);
+
+  FETCH(0, "aaaaaaaaaa", !CACHED);
+  FETCH(1, "bbbbbbbbbb", !CACHED);
+  FETCH(2, "cccccccccc", !CACHED);
+  FETCH(3, "dddddddddd", !CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+
+  /* an invalidated page is gone, and makes room without evicting,
+     after which the LRU page goes */
+  fail_unless(0 == lru_invalidate(lru, 2));
+  fail_unless(1 == lru_invalidate(lru, 2));
+  fail_unless(1 == lru_invalidate(lru, 100));
+  FETCH(4, "eeeeeeeeee", !CACHED);
+  FETCH(5, "ffffffffff", !CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(3, "dddddddddd", CACHED);
+  FETCH(4, "eeeeeeeeee", CACHED);
+  FETCH(5, "ffffffffff", CACHED);
+  FETCH(1, "bbbbbbbbbb", !CACHED);
+
+  lru_free(&lru);
+  fail_unless(lru == NULL);
+}
+END_TEST
+
+START_TEST(test_resize) {
+  lru_t *lru = lru_new(10, 4);
+
+  FETCH(0, "aaaaaaaaaa", !CACHED);
+  FETCH(1, "bbbbbbbbbb", !CACHED);
+  FETCH(2, "cccccccccc", !CACHED);
+  FETCH(3, "dddddddddd", !CACHED);
+
+  /* growing keeps every page, and adds room for more */
+  fail_unless(0 == lru_resize(lru, 8));
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(1, "bbbbbbbbbb", CACHED);
+  FETCH(2, "cccccccccc", CACHED);
+  FETCH(3, "dddddddddd", CACHED);
+  FETCH(4, "eeeeeeeeee", !CACHED);
+  FETCH(5, "ffffffffff", !CACHED);
+  FETCH(6, "gggggggggg", !CACHED);
+  FETCH(7, "hhhhhhhhhh", !CACHED);
+  FETCH(5, "ffffffffff", CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+
+  /* shrinking drops the LRU pages */
+  fail_unless(0 == lru_resize(lru, 4));
+  FETCH(5, "ffffffffff", CACHED);
+  FETCH(6, "gggggggggg", CACHED);
+  FETCH(7, "hhhhhhhhhh", CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(1, "bbbbbbbbbb", !CACHED);
+
+  /* but not below what the policy needs */
+  fail_unless(-1 == lru_resize(lru, 1));
+
+  lru_free(&lru);
+  fail_unless(lru == NULL);
+}
+END_TEST
+
+START_TEST(test_prefetch) {
+  lru_t *lru = lru_new(10, 8);
+
+  fail_unless(lru != NULL);
+
+  FETCH(0, "aaaaaaaaaa", !CACHED);
+  FETCH(1, "bbbbbbbbbb", !CACHED);
+  FETCH(2, "cccccccccc", !CACHED);
+  FETCH(3, "dddddddddd", !CACHED);
+  FETCH(4, "eeeeeeeeee", !CACHED);
+  FETCH(5, "ffffffffff", !CACHED);
+
+  PREFETCH(6, "gggggggggg", !CACHED);
+  PREFETCH(7, "hhhhhhhhhh", !CACHED);
+
+  /* a cached page is left as it is, the LRU one */
+  PREFETCH(0, "aaaaaaaaaa", CACHED);
+
+  /* until they are more than a quarter of the cache, prefetched pages
+     push out the LRU page, and then the oldest prefetched one */
+  PREFETCH(8, "iiiiiiiiii", !CACHED);
+  PREFETCH(9, "jjjjjjjjjj", !CACHED);
+  FETCH(7, "hhhhhhhhhh", CACHED);
+  FETCH(8, "iiiiiiiiii", CACHED);
+  FETCH(9, "jjjjjjjjjj", CACHED);
+  FETCH(6, "gggggggggg", !CACHED);
+  FETCH(0, "aaaaaaaaaa", !CACHED);
+
+  /* fetched prefetched pages are in LRU order as any other */
+  FETCH(10, "kkkkkkkkkk", !CACHED);
+  FETCH(11, "llllllllll", !CACHED);
+  FETCH(12, "mmmmmmmmmm", !CACHED);
+  FETCH(13, "nnnnnnnnnn", !CACHED);
+  FETCH(7, "hhhhhhhhhh", !CACHED);
+  FETCH(9, "jjjjjjjjjj", CACHED);
+
+  lru_free(&lru);
+}
+END_TEST
+
 Suite *lru_suite() {
   TCase *tc;
   Suite *s;
@@ -108,6 +262,10 @@ Suite *lru_suite() {
   tc = tcase_create ("foo");
   tcase_add_test (tc, test_no_eviction);
   tcase_add_test (tc, test_eviction_order);
+  tcase_add_test (tc, test_ttl);
+  tcase_add_test (tc, test_invalidate);
+  tcase_add_test (tc, test_resize);
+  tcase_add_test (tc, test_prefetch);
   suite_add_tcase (s, tc);
 
   return s;
@@ -0,0 +1,230 @@
+#include <stdio.h>
+#include <string.h>
+#include <check.h>
+#include "mq.h"
+
+#define CACHED 0
+#define FETCH(key, data, cached)                              \
+  do {                                                        \
+    void *p;                                                  \
+    fail_unless(cached == mq_fetch(mq, key, &p));             \
+    if (cached == CACHED)                                     \
+      fail_unless(!memcmp(p, data, strlen(data)));            \
+    else                                                      \
+      memcpy(p, data, strlen(data));                          \
+  } while(0)
+
+#define FETCH_TTL(key, now, ttl, data, cached)            \
+  do {                                                    \
+    void *p;                                              \
+    fail_unless(cached == mq_fetch_ttl(mq, key, now, ttl, &p)); \
+    if (cached == CACHED)                                 \
+      fail_unless(!memcmp(p, data, strlen(data)));        \
+    else                                                  \
+      memcpy(p, data, strlen(data));                      \
+  } while(0)
+
+START_TEST(test_no_eviction) {
+  mq_t *mq = mq_new(10, 4);
+
+  fail_unless(mq != NULL);
+
+  FETCH(0, "aaaaaaaaaa", !CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(1, "bbbbbbbbbb", !CACHED);
+  FETCH(2, "cccccccccc", !CACHED);
+  FETCH(3, "dddddddddd", !CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(1, "bbbbbbbbbb", CACHED);
+  FETCH(2, "cccccccccc", CACHED);
+  FETCH(3, "dddddddddd", CACHED);
+
+  mq_free(&mq);
+  fail_unless(mq == NULL);
+}
+END_TEST
+
+START_TEST(test_frequency) {
+  struct mq_opts opts = {.queues = 0, .lifetime = 1000, .history = 0};
+  mq_t *mq = mq_new_ex(10, 4, &opts);
+
+  /* 0/a is referenced 3 times, which takes it to queue 1 */
+  FETCH(0, "aaaaaaaaaa", !CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(1, "bbbbbbbbbb", !CACHED);
+  FETCH(2, "cccccccccc", !CACHED);
+  FETCH(3, "dddddddddd", !CACHED);
+
+  /* so victims come from queue 0, even though 0/a is the LRU */
+  FETCH(4, "eeeeeeeeee", !CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+
+  /* 1/b is remembered in the history, and so comes back with 2
+     references, also in queue 1 */
+  FETCH(1, "bbbbbbbbbb", !CACHED);
+  FETCH(2, "cccccccccc", !CACHED);
+  FETCH(3, "dddddddddd", !CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(1, "bbbbbbbbbb", CACHED);
+  FETCH(2, "cccccccccc", CACHED);
+  FETCH(3, "dddddddddd", CACHED);
+
+  mq_free(&mq);
+  fail_unless(mq == NULL);
+}
+END_TEST
+
+START_TEST(test_lifetime) {
+  struct mq_opts opts = {.queues = 0, .lifetime = 2, .history = 0};
+  mq_t *mq = mq_new_ex(10, 4, &opts);
+
+  FETCH(0, "aaaaaaaaaa", !CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+
+  /* 0/a goes unreferenced for longer than its lifetime, and is
+     demoted back to queue 0 */
+  FETCH(1, "bbbbbbbbbb", !CACHED);
+  FETCH(2, "cccccccccc", !CACHED);
+  FETCH(3, "dddddddddd", !CACHED);
+
+  FETCH(4, "eeeeeeeeee", !CACHED);
+  FETCH(5, "ffffffffff", !CACHED);
+  FETCH(6, "gggggggggg", !CACHED);
+  FETCH(7, "hhhhhhhhhh", !CACHED);
+  FETCH(0, "aaaaaaaaaa", !CACHED);
+
+  mq_free(&mq);
+  fail_unless(mq == NULL);
+
+  /* too many queues */
+  opts.queues = 1000;
+  fail_unless(NULL == mq_new_ex(10, 4, &opts));
+}
+END_TEST
+
+START_TEST(test_invalidate) {
+  mq_t *mq = mq_new(10, 4);
+
+  fail_unless(mq != NULL);
+
+  FETCH(0, "aaaaaaaaaa", !CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(1, "bbbbbbbbbb", !CACHED);
+  FETCH(2, "cccccccccc", !CACHED);
+  FETCH(3, "dddddddddd", !CACHED);
+
+  /* an invalidated page is gone, and makes room without evicting,
+     after which the LRU page of the lowest queue goes */
+  fail_unless(0 == mq_invalidate(mq, 2));
+  fail_unless(1 == mq_invalidate(mq, 2));
+  fail_unless(1 == mq_invalidate(mq, 100));
+  FETCH(4, "eeeeeeeeee", !CACHED);
+  FETCH(5, "ffffffffff", !CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(3, "dddddddddd", CACHED);
+  FETCH(4, "eeeeeeeeee", CACHED);
+  FETCH(5, "ffffffffff", CACHED);
+  FETCH(1, "bbbbbbbbbb", !CACHED);
+
+  mq_free(&mq);
+  fail_unless(mq == NULL);
+}
+END_TEST
+
+START_TEST(test_resize) {
+  mq_t *mq = mq_new(10, 4);
+
+  FETCH(0, "aaaaaaaaaa", !CACHED);
+  FETCH(1, "bbbbbbbbbb", !CACHED);
+  FETCH(2, "cccccccccc", !CACHED);
+  FETCH(3, "dddddddddd", !CACHED);
+
+  /* growing keeps every page, and adds room for more */
+  fail_unless(0 == mq_resize(mq, 8));
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(1, "bbbbbbbbbb", CACHED);
+  FETCH(2, "cccccccccc", CACHED);
+  FETCH(3, "dddddddddd", CACHED);
+  FETCH(4, "eeeeeeeeee", !CACHED);
+  FETCH(5, "ffffffffff", !CACHED);
+  FETCH(6, "gggggggggg", !CACHED);
+  FETCH(7, "hhhhhhhhhh", !CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(5, "ffffffffff", CACHED);
+  FETCH(6, "gggggggggg", CACHED);
+
+  /* shrinking drops the pages of the lowest queue, then the LRU
+     pages of the next, 0 among them, as its three references put it
+     in the same queue as 5 and 6 with their two */
+  fail_unless(0 == mq_resize(mq, 2));
+  FETCH(5, "ffffffffff", CACHED);
+  FETCH(6, "gggggggggg", CACHED);
+  FETCH(0, "aaaaaaaaaa", !CACHED);
+
+  /* but not below what the policy needs */
+  fail_unless(-1 == mq_resize(mq, 1));
+
+  mq_free(&mq);
+  fail_unless(mq == NULL);
+}
+END_TEST
+
+START_TEST(test_ttl) {
+  mq_t *mq = mq_new(10, 4);
+
+  /* 0 and 1 live forever, 2 and 3 until 10, 3 being referenced
+     enough to go up a queue */
+  FETCH_TTL(0, 0, 0, "aaaaaaaaaa", !CACHED);
+  FETCH_TTL(1, 0, 0, "bbbbbbbbbb", !CACHED);
+  FETCH_TTL(2, 0, 10, "cccccccccc", !CACHED);
+  FETCH_TTL(3, 0, 10, "dddddddddd", !CACHED);
+  FETCH_TTL(3, 8, 10, "dddddddddd", CACHED);
+  FETCH_TTL(3, 9, 10, "dddddddddd", CACHED);
+
+  /* an expired page is a miss, and reloading it gives it a new ttl */
+  FETCH_TTL(2, 10, 100, "CCCCCCCCCC", !CACHED);
+  FETCH_TTL(2, 11, 100, "CCCCCCCCCC", CACHED);
+
+  /* 3 has expired too, and is reclaimed before 0, the LRU page of the
+     lowest queue, is evicted */
+  FETCH_TTL(4, 20, 0, "eeeeeeeeee", !CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(1, "bbbbbbbbbb", CACHED);
+  FETCH(2, "CCCCCCCCCC", CACHED);
+  FETCH(4, "eeeeeeeeee", CACHED);
+  FETCH(3, "dddddddddd", !CACHED);
+
+  mq_free(&mq);
+  fail_unless(mq == NULL);
+}
+END_TEST
+
+Suite *mq_suite() {
+  TCase *tc;
+  Suite *s;
+
+  s = suite_create ("mq");
+
+  tc = tcase_create ("foo");
+  tcase_add_test (tc, test_no_eviction);
+  tcase_add_test (tc, test_frequency);
+  tcase_add_test (tc, test_lifetime);
+  tcase_add_test (tc, test_invalidate);
+  tcase_add_test (tc, test_resize);
+  tcase_add_test (tc, test_ttl);
+  suite_add_tcase (s, tc);
+
+  return s;
+}
+
+int main(void) {
+  int number_failed;
+  Suite *s = mq_suite();
+  SRunner *sr = srunner_create(s);
+  srunner_run_all (sr, CK_NORMAL);
+  number_failed = srunner_ntests_failed (sr);
+  srunner_free (sr);
+  return (number_failed == 0) ? 0 : 1;
+}
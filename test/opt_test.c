@@ -0,0 +1,98 @@
+#include <stdio.h>
+#include <string.h>
+#include <check.h>
+#include "opt.h"
+
+#define CACHED 0
+#define FETCH(key, data, cached)                              \
+  do {                                                        \
+    void *p;                                                  \
+    fail_unless(cached == opt_fetch(opt, key, &p));           \
+    if (cached == CACHED)                                     \
+      fail_unless(!memcmp(p, data, strlen(data)));            \
+    else                                                      \
+      memcpy(p, data, strlen(data));                          \
+  } while(0)
+
+START_TEST(test_farthest) {
+  uint64_t trace[] = {0, 1, 2, 0, 3, 0, 1, 2, 1};
+  opt_t *opt = opt_new(10, 3, trace, sizeof(trace)/sizeof(trace[0]));
+  void *p;
+
+  fail_unless(opt != NULL);
+
+  FETCH(0, "aaaaaaaaaa", !CACHED);
+  FETCH(1, "bbbbbbbbbb", !CACHED);
+  FETCH(2, "cccccccccc", !CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  /* 2/c is needed last, so it goes */
+  FETCH(3, "dddddddddd", !CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(1, "bbbbbbbbbb", CACHED);
+  /* 0/a and 3/d are never needed again */
+  FETCH(2, "cccccccccc", !CACHED);
+  FETCH(1, "bbbbbbbbbb", CACHED);
+
+  /* past the end of the trace */
+  fail_unless(-1 == opt_fetch(opt, 1, &p));
+
+  opt_free(&opt);
+  fail_unless(opt == NULL);
+}
+END_TEST
+
+START_TEST(test_out_of_order) {
+  uint64_t trace[] = {0, 1};
+  opt_t *opt = opt_new(10, 3, trace, 2);
+  void *p;
+
+  fail_unless(-1 == opt_fetch(opt, 1, &p));
+  fail_unless(1 == opt_fetch(opt, 0, &p));
+
+  opt_free(&opt);
+}
+END_TEST
+
+START_TEST(test_loop) {
+  static uint64_t trace[100000];
+  opt_t *opt;
+  void *p;
+  int i, hits;
+
+  /* a loop one page larger than the cache defeats LRU entirely, while
+     OPT only misses about once per lap */
+  for (i=0; i<100000; i++)
+    trace[i] = i % 101;
+  opt = opt_new(10, 100, trace, 100000);
+  hits = 0;
+  for (i=0; i<100000; i++)
+    hits += CACHED == opt_fetch(opt, trace[i], &p);
+  fail_unless(hits > 98000);
+  opt_free(&opt);
+}
+END_TEST
+
+Suite *opt_suite() {
+  TCase *tc;
+  Suite *s;
+
+  s = suite_create ("opt");
+
+  tc = tcase_create ("foo");
+  tcase_add_test (tc, test_farthest);
+  tcase_add_test (tc, test_out_of_order);
+  tcase_add_test (tc, test_loop);
+  suite_add_tcase (s, tc);
+
+  return s;
+}
+
+int main(void) {
+  int number_failed;
+  Suite *s = opt_suite();
+  SRunner *sr = srunner_create(s);
+  srunner_run_all (sr, CK_NORMAL);
+  number_failed = srunner_ntests_failed (sr);
+  srunner_free (sr);
+  return (number_failed == 0) ? 0 : 1;
+}
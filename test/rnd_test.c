@@ -19,6 +19,18 @@
       memcpy(p, data, strlen(data));                            \
   } while(0)
 
+#define FETCH_TTL(key, now, ttl, data, count)                   \
+  do {                                                          \
+    void *p;                                                    \
+    int ret;                                                    \
+    ret = rnd_fetch_ttl(rnd, key, now, ttl, &p);                \
+    count += ret;                                               \
+    if (ret == CACHED)                                          \
+      fail_unless(!memcmp(p, data, strlen(data)));              \
+    else                                                        \
+      memcpy(p, data, strlen(data));                            \
+  } while(0)
+
 START_TEST(test_no_eviction) {
   rnd_t *rnd = rnd_new(10, 8);
   int count;
@@ -103,6 +115,213 @@ START_TEST(test_eviction_order) {
 }
 END_TEST
 
+START_TEST(test_reproducible) {
+  struct rnd_opts opts = {.seed = 4711, .samples = 1};
+  rnd_t *a, *b;
+  void *pa, *pb;
+  int i;
+
+  /* two instances with the same seed evict the same pages */
+  a = rnd_new_ex(10, 8, &opts);
+  b = rnd_new_ex(10, 8, &opts);
+  fail_unless(a != NULL && b != NULL);
+  for (i=0; i<1000; i++) {
+    fail_unless(rnd_fetch(a, i % 13, &pa) == rnd_fetch(b, i % 13, &pb));
+    *(int *)pa = *(int *)pb = i;
+  }
+
+  rnd_free(&a);
+  rnd_free(&b);
+}
+END_TEST
+
+START_TEST(test_sample_lru) {
+  struct rnd_opts opts = {.seed = 1, .samples = 64,
+                          .sample = RND_SAMPLE_LRU};
+  rnd_t *rnd = rnd_new_ex(10, 8, &opts);
+  int count = 0;
+
+  fail_unless(rnd != NULL);
+
+  FETCH(0, "aaaaaaaaaa", count);
+  FETCH(1, "bbbbbbbbbb", count);
+  FETCH(2, "cccccccccc", count);
+  FETCH(3, "dddddddddd", count);
+  FETCH(4, "eeeeeeeeee", count);
+  FETCH(5, "ffffffffff", count);
+  FETCH(6, "gggggggggg", count);
+  FETCH(7, "hhhhhhhhhh", count);
+
+  /* with that many samples, the least recently used is evicted */
+  FETCH(0, "aaaaaaaaaa", count);
+  FETCH(8, "iiiiiiiiii", count);
+  fail_unless(count == 9);
+  FETCH(0, "aaaaaaaaaa", count);
+  FETCH(2, "cccccccccc", count);
+  fail_unless(count == 9);
+  FETCH(1, "bbbbbbbbbb", count);
+  fail_unless(count == 10);
+
+  rnd_free(&rnd);
+  fail_unless(rnd == NULL);
+}
+END_TEST
+
+START_TEST(test_sample_lfu) {
+  struct rnd_opts opts = {.seed = 1, .samples = 64,
+                          .sample = RND_SAMPLE_LFU};
+  rnd_t *rnd = rnd_new_ex(10, 4, &opts);
+  int count = 0;
+
+  fail_unless(rnd != NULL);
+
+  FETCH(0, "aaaaaaaaaa", count);
+  FETCH(1, "bbbbbbbbbb", count);
+  FETCH(2, "cccccccccc", count);
+  FETCH(3, "dddddddddd", count);
+  FETCH(0, "aaaaaaaaaa", count);
+  FETCH(1, "bbbbbbbbbb", count);
+  FETCH(3, "dddddddddd", count);
+  FETCH(3, "dddddddddd", count);
+  fail_unless(count == 4);
+
+  /* 2/c was used the least, so it goes first */
+  FETCH(4, "eeeeeeeeee", count);
+  fail_unless(count == 5);
+  FETCH(0, "aaaaaaaaaa", count);
+  FETCH(1, "bbbbbbbbbb", count);
+  FETCH(3, "dddddddddd", count);
+  fail_unless(count == 5);
+  FETCH(2, "cccccccccc", count);
+  fail_unless(count == 6);
+
+  rnd_free(&rnd);
+  fail_unless(rnd == NULL);
+}
+END_TEST
+
+
+START_TEST(test_ttl) {
+  rnd_t *rnd = rnd_new(10, 8);
+  int count;
+
+  /* 0-3 live until 10, 4-7 forever */
+  count = 0;
+  FETCH_TTL(0, 0, 10, "aaaaaaaaaa", count);
+  FETCH_TTL(1, 0, 10, "bbbbbbbbbb", count);
+  FETCH_TTL(2, 0, 10, "cccccccccc", count);
+  FETCH_TTL(3, 0, 10, "dddddddddd", count);
+  FETCH_TTL(4, 0, 0, "eeeeeeeeee", count);
+  FETCH_TTL(5, 0, 0, "ffffffffff", count);
+  FETCH_TTL(6, 0, 0, "gggggggggg", count);
+  FETCH_TTL(7, 0, 0, "hhhhhhhhhh", count);
+  fail_unless(count == 8);
+
+  count = 0;
+  FETCH_TTL(0, 9, 10, "aaaaaaaaaa", count);
+  fail_unless(count == 0);
+
+  /* an expired page is a miss, and reloading it gives it a new ttl */
+  FETCH_TTL(0, 10, 100, "AAAAAAAAAA", count);
+  FETCH_TTL(0, 11, 100, "AAAAAAAAAA", count);
+  fail_unless(count == 1);
+
+  /* expired pages are reclaimed before random eviction kicks in */
+  count = 0;
+  FETCH_TTL(8, 20, 0, "iiiiiiiiii", count);
+  FETCH_TTL(9, 20, 0, "jjjjjjjjjj", count);
+  FETCH(10, "kkkkkkkkkk", count);
+  fail_unless(count == 3);
+
+  count = 0;
+  FETCH(0, "AAAAAAAAAA", count);
+  FETCH(4, "eeeeeeeeee", count);
+  FETCH(5, "ffffffffff", count);
+  FETCH(6, "gggggggggg", count);
+  FETCH(7, "hhhhhhhhhh", count);
+  FETCH(8, "iiiiiiiiii", count);
+  FETCH(9, "jjjjjjjjjj", count);
+  FETCH(10, "kkkkkkkkkk", count);
+  fail_unless(count == 0);
+
+  rnd_free(&rnd);
+  fail_unless(rnd == NULL);
+}
+END_TEST
+
+START_TEST(test_invalidate) {
+  rnd_t *rnd = rnd_new(10, 4);
+  int misses = 0;
+
+  fail_unless(rnd != NULL);
+
+  FETCH(0, "aaaaaaaaaa", misses);
+  FETCH(1, "bbbbbbbbbb", misses);
+  FETCH(2, "cccccccccc", misses);
+  FETCH(3, "dddddddddd", misses);
+  fail_unless(misses == 4);
+
+  /* an invalidated page is gone, and makes room without evicting,
+     after which a random page goes, 3 with this seed */
+  fail_unless(0 == rnd_invalidate(rnd, 2));
+  fail_unless(1 == rnd_invalidate(rnd, 2));
+  fail_unless(1 == rnd_invalidate(rnd, 100));
+  FETCH(4, "eeeeeeeeee", misses);
+  FETCH(0, "aaaaaaaaaa", misses);
+  FETCH(1, "bbbbbbbbbb", misses);
+  FETCH(3, "dddddddddd", misses);
+  fail_unless(misses == 5);
+  FETCH(5, "ffffffffff", misses);
+  FETCH(0, "aaaaaaaaaa", misses);
+  FETCH(1, "bbbbbbbbbb", misses);
+  FETCH(4, "eeeeeeeeee", misses);
+  FETCH(5, "ffffffffff", misses);
+  fail_unless(misses == 6);
+  FETCH(3, "dddddddddd", misses);
+  fail_unless(misses == 7);
+
+  rnd_free(&rnd);
+  fail_unless(rnd == NULL);
+}
+END_TEST
+
+START_TEST(test_resize) {
+  rnd_t *rnd = rnd_new(10, 4);
+  int misses = 0;
+
+  FETCH(0, "aaaaaaaaaa", misses);
+  FETCH(1, "bbbbbbbbbb", misses);
+  FETCH(2, "cccccccccc", misses);
+  FETCH(3, "dddddddddd", misses);
+
+  /* growing keeps every page, and adds room for more */
+  fail_unless(0 == rnd_resize(rnd, 8));
+  FETCH(0, "aaaaaaaaaa", misses);
+  FETCH(1, "bbbbbbbbbb", misses);
+  FETCH(2, "cccccccccc", misses);
+  FETCH(3, "dddddddddd", misses);
+  fail_unless(misses == 4);
+  FETCH(4, "eeeeeeeeee", misses);
+  FETCH(5, "ffffffffff", misses);
+  FETCH(6, "gggggggggg", misses);
+  FETCH(7, "hhhhhhhhhh", misses);
+  fail_unless(misses == 8);
+
+  /* shrinking keeps random pages, hit or not, 1, 2, 5 and 7 with
+     this seed */
+  fail_unless(0 == rnd_resize(rnd, 4));
+  FETCH(1, "bbbbbbbbbb", misses);
+  FETCH(2, "cccccccccc", misses);
+  FETCH(5, "ffffffffff", misses);
+  FETCH(7, "hhhhhhhhhh", misses);
+  fail_unless(misses == 8);
+  FETCH(0, "aaaaaaaaaa", misses);
+  fail_unless(misses == 9);
+
+  rnd_free(&rnd);
+  fail_unless(rnd == NULL);
+}
+END_TEST
 
 Suite *rnd_suite() {
   TCase *tc;
@@ -113,6 +332,12 @@ Suite *rnd_suite() {
   tc = tcase_create ("foo");
   tcase_add_test (tc, test_no_eviction);
   tcase_add_test (tc, test_eviction_order);
+  tcase_add_test (tc, test_reproducible);
+  tcase_add_test (tc, test_sample_lru);
+  tcase_add_test (tc, test_sample_lfu);
+  tcase_add_test (tc, test_ttl);
+  tcase_add_test (tc, test_invalidate);
+  tcase_add_test (tc, test_resize);
   suite_add_tcase (s, tc);
 
   return s;
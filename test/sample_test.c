@@ -0,0 +1,269 @@
+#include <stdio.h>
+#include <string.h>
+#include <check.h>
+#include "sample.h"
+
+#define CACHED 0
+#define FETCH(key, data, cached)                              \
+  do {                                                        \
+    void *p;                                                  \
+    fail_unless(cached == sample_fetch(sample, key, &p));     \
+    if (cached == CACHED)                                     \
+      fail_unless(!memcmp(p, data, strlen(data)));            \
+    else                                                      \
+      memcpy(p, data, strlen(data));                          \
+  } while(0)
+
+#define FETCH_TTL(key, now, ttl, data, cached)            \
+  do {                                                    \
+    void *p;                                              \
+    fail_unless(cached == sample_fetch_ttl(sample, key, now, ttl, &p)); \
+    if (cached == CACHED)                                 \
+      fail_unless(!memcmp(p, data, strlen(data)));        \
+    else                                                  \
+      memcpy(p, data, strlen(data));                      \
+  } while(0)
+
+START_TEST(test_no_eviction) {
+  sample_t *sample = sample_new(10, 8);
+
+  fail_unless(sample != NULL);
+
+  FETCH(0, "aaaaaaaaaa", !CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(1, "bbbbbbbbbb", !CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(1, "bbbbbbbbbb", CACHED);
+
+  FETCH(2, "cccccccccc", !CACHED);
+  FETCH(3, "dddddddddd", !CACHED);
+  FETCH(4, "eeeeeeeeee", !CACHED);
+  FETCH(5, "ffffffffff", !CACHED);
+  FETCH(6, "gggggggggg", !CACHED);
+  FETCH(7, "hhhhhhhhhh", !CACHED);
+
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(1, "bbbbbbbbbb", CACHED);
+  FETCH(2, "cccccccccc", CACHED);
+  FETCH(3, "dddddddddd", CACHED);
+  FETCH(4, "eeeeeeeeee", CACHED);
+  FETCH(5, "ffffffffff", CACHED);
+  FETCH(6, "gggggggggg", CACHED);
+  FETCH(7, "hhhhhhhhhh", CACHED);
+
+  sample_free(&sample);
+  fail_unless(sample == NULL);
+}
+END_TEST
+
+/* With many more samples than pages, the approximation is exact */
+static void check_lru(int pool) {
+  struct sample_opts opts = {.policy = SAMPLE_LRU, .samples = 64,
+                             .pool = pool, .seed = 1};
+  sample_t *sample = sample_new_ex(10, 4, &opts);
+
+  fail_unless(sample != NULL);
+
+  FETCH(0, "aaaaaaaaaa", !CACHED);
+  FETCH(1, "bbbbbbbbbb", !CACHED);
+  FETCH(2, "cccccccccc", !CACHED);
+  FETCH(3, "dddddddddd", !CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+
+  /* 1/b is least recently used */
+  FETCH(4, "eeeeeeeeee", !CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(2, "cccccccccc", CACHED);
+  FETCH(3, "dddddddddd", CACHED);
+  FETCH(4, "eeeeeeeeee", CACHED);
+
+  /* so far 0, 2, 3, 4 have been used in that order, a hit on 0
+     makes 2/c the victim, even if 0/a sits in the pool */
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(1, "bbbbbbbbbb", !CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(3, "dddddddddd", CACHED);
+  FETCH(4, "eeeeeeeeee", CACHED);
+  FETCH(1, "bbbbbbbbbb", CACHED);
+  FETCH(2, "cccccccccc", !CACHED);
+
+  sample_free(&sample);
+  fail_unless(sample == NULL);
+}
+
+START_TEST(test_lru) {
+  check_lru(0);
+  check_lru(16);
+}
+END_TEST
+
+START_TEST(test_lfu) {
+  struct sample_opts opts = {.policy = SAMPLE_LFU, .samples = 64,
+                             .pool = 16, .seed = 1};
+  sample_t *sample = sample_new_ex(10, 4, &opts);
+
+  fail_unless(sample != NULL);
+
+  FETCH(0, "aaaaaaaaaa", !CACHED);
+  FETCH(1, "bbbbbbbbbb", !CACHED);
+  FETCH(2, "cccccccccc", !CACHED);
+  FETCH(3, "dddddddddd", !CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(1, "bbbbbbbbbb", CACHED);
+  FETCH(3, "dddddddddd", CACHED);
+
+  /* 2/c was used the least */
+  FETCH(4, "eeeeeeeeee", !CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(1, "bbbbbbbbbb", CACHED);
+  FETCH(3, "dddddddddd", CACHED);
+  FETCH(4, "eeeeeeeeee", CACHED);
+  FETCH(4, "eeeeeeeeee", CACHED);
+
+  /* now 1/b is, having been used twice to the others' thrice */
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(3, "dddddddddd", CACHED);
+  FETCH(2, "cccccccccc", !CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(3, "dddddddddd", CACHED);
+  FETCH(4, "eeeeeeeeee", CACHED);
+  FETCH(1, "bbbbbbbbbb", !CACHED);
+
+  sample_free(&sample);
+  fail_unless(sample == NULL);
+}
+END_TEST
+
+START_TEST(test_bad_opts) {
+  struct sample_opts opts = {.policy = SAMPLE_LRU, .samples = 5,
+                             .pool = 100000, .seed = 1};
+
+  fail_unless(NULL == sample_new_ex(10, 4, &opts));
+}
+END_TEST
+
+START_TEST(test_invalidate) {
+  struct sample_opts opts = {.policy = SAMPLE_LRU, .samples = 64,
+                             .pool = 16, .seed = 1};
+  sample_t *sample = sample_new_ex(10, 4, &opts);
+
+  fail_unless(sample != NULL);
+
+  FETCH(0, "aaaaaaaaaa", !CACHED);
+  FETCH(1, "bbbbbbbbbb", !CACHED);
+  FETCH(2, "cccccccccc", !CACHED);
+  FETCH(3, "dddddddddd", !CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+
+  /* an invalidated page is gone, and makes room without evicting,
+     after which the LRU page goes */
+  fail_unless(0 == sample_invalidate(sample, 2));
+  fail_unless(1 == sample_invalidate(sample, 2));
+  fail_unless(1 == sample_invalidate(sample, 100));
+  FETCH(4, "eeeeeeeeee", !CACHED);
+  FETCH(5, "ffffffffff", !CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(3, "dddddddddd", CACHED);
+  FETCH(4, "eeeeeeeeee", CACHED);
+  FETCH(5, "ffffffffff", CACHED);
+  FETCH(1, "bbbbbbbbbb", !CACHED);
+
+  sample_free(&sample);
+  fail_unless(sample == NULL);
+}
+END_TEST
+
+START_TEST(test_resize) {
+  struct sample_opts opts = {.policy = SAMPLE_LRU, .samples = 64,
+                             .pool = 16, .seed = 1};
+  sample_t *sample = sample_new_ex(10, 4, &opts);
+
+  FETCH(0, "aaaaaaaaaa", !CACHED);
+  FETCH(1, "bbbbbbbbbb", !CACHED);
+  FETCH(2, "cccccccccc", !CACHED);
+  FETCH(3, "dddddddddd", !CACHED);
+
+  /* growing keeps every page, and adds room for more */
+  fail_unless(0 == sample_resize(sample, 8));
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(1, "bbbbbbbbbb", CACHED);
+  FETCH(2, "cccccccccc", CACHED);
+  FETCH(3, "dddddddddd", CACHED);
+  FETCH(4, "eeeeeeeeee", !CACHED);
+  FETCH(5, "ffffffffff", !CACHED);
+  FETCH(6, "gggggggggg", !CACHED);
+  FETCH(7, "hhhhhhhhhh", !CACHED);
+  FETCH(5, "ffffffffff", CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+
+  /* shrinking drops the LRU pages */
+  fail_unless(0 == sample_resize(sample, 4));
+  FETCH(5, "ffffffffff", CACHED);
+  FETCH(6, "gggggggggg", CACHED);
+  FETCH(7, "hhhhhhhhhh", CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(1, "bbbbbbbbbb", !CACHED);
+
+  sample_free(&sample);
+  fail_unless(sample == NULL);
+}
+END_TEST
+
+START_TEST(test_ttl) {
+  struct sample_opts opts = {.policy = SAMPLE_LRU, .samples = 64,
+                             .pool = 16, .seed = 1};
+  sample_t *sample = sample_new_ex(10, 4, &opts);
+
+  /* 0 and 1 live forever, 2 and 3 until 10, 3 being hit last */
+  FETCH_TTL(0, 0, 0, "aaaaaaaaaa", !CACHED);
+  FETCH_TTL(1, 0, 0, "bbbbbbbbbb", !CACHED);
+  FETCH_TTL(2, 0, 10, "cccccccccc", !CACHED);
+  FETCH_TTL(3, 0, 10, "dddddddddd", !CACHED);
+  FETCH_TTL(3, 9, 10, "dddddddddd", CACHED);
+
+  /* an expired page is a miss, and reloading it gives it a new ttl */
+  FETCH_TTL(2, 10, 100, "CCCCCCCCCC", !CACHED);
+  FETCH_TTL(2, 11, 100, "CCCCCCCCCC", CACHED);
+
+  /* 3 has expired too, and is reclaimed before the LRU page 0 is
+     evicted, though it is more recently used */
+  FETCH_TTL(4, 20, 0, "eeeeeeeeee", !CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(1, "bbbbbbbbbb", CACHED);
+  FETCH(2, "CCCCCCCCCC", CACHED);
+  FETCH(4, "eeeeeeeeee", CACHED);
+  FETCH(3, "dddddddddd", !CACHED);
+
+  sample_free(&sample);
+  fail_unless(sample == NULL);
+}
+END_TEST
+
+Suite *sample_suite() {
+  TCase *tc;
+  Suite *s;
+
+  s = suite_create ("sample");
+
+  tc = tcase_create ("foo");
+  tcase_add_test (tc, test_no_eviction);
+  tcase_add_test (tc, test_lru);
+  tcase_add_test (tc, test_lfu);
+  tcase_add_test (tc, test_bad_opts);
+  tcase_add_test (tc, test_invalidate);
+  tcase_add_test (tc, test_resize);
+  tcase_add_test (tc, test_ttl);
+  suite_add_tcase (s, tc);
+
+  return s;
+}
+
+int main(void) {
+  int number_failed;
+  Suite *s = sample_suite();
+  SRunner *sr = srunner_create(s);
+  srunner_run_all (sr, CK_NORMAL);
+  number_failed = srunner_ntests_failed (sr);
+  srunner_free (sr);
+  return (number_failed == 0) ? 0 : 1;
+}
@@ -0,0 +1,119 @@
+#include <stdio.h>
+#include <string.h>
+#include <check.h>
+#include "seqdet.h"
+
+
+/* fetches key, which asks for n keys from from on */
+#define ACCESS(key, n, from)                                    \
+  do {                                                          \
+    uint64_t f = 12345;                                         \
+    fail_unless(n == seqdet_access(sd, key, &f));               \
+    fail_unless(n ? f == from : f == 12345);                    \
+  } while(0)
+
+START_TEST(test_window) {
+  seqdet_t *sd = seqdet_new();
+  uint64_t k;
+
+  fail_unless(sd != NULL);
+
+  /* a run of two starts prefetching 4 keys ahead, and a repeat
+     doesn't count */
+  ACCESS(100, 0, 0);
+  ACCESS(101, 4, 102);
+  ACCESS(101, 0, 0);
+  ACCESS(102, 0, 0);
+
+  /* the window doubles each time half of it is used up, up to 32
+     keys ahead */
+  ACCESS(103, 6, 106);
+  for (k=104; k<107; k++)
+    ACCESS(k, 0, 0);
+  ACCESS(107, 12, 112);
+  for (k=108; k<115; k++)
+    ACCESS(k, 0, 0);
+  ACCESS(115, 24, 124);
+  for (k=116; k<131; k++)
+    ACCESS(k, 0, 0);
+  ACCESS(131, 16, 148);
+  for (k=132; k<147; k++)
+    ACCESS(k, 0, 0);
+  ACCESS(147, 16, 164);
+
+  /* a jump starts over */
+  ACCESS(1000, 0, 0);
+  ACCESS(1001, 4, 1002);
+
+  seqdet_free(&sd);
+  fail_unless(sd == NULL);
+}
+END_TEST
+
+START_TEST(test_streams) {
+  struct seqdet_opts opts = {.streams = 2, .trigger = 3, .window = 8};
+  seqdet_t *sd = seqdet_new_ex(&opts);
+
+  fail_unless(sd != NULL);
+
+  /* interleaved runs are told apart */
+  ACCESS(0, 0, 0);
+  ACCESS(1000, 0, 0);
+  ACCESS(1, 0, 0);
+  ACCESS(1001, 0, 0);
+  ACCESS(2, 4, 3);
+  ACCESS(1002, 4, 1003);
+  ACCESS(3, 0, 0);
+  ACCESS(1003, 0, 0);
+  ACCESS(4, 6, 7);
+  ACCESS(1004, 6, 1007);
+
+  /* a key continuing neither replaces the one idle the longest */
+  ACCESS(500, 0, 0);
+  ACCESS(1005, 0, 0);
+  ACCESS(5, 0, 0);
+  ACCESS(6, 0, 0);
+  ACCESS(7, 4, 8);
+
+  /* random keys never prefetch */
+  ACCESS(40, 0, 0);
+  ACCESS(20, 0, 0);
+  ACCESS(41, 0, 0);
+  ACCESS(21, 0, 0);
+  ACCESS(60, 0, 0);
+
+  seqdet_free(&sd);
+}
+END_TEST
+
+START_TEST(test_invalid) {
+  struct seqdet_opts opts = {.streams = -1};
+
+  fail_unless(NULL == seqdet_new_ex(&opts));
+}
+END_TEST
+
+Suite *seqdet_suite() {
+  TCase *tc;
+  Suite *s;
+
+  s = suite_create ("seqdet");
+
+  tc = tcase_create ("foo");
+  tcase_add_test (tc, test_window);
+  tcase_add_test (tc, test_streams);
+  tcase_add_test (tc, test_invalid);
+  suite_add_tcase (s, tc);
+
+  return s;
+}
+
+int main(void) {
+  int number_failed;
+  Suite *s = seqdet_suite();
+  SRunner *sr = srunner_create(s);
+  srunner_run_all (sr, CK_NORMAL);
+  number_failed = srunner_ntests_failed (sr);
+  srunner_free (sr);
+  return (number_failed == 0) ? 0 : 1;
+}
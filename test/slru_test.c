@@ -18,6 +18,26 @@
       memcpy(p, data, strlen(data));                          \
   } while(0)
 
+#define FETCH_TTL(key, now, ttl, data, cached)                \
+  do {                                                        \
+    void *p;                                                  \
+    fail_unless(cached == slru_fetch_ttl(slru, key, now, ttl, &p)); \
+    if (cached == CACHED)                                     \
+      fail_unless(!memcmp(p, data, strlen(data)));            \
+    else                                                      \
+      memcpy(p, data, strlen(data));                          \
+  } while(0)
+
+#define PREFETCH(key, data, cached)                       \
+  do {                                                    \
+    void *p;                                              \
+    fail_unless(cached == slru_prefetch(slru, key, &p));  \
+    if (cached == CACHED)                                 \
+      fail_unless(!memcmp(p, data, strlen(data)));        \
+    else                                                  \
+      memcpy(p, data, strlen(data));                      \
+  } while(0)
+
 START_TEST(test_no_eviction) {
   slru_t *slru = slru_new(10, 8);
 
@@ -191,6 +211,279 @@ START_TEST(test_demotion) {
 }
 END_TEST
 
+START_TEST(test_protected_size) {
+  struct slru_opts opts = {.protected = 6, .adaptive = 0};
+  slru_t *slru = slru_new_ex(10, 8, &opts);
+
+  fail_unless(slru != NULL);
+
+  /* 6 protected leaves 2 probationary slots */
+  FETCH(0, "aaaaaaaaaa", !CACHED);
+  FETCH(1, "bbbbbbbbbb", !CACHED);
+  FETCH(2, "cccccccccc", !CACHED);
+  FETCH(0, "aaaaaaaaaa", !CACHED);
+
+  slru_free(&slru);
+}
+END_TEST
+
+START_TEST(test_adaptive) {
+  struct slru_opts opts = {.protected = 0, .adaptive = 0};
+  slru_t *slru;
+  void *p;
+  int adaptive, i, j, hits;
+
+  /* protect 4 pages, then loop over 6 others. the static SLRU never
+     holds the loop in its 4 probationary slots, while the adaptive one
+     keeps hitting ghosts of pages that never got protected, and so
+     grows the probationary segment until the loop fits */
+  for (adaptive=0; adaptive<2; adaptive++) {
+    opts.adaptive = adaptive;
+    slru = slru_new_ex(10, 8, &opts);
+    fail_unless(slru != NULL);
+
+    for (i=0; i<4; i++) {
+      FETCH(i, "aaaaaaaaaa", !CACHED);
+      FETCH(i, "aaaaaaaaaa", CACHED);
+    }
+
+    hits = 0;
+    for (j=0; j<10; j++)
+      for (i=0; i<6; i++)
+        hits += CACHED == slru_fetch(slru, 100 + i, &p);
+
+    if (adaptive)
+      fail_unless(hits > 30);
+    else
+      fail_unless(hits == 0);
+
+    slru_free(&slru);
+    fail_unless(slru == NULL);
+  }
+}
+END_TEST
+
+START_TEST(test_ghost) {
+  struct slru_opts opts = {.protected = 0, .adaptive = 0, .ghost = 0};
+  slru_t *slru;
+  int ghost, i;
+
+  /* 0 to 3 are evicted from probation and, with the ghost option,
+     remembered, so that 0 is protected when it comes back and a scan
+     through the probationary segment doesn't evict it. The adaptive
+     SLRU does the same. */
+  for (ghost=0; ghost<3; ghost++) {
+    opts.ghost = ghost > 0;
+    opts.adaptive = ghost > 1;
+    slru = slru_new_ex(10, 8, &opts);
+    fail_unless(slru != NULL);
+
+    for (i=0; i<8; i++)
+      FETCH(i, "xxxxxxxxxx", !CACHED);
+    FETCH(0, "aaaaaaaaaa", !CACHED);
+    for (i=100; i<120; i++)
+      FETCH(i, "xxxxxxxxxx", !CACHED);
+    if (ghost)
+      FETCH(0, "aaaaaaaaaa", CACHED);
+    else
+      FETCH(0, "aaaaaaaaaa", !CACHED);
+
+    slru_free(&slru);
+  }
+}
+END_TEST
+
+START_TEST(test_segments) {
+  size_t segment[] = {0, 2, 2, 2};
+  struct slru_opts opts = {.protected = 0, .adaptive = 0,
+                           .nsegments = 4, .segment = segment};
+  slru_t *slru = slru_new_ex(10, 8, &opts);
+  int i;
+
+  fail_unless(slru != NULL);
+
+  /* 0/a makes it to the top segment with 3 hits */
+  FETCH(0, "aaaaaaaaaa", !CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+
+  /* 1/b through 4/e make it to segment 1, which only holds 2 of them,
+     so 1/b and 2/c are pushed back to the probationary segment */
+  FETCH(1, "bbbbbbbbbb", !CACHED);
+  FETCH(2, "cccccccccc", !CACHED);
+  FETCH(1, "bbbbbbbbbb", CACHED);
+  FETCH(2, "cccccccccc", CACHED);
+  FETCH(3, "dddddddddd", !CACHED);
+  FETCH(4, "eeeeeeeeee", !CACHED);
+  FETCH(3, "dddddddddd", CACHED);
+  FETCH(4, "eeeeeeeeee", CACHED);
+
+  /* the probationary segment holds 2 pages, so a scan evicts 1/b and
+     2/c but doesn't touch the upper segments */
+  for (i=10; i<20; i++)
+    FETCH(i, "xxxxxxxxxx", !CACHED);
+  FETCH(1, "bbbbbbbbbb", !CACHED);
+  FETCH(2, "cccccccccc", !CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(3, "dddddddddd", CACHED);
+  FETCH(4, "eeeeeeeeee", CACHED);
+
+  slru_free(&slru);
+  fail_unless(slru == NULL);
+
+  /* adaptive needs exactly 2 segments */
+  opts.adaptive = 1;
+  fail_unless(NULL == slru_new_ex(10, 8, &opts));
+}
+END_TEST
+
+START_TEST(test_ttl) {
+  slru_t *slru = slru_new(10, 8);
+
+  /* 0-3 live until 10 in the protected segment, 4-7 forever */
+  FETCH_TTL(0, 0, 10, "aaaaaaaaaa", !CACHED);
+  FETCH_TTL(1, 0, 10, "bbbbbbbbbb", !CACHED);
+  FETCH_TTL(2, 0, 10, "cccccccccc", !CACHED);
+  FETCH_TTL(3, 0, 10, "dddddddddd", !CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(1, "bbbbbbbbbb", CACHED);
+  FETCH(2, "cccccccccc", CACHED);
+  FETCH(3, "dddddddddd", CACHED);
+  FETCH_TTL(4, 0, 0, "eeeeeeeeee", !CACHED);
+  FETCH_TTL(5, 0, 0, "ffffffffff", !CACHED);
+  FETCH_TTL(6, 0, 0, "gggggggggg", !CACHED);
+  FETCH_TTL(7, 0, 0, "hhhhhhhhhh", !CACHED);
+  FETCH_TTL(0, 9, 10, "aaaaaaaaaa", CACHED);
+
+  /* an expired page is a miss, and reloading it gives it a new ttl */
+  FETCH_TTL(0, 10, 100, "AAAAAAAAAA", !CACHED);
+  FETCH_TTL(0, 11, 100, "AAAAAAAAAA", CACHED);
+
+  /* expired pages are reclaimed before live ones are evicted */
+  FETCH_TTL(8, 20, 0, "iiiiiiiiii", !CACHED);
+  FETCH_TTL(9, 20, 0, "jjjjjjjjjj", !CACHED);
+  FETCH(10, "kkkkkkkkkk", !CACHED);
+  FETCH(0, "AAAAAAAAAA", CACHED);
+  FETCH(4, "eeeeeeeeee", CACHED);
+  FETCH(5, "ffffffffff", CACHED);
+  FETCH(6, "gggggggggg", CACHED);
+  FETCH(7, "hhhhhhhhhh", CACHED);
+  FETCH(8, "iiiiiiiiii", CACHED);
+  FETCH(9, "jjjjjjjjjj", CACHED);
+  FETCH(10, "kkkkkkkkkk", CACHED);
+
+  slru_free(&slru);
+  fail_unless(slru == NULL);
+}
+END_TEST
+
+START_TEST(test_invalidate) {
+  slru_t *slru = slru_new(10, 4);
+
+  fail_unless(slru != NULL);
+
+  FETCH(0, "aaaaaaaaaa", !CACHED);
+  FETCH(1, "bbbbbbbbbb", !CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(1, "bbbbbbbbbb", CACHED);
+  FETCH(2, "cccccccccc", !CACHED);
+  FETCH(3, "dddddddddd", !CACHED);
+
+  /* an invalidated page is gone, and makes room in its segment
+     without evicting, after which the probationary LRU page goes
+     before the older protected ones */
+  fail_unless(0 == slru_invalidate(slru, 2));
+  fail_unless(1 == slru_invalidate(slru, 2));
+  fail_unless(1 == slru_invalidate(slru, 100));
+  FETCH(4, "eeeeeeeeee", !CACHED);
+  FETCH(5, "ffffffffff", !CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(1, "bbbbbbbbbb", CACHED);
+  FETCH(4, "eeeeeeeeee", CACHED);
+  FETCH(5, "ffffffffff", CACHED);
+  FETCH(3, "dddddddddd", !CACHED);
+
+  slru_free(&slru);
+  fail_unless(slru == NULL);
+}
+END_TEST
+
+START_TEST(test_resize) {
+  slru_t *slru = slru_new(10, 4);
+
+  FETCH(0, "aaaaaaaaaa", !CACHED);
+  FETCH(1, "bbbbbbbbbb", !CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(1, "bbbbbbbbbb", CACHED);
+  FETCH(2, "cccccccccc", !CACHED);
+  FETCH(3, "dddddddddd", !CACHED);
+
+  /* growing keeps every page, and both segments double, so 2 and
+     3 join 0 and 1 in the protected one */
+  fail_unless(0 == slru_resize(slru, 8));
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(1, "bbbbbbbbbb", CACHED);
+  FETCH(2, "cccccccccc", CACHED);
+  FETCH(3, "dddddddddd", CACHED);
+  FETCH(4, "eeeeeeeeee", !CACHED);
+  FETCH(5, "ffffffffff", !CACHED);
+  FETCH(6, "gggggggggg", !CACHED);
+  FETCH(7, "hhhhhhhhhh", !CACHED);
+  FETCH(5, "ffffffffff", CACHED);
+  FETCH(1, "bbbbbbbbbb", CACHED);
+
+  /* shrinking halves the segments again, the protected one keeping
+     its MRU pages 5 and 1 and demoting 2 and 3, which outlive the
+     older probationary pages */
+  fail_unless(0 == slru_resize(slru, 4));
+  FETCH(1, "bbbbbbbbbb", CACHED);
+  FETCH(2, "cccccccccc", CACHED);
+  FETCH(3, "dddddddddd", CACHED);
+  FETCH(5, "ffffffffff", CACHED);
+  FETCH(0, "aaaaaaaaaa", !CACHED);
+
+  /* but not below a page per segment */
+  fail_unless(-1 == slru_resize(slru, 1));
+
+  slru_free(&slru);
+  fail_unless(slru == NULL);
+}
+END_TEST
+
+START_TEST(test_prefetch) {
+  slru_t *slru = slru_new(10, 8);
+
+  fail_unless(slru != NULL);
+
+  /* 0 and 1 protected, 2 and 3 probationary */
+  FETCH(0, "aaaaaaaaaa", !CACHED);
+  FETCH(1, "bbbbbbbbbb", !CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(1, "bbbbbbbbbb", CACHED);
+  FETCH(2, "cccccccccc", !CACHED);
+  FETCH(3, "dddddddddd", !CACHED);
+
+  /* prefetched pages share the probationary segment's room, and go
+     first once they are more than a quarter of it */
+  PREFETCH(4, "eeeeeeeeee", !CACHED);
+  PREFETCH(5, "ffffffffff", !CACHED);
+  PREFETCH(6, "gggggggggg", !CACHED);
+  PREFETCH(1, "bbbbbbbbbb", CACHED);
+
+  /* once fetched, a prefetched page is probationary */
+  FETCH(5, "ffffffffff", CACHED);
+  FETCH(7, "hhhhhhhhhh", !CACHED);
+  FETCH(4, "eeeeeeeeee", !CACHED);
+  FETCH(6, "gggggggggg", CACHED);
+  FETCH(5, "ffffffffff", CACHED);
+  FETCH(2, "cccccccccc", !CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+
+  slru_free(&slru);
+}
+END_TEST
+
 Suite *slru_suite() {
   TCase *tc;
   Suite *s;
@@ -202,6 +495,14 @@ Suite *slru_suite() {
   tcase_add_test (tc, test_promotion);
   tcase_add_test (tc, test_demotion);
   tcase_add_test (tc, test_probationary_eviction);
+  tcase_add_test (tc, test_protected_size);
+  tcase_add_test (tc, test_adaptive);
+  tcase_add_test (tc, test_ghost);
+  tcase_add_test (tc, test_segments);
+  tcase_add_test (tc, test_ttl);
+  tcase_add_test (tc, test_invalidate);
+  tcase_add_test (tc, test_resize);
+  tcase_add_test (tc, test_prefetch);
   suite_add_tcase (s, tc);
 
   return s;
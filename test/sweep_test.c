@@ -0,0 +1,86 @@
+#include <check.h>
+#include <string.h>
+#include "rng.h"
+#include "sweep.h"
+
+#define MAX_N 300
+
+/* The obvious one-at-a-time clock hand, to compare against */
+static size_t reference(uint8_t *c, size_t n, size_t hand) {
+  while (c[hand]) {
+    c[hand]--;
+    if (++hand >= n)
+      hand = 0;
+  }
+  return hand;
+}
+
+START_TEST(test_simple) {
+  uint8_t c[5] = {1, 1, 0, 1, 1};
+
+  /* stops at the first zero, decrementing on the way */
+  fail_unless(2 == sweep(c, 5, 0));
+  fail_unless(c[0] == 0 && c[1] == 0 && c[2] == 0);
+  fail_unless(c[3] == 1 && c[4] == 1);
+
+  /* a zero under the hand is the victim right away */
+  fail_unless(2 == sweep(c, 5, 2));
+
+  /* wraps around */
+  fail_unless(0 == sweep(c, 5, 3));
+  fail_unless(c[3] == 0 && c[4] == 0);
+
+  /* and laps as many times as it takes, here three full laps */
+  memset(c, 3, 5);
+  c[4] = 4;
+  fail_unless(1 == sweep(c, 5, 1));
+  fail_unless(c[0] == 0 && c[1] == 0 && c[2] == 0 && c[4] == 1);
+}
+END_TEST
+
+START_TEST(test_compare) {
+  uint8_t c[MAX_N], d[MAX_N];
+  rng_t rng;
+  size_t n, hand, i;
+  int round, max;
+
+  /* all sizes around the vector widths, all sorts of counters */
+  rng_seed(&rng, 1);
+  for (n=1; n<MAX_N; n++)
+    for (round=0; round<20; round++) {
+      max = 1 + rng_range(&rng, 4);
+      for (i=0; i<n; i++)
+        c[i] = rng_range(&rng, 8) ? rng_range(&rng, max) + 1 : 0;
+      if (round % 4 == 0)
+        memset(c, max, n);
+      memcpy(d, c, n);
+      hand = rng_range(&rng, n);
+      fail_unless(reference(d, n, hand) == sweep(c, n, hand));
+      fail_unless(!memcmp(c, d, n));
+    }
+}
+END_TEST
+
+Suite *sweep_suite() {
+  TCase *tc;
+  Suite *s;
+
+  s = suite_create ("sweep");
+
+  tc = tcase_create ("foo");
+  tcase_add_test (tc, test_simple);
+  tcase_add_test (tc, test_compare);
+  suite_add_tcase (s, tc);
+
+  return s;
+}
+
+int main(void) {
+  int number_failed;
+  Suite *s = sweep_suite();
+  SRunner *sr = srunner_create(s);
+  srunner_run_all (sr, CK_NORMAL);
+  number_failed = srunner_ntests_failed (sr);
+  srunner_free (sr);
+  return (number_failed == 0) ? 0 : 1;
+}
@@ -0,0 +1,198 @@
+#include <stdio.h>
+#include <string.h>
+#include <check.h>
+#include "tenant.h"
+
+
+/* each tenant's page of a key holds different data */
+#define CACHED 0
+#define FETCH(tenant, key, cached)                                \
+  do {                                                            \
+    char data[32];                                                \
+    void *p;                                                      \
+    snprintf(data, sizeof(data), "tenant %d key %d",              \
+             tenant, key);                                        \
+    fail_unless(cached == tenant_fetch(tc, tenant, key, &p));     \
+    if (cached == CACHED)                                         \
+      fail_unless(!memcmp(p, data, strlen(data)));                \
+    else                                                          \
+      memcpy(p, data, strlen(data));                              \
+  } while(0)
+
+#define STATS(tenant, h, m, e, u)                                 \
+  do {                                                            \
+    struct tenant_stats st;                                       \
+    fail_unless(0 == tenant_stats(tc, tenant, &st));              \
+    fail_unless(st.hits == h && st.misses == m &&                 \
+                st.evictions == e && st.used == u);               \
+  } while(0)
+
+START_TEST(test_share) {
+  tenant_t *tc = tenant_new(32, 8, 2);
+  int k;
+
+  fail_unless(tc != NULL);
+
+  /* an idle tenant leaves all pages to the other */
+  for (k=0; k<8; k++)
+    FETCH(0, k, !CACHED);
+  for (k=0; k<8; k++)
+    FETCH(0, k, CACHED);
+
+  /* which gives them up, LRU first, until both have their share */
+  for (k=0; k<4; k++)
+    FETCH(1, k, !CACHED);
+  STATS(0, 8, 8, 4, 4);
+  STATS(1, 0, 4, 0, 4);
+
+  /* after which each tenant makes room itself */
+  FETCH(1, 4, !CACHED);
+  for (k=4; k<8; k++)
+    FETCH(0, k, CACHED);
+  for (k=1; k<5; k++)
+    FETCH(1, k, CACHED);
+  FETCH(1, 0, !CACHED);
+  FETCH(0, 0, !CACHED);
+  FETCH(0, 5, CACHED);
+  FETCH(1, 2, CACHED);
+  FETCH(0, 4, !CACHED);
+  FETCH(1, 1, !CACHED);
+
+  tenant_free(&tc);
+  fail_unless(tc == NULL);
+}
+END_TEST
+
+START_TEST(test_grow) {
+  tenant_t *tc = tenant_new(32, 1024, 2);
+  int k;
+
+  fail_unless(tc != NULL);
+
+  /* a tenant's index grows to hold far more pages than it starts
+     with, and shrinks back to its share as the other moves in */
+  for (k=0; k<1024; k++)
+    FETCH(0, k, !CACHED);
+  for (k=0; k<1024; k++)
+    FETCH(0, k, CACHED);
+  STATS(0, 1024, 1024, 0, 1024);
+  for (k=0; k<512; k++)
+    FETCH(1, k, !CACHED);
+  STATS(0, 1024, 1024, 512, 512);
+  STATS(1, 0, 512, 0, 512);
+  for (k=512; k<1024; k++)
+    FETCH(0, k, CACHED);
+  for (k=0; k<512; k++)
+    FETCH(1, k, CACHED);
+
+  tenant_free(&tc);
+}
+END_TEST
+
+START_TEST(test_weight_min) {
+  struct tenant_opts opts[2] = {{.weight = 3}, {.min = 4}};
+  tenant_t *tc = tenant_new_ex(32, 8, 2, opts);
+  int k;
+
+  fail_unless(tc != NULL);
+
+  for (k=10; k<18; k++)
+    FETCH(1, k, !CACHED);
+
+  /* tenant 0's share is 6 pages, but tenant 1 keeps its min of 4 */
+  for (k=0; k<8; k++)
+    FETCH(0, k, !CACHED);
+  STATS(0, 0, 8, 4, 4);
+  STATS(1, 0, 8, 4, 4);
+  for (k=4; k<8; k++)
+    FETCH(0, k, CACHED);
+  for (k=14; k<18; k++)
+    FETCH(1, k, CACHED);
+  FETCH(0, 0, !CACHED);
+  FETCH(1, 10, !CACHED);
+
+  tenant_free(&tc);
+}
+END_TEST
+
+START_TEST(test_max) {
+  struct tenant_opts opts[2] = {{.max = 3}, {.min = 0}};
+  tenant_t *tc = tenant_new_ex(32, 8, 2, opts);
+  int k;
+
+  fail_unless(tc != NULL);
+
+  /* pages are free, but tenant 0 may only have 3 */
+  for (k=0; k<5; k++)
+    FETCH(0, k, !CACHED);
+  STATS(0, 0, 5, 2, 3);
+  for (k=2; k<5; k++)
+    FETCH(0, k, CACHED);
+  FETCH(0, 0, !CACHED);
+  FETCH(0, 2, !CACHED);
+
+  for (k=0; k<5; k++)
+    FETCH(1, k, !CACHED);
+  STATS(1, 0, 5, 0, 5);
+
+  tenant_free(&tc);
+}
+END_TEST
+
+START_TEST(test_invalid) {
+  struct tenant_opts opts[2] = {{.min = 4}, {.min = 4}};
+  tenant_t *tc;
+  void *p;
+
+  /* the mins must leave a page to evict */
+  fail_unless(NULL == tenant_new_ex(32, 8, 2, opts));
+  opts[1].min = 3;
+  opts[0].max = 3;
+  fail_unless(NULL == tenant_new_ex(32, 8, 2, opts));
+  opts[0].max = 0;
+
+  tc = tenant_new_ex(32, 8, 2, opts);
+  fail_unless(tc != NULL);
+
+  fail_unless(-1 == tenant_fetch(tc, 2, 0, &p));
+  fail_unless(-1 == tenant_fetch(tc, -1, 0, &p));
+  fail_unless(-1 == tenant_invalidate(tc, 2, 0));
+
+  FETCH(0, 1, !CACHED);
+  FETCH(1, 1, !CACHED);
+  fail_unless(0 == tenant_invalidate(tc, 0, 1));
+  fail_unless(1 == tenant_invalidate(tc, 0, 1));
+  STATS(0, 0, 1, 0, 0);
+  FETCH(1, 1, CACHED);
+  FETCH(0, 1, !CACHED);
+
+  tenant_free(&tc);
+}
+END_TEST
+
+Suite *tenant_suite() {
+  TCase *tc;
+  Suite *s;
+
+  s = suite_create ("tenant");
+
+  tc = tcase_create ("foo");
+  tcase_add_test (tc, test_share);
+  tcase_add_test (tc, test_grow);
+  tcase_add_test (tc, test_weight_min);
+  tcase_add_test (tc, test_max);
+  tcase_add_test (tc, test_invalid);
+  suite_add_tcase (s, tc);
+
+  return s;
+}
+
+int main(void) {
+  int number_failed;
+  Suite *s = tenant_suite();
+  SRunner *sr = srunner_create(s);
+  srunner_run_all (sr, CK_NORMAL);
+  number_failed = srunner_ntests_failed (sr);
+  srunner_free (sr);
+  return (number_failed == 0) ? 0 : 1;
+}
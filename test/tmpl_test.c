@@ -0,0 +1,256 @@
+#include <stdio.h>
+#include <string.h>
+#include <check.h>
+#include "gclk.h"
+#include "rnd.h"
+
+#define TMPL_NAME   fifo4
+#define TMPL_POLICY TMPL_FIFO
+#define TMPL_SIZE   10
+#define TMPL_NMEMB  4
+#include "tmpl.h"
+
+#define TMPL_NAME   clk4
+#define TMPL_POLICY TMPL_CLK
+#define TMPL_SIZE   10
+#define TMPL_NMEMB  4
+#include "tmpl.h"
+
+#define TMPL_NAME   clk4_swiss
+#define TMPL_POLICY TMPL_CLK
+#define TMPL_SIZE   10
+#define TMPL_NMEMB  4
+#define TMPL_INDEX  TMPL_SWISS
+#include "tmpl.h"
+
+#define TMPL_NAME   lru4
+#define TMPL_POLICY TMPL_LRU
+#define TMPL_SIZE   10
+#define TMPL_NMEMB  4
+#include "tmpl.h"
+
+#define TMPL_NAME   lru_chained
+#define TMPL_POLICY TMPL_LRU
+#define TMPL_SIZE   8
+#define TMPL_NMEMB  200
+#include "tmpl.h"
+
+#define TMPL_NAME   lru_swiss
+#define TMPL_POLICY TMPL_LRU
+#define TMPL_SIZE   8
+#define TMPL_NMEMB  200
+#define TMPL_INDEX  TMPL_SWISS
+#include "tmpl.h"
+
+#define TMPL_NAME   gclk64
+#define TMPL_POLICY TMPL_GCLK
+#define TMPL_SIZE   8
+#define TMPL_NMEMB  64
+#include "tmpl.h"
+
+#define TMPL_NAME   rnd64
+#define TMPL_POLICY TMPL_RND
+#define TMPL_SIZE   8
+#define TMPL_NMEMB  64
+#include "tmpl.h"
+
+#define CACHED 0
+#define FETCH(fetch, key, data, cached)                       \
+  do {                                                        \
+    void *p;                                                  \
+    fail_unless(cached == fetch(c, key, &p));                 \
+    if (cached == CACHED)                                     \
+      fail_unless(!memcmp(p, data, strlen(data)));            \
+    else                                                      \
+      memcpy(p, data, strlen(data));                          \
+  } while(0)
+
+START_TEST(test_fifo) {
+  fifo4_t *c = fifo4_new();
+
+  fail_unless(c != NULL);
+
+  FETCH(fifo4_fetch, 0, "aaaaaaaaaa", !CACHED);
+  FETCH(fifo4_fetch, 1, "bbbbbbbbbb", !CACHED);
+  FETCH(fifo4_fetch, 2, "cccccccccc", !CACHED);
+  FETCH(fifo4_fetch, 3, "dddddddddd", !CACHED);
+  FETCH(fifo4_fetch, 0, "aaaaaaaaaa", CACHED);
+
+  /* hits don't matter, the oldest goes first */
+  FETCH(fifo4_fetch, 4, "eeeeeeeeee", !CACHED);
+  FETCH(fifo4_fetch, 1, "bbbbbbbbbb", CACHED);
+  FETCH(fifo4_fetch, 0, "AAAAAAAAAA", !CACHED);
+  FETCH(fifo4_fetch, 2, "cccccccccc", CACHED);
+  FETCH(fifo4_fetch, 1, "BBBBBBBBBB", !CACHED);
+  FETCH(fifo4_fetch, 3, "dddddddddd", CACHED);
+  FETCH(fifo4_fetch, 4, "eeeeeeeeee", CACHED);
+  FETCH(fifo4_fetch, 0, "AAAAAAAAAA", CACHED);
+  FETCH(fifo4_fetch, 1, "BBBBBBBBBB", CACHED);
+  FETCH(fifo4_fetch, 2, "CCCCCCCCCC", !CACHED);
+
+  fifo4_free(&c);
+  fail_unless(c == NULL);
+}
+END_TEST
+
+START_TEST(test_clk) {
+  clk4_t *c = clk4_new();
+
+  fail_unless(c != NULL);
+
+  FETCH(clk4_fetch, 0, "aaaaaaaaaa", !CACHED);
+  FETCH(clk4_fetch, 1, "bbbbbbbbbb", !CACHED);
+  FETCH(clk4_fetch, 2, "cccccccccc", !CACHED);
+  FETCH(clk4_fetch, 3, "dddddddddd", !CACHED);
+  FETCH(clk4_fetch, 0, "aaaaaaaaaa", CACHED);
+
+  /* 0 was referenced, so 1 goes, and the hand moves on to 2 */
+  FETCH(clk4_fetch, 4, "eeeeeeeeee", !CACHED);
+  FETCH(clk4_fetch, 0, "aaaaaaaaaa", CACHED);
+  FETCH(clk4_fetch, 2, "cccccccccc", CACHED);
+  FETCH(clk4_fetch, 1, "bbbbbbbbbb", !CACHED);
+  FETCH(clk4_fetch, 2, "cccccccccc", CACHED);
+  FETCH(clk4_fetch, 3, "dddddddddd", !CACHED);
+  FETCH(clk4_fetch, 4, "EEEEEEEEEE", !CACHED);
+
+  clk4_free(&c);
+}
+END_TEST
+
+START_TEST(test_clk_swiss) {
+  clk4_swiss_t *c = clk4_swiss_new();
+
+  fail_unless(c != NULL);
+
+  FETCH(clk4_swiss_fetch, 0, "aaaaaaaaaa", !CACHED);
+  FETCH(clk4_swiss_fetch, 1, "bbbbbbbbbb", !CACHED);
+  FETCH(clk4_swiss_fetch, 2, "cccccccccc", !CACHED);
+  FETCH(clk4_swiss_fetch, 3, "dddddddddd", !CACHED);
+  FETCH(clk4_swiss_fetch, 0, "aaaaaaaaaa", CACHED);
+
+  FETCH(clk4_swiss_fetch, 4, "eeeeeeeeee", !CACHED);
+  FETCH(clk4_swiss_fetch, 0, "aaaaaaaaaa", CACHED);
+  FETCH(clk4_swiss_fetch, 2, "cccccccccc", CACHED);
+  FETCH(clk4_swiss_fetch, 1, "bbbbbbbbbb", !CACHED);
+  FETCH(clk4_swiss_fetch, 2, "cccccccccc", CACHED);
+  FETCH(clk4_swiss_fetch, 3, "dddddddddd", !CACHED);
+  FETCH(clk4_swiss_fetch, 4, "EEEEEEEEEE", !CACHED);
+
+  clk4_swiss_free(&c);
+}
+END_TEST
+
+START_TEST(test_lru) {
+  lru4_t *c = lru4_new();
+
+  fail_unless(c != NULL);
+
+  FETCH(lru4_fetch, 0, "aaaaaaaaaa", !CACHED);
+  FETCH(lru4_fetch, 1, "bbbbbbbbbb", !CACHED);
+  FETCH(lru4_fetch, 2, "cccccccccc", !CACHED);
+  FETCH(lru4_fetch, 3, "dddddddddd", !CACHED);
+  FETCH(lru4_fetch, 0, "aaaaaaaaaa", CACHED);
+
+  /* least recently used first */
+  FETCH(lru4_fetch, 4, "eeeeeeeeee", !CACHED);
+  FETCH(lru4_fetch, 2, "cccccccccc", CACHED);
+  FETCH(lru4_fetch, 1, "bbbbbbbbbb", !CACHED);
+  FETCH(lru4_fetch, 3, "dddddddddd", !CACHED);
+  FETCH(lru4_fetch, 0, "AAAAAAAAAA", !CACHED);
+  FETCH(lru4_fetch, 2, "cccccccccc", CACHED);
+  FETCH(lru4_fetch, 4, "EEEEEEEEEE", !CACHED);
+  FETCH(lru4_fetch, 1, "BBBBBBBBBB", !CACHED);
+  FETCH(lru4_fetch, 0, "AAAAAAAAAA", CACHED);
+
+  lru4_free(&c);
+}
+END_TEST
+
+START_TEST(test_index) {
+  /* both indexes find the same pages through plenty of evictions */
+  lru_chained_t *c = lru_chained_new();
+  lru_swiss_t *s = lru_swiss_new();
+  uint64_t key, x = 1;
+  void *p, *q;
+  int i;
+
+  fail_unless(c != NULL && s != NULL);
+
+  for (i=0; i<100000; i++) {
+    x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+    key = (x >> 33) % 300;
+    fail_unless(lru_chained_fetch(c, key, &p) == lru_swiss_fetch(s, key, &q));
+    fail_unless((uint8_t *)p - c->page == (uint8_t *)q - s->page);
+  }
+
+  lru_chained_free(&c);
+  lru_swiss_free(&s);
+}
+END_TEST
+
+/* the templates evict the same pages as the library policies, so
+   the same fetches hit */
+#define REPLAY(c, fetch, lib, lib_fetch)                                \
+  do {                                                                  \
+    uint64_t key, x = 1;                                                \
+    void *p, *q;                                                        \
+    int i;                                                              \
+                                                                        \
+    fail_unless(c != NULL && lib != NULL);                              \
+    for (i=0; i<100000; i++) {                                          \
+      x = x * 6364136223846793005ULL + 1442695040888963407ULL;          \
+      key = (x >> 33) % 100;                                            \
+      fail_unless(fetch(c, key, &p) == lib_fetch(lib, key, &q));        \
+    }                                                                   \
+  } while(0)
+
+START_TEST(test_gclk) {
+  gclk64_t *c = gclk64_new();
+  gclk_t *lib = gclk_new(8, 64);
+
+  REPLAY(c, gclk64_fetch, lib, gclk_fetch);
+
+  gclk64_free(&c);
+  gclk_free(&lib);
+}
+END_TEST
+
+START_TEST(test_rnd) {
+  rnd64_t *c = rnd64_new();
+  rnd_t *lib = rnd_new(8, 64);
+
+  REPLAY(c, rnd64_fetch, lib, rnd_fetch);
+
+  rnd64_free(&c);
+  rnd_free(&lib);
+}
+END_TEST
+
+Suite *tmpl_suite() {
+  TCase *tc;
+  Suite *s;
+
+  s = suite_create ("tmpl");
+
+  tc = tcase_create ("foo");
+  tcase_add_test (tc, test_fifo);
+  tcase_add_test (tc, test_clk);
+  tcase_add_test (tc, test_clk_swiss);
+  tcase_add_test (tc, test_lru);
+  tcase_add_test (tc, test_gclk);
+  tcase_add_test (tc, test_rnd);
+  tcase_add_test (tc, test_index);
+  suite_add_tcase (s, tc);
+
+  return s;
+}
+
+int main(void) {
+  int number_failed;
+  Suite *s = tmpl_suite();
+  SRunner *sr = srunner_create(s);
+  srunner_run_all (sr, CK_NORMAL);
+  number_failed = srunner_ntests_failed (sr);
+  srunner_free (sr);
+  return (number_failed == 0) ? 0 : 1;
+}
@@ -0,0 +1,173 @@
+#include <check.h>
+#include <string.h>
+#include "tracegen.h"
+
+#define MAX_PHASES 8
+
+START_TEST(test_reproducible) {
+  struct tracegen_phase phase[MAX_PHASES];
+  tracegen_t *a, *b;
+  int i;
+
+  fail_unless(1 == tracegen_parse("zipf:n=1000,alpha=0.8", phase,
+                                  MAX_PHASES));
+
+  /* same seed, same keys */
+  a = tracegen_new(phase, 1, 42);
+  b = tracegen_new(phase, 1, 42);
+  fail_unless(a != NULL && b != NULL);
+  for (i=0; i<10000; i++)
+    fail_unless(tracegen_next(a) == tracegen_next(b));
+  tracegen_free(&b);
+  fail_unless(b == NULL);
+
+  /* different seed, different keys */
+  b = tracegen_new(phase, 1, 43);
+  for (i=0; i<100; i++)
+    if (tracegen_next(a) != tracegen_next(b))
+      break;
+  fail_unless(i < 100);
+
+  tracegen_free(&a);
+  tracegen_free(&b);
+}
+END_TEST
+
+START_TEST(test_ranges) {
+  struct tracegen_phase phase[MAX_PHASES];
+  tracegen_t *tg;
+  uint64_t key;
+  int i, hits;
+
+  /* uniform, zipf and hotset keys stay within [base, base+n) */
+  fail_unless(3 == tracegen_parse("uniform:n=100,base=1000,len=1000+"
+                                  "zipf:n=100,base=1000,len=1000+"
+                                  "hotset:n=100,base=1000,hot=10,len=1000",
+                                  phase, MAX_PHASES));
+  tg = tracegen_new(phase, 3, 1);
+  for (i=0; i<3000; i++) {
+    key = tracegen_next(tg);
+    fail_unless(1000 <= key && key < 1100);
+  }
+  tracegen_free(&tg);
+
+  /* zipf favours the low keys */
+  fail_unless(1 == tracegen_parse("zipf:n=1000000,alpha=1", phase,
+                                  MAX_PHASES));
+  tg = tracegen_new(phase, 1, 1);
+  hits = 0;
+  for (i=0; i<10000; i++)
+    if (tracegen_next(tg) < 1000)
+      hits++;
+  fail_unless(hits > 4000);
+  tracegen_free(&tg);
+}
+END_TEST
+
+START_TEST(test_scan_loop) {
+  struct tracegen_phase phase[MAX_PHASES];
+  tracegen_t *tg;
+  uint64_t key[12];
+
+  /* loop wraps around after n keys, scan never repeats */
+  fail_unless(2 == tracegen_parse("loop:n=3,len=4+scan:base=100,len=2",
+                                  phase, MAX_PHASES));
+  tg = tracegen_new(phase, 2, 1);
+  tracegen_fill(tg, key, 12);
+  fail_unless(key[0] == 0);
+  fail_unless(key[1] == 1);
+  fail_unless(key[2] == 2);
+  fail_unless(key[3] == 0);
+  fail_unless(key[4] == 100);
+  fail_unless(key[5] == 101);
+  /* phases start over, each keeping its own position */
+  fail_unless(key[6] == 1);
+  fail_unless(key[7] == 2);
+  fail_unless(key[8] == 0);
+  fail_unless(key[9] == 1);
+  fail_unless(key[10] == 102);
+  fail_unless(key[11] == 103);
+  tracegen_free(&tg);
+}
+END_TEST
+
+START_TEST(test_hotset_moves) {
+  struct tracegen_phase phase[MAX_PHASES];
+  tracegen_t *tg;
+  uint64_t key;
+  int i, first, second;
+
+  /* all accesses go to the hot set, which moves after 100 of them */
+  fail_unless(1 == tracegen_parse("hotset:n=1000,hot=10,p=1,period=100",
+                                  phase, MAX_PHASES));
+  tg = tracegen_new(phase, 1, 1);
+  first = second = 0;
+  for (i=0; i<200; i++) {
+    key = tracegen_next(tg);
+    if (key < 10)
+      first++;
+    else if (key < 20)
+      second++;
+  }
+  fail_unless(first == 100);
+  fail_unless(second == 100);
+  tracegen_free(&tg);
+}
+END_TEST
+
+START_TEST(test_parse) {
+  struct tracegen_phase phase[MAX_PHASES];
+
+  fail_unless(1 == tracegen_parse("uniform", phase, MAX_PHASES));
+  fail_unless(phase[0].kind == TRACEGEN_UNIFORM);
+
+  fail_unless(2 == tracegen_parse("zipf:alpha=0.5,len=7+loop:n=9",
+                                  phase, MAX_PHASES));
+  fail_unless(phase[0].kind == TRACEGEN_ZIPF);
+  fail_unless(phase[0].alpha == 0.5);
+  fail_unless(phase[0].len == 7);
+  fail_unless(phase[1].kind == TRACEGEN_LOOP);
+  fail_unless(phase[1].n == 9);
+
+  /* junk is rejected */
+  fail_unless(-1 == tracegen_parse("bogus", phase, MAX_PHASES));
+  fail_unless(-1 == tracegen_parse("zipf:", phase, MAX_PHASES));
+  fail_unless(-1 == tracegen_parse("zipf:alpha", phase, MAX_PHASES));
+  fail_unless(-1 == tracegen_parse("zipf:beta=1", phase, MAX_PHASES));
+  fail_unless(-1 == tracegen_parse("zipf:n=x", phase, MAX_PHASES));
+  fail_unless(-1 == tracegen_parse("scan+scan+scan", phase, 2));
+
+  /* and so are phases that can't produce keys */
+  fail_unless(1 == tracegen_parse("uniform:n=0", phase, MAX_PHASES));
+  fail_unless(NULL == tracegen_new(phase, 1, 1));
+  fail_unless(1 == tracegen_parse("loop:len=0", phase, MAX_PHASES));
+  fail_unless(NULL == tracegen_new(phase, 1, 1));
+}
+END_TEST
+
+Suite *tracegen_suite() {
+  TCase *tc;
+  Suite *s;
+
+  s = suite_create ("tracegen");
+
+  tc = tcase_create ("foo");
+  tcase_add_test (tc, test_reproducible);
+  tcase_add_test (tc, test_ranges);
+  tcase_add_test (tc, test_scan_loop);
+  tcase_add_test (tc, test_hotset_moves);
+  tcase_add_test (tc, test_parse);
+  suite_add_tcase (s, tc);
+
+  return s;
+}
+
+int main(void) {
+  int number_failed;
+  Suite *s = tracegen_suite();
+  SRunner *sr = srunner_create(s);
+  srunner_run_all (sr, CK_NORMAL);
+  number_failed = srunner_ntests_failed (sr);
+  srunner_free (sr);
+  return (number_failed == 0) ? 0 : 1;
+}
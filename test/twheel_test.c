@@ -0,0 +1,141 @@
+#include <check.h>
+#include <stdlib.h>
+#include "rng.h"
+#include "twheel.h"
+
+START_TEST(test_expiry) {
+  twheel_t *tw = twheel_new(10, 0);
+  size_t slot;
+  int i, seen;
+
+  fail_unless(tw != NULL);
+  fail_unless(1 == twheel_pop(tw, 1000, &slot));
+
+  for (i=0; i<10; i++)
+    twheel_set(tw, i, 1000 + 10 * i);
+  fail_unless(!twheel_expired(tw, 0, 999));
+  fail_unless(twheel_expired(tw, 0, 1000));
+  fail_unless(!twheel_expired(tw, 1, 1000));
+
+  fail_unless(!twheel_pop(tw, 1000, &slot));
+  fail_unless(slot == 0);
+  fail_unless(!twheel_expired(tw, 0, 1000));
+  fail_unless(1 == twheel_pop(tw, 1009, &slot));
+
+  /* 1, 2 and 3 have expired by 1035, in any order */
+  seen = 0;
+  while (!twheel_pop(tw, 1035, &slot))
+    seen |= 1 << slot;
+  fail_unless(seen == 0xe);
+
+  /* unscheduled slots never expire, rescheduled ones when told */
+  twheel_del(tw, 4);
+  twheel_set(tw, 5, 5000);
+  twheel_set(tw, 6, 1050);
+  seen = 0;
+  while (!twheel_pop(tw, 1100, &slot))
+    seen |= 1 << slot;
+  fail_unless(seen == 0x3c0);
+  fail_unless(1 == twheel_pop(tw, 4999, &slot));
+  fail_unless(!twheel_pop(tw, 5000, &slot));
+  fail_unless(slot == 5);
+
+  /* time doesn't go back, and the past expires right away */
+  twheel_set(tw, 0, 10);
+  fail_unless(!twheel_pop(tw, 0, &slot));
+  fail_unless(slot == 0);
+
+  twheel_free(&tw);
+  fail_unless(tw == NULL);
+}
+END_TEST
+
+START_TEST(test_far) {
+  twheel_t *tw = twheel_new(2, 7);
+  size_t slot;
+
+  /* from the top level all the way down */
+  twheel_set(tw, 0, 1ULL << 62);
+  twheel_set(tw, 1, UINT64_MAX);
+  fail_unless(1 == twheel_pop(tw, (1ULL << 40), &slot));
+  fail_unless(1 == twheel_pop(tw, (1ULL << 62) - 1, &slot));
+  fail_unless(!twheel_pop(tw, (1ULL << 62), &slot));
+  fail_unless(slot == 0);
+  fail_unless(1 == twheel_pop(tw, UINT64_MAX - 1, &slot));
+  fail_unless(!twheel_pop(tw, UINT64_MAX, &slot));
+  fail_unless(slot == 1);
+
+  twheel_free(&tw);
+}
+END_TEST
+
+#define NSLOTS 1000
+
+START_TEST(test_random) {
+  static uint64_t expire[NSLOTS];
+  static int scheduled[NSLOTS];
+  twheel_t *tw;
+  uint64_t now;
+  size_t slot;
+  rng_t rng;
+  int i, j;
+
+  /* compare against brute force, with time moving in steps small and
+     large so that every level gets some use */
+  rng_seed(&rng, 1);
+  now = 12345;
+  tw = twheel_new(NSLOTS, now);
+  for (i=0; i<NSLOTS; i++)
+    scheduled[i] = 0;
+
+  for (i=0; i<20000; i++) {
+    for (j=0; j<10; j++) {
+      slot = rng_range(&rng, NSLOTS);
+      if (rng_range(&rng, 4)) {
+        expire[slot] = now + (rng_next(&rng) >> (1 + rng_range(&rng, 63)));
+        scheduled[slot] = 1;
+        twheel_set(tw, slot, expire[slot]);
+      } else {
+        scheduled[slot] = 0;
+        twheel_del(tw, slot);
+      }
+    }
+
+    now += rng_next(&rng) >> (20 + rng_range(&rng, 44));
+
+    while (!twheel_pop(tw, now, &slot)) {
+      fail_unless(scheduled[slot] && expire[slot] <= now);
+      scheduled[slot] = 0;
+    }
+    for (j=0; j<NSLOTS; j++)
+      fail_unless(!scheduled[j] || expire[j] > now);
+  }
+
+  twheel_free(&tw);
+}
+END_TEST
+
+Suite *twheel_suite() {
+  TCase *tc;
+  Suite *s;
+
+  s = suite_create ("twheel");
+
+  tc = tcase_create ("foo");
+  tcase_add_test (tc, test_expiry);
+  tcase_add_test (tc, test_far);
+  tcase_add_test (tc, test_random);
+  suite_add_tcase (s, tc);
+
+  return s;
+}
+
+int main(void) {
+  int number_failed;
+  Suite *s = twheel_suite();
+  SRunner *sr = srunner_create(s);
+  srunner_run_all (sr, CK_NORMAL);
+  number_failed = srunner_ntests_failed (sr);
+  srunner_free (sr);
+  return (number_failed == 0) ? 0 : 1;
+}
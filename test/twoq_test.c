@@ -0,0 +1,296 @@
+#include <stdio.h>
+#include <string.h>
+#include <check.h>
+#include "twoq.h"
+
+/* NOTE: these tests assume the default A1in size of nmemb/4 */
+
+#define CACHED 0
+#define FETCH(key, data, cached)                              \
+  do {                                                        \
+    void *p;                                                  \
+    fail_unless(cached == twoq_fetch(twoq, key, &p));         \
+    if (cached == CACHED)                                     \
+      fail_unless(!memcmp(p, data, strlen(data)));            \
+    else                                                      \
+      memcpy(p, data, strlen(data));                          \
+  } while(0)
+
+#define FETCH_TTL(key, now, ttl, data, cached)            \
+  do {                                                    \
+    void *p;                                              \
+    fail_unless(cached == twoq_fetch_ttl(twoq, key, now, ttl, &p)); \
+    if (cached == CACHED)                                 \
+      fail_unless(!memcmp(p, data, strlen(data)));        \
+    else                                                  \
+      memcpy(p, data, strlen(data));                      \
+  } while(0)
+
+START_TEST(test_no_eviction) {
+  twoq_t *twoq = twoq_new(10, 8);
+
+  fail_unless(twoq != NULL);
+
+  FETCH(0, "aaaaaaaaaa", !CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(1, "bbbbbbbbbb", !CACHED);
+  FETCH(2, "cccccccccc", !CACHED);
+  FETCH(3, "dddddddddd", !CACHED);
+  FETCH(4, "eeeeeeeeee", !CACHED);
+  FETCH(5, "ffffffffff", !CACHED);
+  FETCH(6, "gggggggggg", !CACHED);
+  FETCH(7, "hhhhhhhhhh", !CACHED);
+
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(1, "bbbbbbbbbb", CACHED);
+  FETCH(2, "cccccccccc", CACHED);
+  FETCH(3, "dddddddddd", CACHED);
+  FETCH(4, "eeeeeeeeee", CACHED);
+  FETCH(5, "ffffffffff", CACHED);
+  FETCH(6, "gggggggggg", CACHED);
+  FETCH(7, "hhhhhhhhhh", CACHED);
+
+  twoq_free(&twoq);
+  fail_unless(twoq == NULL);
+}
+END_TEST
+
+START_TEST(test_fifo) {
+  twoq_t *twoq = twoq_new(10, 8);
+
+  /* pages in A1in are evicted in FIFO order, even if hit */
+  FETCH(0, "aaaaaaaaaa", !CACHED);
+  FETCH(1, "bbbbbbbbbb", !CACHED);
+  FETCH(2, "cccccccccc", !CACHED);
+  FETCH(3, "dddddddddd", !CACHED);
+  FETCH(4, "eeeeeeeeee", !CACHED);
+  FETCH(5, "ffffffffff", !CACHED);
+  FETCH(6, "gggggggggg", !CACHED);
+  FETCH(7, "hhhhhhhhhh", !CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(8, "iiiiiiiiii", !CACHED);
+  FETCH(1, "bbbbbbbbbb", CACHED);
+  FETCH(2, "cccccccccc", CACHED);
+  FETCH(3, "dddddddddd", CACHED);
+  FETCH(4, "eeeeeeeeee", CACHED);
+  FETCH(5, "ffffffffff", CACHED);
+  FETCH(6, "gggggggggg", CACHED);
+  FETCH(7, "hhhhhhhhhh", CACHED);
+  FETCH(8, "iiiiiiiiii", CACHED);
+
+  twoq_free(&twoq);
+  fail_unless(twoq == NULL);
+}
+END_TEST
+
+START_TEST(test_ghost) {
+  twoq_t *twoq = twoq_new(10, 8);
+  int i;
+
+  for (i=0; i<9; i++)
+    FETCH(i, "xxxxxxxxxx", !CACHED);
+
+  /* 0 was evicted from A1in to A1out, so a miss takes it to Am */
+  FETCH(0, "aaaaaaaaaa", !CACHED);
+
+  /* where a scan doesn't reach it, as A1in is over its size */
+  for (i=100; i<120; i++)
+    FETCH(i, "xxxxxxxxxx", !CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+
+  /* A1in still holds the last pages of the scan */
+  FETCH(119, "xxxxxxxxxx", CACHED);
+  FETCH(118, "xxxxxxxxxx", CACHED);
+
+  /* A1out only remembers so many ghosts, so 1/b is back in A1in
+     rather than in Am, and another scan evicts it */
+  FETCH(1, "bbbbbbbbbb", !CACHED);
+  for (i=200; i<210; i++)
+    FETCH(i, "xxxxxxxxxx", !CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(1, "bbbbbbbbbb", !CACHED);
+
+  twoq_free(&twoq);
+  fail_unless(twoq == NULL);
+}
+END_TEST
+
+START_TEST(test_ghost_filter) {
+  struct twoq_opts opts = {.kin = 0, .kout = 0, .ghost = 1};
+  twoq_t *twoq = twoq_new_ex(10, 8, &opts);
+  int i;
+
+  fail_unless(twoq != NULL);
+
+  for (i=0; i<9; i++)
+    FETCH(i, "xxxxxxxxxx", !CACHED);
+
+  /* the same with A1out a ghost_t */
+  FETCH(0, "aaaaaaaaaa", !CACHED);
+  for (i=100; i<120; i++)
+    FETCH(i, "xxxxxxxxxx", !CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(119, "xxxxxxxxxx", CACHED);
+  FETCH(118, "xxxxxxxxxx", CACHED);
+
+  twoq_free(&twoq);
+  fail_unless(twoq == NULL);
+}
+END_TEST
+
+START_TEST(test_invalidate) {
+  twoq_t *twoq = twoq_new(10, 4);
+
+  fail_unless(twoq != NULL);
+
+  FETCH(0, "aaaaaaaaaa", !CACHED);
+  FETCH(1, "bbbbbbbbbb", !CACHED);
+  FETCH(2, "cccccccccc", !CACHED);
+  FETCH(3, "dddddddddd", !CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+
+  /* an invalidated page is gone, and makes room without evicting,
+     after which A1in loses the page that came in first, hit or not */
+  fail_unless(0 == twoq_invalidate(twoq, 1));
+  fail_unless(1 == twoq_invalidate(twoq, 1));
+  fail_unless(1 == twoq_invalidate(twoq, 100));
+  FETCH(4, "eeeeeeeeee", !CACHED);
+  FETCH(5, "ffffffffff", !CACHED);
+  FETCH(2, "cccccccccc", CACHED);
+  FETCH(3, "dddddddddd", CACHED);
+  FETCH(4, "eeeeeeeeee", CACHED);
+  FETCH(5, "ffffffffff", CACHED);
+
+  /* which A1out remembers, so it comes back into Am and outlives
+     the A1in pages */
+  FETCH(0, "aaaaaaaaaa", !CACHED);
+  FETCH(6, "gggggggggg", !CACHED);
+  FETCH(7, "hhhhhhhhhh", !CACHED);
+  FETCH(8, "iiiiiiiiii", !CACHED);
+  FETCH(9, "jjjjjjjjjj", !CACHED);
+  FETCH(0, "aaaaaaaaaa", CACHED);
+
+  twoq_free(&twoq);
+  fail_unless(twoq == NULL);
+}
+END_TEST
+
+START_TEST(test_resize) {
+  twoq_t *twoq = twoq_new(10, 4);
+
+  FETCH(0, "aaaaaaaaaa", !CACHED);
+  FETCH(1, "bbbbbbbbbb", !CACHED);
+  FETCH(2, "cccccccccc", !CACHED);
+  FETCH(3, "dddddddddd", !CACHED);
+
+  /* growing keeps every page, and adds room for more */
+  fail_unless(0 == twoq_resize(twoq, 8));
+  FETCH(0, "aaaaaaaaaa", CACHED);
+  FETCH(1, "bbbbbbbbbb", CACHED);
+  FETCH(2, "cccccccccc", CACHED);
+  FETCH(3, "dddddddddd", CACHED);
+  FETCH(4, "eeeeeeeeee", !CACHED);
+  FETCH(5, "ffffffffff", !CACHED);
+  FETCH(6, "gggggggggg", !CACHED);
+  FETCH(7, "hhhhhhhhhh", !CACHED);
+
+  /* shrinking drops A1in pages in the order they came in, hit or
+     not, and A1out keeps the last kout of them, so 3 comes back into
+     Am and outlives the A1in pages */
+  fail_unless(0 == twoq_resize(twoq, 4));
+  FETCH(4, "eeeeeeeeee", CACHED);
+  FETCH(5, "ffffffffff", CACHED);
+  FETCH(6, "gggggggggg", CACHED);
+  FETCH(7, "hhhhhhhhhh", CACHED);
+  FETCH(3, "dddddddddd", !CACHED);
+  FETCH(8, "iiiiiiiiii", !CACHED);
+  FETCH(9, "jjjjjjjjjj", !CACHED);
+  FETCH(10, "kkkkkkkkkk", !CACHED);
+  FETCH(11, "llllllllll", !CACHED);
+  FETCH(3, "dddddddddd", CACHED);
+
+  /* but not below what the policy needs */
+  fail_unless(-1 == twoq_resize(twoq, 1));
+
+  twoq_free(&twoq);
+  fail_unless(twoq == NULL);
+}
+END_TEST
+
+START_TEST(test_ttl) {
+  twoq_t *twoq = twoq_new(10, 8);
+
+  /* 0-3 live until 10, 4-7 forever */
+  FETCH_TTL(0, 0, 10, "aaaaaaaaaa", !CACHED);
+  FETCH_TTL(1, 0, 10, "bbbbbbbbbb", !CACHED);
+  FETCH_TTL(2, 0, 10, "cccccccccc", !CACHED);
+  FETCH_TTL(3, 0, 10, "dddddddddd", !CACHED);
+  FETCH_TTL(4, 0, 0, "eeeeeeeeee", !CACHED);
+  FETCH_TTL(5, 0, 0, "ffffffffff", !CACHED);
+  FETCH_TTL(6, 0, 0, "gggggggggg", !CACHED);
+  FETCH_TTL(7, 0, 0, "hhhhhhhhhh", !CACHED);
+  FETCH_TTL(0, 9, 10, "aaaaaaaaaa", CACHED);
+
+  /* an expired page is a miss, and reloading it gives it a new ttl */
+  FETCH_TTL(0, 10, 100, "AAAAAAAAAA", !CACHED);
+  FETCH_TTL(0, 11, 100, "AAAAAAAAAA", CACHED);
+
+  /* expired pages are reclaimed before live ones are evicted */
+  FETCH_TTL(8, 20, 0, "iiiiiiiiii", !CACHED);
+  FETCH_TTL(9, 20, 0, "jjjjjjjjjj", !CACHED);
+  FETCH(10, "kkkkkkkkkk", !CACHED);
+  FETCH(0, "AAAAAAAAAA", CACHED);
+  FETCH(4, "eeeeeeeeee", CACHED);
+  FETCH(5, "ffffffffff", CACHED);
+  FETCH(6, "gggggggggg", CACHED);
+  FETCH(7, "hhhhhhhhhh", CACHED);
+  FETCH(8, "iiiiiiiiii", CACHED);
+  FETCH(9, "jjjjjjjjjj", CACHED);
+  FETCH(10, "kkkkkkkkkk", CACHED);
+
+  /* and leave no ghost in A1out, so a reloaded one enters A1in again,
+     and leaves it after 8 more misses rather than going to Am */
+  FETCH(1, "bbbbbbbbbb", !CACHED);
+  FETCH(11, "llllllllll", !CACHED);
+  FETCH(12, "mmmmmmmmmm", !CACHED);
+  FETCH(13, "nnnnnnnnnn", !CACHED);
+  FETCH(14, "oooooooooo", !CACHED);
+  FETCH(15, "pppppppppp", !CACHED);
+  FETCH(16, "qqqqqqqqqq", !CACHED);
+  FETCH(17, "rrrrrrrrrr", !CACHED);
+  FETCH(18, "ssssssssss", !CACHED);
+  FETCH(1, "bbbbbbbbbb", !CACHED);
+
+  twoq_free(&twoq);
+  fail_unless(twoq == NULL);
+}
+END_TEST
+
+Suite *twoq_suite() {
+  TCase *tc;
+  Suite *s;
+
+  s = suite_create ("twoq");
+
+  tc = tcase_create ("foo");
+  tcase_add_test (tc, test_no_eviction);
+  tcase_add_test (tc, test_fifo);
+  tcase_add_test (tc, test_ghost);
+  tcase_add_test (tc, test_ghost_filter);
+  tcase_add_test (tc, test_invalidate);
+  tcase_add_test (tc, test_resize);
+  tcase_add_test (tc, test_ttl);
+  suite_add_tcase (s, tc);
+
+  return s;
+}
+
+int main(void) {
+  int number_failed;
+  Suite *s = twoq_suite();
+  SRunner *sr = srunner_create(s);
+  srunner_run_all (sr, CK_NORMAL);
+  number_failed = srunner_ntests_failed (sr);
+  srunner_free (sr);
+  return (number_failed == 0) ? 0 : 1;
+}